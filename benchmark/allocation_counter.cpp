@@ -0,0 +1,88 @@
+/*
+* Copyright 2013 Sveriges Television AB http://casparcg.com/
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+
+#include "allocation_counter.h"
+
+#include <tbb/atomic.h>
+
+#include <cstdlib>
+#include <new>
+
+namespace caspar { namespace benchmark {
+
+namespace {
+
+// Zero initialized before any dynamic initialization, operator new can be called from static 
+// constructors.
+tbb::atomic<int64_t> g_count;
+tbb::atomic<int64_t> g_bytes;
+
+void* allocate(size_t size)
+{
+	g_count.fetch_and_increment();
+	g_bytes.fetch_and_add(static_cast<int64_t>(size));
+
+	auto ptr = std::malloc(size > 0 ? size : 1);
+	if(!ptr)
+		throw std::bad_alloc();
+	return ptr;
+}
+
+}
+
+allocation_stats get_allocation_stats()
+{
+	allocation_stats stats;
+	stats.count = g_count;
+	stats.bytes = g_bytes;
+	return stats;
+}
+
+allocation_stats operator-(const allocation_stats& lhs, const allocation_stats& rhs)
+{
+	allocation_stats stats;
+	stats.count = lhs.count - rhs.count;
+	stats.bytes = lhs.bytes - rhs.bytes;
+	return stats;
+}
+
+}}
+
+void* operator new(size_t size)
+{
+	return caspar::benchmark::allocate(size);
+}
+
+void* operator new[](size_t size)
+{
+	return caspar::benchmark::allocate(size);
+}
+
+void operator delete(void* ptr)
+{
+	std::free(ptr);
+}
+
+void operator delete[](void* ptr)
+{
+	std::free(ptr);
+}
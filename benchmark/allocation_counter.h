@@ -19,14 +19,26 @@
 * Author: Robert Nagy, ronag89@gmail.com
 */
 
+
 #pragma once
 
-#include <memory>
+#include <cstdint>
+
+namespace caspar { namespace benchmark {
+
+// Counts every allocation made through the global operator new of the process. The static
+// libraries are linked into the benchmark executable, so this covers all of core and modules
+// but not allocations made inside third party dlls (e.g. ffmpeg).
+struct allocation_stats
+{
+	int64_t count;
+	int64_t bytes;
+
+	allocation_stats() : count(0), bytes(0) {}
+};
 
-struct AVFilterContext;
+allocation_stats get_allocation_stats();
 
-namespace caspar { namespace ffmpeg {
-	
-std::shared_ptr<void> make_parallel_yadif(AVFilterContext* ctx);
+allocation_stats operator-(const allocation_stats& lhs, const allocation_stats& rhs);
 
-}}
\ No newline at end of file
+}}
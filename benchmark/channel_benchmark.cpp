@@ -0,0 +1,354 @@
+/*
+* Copyright 2013 Sveriges Television AB http://casparcg.com/
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+
+#include "channel_benchmark.h"
+
+#include <core/video_channel.h>
+#include <core/consumer/frame_consumer.h>
+#include <core/consumer/output.h>
+#include <core/mixer/mixer.h>
+#include <core/mixer/read_frame.h>
+#include <core/mixer/audio/audio_buffer_pool.h>
+#include <core/producer/stage.h>
+#include <core/producer/frame_producer.h>
+
+#include <common/concurrency/future_util.h>
+#include <common/diagnostics/graph.h>
+
+#include <tbb/atomic.h>
+#include <tbb/spin_mutex.h>
+
+#include <boost/algorithm/string/join.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/foreach.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/thread.hpp>
+#include <boost/timer.hpp>
+
+#include <emmintrin.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <ostream>
+
+namespace caspar { namespace benchmark {
+
+channel_benchmark_params::channel_benchmark_params()
+	: format_desc(core::video_format_desc::get(core::video_format::x1080i5000))
+	, audio_channel_layout(core::channel_layout::stereo())
+	, channels(1)
+	, layers(1)
+	, blend_mode(core::blend_mode::normal)
+	, accumulate(true)
+	, warmup_frames(50)
+	, frames(500)
+{
+	patterns.push_back(synthetic_pattern::bars);
+}
+
+channel_benchmark_result::channel_benchmark_result()
+	: seconds(0.0)
+	, frames(0)
+	, fps(0.0)
+	, audio_heap_allocations(0)
+	, stalled(false)
+{
+}
+
+namespace {
+
+// Sum of all bytes, keeps the reads of the accumulating consumer from being optimized away.
+uint64_t accumulate_bytes(const uint8_t* data, size_t count)
+{
+	auto sum = _mm_setzero_si128();
+	const auto zero = _mm_setzero_si128();
+
+	size_t n = 0;
+	for(; n + 16 <= count; n += 16)
+		sum = _mm_add_epi64(sum, _mm_sad_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + n)), zero));
+
+	uint64_t result = static_cast<uint64_t>(_mm_cvtsi128_si32(sum)) + static_cast<uint64_t>(_mm_cvtsi128_si32(_mm_srli_si128(sum, 8)));
+	for(; n < count; ++n)
+		result += data[n];
+	return result;
+}
+
+class benchmark_consumer : public core::frame_consumer
+{
+	const bool				accumulate_;
+	int						channel_index_;
+	tbb::atomic<int64_t>	frames_;
+	tbb::atomic<int64_t>	age_;
+	uint64_t				checksum_;
+public:
+	explicit benchmark_consumer(bool accumulate)
+		: accumulate_(accumulate)
+		, channel_index_(-1)
+		, checksum_(0)
+	{
+		frames_ = 0;
+		age_	= 0;
+	}
+
+	// frame_consumer
+
+	virtual boost::unique_future<bool> send(const safe_ptr<core::read_frame>& frame) override
+	{
+		if(accumulate_)
+		{
+			auto image = frame->image_data();
+			auto audio = frame->audio_data();
+			checksum_ += accumulate_bytes(image.begin(), image.size());
+			checksum_ += accumulate_bytes(reinterpret_cast<const uint8_t*>(audio.begin()), audio.size()*sizeof(int32_t));
+		}
+
+		age_ = frame->get_age_millis();
+		++frames_;
+
+		return wrap_as_future(true);
+	}
+
+	virtual void initialize(const core::video_format_desc&, int channel_index) override
+	{
+		channel_index_ = channel_index;
+	}
+
+	virtual int64_t presentation_frame_age_millis() const override
+	{
+		return age_;
+	}
+
+	virtual std::wstring print() const override
+	{
+		return L"benchmark[" + boost::lexical_cast<std::wstring>(channel_index_) + L"]";
+	}
+
+	virtual boost::property_tree::wptree info() const override
+	{
+		boost::property_tree::wptree info;
+		info.add(L"type", L"benchmark-consumer");
+		info.add(L"frames", static_cast<int64_t>(frames_));
+		return info;
+	}
+
+	virtual bool has_synchronization_clock() const override
+	{
+		return true;
+	}
+
+	virtual size_t buffer_depth() const override
+	{
+		return 0;
+	}
+
+	virtual int index() const override
+	{
+		return 900;
+	}
+
+	int64_t frames() const
+	{
+		return frames_;
+	}
+};
+
+// Collects the stage timings the channels write to their diagnostics graphs.
+class timing_sink : public diagnostics::sink
+{
+	const double							fps_;
+	tbb::spin_mutex							mutex_;
+	std::map<std::string, stage_timing>		timings_;
+public:
+	explicit timing_sink(double fps)
+		: fps_(fps)
+	{
+	}
+
+	virtual void on_value(const std::wstring& graph_text, const std::string& name, double value) override
+	{
+		if(!boost::starts_with(graph_text, L"video_channel[") || !boost::ends_with(name, "-time"))
+			return;
+
+		// Graph values are normalized to half a frame.
+		auto millis = value / (fps_ * 0.5) * 1000.0;
+
+		tbb::spin_mutex::scoped_lock lock(mutex_);
+		auto& timing = timings_[name];
+		++timing.samples;
+		timing.total_millis += millis;
+		timing.max_millis	 = std::max(timing.max_millis, millis);
+	}
+
+	virtual void on_tag(const std::wstring&, const std::string&) override
+	{
+	}
+
+	void reset()
+	{
+		tbb::spin_mutex::scoped_lock lock(mutex_);
+		timings_.clear();
+	}
+
+	std::map<std::string, stage_timing> timings()
+	{
+		tbb::spin_mutex::scoped_lock lock(mutex_);
+		return timings_;
+	}
+};
+
+// Returns false if a consumer hasn't received a frame for stall_timeout_seconds.
+bool wait_for_frames(const std::vector<safe_ptr<benchmark_consumer>>& consumers, const std::vector<int64_t>& targets)
+{
+	static const int stall_timeout_seconds = 10;
+
+	for(size_t n = 0; n < consumers.size(); ++n)
+	{
+		auto frames		= consumers[n]->frames();
+		auto deadline	= boost::posix_time::microsec_clock::universal_time() + boost::posix_time::seconds(stall_timeout_seconds);
+
+		while(frames < targets[n])
+		{
+			if(boost::posix_time::microsec_clock::universal_time() > deadline)
+				return false;
+
+			boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+
+			auto received = consumers[n]->frames();
+			if(received != frames)
+			{
+				frames		= received;
+				deadline	= boost::posix_time::microsec_clock::universal_time() + boost::posix_time::seconds(stall_timeout_seconds);
+			}
+		}
+	}
+
+	return true;
+}
+
+}
+
+channel_benchmark_result run_channel_benchmark(const channel_benchmark_params& params)
+{
+	auto sink = std::make_shared<timing_sink>(params.format_desc.fps);
+
+	std::vector<safe_ptr<core::video_channel>>	channels;
+	std::vector<safe_ptr<benchmark_consumer>>	consumers;
+
+	for(int n = 0; n < params.channels; ++n)
+	{
+		auto channel  = make_safe<core::video_channel>(n+1, params.format_desc, params.ogl, params.audio_channel_layout);
+		auto consumer = make_safe<benchmark_consumer>(params.accumulate);
+
+		channel->output()->add(consumer, core::consumer_queue_policy::block);
+		
+		for(int layer = 0; layer < params.layers; ++layer)
+		{
+			auto pattern  = params.patterns.at(layer % params.patterns.size());
+			auto producer = create_synthetic_producer(channel->mixer(), pattern, 440.0 * (layer+1), params.audio_channel_layout);
+
+			channel->stage()->load(layer, producer);
+			channel->stage()->play(layer);
+
+			if(layer > 0)
+				channel->mixer()->set_blend_mode(layer, params.blend_mode);
+		}
+
+		channels.push_back(channel);
+		consumers.push_back(consumer);
+	}
+	
+	channel_benchmark_result result;
+
+	std::vector<int64_t> targets(consumers.size(), params.warmup_frames);
+	if(!wait_for_frames(consumers, targets))
+	{
+		result.stalled = true;
+		return result;
+	}
+
+	diagnostics::register_sink(sink);
+	
+	std::vector<int64_t> starts;
+	BOOST_FOREACH(auto& consumer, consumers)
+		starts.push_back(consumer->frames());
+	for(size_t n = 0; n < consumers.size(); ++n)
+		targets[n] = starts[n] + params.frames;
+	
+	auto audio_stats = core::get_audio_buffer_pool_stats();
+	auto allocations = get_allocation_stats();
+	boost::timer timer;
+
+	result.stalled					= !wait_for_frames(consumers, targets);
+	result.seconds					= timer.elapsed();
+	result.allocations				= get_allocation_stats() - allocations;
+	result.audio_heap_allocations	= core::get_audio_buffer_pool_stats().heap_allocations - audio_stats.heap_allocations;
+
+	diagnostics::unregister_sink(sink);
+	result.timings = sink->timings();
+
+	for(size_t n = 0; n < consumers.size(); ++n)
+		result.frames += consumers[n]->frames() - starts[n];
+
+	if(!result.stalled && result.seconds > 0.0)
+		result.fps = static_cast<double>(result.frames) / static_cast<double>(params.channels) / result.seconds;
+
+	return result;
+}
+
+std::wstring print(const channel_benchmark_params& params)
+{
+	std::vector<std::wstring> patterns;
+	BOOST_FOREACH(auto pattern, params.patterns)
+		patterns.push_back(synthetic_pattern::print(pattern));
+
+	return params.format_desc.name 
+		+ L" channels:" + boost::lexical_cast<std::wstring>(params.channels)
+		+ L" layers:"	+ boost::lexical_cast<std::wstring>(params.layers)
+		+ L" blend:"	+ core::get_blend_mode(params.blend_mode)
+		+ L" patterns:" + boost::join(patterns, L",")
+		+ L" audio:"	+ params.audio_channel_layout.name
+		+ L" mixer:"	+ (params.ogl ? L"gpu" : L"cpu")
+		+ L" consumer:" + (params.accumulate ? L"accumulate" : L"null");
+}
+
+void print(std::wostream& out, const channel_benchmark_params& params, const channel_benchmark_result& result)
+{
+	const auto frames = static_cast<double>(std::max<int64_t>(1, result.frames));
+
+	out << L"channel " << print(params) << std::endl;
+	out << std::fixed << std::setprecision(2);
+	out << L"  frames           " << result.frames << L" in " << result.seconds << L" s, " 
+		<< result.fps << L" fps per channel (" << result.fps / params.format_desc.fps << L"x real time)" << std::endl;
+
+	BOOST_FOREACH(auto& timing, result.timings)
+	{
+		out << L"  " << std::left << std::setw(17) << std::wstring(timing.first.begin(), timing.first.end()) << std::right
+			<< L"mean " << timing.second.mean_millis() << L" ms, max " << timing.second.max_millis << L" ms" << std::endl;
+	}
+
+	out << L"  allocations      " << static_cast<double>(result.allocations.count) / frames << L" per frame, " 
+		<< static_cast<double>(result.allocations.bytes) / frames / 1024.0 << L" KB per frame" << std::endl;
+	out << L"  audio heap       " << static_cast<double>(result.audio_heap_allocations) / frames << L" allocations per frame" << std::endl;
+}
+
+}}
@@ -0,0 +1,96 @@
+/*
+* Copyright 2013 Sveriges Television AB http://casparcg.com/
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+
+#pragma once
+
+#include "allocation_counter.h"
+#include "synthetic_producer.h"
+
+#include <core/video_format.h>
+#include <core/mixer/audio/audio_util.h>
+#include <core/mixer/image/blend_modes.h>
+
+#include <cstdint>
+#include <iosfwd>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace caspar { 
+
+namespace core {
+
+class ogl_device;
+
+}
+
+namespace benchmark {
+
+struct channel_benchmark_params
+{
+	core::video_format_desc					format_desc;
+	core::channel_layout					audio_channel_layout;
+	std::shared_ptr<core::ogl_device>		ogl;			// nullptr selects the cpu image mixer.
+	int										channels;
+	int										layers;
+	std::vector<synthetic_pattern::type>	patterns;		// Assigned to the layers in turn.
+	core::blend_mode::type					blend_mode;		// Of every layer above the first.
+	bool									accumulate;		// The consumer reads every sample of every frame.
+	int										warmup_frames;
+	int										frames;			// Measured frames per channel.
+
+	channel_benchmark_params();
+};
+
+struct stage_timing
+{
+	int64_t	samples;
+	double	total_millis;
+	double	max_millis;
+
+	stage_timing() : samples(0), total_millis(0.0), max_millis(0.0) {}
+
+	double mean_millis() const { return samples > 0 ? total_millis / static_cast<double>(samples) : 0.0; }
+};
+
+struct channel_benchmark_result
+{
+	double								seconds;
+	int64_t								frames;					// Summed over all channels.
+	double								fps;					// Per channel.
+	std::map<std::string, stage_timing>	timings;				// By diagnostics graph value, e.g. "mix-time".
+	allocation_stats					allocations;
+	int64_t								audio_heap_allocations;
+	bool								stalled;				// A channel stopped delivering frames, fps is 0.
+
+	channel_benchmark_result();
+};
+
+// Runs params.channels video_channels in parallel. The consumer provides the synchronization 
+// clock and never blocks, so the channels run as fast as the pipeline allows.
+channel_benchmark_result run_channel_benchmark(const channel_benchmark_params& params);
+
+std::wstring print(const channel_benchmark_params& params);
+void print(std::wostream& out, const channel_benchmark_params& params, const channel_benchmark_result& result);
+
+}}
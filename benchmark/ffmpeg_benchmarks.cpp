@@ -0,0 +1,576 @@
+/*
+* Copyright 2013 Sveriges Television AB http://casparcg.com/
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+
+#include "micro_benchmarks.h"
+
+#include "options.h"
+
+#include <modules/ffmpeg/producer/tbb_avcodec.h>
+#include <modules/ffmpeg/producer/filter/deinterlacer.h>
+#include <modules/ffmpeg/producer/util/color_conversion.h>
+
+#include <common/utility/string.h>
+
+#include <tbb/tick_count.h>
+
+#include <boost/foreach.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+#if defined(_MSC_VER)
+#pragma warning (push)
+#pragma warning (disable : 4244)
+#endif
+extern "C"
+{
+	#define __STDC_CONSTANT_MACROS
+	#define __STDC_LIMIT_MACROS
+	#include <libavformat/avformat.h>
+	#include <libavcodec/avcodec.h>
+	#include <libavutil/imgutils.h>
+	#include <libavutil/pixdesc.h>
+}
+#if defined(_MSC_VER)
+#pragma warning (pop)
+#endif
+
+namespace caspar { namespace benchmark {
+
+namespace {
+
+typedef std::vector<uint8_t> packet_data;
+
+std::shared_ptr<AVCodecContext> create_codec_context()
+{
+	return std::shared_ptr<AVCodecContext>(avcodec_alloc_context(), [](AVCodecContext* context)
+	{
+		av_freep(&context->extradata); // Duplicated by avcodec_copy_context.
+		av_free(context);
+	});
+}
+
+// Frame with an image buffer of its own.
+std::shared_ptr<AVFrame> create_picture(PixelFormat pix_fmt, int width, int height)
+{
+	std::shared_ptr<AVFrame> frame(avcodec_alloc_frame(), [](AVFrame* frame)
+	{
+		avpicture_free(reinterpret_cast<AVPicture*>(frame));
+		av_free(frame);
+	});
+
+	if(avpicture_alloc(reinterpret_cast<AVPicture*>(frame.get()), pix_fmt, width, height) < 0)
+		return nullptr;
+
+	frame->width	= width;
+	frame->height	= height;
+	frame->format	= pix_fmt;
+
+	return frame;
+}
+
+// Moving diagonal gradient with a little noise, compresses roughly like camera content.
+void fill_picture(AVFrame& frame, int frame_number)
+{
+	auto size = avpicture_get_size(static_cast<PixelFormat>(frame.format), frame.width, frame.height);
+	auto data = frame.data[0];
+
+	uint32_t state = static_cast<uint32_t>(frame_number) * 2654435761u | 1u;
+	for(int n = 0; n < size; ++n)
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		data[n] = static_cast<uint8_t>(((n % frame.linesize[0]) + n / frame.linesize[0] + frame_number * 4) + (state & 7));
+	}
+}
+
+std::vector<packet_data> encode(AVCodec* encoder, int width, int height, int frames)
+{
+	std::vector<packet_data> packets;
+
+	auto context = create_codec_context();
+	context->width			= width;
+	context->height			= height;
+	context->pix_fmt		= encoder->pix_fmts ? encoder->pix_fmts[0] : PIX_FMT_YUV420P;
+	context->time_base.num	= 1;
+	context->time_base.den	= 25;
+	context->bit_rate		= 50000000;
+	context->gop_size		= 12;
+	context->max_b_frames	= 0;
+
+	if(avcodec_open(context.get(), encoder) < 0)
+		return packets;
+		
+	auto picture = create_picture(context->pix_fmt, width, height);
+	if(picture)
+	{
+		std::vector<uint8_t> buffer(std::max(width * height * 8, FF_MIN_BUFFER_SIZE));
+		for(int n = 0; n < frames; ++n)
+		{
+			fill_picture(*picture, n);
+			picture->pts = n;
+
+			auto size = avcodec_encode_video(context.get(), buffer.data(), static_cast<int>(buffer.size()), picture.get());
+			if(size < 0)
+				break;
+			if(size > 0)
+			{
+				packet_data packet(buffer.begin(), buffer.begin() + size);
+				packet.resize(size + FF_INPUT_BUFFER_PADDING_SIZE, 0);
+				packets.push_back(std::move(packet));
+			}
+		}
+	}
+	
+	avcodec_close(context.get());
+	return packets;
+}
+
+// Reads the packets of the first video stream of a file. context receives the stream parameters.
+std::vector<packet_data> read_packets(const std::wstring& filename, AVCodecContext& context, int frames)
+{
+	std::vector<packet_data> packets;
+
+	AVFormatContext* weak_format_context = nullptr;
+	if(avformat_open_input(&weak_format_context, narrow(filename).c_str(), nullptr, nullptr) < 0)
+		return packets;
+	std::shared_ptr<AVFormatContext> format_context(weak_format_context, av_close_input_file);
+
+	if(avformat_find_stream_info(format_context.get(), nullptr) < 0)
+		return packets;
+		
+	auto index = av_find_best_stream(format_context.get(), AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+	if(index < 0 || avcodec_copy_context(&context, format_context->streams[index]->codec) < 0)
+		return packets;
+
+	AVPacket packet;
+	while(static_cast<int>(packets.size()) < frames && av_read_frame(format_context.get(), &packet) >= 0)
+	{
+		if(packet.stream_index == index)
+		{
+			packet_data data(packet.data, packet.data + packet.size);
+			data.resize(packet.size + FF_INPUT_BUFFER_PADDING_SIZE, 0);
+			packets.push_back(std::move(data));
+		}
+		av_free_packet(&packet);
+	}
+
+	return packets;
+}
+
+// Returns decoded frames per second, or a negative value if the decoder could not be opened.
+double measure_decode(const AVCodecContext& source_context, const std::vector<packet_data>& packets, int thread_count)
+{
+	auto decoder = avcodec_find_decoder(source_context.codec_id);
+	if(!decoder)
+		return -1.0;
+
+	auto context = create_codec_context();
+	if(avcodec_copy_context(context.get(), &source_context) < 0)
+		return -1.0;
+
+	if(tbb_avcodec_open(context.get(), decoder, thread_count) < 0)
+		return -1.0;
+
+	std::shared_ptr<AVFrame> frame(avcodec_alloc_frame(), av_free);
+	int decoded = 0;
+	int got_frame = 0;
+	
+	AVPacket packet;
+	av_init_packet(&packet);
+
+	auto start = tbb::tick_count::now();
+	BOOST_FOREACH(auto& data, packets)
+	{
+		packet.data = const_cast<uint8_t*>(data.data());
+		packet.size = static_cast<int>(data.size()) - FF_INPUT_BUFFER_PADDING_SIZE;
+		if(avcodec_decode_video2(context.get(), frame.get(), &got_frame, &packet) >= 0 && got_frame)
+			++decoded;
+	}
+
+	// Frame threaded decoders return frames with a delay.
+	packet.data = nullptr;
+	packet.size = 0;
+	do
+	{
+		got_frame = 0;
+		if(avcodec_decode_video2(context.get(), frame.get(), &got_frame, &packet) >= 0 && got_frame)
+			++decoded;
+	}
+	while(got_frame);
+	auto seconds = (tbb::tick_count::now() - start).seconds();
+
+	tbb_avcodec_close(context.get());
+
+	return static_cast<double>(decoded) / seconds;
+}
+
+}
+
+void run_color_conversion_benchmark(std::wostream& out, const boost::property_tree::wptree& options)
+{
+	struct source_format
+	{
+		const wchar_t*	name;
+		PixelFormat		pix_fmt;
+	};
+
+	struct resolution
+	{
+		const wchar_t*	name;
+		int				width;
+		int				height;
+	};
+
+	const source_format formats[] =
+	{
+		{L"uyvy422",	PIX_FMT_UYVY422},
+		{L"yuyv422",	PIX_FMT_YUYV422},
+		{L"nv12",		PIX_FMT_NV12},
+		{L"yuv422p10",	PIX_FMT_YUV422P10},
+		{L"yuvj420p",	PIX_FMT_YUVJ420P},
+		{L"yuv440p",	PIX_FMT_YUV440P}
+	};
+
+	const resolution resolutions[] =
+	{
+		{L"1080p",	1920,	1080},
+		{L"2160p",	3840,	2160}
+	};
+
+	const auto frames = options.get(L"frames", 100);
+
+	out << L"convert_frame, milliseconds per frame" << std::endl;
+	out << std::left << std::setw(12) << L"source" << std::setw(10) << L"target" << std::right;
+	BOOST_FOREACH(auto& resolution, resolutions)
+		out << std::setw(10) << resolution.name;
+	out << std::endl;
+	out << std::fixed << std::setprecision(2);
+
+	BOOST_FOREACH(auto& format, formats)
+	{
+		auto target = ffmpeg::get_conversion_target(format.pix_fmt);
+		auto target_name = target == PIX_FMT_NONE ? "none" : av_get_pix_fmt_name(target);
+
+		out << std::left << std::setw(12) << format.name << std::setw(10) << widen(std::string(target_name)) << std::right;
+
+		BOOST_FOREACH(auto& resolution, resolutions)
+		{
+			auto source = create_picture(format.pix_fmt, resolution.width, resolution.height);
+			auto dest	= target != PIX_FMT_NONE ? create_picture(target, resolution.width, resolution.height) : nullptr;
+			if(!source || !dest)
+			{
+				out << std::setw(10) << L"-";
+				continue;
+			}
+
+			fill_picture(*source, 0);
+			if(format.pix_fmt == PIX_FMT_YUV422P10) // Keep the samples within 10 bits.
+			{
+				auto size = avpicture_get_size(format.pix_fmt, resolution.width, resolution.height) / 2;
+				auto data = reinterpret_cast<uint16_t*>(source->data[0]);
+				for(int n = 0; n < size; ++n)
+					data[n] &= 0x03FF;
+			}
+
+			auto space = ffmpeg::color_space::get_default(resolution.height);
+			auto range = ffmpeg::get_color_range(format.pix_fmt);
+
+			ffmpeg::convert_frame(*source, *dest, space, range);
+
+			auto start = tbb::tick_count::now();
+			for(int n = 0; n < frames; ++n)
+				ffmpeg::convert_frame(*source, *dest, space, range);
+			auto millis = (tbb::tick_count::now() - start).seconds() * 1000.0 / static_cast<double>(frames);
+
+			out << std::setw(10) << millis;
+		}
+		out << std::endl;
+	}
+}
+
+void run_decode_benchmark(std::wostream& out, const boost::property_tree::wptree& options)
+{
+	auto thread_counts	= get_list<int>(options, L"threads", L"1,2,4,8");
+	auto codecs			= get_list<std::wstring>(options, L"codecs", L"mpeg2video,mpeg4,mjpeg,ffvhuff");
+	auto filename		= options.get(L"file", L"");
+	auto frames			= options.get(L"frames", 100);
+	auto width			= options.get(L"width", 1920);
+	auto height			= options.get(L"height", 1080);
+
+	// Each entry holds the stream parameters and the packets of one codec.
+	std::vector<std::pair<std::shared_ptr<AVCodecContext>, std::vector<packet_data>>> streams;
+
+	if(!filename.empty())
+	{
+		auto context = create_codec_context();
+		auto packets = read_packets(filename, *context, frames);
+		if(!packets.empty())
+			streams.push_back(std::make_pair(context, std::move(packets)));
+		else
+			out << L"Could not read video packets from " << filename << std::endl;
+	}
+	else
+	{
+		BOOST_FOREACH(auto& name, codecs)
+		{
+			auto encoder = avcodec_find_encoder_by_name(narrow(name).c_str());
+			auto packets = encoder ? encode(encoder, width, height, frames) : std::vector<packet_data>();
+			if(packets.empty())
+			{
+				out << L"Could not encode " << name << std::endl;
+				continue;
+			}
+
+			auto context = create_codec_context();
+			context->codec_type = AVMEDIA_TYPE_VIDEO;
+			context->codec_id	= encoder->id;
+			context->width		= width;
+			context->height		= height;
+			context->pix_fmt	= encoder->pix_fmts ? encoder->pix_fmts[0] : PIX_FMT_YUV420P;
+			streams.push_back(std::make_pair(context, std::move(packets)));
+		}
+	}
+
+	out << L"decode, frames per second by decoder threads" << std::endl;
+	out << std::left << std::setw(14) << L"codec" << std::right;
+	BOOST_FOREACH(auto threads, thread_counts)
+		out << std::setw(10) << threads;
+	out << std::endl;
+	out << std::fixed << std::setprecision(1);
+
+	BOOST_FOREACH(auto& stream, streams)
+	{
+		auto decoder = avcodec_find_decoder(stream.first->codec_id);
+		out << std::left << std::setw(14) << (decoder ? widen(std::string(decoder->name)) : L"unknown") << std::right;
+		BOOST_FOREACH(auto threads, thread_counts)
+		{
+			auto fps = measure_decode(*stream.first, stream.second, threads);
+			if(fps < 0.0)
+				out << std::setw(10) << L"-";
+			else
+				out << std::setw(10) << fps;
+		}
+		out << std::endl;
+	}
+}
+
+namespace {
+
+// Size in bytes and height of every plane of a picture.
+std::vector<std::pair<int, int>> get_plane_sizes(const AVFrame& frame)
+{
+	std::vector<std::pair<int, int>> sizes;
+
+	int linesizes[4];
+	if(av_image_fill_linesizes(linesizes, static_cast<PixelFormat>(frame.format), frame.width) < 0)
+		return sizes;
+
+	const auto& desc = av_pix_fmt_descriptors[frame.format];
+	for(int n = 0; n < 4 && frame.data[n]; ++n)
+	{
+		auto height = n == 1 || n == 2 ? -((-frame.height) >> desc.log2_chroma_h) : frame.height;
+		sizes.push_back(std::make_pair(linesizes[n], height));
+	}
+
+	return sizes;
+}
+
+// Interlaced content which takes every branch of the line kernels: a diagonal edge moving between frames, 
+// a bar which only exists in the bottom field, a gradient and noise.
+void fill_fields(AVFrame& frame, int frame_number)
+{
+	auto sizes = get_plane_sizes(frame);
+
+	for(int n = 0; n < static_cast<int>(sizes.size()); ++n)
+	{
+		for(int y = 0; y < sizes[n].second; ++y)
+		{
+			auto row = frame.data[n] + y * frame.linesize[n];
+			for(int x = 0; x < sizes[n].first; ++x)
+			{
+				uint32_t noise = (static_cast<uint32_t>(x) * 73856093u) ^ (static_cast<uint32_t>(y) * 19349663u) ^ (static_cast<uint32_t>(frame_number * 4 + n) * 83492791u);
+				noise ^= noise >> 13;
+				noise *= 0x85EBCA77u;
+				noise ^= noise >> 16;
+
+				int value = (x * 3 + y * 5 + frame_number * 7) & 0xFF;
+				if((x + y + frame_number * 3) % 97 < 40)
+					value = 235;
+				else if((y & 1) && (x / 8 + frame_number) % 13 == 0)
+					value = 16;
+				if((noise & 0x300) == 0)
+					value = noise & 0xFF;
+
+				row[x] = static_cast<uint8_t>(value);
+			}
+		}
+	}
+}
+
+std::vector<std::shared_ptr<AVFrame>> deinterlace_fields(const ffmpeg::deinterlace_params& params, ffmpeg::deinterlace_simd_level::type level, PixelFormat pix_fmt, int width, int height)
+{
+	const int FRAMES = 5;
+
+	ffmpeg::set_deinterlace_simd_level(level);
+	ffmpeg::deinterlacer deinterlacer(params);
+
+	std::vector<std::shared_ptr<AVFrame>> output;
+
+	for(int n = 0; n < FRAMES; ++n)
+	{
+		auto frame = create_picture(pix_fmt, width, height);
+		if(!frame)
+			break;
+
+		fill_fields(*frame, n);
+		frame->interlaced_frame = 1;
+		frame->top_field_first	= 1;
+
+		deinterlacer.push(frame);
+		for(auto result = deinterlacer.poll(); result; result = deinterlacer.poll())
+			output.push_back(result);
+	}
+
+	return output;
+}
+
+bool equal_pictures(const std::vector<std::shared_ptr<AVFrame>>& expected, const std::vector<std::shared_ptr<AVFrame>>& actual)
+{
+	if(expected.size() != actual.size())
+		return false;
+
+	for(size_t f = 0; f < expected.size(); ++f)
+	{
+		auto sizes = get_plane_sizes(*expected[f]);
+		if(sizes != get_plane_sizes(*actual[f]))
+			return false;
+
+		for(int n = 0; n < static_cast<int>(sizes.size()); ++n)
+		{
+			for(int y = 0; y < sizes[n].second; ++y)
+			{
+				if(std::memcmp(expected[f]->data[n] + y * expected[f]->linesize[n], actual[f]->data[n] + y * actual[f]->linesize[n], sizes[n].first) != 0)
+					return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+}
+
+bool run_deinterlace_verification(std::wostream& out, const boost::property_tree::wptree& options)
+{
+	struct mode
+	{
+		const wchar_t*					name;
+		ffmpeg::deinterlace_mode::type	mode;
+		bool							double_rate;
+		bool							spatial_check;
+		int								parity;
+	};
+
+	const mode modes[] =
+	{
+		{L"yadif",				ffmpeg::deinterlace_mode::yadif,	false,	true,	-1},
+		{L"yadif no-spatial",	ffmpeg::deinterlace_mode::yadif,	false,	false,	-1},
+		{L"yadif double",		ffmpeg::deinterlace_mode::yadif,	true,	true,	-1},
+		{L"yadif double bff",	ffmpeg::deinterlace_mode::yadif,	true,	false,	1},
+		{L"bob",				ffmpeg::deinterlace_mode::bob,		false,	true,	-1},
+		{L"bob double",			ffmpeg::deinterlace_mode::bob,		true,	true,	-1},
+		{L"blend",				ffmpeg::deinterlace_mode::blend,	false,	true,	-1}
+	};
+
+	// Packed and planar formats with every chroma subsampling, the sizes cover the simd tails and the edges.
+	const PixelFormat pix_fmts[] = {PIX_FMT_GRAY8, PIX_FMT_YUV420P, PIX_FMT_YUV422P, PIX_FMT_YUV411P, PIX_FMT_BGRA, PIX_FMT_RGB24};
+	const int sizes[][2] = {{720, 32}, {97, 17}, {33, 8}, {5, 5}, {1, 3}};
+
+	const ffmpeg::deinterlace_simd_level::type levels[] = {ffmpeg::deinterlace_simd_level::sse2, ffmpeg::deinterlace_simd_level::avx2};
+	const wchar_t* level_names[] = {L"sse2", L"avx2"};
+
+	out << L"deinterlacer kernels against the scalar reference, mismatching pictures" << std::endl;
+	out << std::left << std::setw(18) << L"mode" << std::right;
+	for(int n = 0; n < 2; ++n)
+		out << std::setw(10) << level_names[n];
+	out << std::endl;
+
+	const auto default_level = ffmpeg::get_deinterlace_simd_level();
+	bool passed = true;
+
+	BOOST_FOREACH(auto& mode, modes)
+	{
+		ffmpeg::deinterlace_params params(mode.mode, mode.double_rate, mode.parity);
+		params.spatial_check = mode.spatial_check;
+
+		int mismatches[2] = {0, 0};
+
+		BOOST_FOREACH(auto pix_fmt, pix_fmts)
+		{
+			BOOST_FOREACH(auto& size, sizes)
+			{
+				auto expected = deinterlace_fields(params, ffmpeg::deinterlace_simd_level::scalar, pix_fmt, size[0], size[1]);
+
+				for(int n = 0; n < 2; ++n)
+				{
+					ffmpeg::set_deinterlace_simd_level(levels[n]);
+					if(ffmpeg::get_deinterlace_simd_level() != levels[n])
+						continue;
+
+					if(!equal_pictures(expected, deinterlace_fields(params, levels[n], pix_fmt, size[0], size[1])))
+						++mismatches[n];
+				}
+			}
+		}
+
+		out << std::left << std::setw(18) << mode.name << std::right;
+		for(int n = 0; n < 2; ++n)
+		{
+			ffmpeg::set_deinterlace_simd_level(levels[n]);
+			if(ffmpeg::get_deinterlace_simd_level() != levels[n])
+				out << std::setw(10) << L"-";
+			else if(mismatches[n] > 0)
+				out << std::setw(10) << mismatches[n];
+			else
+				out << std::setw(10) << L"ok";
+
+			passed &= mismatches[n] == 0;
+		}
+		out << std::endl;
+	}
+
+	ffmpeg::set_deinterlace_simd_level(default_level);
+
+	if(!passed)
+		out << L"FAILED, the simd kernels differ from the scalar reference" << std::endl;
+
+	return passed;
+}
+
+}}
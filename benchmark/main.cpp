@@ -0,0 +1,311 @@
+/*
+* Copyright 2013 Sveriges Television AB http://casparcg.com/
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+
+// Headless benchmarks of the channel pipeline and of its components. Run from the server 
+// folder, casparcg.config is read for the settings the channels share with the server.
+//
+//   benchmark [mode] [--option value]...
+//
+// See print_usage for the modes and their options.
+
+#include "channel_benchmark.h"
+#include "micro_benchmarks.h"
+#include "options.h"
+
+#include <common/env.h>
+#include <common/exception/exceptions.h>
+#include <common/log/log.h>
+#include <common/utility/string.h>
+
+#include <core/mixer/gpu/ogl_device.h>
+#include <core/mixer/audio/audio_util.h>
+
+#include <modules/ffmpeg/ffmpeg.h>
+
+#include <tbb/task_scheduler_init.h>
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/algorithm/string/case_conv.hpp>
+#include <boost/foreach.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+#include <iostream>
+#include <string>
+
+using namespace caspar;
+using namespace caspar::benchmark;
+
+namespace {
+
+void print_usage()
+{
+	std::wcout 
+		<< L"usage: benchmark [mode] [--option value]..." << std::endl
+		<< std::endl
+		<< L"modes:" << std::endl
+		<< L"  channel           video_channels with synthetic producers (default)" << std::endl
+		<< L"    --formats         video modes                     1080i5000" << std::endl
+		<< L"    --channels        parallel channels               1" << std::endl
+		<< L"    --layers          layers per channel              1,4,16" << std::endl
+		<< L"    --blend-modes     blend modes of upper layers     normal" << std::endl
+		<< L"    --patterns        bars, noise, gradient per layer bars,noise,gradient" << std::endl
+		<< L"    --channel-layout  audio channel layout            STEREO" << std::endl
+		<< L"    --accelerator     auto, cpu or gpu                auto" << std::endl
+		<< L"    --consumer        accumulate or null              accumulate" << std::endl
+		<< L"    --frames          measured frames per channel     500" << std::endl
+		<< L"    --warmup          frames before measuring         50" << std::endl
+		<< L"    --min-fps         exit code 1 below this fps      0" << std::endl
+		<< L"  executor          executor against ring_executor" << std::endl
+		<< L"    --channels 1,2,4,8 --fps 50,60 --hops 3 --seconds 2 --tasks 200000" << std::endl
+		<< L"  memcpy            fast_memcpy of 720p, 1080p and 2160p planes" << std::endl
+		<< L"    --gigabytes 4" << std::endl
+		<< L"  audio-mixer       audio_mixer per layer and channel count" << std::endl
+		<< L"    --audio-layers 1,4,16 --audio-channels 2,8,16 --frames 2000" << std::endl
+		<< L"  audio-convert     sample conversions per simd level" << std::endl
+		<< L"    --iterations 100" << std::endl
+		<< L"  color-conversion  convert_frame per source format" << std::endl
+		<< L"    --frames 100" << std::endl
+		<< L"  decode            decoder fps per thread count" << std::endl
+		<< L"    --codecs mpeg2video,mpeg4,mjpeg,ffvhuff --threads 1,2,4,8 --frames 100" << std::endl
+		<< L"    --width 1920 --height 1080 --file <decodes the file instead>" << std::endl
+		<< L"  all               every mode above" << std::endl
+		<< std::endl
+		<< L"verification modes, exit code 1 on any mismatch:" << std::endl
+		<< L"  verify-audio      sample conversions per simd level against the scalar reference" << std::endl
+		<< L"    --samples 1048576 (random 32 bit and float samples)" << std::endl
+		<< L"  verify-deinterlace  deinterlacer kernels per simd level against the scalar reference" << std::endl
+		<< L"  verify            every verification mode above" << std::endl
+		<< std::endl
+		<< L"  --log-level       log level                       warning" << std::endl;
+}
+
+std::shared_ptr<core::ogl_device> create_accelerator(const std::wstring& accelerator)
+{
+	if(accelerator == L"cpu")
+		return nullptr;
+
+	try
+	{
+		return core::ogl_device::create();
+	}
+	catch(...)
+	{
+		if(accelerator == L"gpu")
+			throw;
+
+		CASPAR_LOG_CURRENT_EXCEPTION();
+		CASPAR_LOG(warning) << L"Failed to initialize OpenGL. Falling back to cpu image mixer.";
+		return nullptr;
+	}
+}
+
+typedef void (*micro_benchmark)(std::wostream& out, const boost::property_tree::wptree& options);
+
+struct micro_benchmark_mode
+{
+	const wchar_t*	name;
+	micro_benchmark	run;
+};
+
+const micro_benchmark_mode micro_benchmark_modes[] =
+{
+	{L"executor",			run_executor_benchmark},
+	{L"memcpy",				run_memcpy_benchmark},
+	{L"audio-mixer",		run_audio_mixer_benchmark},
+	{L"audio-convert",		run_audio_convert_benchmark},
+	{L"color-conversion",	run_color_conversion_benchmark},
+	{L"decode",				run_decode_benchmark}
+};
+
+typedef bool (*verification)(std::wostream& out, const boost::property_tree::wptree& options);
+
+struct verification_mode
+{
+	const wchar_t*	name;
+	verification	run;
+};
+
+const verification_mode verification_modes[] =
+{
+	{L"verify-audio",		run_audio_convert_verification},
+	{L"verify-deinterlace",	run_deinterlace_verification}
+};
+
+bool is_valid_mode(const std::wstring& mode)
+{
+	if(mode == L"channel" || mode == L"all" || mode == L"verify")
+		return true;
+
+	BOOST_FOREACH(auto& entry, micro_benchmark_modes)
+	{
+		if(mode == entry.name)
+			return true;
+	}
+	BOOST_FOREACH(auto& entry, verification_modes)
+	{
+		if(mode == entry.name)
+			return true;
+	}
+	return false;
+}
+
+// Returns false if any configuration stalls or runs slower than --min-fps.
+bool run_channel_benchmarks(std::wostream& out, const boost::property_tree::wptree& options)
+{
+	auto formats		= get_list<std::wstring>(options, L"formats", L"1080i5000");
+	auto channel_counts	= get_list<int>(options, L"channels", L"1");
+	auto layer_counts	= get_list<int>(options, L"layers", L"1,4,16");
+	auto blend_modes	= get_list<std::wstring>(options, L"blend-modes", L"normal");
+	auto patterns		= get_list<std::wstring>(options, L"patterns", L"bars,noise,gradient");
+	auto min_fps		= options.get(L"min-fps", 0.0);
+
+	channel_benchmark_params params;
+	params.audio_channel_layout = core::default_channel_layout_repository().get_by_name(boost::to_upper_copy(options.get(L"channel-layout", L"STEREO")));
+	params.ogl					= create_accelerator(options.get(L"accelerator", L"auto"));
+	params.accumulate			= options.get(L"consumer", L"accumulate") != L"null";
+	params.frames				= options.get(L"frames", 500);
+	params.warmup_frames		= options.get(L"warmup", 50);
+
+	params.patterns.clear();
+	BOOST_FOREACH(auto& pattern, patterns)
+		params.patterns.push_back(synthetic_pattern::parse(pattern));
+	if(params.patterns.empty())
+		params.patterns.push_back(synthetic_pattern::bars);
+
+	bool passed = true;
+
+	BOOST_FOREACH(auto& format, formats)
+	{
+		params.format_desc = core::video_format_desc::get(format);
+		if(params.format_desc.format == core::video_format::invalid)
+			BOOST_THROW_EXCEPTION(invalid_argument() << arg_name_info("formats") << arg_value_info(narrow(format)) << msg_info("Invalid video-mode."));
+
+		BOOST_FOREACH(auto channels, channel_counts)
+		{
+			BOOST_FOREACH(auto layers, layer_counts)
+			{
+				BOOST_FOREACH(auto& blend_mode, blend_modes)
+				{
+					params.channels		= channels;
+					params.layers		= layers;
+					params.blend_mode	= core::get_blend_mode(blend_mode);
+
+					auto result = run_channel_benchmark(params);
+					print(out, params, result);
+
+					if(result.stalled)
+					{
+						out << L"  FAILED, stalled" << std::endl;
+						passed = false;
+					}
+					else if(result.fps < min_fps)
+					{
+						out << L"  FAILED, below " << min_fps << L" fps" << std::endl;
+						passed = false;
+					}
+					out << std::endl;
+				}
+			}
+		}
+	}
+
+	return passed;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+	std::wstring mode = L"channel";
+	boost::property_tree::wptree options;
+
+	for(int n = 1; n < argc; ++n)
+	{
+		auto arg = widen(std::string(argv[n]));
+		if(arg == L"--help" || arg == L"-h")
+		{
+			print_usage();
+			return 0;
+		}
+		else if(boost::starts_with(arg, L"--") && n + 1 < argc)
+			options.put(arg.substr(2), widen(std::string(argv[++n])));
+		else if(!boost::starts_with(arg, L"--"))
+			mode = arg;
+		else
+		{
+			print_usage();
+			return 2;
+		}
+	}
+
+	if(!is_valid_mode(mode))
+	{
+		print_usage();
+		return 2;
+	}
+
+	tbb::task_scheduler_init init;
+	bool passed = true;
+
+	try
+	{
+		env::configure(L"casparcg.config");
+		log::set_log_level(options.get(L"log-level", L"warning"));
+
+		core::register_default_channel_layouts(core::default_channel_layout_repository());
+		core::register_default_mix_configs(core::default_mix_config_repository());
+
+		ffmpeg::init();
+
+		const bool all = mode == L"all";
+
+		BOOST_FOREACH(auto& entry, micro_benchmark_modes)
+		{
+			if(all || mode == entry.name)
+			{
+				entry.run(std::wcout, options);
+				std::wcout << std::endl;
+			}
+		}
+
+		BOOST_FOREACH(auto& entry, verification_modes)
+		{
+			if(mode == L"verify" || mode == entry.name)
+			{
+				passed = entry.run(std::wcout, options) && passed;
+				std::wcout << std::endl;
+			}
+		}
+
+		if(all || mode == L"channel")
+			passed = run_channel_benchmarks(std::wcout, options) && passed;
+
+		ffmpeg::uninit();
+	}
+	catch(...)
+	{
+		CASPAR_LOG_CURRENT_EXCEPTION();
+		return 2;
+	}
+
+	return passed ? 0 : 1;
+}
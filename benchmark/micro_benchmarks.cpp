@@ -0,0 +1,633 @@
+/*
+* Copyright 2013 Sveriges Television AB http://casparcg.com/
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+
+#include "micro_benchmarks.h"
+
+#include "options.h"
+
+#include <common/concurrency/executor.h>
+#include <common/concurrency/ring_executor.h>
+#include <common/diagnostics/graph.h>
+#include <common/memory/memcpy.h>
+
+#include <core/mixer/audio/audio_convert.h>
+#include <core/mixer/audio/audio_mixer.h>
+#include <core/mixer/audio/audio_util.h>
+#include <core/mixer/write_frame.h>
+#include <core/video_format.h>
+
+#include <tbb/cache_aligned_allocator.h>
+#include <tbb/spin_mutex.h>
+#include <tbb/tick_count.h>
+
+#include <boost/foreach.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/future.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <limits>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+namespace caspar { namespace benchmark {
+
+namespace {
+
+typedef std::vector<uint8_t, tbb::cache_aligned_allocator<uint8_t>> aligned_buffer;
+
+double percentile(std::vector<double> values, double p)
+{
+	if(values.empty())
+		return 0.0;
+
+	std::sort(values.begin(), values.end());
+	return values[std::min(values.size()-1, static_cast<size_t>(p * static_cast<double>(values.size())))];
+}
+
+double mean(const std::vector<double>& values)
+{
+	double sum = 0.0;
+	BOOST_FOREACH(auto value, values)
+		sum += value;
+	return values.empty() ? 0.0 : sum / static_cast<double>(values.size());
+}
+
+// Every frame hops through the executors of a channel, as from stage to mixer to output.
+template<typename Executor>
+void post_frame(const std::vector<std::shared_ptr<Executor>>* chain, size_t hop, tbb::tick_count start, const std::shared_ptr<boost::promise<double>>& done)
+{
+	(*chain)[hop]->begin_invoke([=]
+	{
+		if(hop + 1 < chain->size())
+			post_frame(chain, hop + 1, start, done);
+		else
+			done->set_value((tbb::tick_count::now() - start).seconds());
+	});
+}
+
+// Returns the latency of every frame in microseconds.
+template<typename Executor>
+std::vector<double> measure_executor_latency(int channels, int hops, double fps, int frames)
+{
+	std::vector<std::vector<std::shared_ptr<Executor>>> chains(channels);
+	BOOST_FOREACH(auto& chain, chains)
+	{
+		for(int n = 0; n < hops; ++n)
+			chain.push_back(std::make_shared<Executor>(L"benchmark"));
+	}
+
+	tbb::spin_mutex		mutex;
+	std::vector<double>	latencies;
+	
+	boost::thread_group threads;
+	BOOST_FOREACH(auto& chain, chains)
+	{
+		auto chain_ptr = &chain;
+		threads.create_thread([&, chain_ptr]
+		{
+			const auto period	= boost::posix_time::microseconds(static_cast<int64_t>(1000000.0 / fps));
+			auto deadline		= boost::get_system_time();
+
+			std::vector<double> local;
+			for(int frame = 0; frame < frames; ++frame)
+			{
+				auto done	= std::make_shared<boost::promise<double>>();
+				auto result	= done->get_future();
+				post_frame(chain_ptr, 0, tbb::tick_count::now(), done);
+				local.push_back(result.get() * 1000000.0);
+
+				deadline += period;
+				boost::this_thread::sleep(deadline);
+			}
+
+			tbb::spin_mutex::scoped_lock lock(mutex);
+			latencies.insert(latencies.end(), local.begin(), local.end());
+		});
+	}
+	threads.join_all();
+
+	return latencies;
+}
+
+// Returns the number of tasks per second a single producer can push through the executor.
+template<typename Executor>
+double measure_executor_throughput(int tasks)
+{
+	Executor executor(L"benchmark");
+	int count = 0;
+
+	auto start = tbb::tick_count::now();
+	for(int n = 0; n < tasks; ++n)
+		executor.begin_invoke([&count]{++count;});
+	executor.wait();
+
+	return static_cast<double>(tasks) / (tbb::tick_count::now() - start).seconds();
+}
+
+template<typename Executor>
+void print_executor_latency(std::wostream& out, const std::wstring& name, int channels, int hops, double fps, int frames)
+{
+	auto latencies = measure_executor_latency<Executor>(channels, hops, fps, frames);
+
+	out << std::left << std::setw(16) << name << std::right
+		<< std::setw(6) << fps
+		<< std::setw(10) << channels
+		<< std::setw(12) << mean(latencies)
+		<< std::setw(12) << percentile(latencies, 0.99)
+		<< std::setw(12) << percentile(latencies, 1.0) << std::endl;
+}
+
+double measure_copy(void* dest, const void* source, size_t size, int iterations, int mode)
+{
+	auto start = tbb::tick_count::now();
+	for(int n = 0; n < iterations; ++n)
+	{
+		if(mode < 0)
+			std::memcpy(dest, source, size);
+		else
+			fast_memcpy(dest, source, size, static_cast<memcpy_mode::type>(mode));
+	}
+	auto seconds = (tbb::tick_count::now() - start).seconds();
+
+	return static_cast<double>(size) * static_cast<double>(iterations) / seconds / 1000000000.0;
+}
+
+}
+
+void run_executor_benchmark(std::wostream& out, const boost::property_tree::wptree& options)
+{
+	auto channel_counts = get_list<int>(options, L"channels", L"1,2,4,8");
+	auto frame_rates	= get_list<double>(options, L"fps", L"50,60");
+	auto hops			= options.get(L"hops", 3);
+	auto seconds		= options.get(L"seconds", 2.0);
+	auto tasks			= options.get(L"tasks", 200000);
+
+	out << L"executor latency, " << hops << L" executors per channel, microseconds" << std::endl;
+	out << std::left << std::setw(16) << L"executor" << std::right
+		<< std::setw(6) << L"fps"
+		<< std::setw(10) << L"channels"
+		<< std::setw(12) << L"mean"
+		<< std::setw(12) << L"p99"
+		<< std::setw(12) << L"max" << std::endl;
+	out << std::fixed << std::setprecision(1);
+
+	BOOST_FOREACH(auto fps, frame_rates)
+	{
+		BOOST_FOREACH(auto channels, channel_counts)
+		{
+			auto frames = std::max(1, static_cast<int>(seconds * fps));
+			print_executor_latency<executor>(out, L"executor", channels, hops, fps, frames);
+			print_executor_latency<ring_executor>(out, L"ring_executor", channels, hops, fps, frames);
+		}
+	}
+
+	out << std::endl << L"executor throughput, single producer, million tasks per second" << std::endl;
+	out << std::setprecision(2);
+	out << std::left << std::setw(16) << L"executor" << std::right << std::setw(12) << measure_executor_throughput<executor>(tasks) / 1000000.0 << std::endl;
+	out << std::left << std::setw(16) << L"ring_executor" << std::right << std::setw(12) << measure_executor_throughput<ring_executor>(tasks) / 1000000.0 << std::endl;
+}
+
+void run_memcpy_benchmark(std::wostream& out, const boost::property_tree::wptree& options)
+{
+	struct plane
+	{
+		const wchar_t*	name;
+		size_t			size;
+	};
+	
+	const plane planes[] = 
+	{
+		{L"720p",	1280*720*4},
+		{L"1080p",	1920*1080*4},
+		{L"2160p",	3840*2160*4}
+	};
+	
+	const auto gigabytes = options.get(L"gigabytes", 4.0);
+
+	out << L"bgra plane copies, GB/s" << std::endl;
+	out << std::left << std::setw(8) << L"plane" << std::right
+		<< std::setw(12) << L"memcpy"
+		<< std::setw(12) << L"automatic"
+		<< std::setw(12) << L"streaming"
+		<< std::setw(12) << L"cached" << std::endl;
+	out << std::fixed << std::setprecision(2);
+
+	BOOST_FOREACH(auto& plane, planes)
+	{
+		aligned_buffer source(plane.size, 128);
+		aligned_buffer dest(plane.size);
+		auto iterations = std::max(4, static_cast<int>(gigabytes * 1000000000.0 / static_cast<double>(plane.size)));
+
+		out << std::left << std::setw(8) << plane.name << std::right;
+		for(int mode = -1; mode <= memcpy_mode::cached; ++mode)
+			out << std::setw(12) << measure_copy(dest.data(), source.data(), plane.size, iterations, mode);
+		out << std::endl;
+	}
+}
+
+void run_audio_mixer_benchmark(std::wostream& out, const boost::property_tree::wptree& options)
+{
+	auto layer_counts	= get_list<int>(options, L"audio-layers", L"1,4,16");
+	auto channel_counts	= get_list<int>(options, L"audio-channels", L"2,8,16");
+	auto frames			= options.get(L"frames", 2000);
+
+	const auto& format_desc = core::video_format_desc::get(core::video_format::x1080i5000);
+
+	out << L"audio_mixer, " << format_desc.audio_cadence.front() << L" samples per frame, microseconds" << std::endl;
+	out << std::setw(8) << L"layers"
+		<< std::setw(10) << L"channels"
+		<< std::setw(12) << L"per frame"
+		<< std::setw(12) << L"per layer" << std::endl;
+	out << std::fixed << std::setprecision(1);
+
+	BOOST_FOREACH(auto channels, channel_counts)
+	{
+		auto layout = core::create_unspecified_layout(channels);
+
+		BOOST_FOREACH(auto layers, layer_counts)
+		{
+			core::audio_mixer mixer(make_safe<diagnostics::graph>());
+
+			std::vector<int> tags(layers);
+			std::vector<safe_ptr<core::write_frame>> layer_frames;
+			for(int n = 0; n < layers; ++n)
+			{
+				auto frame = make_safe<core::write_frame>(&tags[n], layout);
+				frame->audio_data().resize(format_desc.audio_cadence.front() * channels);
+				for(size_t s = 0; s < frame->audio_data().size(); ++s)
+					frame->audio_data()[s] = static_cast<int32_t>((s * 2654435761u) & 0x0FFFFFFF) - 0x08000000;
+				layer_frames.push_back(frame);
+			}
+
+			auto start = tbb::tick_count::now();
+			for(int n = 0; n < frames; ++n)
+			{
+				BOOST_FOREACH(auto& frame, layer_frames)
+					frame->accept(mixer);
+				mixer(format_desc, layout);
+			}
+			auto micros = (tbb::tick_count::now() - start).seconds() * 1000000.0 / static_cast<double>(frames);
+
+			out << std::setw(8) << layers
+				<< std::setw(10) << channels
+				<< std::setw(12) << micros
+				<< std::setw(12) << micros / static_cast<double>(layers) << std::endl;
+		}
+	}
+}
+
+void run_audio_convert_benchmark(std::wostream& out, const boost::property_tree::wptree& options)
+{
+	const size_t num_channels	= 8;
+	const size_t num_frames		= 48000;
+	const size_t count			= num_channels * num_frames;
+	const auto iterations		= options.get(L"iterations", 100);
+
+	std::vector<int32_t>	samples(count);
+	std::vector<int32_t>	samples2(count);
+	std::vector<int16_t>	samples16(count);
+	std::vector<uint8_t>	samples24(count*3);
+	std::vector<float>		samples_float(count);
+	std::vector<int32_t>	planes(count);
+
+	for(size_t n = 0; n < count; ++n)
+		samples[n] = static_cast<int32_t>(n * 2654435761u);
+
+	std::vector<int32_t*> plane_ptrs;
+	std::vector<const int32_t*> const_plane_ptrs;
+	for(size_t n = 0; n < num_channels; ++n)
+	{
+		plane_ptrs.push_back(planes.data() + n * num_frames);
+		const_plane_ptrs.push_back(planes.data() + n * num_frames);
+	}
+
+	struct conversion
+	{
+		const wchar_t*			name;
+		std::function<void()>	func;
+	};
+
+	core::audio_dither dither;
+	conversion conversions[] =
+	{
+		{L"32_to_16",		[&]{core::audio_32_to_16(samples16.data(), samples.data(), count, &dither);}},
+		{L"16_to_32",		[&]{core::audio_16_to_32(samples2.data(), samples16.data(), count);}},
+		{L"32_to_24",		[&]{core::audio_32_to_24(samples24.data(), samples.data(), count);}},
+		{L"24_to_32",		[&]{core::audio_24_to_32(samples2.data(), samples24.data(), count);}},
+		{L"32_to_float",	[&]{core::audio_32_to_float(samples_float.data(), samples.data(), count);}},
+		{L"float_to_32",	[&]{core::audio_float_to_32(samples2.data(), samples_float.data(), count);}},
+		{L"deinterleave",	[&]{core::audio_deinterleave(plane_ptrs.data(), samples.data(), num_channels, num_frames);}},
+		{L"interleave",		[&]{core::audio_interleave(samples2.data(), const_plane_ptrs.data(), num_channels, num_frames);}}
+	};
+
+	const core::audio_simd_level::type levels[] = {core::audio_simd_level::scalar, core::audio_simd_level::sse2, core::audio_simd_level::avx2};
+	const wchar_t* level_names[] = {L"scalar", L"sse2", L"avx2"};
+
+	out << L"audio sample conversions, million samples per second" << std::endl;
+	out << std::left << std::setw(14) << L"conversion" << std::right;
+	for(int n = 0; n < 3; ++n)
+		out << std::setw(10) << level_names[n];
+	out << std::endl;
+	out << std::fixed << std::setprecision(0);
+
+	const auto default_level = core::get_audio_simd_level();
+
+	BOOST_FOREACH(auto& conversion, conversions)
+	{
+		out << std::left << std::setw(14) << conversion.name << std::right;
+		for(int n = 0; n < 3; ++n)
+		{
+			core::set_audio_simd_level(levels[n]);
+			if(core::get_audio_simd_level() != levels[n])
+			{
+				out << std::setw(10) << L"-";
+				continue;
+			}
+
+			auto start = tbb::tick_count::now();
+			for(int i = 0; i < iterations; ++i)
+				conversion.func();
+			auto seconds = (tbb::tick_count::now() - start).seconds();
+
+			out << std::setw(10) << static_cast<double>(count) * static_cast<double>(iterations) / seconds / 1000000.0;
+		}
+		out << std::endl;
+	}
+
+	core::set_audio_simd_level(default_level);
+}
+
+namespace {
+
+// Converts count samples with the scalar reference and with level, from every source and destination offset
+// below MAX_OFFSET samples. Returns the number of conversions where the output, or the guard area behind it,
+// differs.
+template<typename Dest, typename Source>
+int count_audio_mismatches(
+		const std::vector<Source>& source,
+		size_t source_width,
+		size_t dest_width,
+		core::audio_simd_level::type level,
+		const std::function<void(Dest*, const Source*, size_t)>& convert)
+{
+	const size_t MAX_OFFSET	= 4;
+	const size_t MAX_TAIL	= 80;	// Two avx2 iterations of the widest kernel and then some.
+	const size_t GUARD		= 64;
+
+	auto num_samples = source.size() / source_width - MAX_OFFSET;
+
+	std::vector<size_t> counts;
+	for(size_t count = 0; count <= std::min(MAX_TAIL, num_samples); ++count)
+		counts.push_back(count);
+	counts.push_back(num_samples);
+
+	int mismatches = 0;
+
+	BOOST_FOREACH(auto count, counts)
+	{
+		for(size_t offset = 0; offset < MAX_OFFSET; ++offset)
+		{
+			auto input = source.data() + offset * source_width;
+
+			std::vector<Dest> expected((offset + count) * dest_width + GUARD, static_cast<Dest>(0x5A));
+			auto actual = expected;
+
+			core::set_audio_simd_level(core::audio_simd_level::scalar);
+			convert(expected.data() + offset * dest_width, input, count);
+
+			core::set_audio_simd_level(level);
+			convert(actual.data() + offset * dest_width, input, count);
+
+			if(std::memcmp(expected.data(), actual.data(), expected.size() * sizeof(Dest)) != 0)
+				++mismatches;
+		}
+	}
+
+	return mismatches;
+}
+
+uint32_t next_random(uint32_t& state)
+{
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+}
+
+bool run_audio_convert_verification(std::wostream& out, const boost::property_tree::wptree& options)
+{
+	const auto num_random = options.get(L"samples", 1 << 20);
+
+	uint32_t state = 2463534242u;
+
+	// 32 bit sources, the edges of every output format and then random values.
+	const int32_t edges32[] = 
+	{
+		0, 1, -1, 0x7F, 0x80, 0xFF, 0x100, 0x7FFF, 0x8000, 0xFFFF, 0x10000, 0x7FFF8000, 0x7FFFFF00, 
+		-0x7F, -0x80, -0x8000, -0x10000, std::numeric_limits<int32_t>::max(), std::numeric_limits<int32_t>::max() - 1,
+		std::numeric_limits<int32_t>::min(), std::numeric_limits<int32_t>::min() + 1
+	};
+	std::vector<int32_t> samples32(std::begin(edges32), std::end(edges32));
+	for(int n = 0; n < num_random; ++n)
+		samples32.push_back(static_cast<int32_t>(next_random(state)));
+
+	// Every 16 and 24 bit value.
+	std::vector<int16_t> samples16;
+	for(int n = 0; n < 0x10000 + 4; ++n)
+		samples16.push_back(static_cast<int16_t>(n));
+
+	std::vector<uint8_t> samples24;
+	for(int n = 0; n < 0x1000000 + 4; ++n)
+	{
+		samples24.push_back(static_cast<uint8_t>(n));
+		samples24.push_back(static_cast<uint8_t>(n >> 8));
+		samples24.push_back(static_cast<uint8_t>(n >> 16));
+	}
+
+	std::vector<int32_t> samples24_in_32;
+	for(int n = 0; n < 0x1000000 + 4; ++n)
+		samples24_in_32.push_back(static_cast<int32_t>(static_cast<uint32_t>(n) << 8) >> 8);
+
+	// Floats around and outside [-1.0, 1.0), rounding ties at the 32 bit scale, nans, infinities, 
+	// denormals and random bit patterns.
+	const float edges_float[] = 
+	{
+		0.0f, -0.0f, 1.0f, -1.0f, 0.5f, -0.5f, 0.99999994f, -0.99999994f, 1.5f, -1.5f, 1e30f, -1e30f, 1e-40f, -1e-40f,
+		1.0f / 4294967296.0f, 3.0f / 4294967296.0f, -5.0f / 4294967296.0f,
+		std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(), std::numeric_limits<float>::quiet_NaN()
+	};
+	std::vector<float> samples_float(std::begin(edges_float), std::end(edges_float));
+	for(int n = 0; n < num_random; ++n)
+	{
+		auto bits = next_random(state);
+		if(n % 2 == 0)
+		{
+			float value;
+			std::memcpy(&value, &bits, sizeof(value));
+			samples_float.push_back(value);
+		}
+		else
+			samples_float.push_back(static_cast<float>(static_cast<int32_t>(bits)) / 1800000000.0f);
+	}
+
+	struct verification
+	{
+		std::wstring											name;
+		std::function<int(core::audio_simd_level::type level)>	run;
+	};
+
+	std::vector<verification> verifications;
+
+	auto add = [&](const std::wstring& name, const std::function<int(core::audio_simd_level::type level)>& run)
+	{
+		verification entry = {name, run};
+		verifications.push_back(entry);
+	};
+
+	add(L"32_to_16", [&](core::audio_simd_level::type level)
+	{
+		return count_audio_mismatches<int16_t, int32_t>(samples32, 1, 1, level, [](int16_t* dest, const int32_t* source, size_t count)
+		{
+			core::audio_32_to_16(dest, source, count);
+		});
+	});
+	add(L"32_to_16 dither", [&](core::audio_simd_level::type level)
+	{
+		return count_audio_mismatches<int16_t, int32_t>(samples32, 1, 1, level, [](int16_t* dest, const int32_t* source, size_t count)
+		{
+			core::audio_dither dither;
+			dither.position = 0xFFFFFFF0u; // Wraps around within the tails.
+			core::audio_32_to_16(dest, source, count, &dither);
+		});
+	});
+	add(L"16_to_32", [&](core::audio_simd_level::type level)
+	{
+		return count_audio_mismatches<int32_t, int16_t>(samples16, 1, 1, level, core::audio_16_to_32);
+	});
+	add(L"32_to_24", [&](core::audio_simd_level::type level)
+	{
+		return count_audio_mismatches<uint8_t, int32_t>(samples32, 1, 3, level, [](uint8_t* dest, const int32_t* source, size_t count)
+		{
+			core::audio_32_to_24(dest, source, count); // Not the audio_util.h overload.
+		});
+	});
+	add(L"24_to_32", [&](core::audio_simd_level::type level)
+	{
+		return count_audio_mismatches<int32_t, uint8_t>(samples24, 3, 1, level, core::audio_24_to_32);
+	});
+	add(L"32_to_24_in_32", [&](core::audio_simd_level::type level)
+	{
+		return count_audio_mismatches<int32_t, int32_t>(samples32, 1, 1, level, core::audio_32_to_24_in_32);
+	});
+	add(L"24_in_32_to_32", [&](core::audio_simd_level::type level)
+	{
+		return count_audio_mismatches<int32_t, int32_t>(samples24_in_32, 1, 1, level, core::audio_24_in_32_to_32);
+	});
+	add(L"32_to_float", [&](core::audio_simd_level::type level)
+	{
+		return count_audio_mismatches<float, int32_t>(samples32, 1, 1, level, core::audio_32_to_float);
+	});
+	add(L"float_to_32", [&](core::audio_simd_level::type level)
+	{
+		return count_audio_mismatches<int32_t, float>(samples_float, 1, 1, level, core::audio_float_to_32);
+	});
+
+	const size_t channel_counts[] = {1, 2, 3, 6, 8, 16};
+	BOOST_FOREACH(auto num_channels, channel_counts)
+	{
+		auto channels = num_channels;
+
+		// Planar data is laid out as one plane of count samples after the other.
+		add(L"interleave " + boost::lexical_cast<std::wstring>(channels), [&, channels](core::audio_simd_level::type level)
+		{
+			return count_audio_mismatches<int32_t, int32_t>(samples32, channels, channels, level, [=](int32_t* dest, const int32_t* source, size_t count)
+			{
+				std::vector<const int32_t*> planes;
+				for(size_t c = 0; c < channels; ++c)
+					planes.push_back(source + c * count);
+				core::audio_interleave(dest, planes.data(), channels, count);
+			});
+		});
+		add(L"deinterleave " + boost::lexical_cast<std::wstring>(channels), [&, channels](core::audio_simd_level::type level)
+		{
+			return count_audio_mismatches<int32_t, int32_t>(samples32, channels, channels, level, [=](int32_t* dest, const int32_t* source, size_t count)
+			{
+				std::vector<int32_t*> planes;
+				for(size_t c = 0; c < channels; ++c)
+					planes.push_back(dest + c * count);
+				core::audio_deinterleave(planes.data(), source, channels, count);
+			});
+		});
+	}
+
+	const core::audio_simd_level::type levels[] = {core::audio_simd_level::sse2, core::audio_simd_level::avx2};
+	const wchar_t* level_names[] = {L"sse2", L"avx2"};
+
+	out << L"audio sample conversions against the scalar reference, mismatching conversions" << std::endl;
+	out << std::left << std::setw(18) << L"conversion" << std::right;
+	for(int n = 0; n < 2; ++n)
+		out << std::setw(10) << level_names[n];
+	out << std::endl;
+
+	const auto default_level = core::get_audio_simd_level();
+	bool passed = true;
+
+	BOOST_FOREACH(auto& verification, verifications)
+	{
+		out << std::left << std::setw(18) << verification.name << std::right;
+		for(int n = 0; n < 2; ++n)
+		{
+			core::set_audio_simd_level(levels[n]);
+			if(core::get_audio_simd_level() != levels[n])
+			{
+				out << std::setw(10) << L"-";
+				continue;
+			}
+
+			auto mismatches = verification.run(levels[n]);
+			if(mismatches > 0)
+			{
+				out << std::setw(10) << mismatches;
+				passed = false;
+			}
+			else
+				out << std::setw(10) << L"ok";
+		}
+		out << std::endl;
+	}
+
+	core::set_audio_simd_level(default_level);
+
+	if(!passed)
+		out << L"FAILED, the simd conversions differ from the scalar reference" << std::endl;
+
+	return passed;
+}
+
+}}
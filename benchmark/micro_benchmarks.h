@@ -0,0 +1,63 @@
+/*
+* Copyright 2013 Sveriges Television AB http://casparcg.com/
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+
+#pragma once
+
+#include <boost/property_tree/ptree_fwd.hpp>
+
+#include <iosfwd>
+
+namespace caspar { namespace benchmark {
+
+// Benchmarks of single pipeline components, each prints a table to out. options holds the 
+// command line options, see main.cpp.
+
+// Dispatch latency of executor and ring_executor with one task per frame from every channel.
+void run_executor_benchmark(std::wostream& out, const boost::property_tree::wptree& options);
+
+// fast_memcpy against memcpy for image planes of 720p, 1080p and 2160p.
+void run_memcpy_benchmark(std::wostream& out, const boost::property_tree::wptree& options);
+
+// audio_mixer cost per frame for a number of layers and audio channels.
+void run_audio_mixer_benchmark(std::wostream& out, const boost::property_tree::wptree& options);
+
+// Sample format conversions at every simd level the cpu supports.
+void run_audio_convert_benchmark(std::wostream& out, const boost::property_tree::wptree& options);
+
+// convert_frame for every source format the ffmpeg producer converts on the cpu.
+void run_color_conversion_benchmark(std::wostream& out, const boost::property_tree::wptree& options);
+
+// Decoded frames per second per codec and decoder thread count.
+void run_decode_benchmark(std::wostream& out, const boost::property_tree::wptree& options);
+
+// Verifications, each prints a table to out and returns false on any mismatch.
+
+// Every sample conversion at every simd level the cpu supports against the scalar reference, for every
+// tail length and unaligned buffers. 16 and 24 bit sources are exhaustive, 32 bit and float are edge
+// values and --samples random values.
+bool run_audio_convert_verification(std::wostream& out, const boost::property_tree::wptree& options);
+
+// Every deinterlace mode at every simd level the cpu supports against the scalar kernels, on fixed fields 
+// of packed and planar formats and sizes which cover the simd tails.
+bool run_deinterlace_verification(std::wostream& out, const boost::property_tree::wptree& options);
+
+}}
@@ -0,0 +1,52 @@
+/*
+* Copyright 2013 Sveriges Television AB http://casparcg.com/
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+
+#pragma once
+
+#include <boost/algorithm/string/classification.hpp>
+#include <boost/algorithm/string/split.hpp>
+#include <boost/foreach.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+#include <string>
+#include <vector>
+
+namespace caspar { namespace benchmark {
+
+// Returns the comma separated values of a command line option, e.g. "--layers 1,4,16".
+template<typename T>
+std::vector<T> get_list(const boost::property_tree::wptree& options, const std::wstring& name, const std::wstring& default_value)
+{
+	std::vector<std::wstring> values;
+	boost::split(values, options.get(name, default_value), boost::is_any_of(L","), boost::token_compress_on);
+
+	std::vector<T> result;
+	BOOST_FOREACH(auto& value, values)
+	{
+		if(!value.empty())
+			result.push_back(boost::lexical_cast<T>(value));
+	}
+	return result;
+}
+
+}}
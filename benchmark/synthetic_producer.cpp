@@ -0,0 +1,261 @@
+/*
+* Copyright 2013 Sveriges Television AB http://casparcg.com/
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+
+#include "synthetic_producer.h"
+
+#include <core/monitor/monitor.h>
+#include <core/producer/frame_producer.h>
+#include <core/producer/frame/basic_frame.h>
+#include <core/producer/frame/frame_factory.h>
+#include <core/producer/frame/pixel_format.h>
+#include <core/mixer/write_frame.h>
+#include <core/mixer/audio/audio_util.h>
+#include <core/video_format.h>
+
+#include <common/memory/memcpy.h>
+
+#include <tbb/parallel_for.h>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace caspar { namespace benchmark {
+
+synthetic_pattern::type synthetic_pattern::parse(const std::wstring& value, synthetic_pattern::type default_value)
+{
+	for(int n = 0; n < count; ++n)
+	{
+		if(boost::iequals(value, print(static_cast<type>(n))))
+			return static_cast<type>(n);
+	}
+	return default_value;
+}
+
+std::wstring synthetic_pattern::print(synthetic_pattern::type value)
+{
+	switch(value)
+	{
+	case bars:		return L"bars";
+	case noise:		return L"noise";
+	case gradient:	return L"gradient";
+	default:		return L"invalid";
+	}
+}
+
+namespace {
+
+uint32_t make_bgra(uint32_t r, uint32_t g, uint32_t b, uint32_t a = 255)
+{
+	return (a << 24) | (r << 16) | (g << 8) | b;
+}
+
+std::vector<uint32_t> make_bars(size_t width, size_t height)
+{
+	static const uint32_t bars[] = 
+	{
+		make_bgra(191, 191, 191),
+		make_bgra(191, 191,   0),
+		make_bgra(  0, 191, 191),
+		make_bgra(  0, 191,   0),
+		make_bgra(191,   0, 191),
+		make_bgra(191,   0,   0),
+		make_bgra(  0,   0, 191)
+	};
+	static const size_t bar_count = sizeof(bars)/sizeof(bars[0]);
+
+	std::vector<uint32_t> image(width*height);
+	for(size_t x = 0; x < width; ++x)
+		image[x] = bars[std::min(bar_count-1, x*bar_count/width)];
+	for(size_t y = 1; y < height; ++y)
+		std::copy(image.begin(), image.begin() + width, image.begin() + y*width);
+	return image;
+}
+
+class synthetic_producer : public core::frame_producer
+{	
+	core::monitor::subject				monitor_subject_;
+
+	const safe_ptr<core::frame_factory>		frame_factory_;
+	const core::video_format_desc			format_desc_;
+	const core::channel_layout				audio_channel_layout_;
+	const synthetic_pattern::type			pattern_;
+	const double							tone_frequency_;
+	
+	core::pixel_format_desc					pixel_desc_;
+	std::vector<uint32_t>					bars_;
+	std::vector<size_t>						audio_cadence_;
+	double									tone_phase_;
+	uint32_t								frame_number_;
+
+	safe_ptr<core::basic_frame>				last_frame_;
+public:
+	synthetic_producer(const safe_ptr<core::frame_factory>& frame_factory, synthetic_pattern::type pattern, double tone_frequency, const core::channel_layout& audio_channel_layout)
+		: monitor_subject_("/synthetic")
+		, frame_factory_(frame_factory)
+		, format_desc_(frame_factory->get_video_format_desc())
+		, audio_channel_layout_(audio_channel_layout)
+		, pattern_(pattern)
+		, tone_frequency_(tone_frequency)
+		, audio_cadence_(format_desc_.audio_cadence)
+		, tone_phase_(0.0)
+		, frame_number_(0)
+		, last_frame_(core::basic_frame::empty())
+	{
+		pixel_desc_.pix_fmt = core::pixel_format::bgra;
+		pixel_desc_.planes.push_back(core::pixel_format_desc::plane(format_desc_.width, format_desc_.height, 4));
+
+		if(pattern_ == synthetic_pattern::bars)
+			bars_ = make_bars(format_desc_.width, format_desc_.height);
+	}
+
+	// frame_producer
+	
+	virtual safe_ptr<core::basic_frame> receive(int) override
+	{
+		auto frame = frame_factory_->create_frame(this, pixel_desc_, audio_channel_layout_);
+
+		render_image(reinterpret_cast<uint32_t*>(frame->image_data().begin()));
+		render_tone(frame->audio_data());
+		frame->commit();
+
+		monitor_subject_ << core::monitor::message("/frame") % static_cast<int64_t>(frame_number_);
+
+		++frame_number_;
+		last_frame_ = frame;
+		return frame;
+	}
+	
+	virtual safe_ptr<core::basic_frame> last_frame() const override
+	{
+		return last_frame_;
+	}
+
+	virtual std::wstring print() const override
+	{
+		return L"synthetic[" + synthetic_pattern::print(pattern_) + L"]";
+	}
+
+	virtual boost::property_tree::wptree info() const override
+	{
+		boost::property_tree::wptree info;
+		info.add(L"type", L"synthetic-producer");
+		info.add(L"pattern", synthetic_pattern::print(pattern_));
+		info.add(L"tone-frequency", tone_frequency_);
+		return info;
+	}
+	
+	virtual core::monitor::source& monitor_output() override
+	{
+		return monitor_subject_;
+	}
+
+private:
+	void render_image(uint32_t* dest)
+	{
+		const int width	 = static_cast<int>(format_desc_.width);
+		const int height = static_cast<int>(format_desc_.height);
+
+		switch(pattern_)
+		{
+		case synthetic_pattern::bars:
+			fast_memcpy(dest, bars_.data(), bars_.size()*sizeof(uint32_t));
+			break;
+		case synthetic_pattern::noise:
+			{
+				const uint32_t frame_number = frame_number_;
+				tbb::parallel_for(tbb::blocked_range<int>(0, height), [&](const tbb::blocked_range<int>& r)
+				{
+					for(int y = r.begin(); y < r.end(); ++y)
+					{
+						uint32_t state = ((frame_number * static_cast<uint32_t>(height) + static_cast<uint32_t>(y)) * 2654435761u) | 1u; 
+						auto row = dest + y*width;
+						for(int x = 0; x < width; ++x)
+						{
+							state ^= state << 13;
+							state ^= state >> 17;
+							state ^= state << 5;
+							row[x] = state | 0xFF000000;
+						}
+					}
+				});
+			}
+			break;
+		case synthetic_pattern::gradient:
+			{
+				const int offset = static_cast<int>((frame_number_ * 8) % width);
+				tbb::parallel_for(tbb::blocked_range<int>(0, height), [&](const tbb::blocked_range<int>& r)
+				{
+					for(int y = r.begin(); y < r.end(); ++y)
+					{
+						// Premultiplied, as all frames in the mixer.
+						const uint32_t alpha = static_cast<uint32_t>(255 * y / std::max(1, height-1));
+						auto row = dest + y*width;
+						for(int x = 0; x < width; ++x)
+						{
+							const uint32_t value = static_cast<uint32_t>(((x + offset) % width) * 255 / width) * alpha / 255;
+							row[x] = make_bgra(value, alpha - value, alpha - value/2, alpha);
+						}
+					}
+				});
+			}
+			break;
+		}
+	}
+
+	void render_tone(core::audio_buffer& audio_data)
+	{
+		static const double pi			= 3.14159265358979323846;
+		static const double amplitude	= 0.1 * 2147483647.0; // -20 dBFS.
+
+		const auto num_channels = static_cast<size_t>(audio_channel_layout_.num_channels);
+		const auto num_samples	= audio_cadence_.front();
+		std::rotate(audio_cadence_.begin(), audio_cadence_.begin() + 1, audio_cadence_.end());
+
+		const double step = 2.0 * pi * tone_frequency_ / static_cast<double>(format_desc_.audio_sample_rate);
+
+		audio_data.resize(num_samples * num_channels);
+		for(size_t n = 0; n < num_samples; ++n)
+		{
+			auto sample = static_cast<int32_t>(std::sin(tone_phase_) * amplitude);
+			std::fill_n(audio_data.begin() + n * num_channels, num_channels, sample);
+			tone_phase_ = std::fmod(tone_phase_ + step, 2.0 * pi);
+		}
+	}
+};
+
+}
+
+safe_ptr<core::frame_producer> create_synthetic_producer(
+		const safe_ptr<core::frame_factory>& frame_factory,
+		synthetic_pattern::type pattern,
+		double tone_frequency,
+		const core::channel_layout& audio_channel_layout)
+{
+	return make_safe<synthetic_producer>(frame_factory, pattern, tone_frequency, audio_channel_layout);
+}
+
+}}
@@ -0,0 +1,63 @@
+/*
+* Copyright 2013 Sveriges Television AB http://casparcg.com/
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+
+#pragma once
+
+#include <common/memory/safe_ptr.h>
+
+#include <string>
+
+namespace caspar { 
+
+namespace core {
+
+class frame_producer;
+struct frame_factory;
+struct channel_layout;
+
+}
+
+namespace benchmark {
+
+struct synthetic_pattern
+{
+	enum type
+	{
+		bars,		// 75% colour bars, the same image every frame.
+		noise,		// Random pixels, defeats any caching or compression.
+		gradient,	// Moving horizontal gradient with a vertical alpha ramp.
+		count
+	};
+
+	static synthetic_pattern::type parse(const std::wstring& value, synthetic_pattern::type default_value = bars);
+	static std::wstring print(synthetic_pattern::type value);
+};
+
+// Renders a new bgra frame of the channel format every time it is received, together with a sine 
+// tone of tone_frequency Hz (-20 dBFS) on every audio channel.
+safe_ptr<core::frame_producer> create_synthetic_producer(
+		const safe_ptr<core::frame_factory>& frame_factory,
+		synthetic_pattern::type pattern,
+		double tone_frequency,
+		const core::channel_layout& audio_channel_layout);
+
+}}
@@ -0,0 +1,551 @@
+/*
+* Copyright 2013 Sveriges Television AB http://casparcg.com/
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+#pragma once
+
+#include "executor.h"
+
+#include "../exception/win32_exception.h"
+#include "../exception/exceptions.h"
+#include "../utility/string.h"
+#include "../log/log.h"
+
+#include <tbb/atomic.h>
+
+#include <boost/aligned_storage.hpp>
+#include <boost/mpl/if.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/thread.hpp>
+
+#include <algorithm>
+#include <memory>
+#include <type_traits>
+
+namespace caspar {
+
+namespace detail {
+
+struct task_vtable_t
+{
+	void (*invoke)(void* self);
+	void (*move)(void* dest, void* source);
+	void (*destroy)(void* self);
+};
+
+template<typename F>
+struct task_vtable
+{
+	static void invoke(void* self)
+	{
+		(*static_cast<F*>(self))();
+	}
+
+	static void move(void* dest, void* source)
+	{
+		new(dest) F(std::move(*static_cast<F*>(source)));
+		static_cast<F*>(source)->~F();
+	}
+
+	static void destroy(void* self)
+	{
+		static_cast<F*>(self)->~F();
+	}
+
+	static const task_vtable_t value;
+};
+
+template<typename F>
+const task_vtable_t task_vtable<F>::value = { &task_vtable<F>::invoke, &task_vtable<F>::move, &task_vtable<F>::destroy };
+
+// Functors which do not fit into small_task are stored on the heap.
+template<typename F>
+struct heap_task
+{
+	std::unique_ptr<F> func;
+
+	template<typename F2>
+	explicit heap_task(F2&& f) : func(new F(std::forward<F2>(f))){}
+	heap_task(heap_task&& other) : func(std::move(other.func)){}
+
+	void operator()() { (*func)(); }
+};
+
+template<typename R>
+struct packaged_task_invoker
+{
+	boost::packaged_task<R> task;
+
+	explicit packaged_task_invoker(boost::packaged_task<R>&& task) : task(std::move(task)){}
+	packaged_task_invoker(packaged_task_invoker&& other) : task(std::move(other.task)){}
+
+	void operator()()
+	{
+		try
+		{
+			task();
+		}
+		catch(boost::task_already_started&)
+		{
+		}
+	}
+};
+
+// Type erased void() functor with in place storage for small functors, avoids the
+// std::function heap allocation for the typical lambda capturing a few pointers.
+class small_task : boost::noncopyable
+{
+public:
+	static const size_t buffer_size = 64;
+
+	small_task() : vtable_(nullptr){}
+	~small_task() { reset(); }
+
+	template<typename F>
+	void assign(F&& func)
+	{
+		typedef typename std::decay<F>::type functor_type;
+		typedef typename boost::mpl::if_c<sizeof(functor_type) <= buffer_size, functor_type, heap_task<functor_type>>::type stored_type;
+
+		reset();
+		new(storage_.address()) stored_type(std::forward<F>(func));
+		vtable_ = &task_vtable<stored_type>::value;
+	}
+
+	void move_to(small_task& other)
+	{
+		other.reset();
+		if(!vtable_)
+			return;
+		vtable_->move(other.storage_.address(), storage_.address());
+		other.vtable_ = vtable_;
+		vtable_ = nullptr;
+	}
+
+	void reset()
+	{
+		if(!vtable_)
+			return;
+		vtable_->destroy(storage_.address());
+		vtable_ = nullptr;
+	}
+
+	void operator()()
+	{
+		if(vtable_)
+			vtable_->invoke(storage_.address());
+	}
+
+	bool empty() const { return vtable_ == nullptr; }
+private:
+	boost::aligned_storage<buffer_size, 16>	storage_;
+	const task_vtable_t*					vtable_;
+};
+
+// Bounded multi producer single consumer queue (D. Vyukov). Producers claim a slot with
+// a single compare and swap, the consumer never takes a lock.
+class mpsc_task_ring : boost::noncopyable
+{
+	struct cell
+	{
+		tbb::atomic<size_t>	sequence;
+		small_task			task;
+	};
+
+	const size_t				mask_;
+	boost::scoped_array<cell>	cells_;
+	char						pad0_[64];
+	tbb::atomic<size_t>			enqueue_pos_;
+	char						pad1_[64];
+	size_t						dequeue_pos_;
+public:
+	explicit mpsc_task_ring(size_t size) // size must be a power of two.
+		: mask_(size - 1)
+		, cells_(new cell[size])
+		, dequeue_pos_(0)
+	{
+		for(size_t n = 0; n < size; ++n)
+			cells_[n].sequence = n;
+		enqueue_pos_ = 0;
+	}
+
+	template<typename F>
+	bool try_push(F&& func)
+	{
+		cell* c;
+		size_t pos = enqueue_pos_;
+		while(true)
+		{
+			c = &cells_[pos & mask_];
+			auto dif = static_cast<std::ptrdiff_t>(c->sequence) - static_cast<std::ptrdiff_t>(pos);
+			if(dif == 0)
+			{
+				auto prev = enqueue_pos_.compare_and_swap(pos + 1, pos);
+				if(prev == pos)
+					break;
+				pos = prev;
+			}
+			else if(dif < 0)
+				return false;
+			else
+				pos = enqueue_pos_;
+		}
+		c->task.assign(std::forward<F>(func));
+		c->sequence = pos + 1;
+		return true;
+	}
+
+	// Consumer thread only.
+	bool try_pop(small_task& task)
+	{
+		auto& c = cells_[dequeue_pos_ & mask_];
+		if(static_cast<std::ptrdiff_t>(c.sequence) - static_cast<std::ptrdiff_t>(dequeue_pos_ + 1) < 0)
+			return false;
+		c.task.move_to(task);
+		c.sequence = dequeue_pos_ + mask_ + 1;
+		++dequeue_pos_;
+		return true;
+	}
+
+	// Consumer thread only.
+	bool ready() const
+	{
+		return static_cast<std::ptrdiff_t>(cells_[dequeue_pos_ & mask_].sequence) - static_cast<std::ptrdiff_t>(dequeue_pos_ + 1) >= 0;
+	}
+
+	size_t size() const
+	{
+		return mask_ + 1;
+	}
+};
+
+}
+
+// Drop in replacement for executor intended for the per frame hops (stage, mixer). Tasks are
+// stored in place in a bounded lock free ring instead of std::function + tbb::concurrent_bounded_queue,
+// the execution thread drains tasks in batches and only parks when both queues are empty.
+// post() is fire and forget and does not allocate a future.
+// NOTE: Producers block while the queue is full, do not post() from the execution thread into a full queue.
+class ring_executor : boost::noncopyable
+{
+	static const size_t default_ring_size	= 1024;
+	static const size_t batch_size			= 32;
+
+	const std::string				name_;
+	boost::thread					thread_;
+	tbb::atomic<bool>				is_running_;
+
+	std::unique_ptr<detail::mpsc_task_ring>	rings_[priority_count];
+	tbb::atomic<size_t>				counts_[priority_count];
+	tbb::atomic<size_t>				capacity_;
+	const size_t					spin_count_;
+
+	boost::mutex					mutex_;
+	boost::condition_variable		ready_cond_;
+	boost::condition_variable		full_cond_;
+	tbb::atomic<bool>				sleeping_;
+	tbb::atomic<int>				full_waiters_;
+
+	template<typename Func>
+	auto create_task(Func&& func) -> boost::packaged_task<decltype(func())> // noexcept
+	{
+		typedef boost::packaged_task<decltype(func())> task_type;
+
+		auto task = task_type(std::forward<Func>(func));
+
+		task.set_wait_callback(std::function<void(task_type&)>([=](task_type& my_task) // The std::function wrapper is required in order to add ::result_type to functor class.
+		{
+			try
+			{
+				if(boost::this_thread::get_id() == thread_.get_id())  // Avoids potential deadlock.
+					my_task();
+			}
+			catch(boost::task_already_started&){}
+		}));
+
+		return std::move(task);
+	}
+
+public:
+
+	// spin_count is the number of polls before the execution thread parks on an empty queue.
+	explicit ring_executor(const std::wstring& name, size_t spin_count = 0, size_t ring_size = default_ring_size) // noexcept
+		: name_(narrow(name))
+		, spin_count_(spin_count)
+	{
+		rings_[high_priority].reset(new detail::mpsc_task_ring(ring_size));
+		rings_[normal_priority].reset(new detail::mpsc_task_ring(ring_size));
+
+		counts_[high_priority]		= 0;
+		counts_[normal_priority]	= 0;
+		capacity_					= ring_size;
+		sleeping_					= false;
+		full_waiters_				= 0;
+		is_running_					= true;
+		thread_ = boost::thread([this]{run();});
+	}
+
+	virtual ~ring_executor() // noexcept
+	{
+		stop();
+		join();
+	}
+
+	void set_capacity(size_t capacity) // noexcept
+	{
+		capacity_ = std::min(std::max<size_t>(capacity, 1), rings_[normal_priority]->size());
+		notify_not_full();
+	}
+
+	void set_priority_class(thread_priority p)
+	{
+		post([=]
+		{
+			if(p == high_priority_class)
+				SetThreadPriority(GetCurrentThread(), HIGH_PRIORITY_CLASS);
+			else if(p == above_normal_priority_class)
+				SetThreadPriority(GetCurrentThread(), ABOVE_NORMAL_PRIORITY_CLASS);
+			else if(p == normal_priority_class)
+				SetThreadPriority(GetCurrentThread(), NORMAL_PRIORITY_CLASS);
+			else if(p == below_normal_priority_class)
+				SetThreadPriority(GetCurrentThread(), BELOW_NORMAL_PRIORITY_CLASS);
+		});
+	}
+
+	void clear()
+	{
+		invoke([this]
+		{
+			detail::small_task task;
+			while(pop(high_priority, task));
+			while(pop(normal_priority, task));
+		}, high_priority);
+	}
+
+	void stop() // noexcept
+	{
+		is_running_ = false;
+		wake(); // Wake the execution thread.
+	}
+
+	void wait() // noexcept
+	{
+		invoke([]{});
+	}
+
+	void join()
+	{
+		if(boost::this_thread::get_id() != thread_.get_id())
+			thread_.join();
+	}
+
+	template<typename Func>
+	auto begin_invoke(Func&& func, task_priority priority = normal_priority) -> boost::unique_future<decltype(func())> // noexcept
+	{
+		if(!is_running_)
+			BOOST_THROW_EXCEPTION(invalid_operation() << msg_info("executor not running."));
+
+		auto task = create_task(func);
+		auto future = task.get_future();
+
+		push(detail::packaged_task_invoker<decltype(func())>(std::move(task)), priority);
+
+		return std::move(future);
+	}
+
+	// Fire and forget, exceptions are logged on the execution thread.
+	template<typename Func>
+	void post(Func&& func, task_priority priority = normal_priority)
+	{
+		if(!is_running_)
+			BOOST_THROW_EXCEPTION(invalid_operation() << msg_info("executor not running."));
+
+		push(std::forward<Func>(func), priority);
+	}
+
+	template<typename Func>
+	auto invoke(Func&& func, task_priority priority = normal_priority) -> decltype(func()) // noexcept
+	{
+		if(boost::this_thread::get_id() == thread_.get_id())  // Avoids potential deadlock.
+			return func();
+
+		return begin_invoke(std::forward<Func>(func), priority).get();
+	}
+
+	void yield() // noexcept
+	{
+		if(boost::this_thread::get_id() != thread_.get_id())  // Only yield when calling from execution thread.
+			return;
+
+		execute_rest(high_priority);
+	}
+
+	size_t capacity() const /*noexcept*/ { return capacity_;	}
+	size_t size() const /*noexcept*/ { return counts_[normal_priority]; }
+	bool empty() const /*noexcept*/	{ return counts_[normal_priority] == 0;	}
+	bool is_running() const /*noexcept*/ { return is_running_; }
+
+private:
+
+	size_t capacity(task_priority priority) const
+	{
+		return priority == normal_priority ? capacity_ : rings_[priority]->size();
+	}
+
+	template<typename Func>
+	void push(Func&& func, task_priority priority)
+	{
+		reserve(priority);
+
+		while(!rings_[priority]->try_push(std::forward<Func>(func)))
+			boost::this_thread::yield(); // Slot reserved but not yet released by the consumer.
+
+		if(sleeping_.fetch_and_store(false))
+		{
+			boost::lock_guard<boost::mutex> lock(mutex_);
+			ready_cond_.notify_one();
+		}
+	}
+
+	void reserve(task_priority priority)
+	{
+		while(true)
+		{
+			size_t count = counts_[priority];
+			if(count < capacity(priority))
+			{
+				if(counts_[priority].compare_and_swap(count + 1, count) == count)
+					return;
+				continue;
+			}
+
+			boost::unique_lock<boost::mutex> lock(mutex_);
+			full_waiters_.fetch_and_increment();
+			while(counts_[priority] >= capacity(priority))
+				full_cond_.wait(lock);
+			full_waiters_.fetch_and_decrement();
+		}
+	}
+
+	bool pop(task_priority priority, detail::small_task& task)
+	{
+		if(!rings_[priority]->try_pop(task))
+			return false;
+
+		counts_[priority].fetch_and_decrement();
+		notify_not_full();
+		return true;
+	}
+
+	void notify_not_full()
+	{
+		if(full_waiters_ > 0)
+		{
+			boost::lock_guard<boost::mutex> lock(mutex_);
+			full_cond_.notify_all();
+		}
+	}
+
+	void wake()
+	{
+		sleeping_.fetch_and_store(false);
+		boost::lock_guard<boost::mutex> lock(mutex_);
+		ready_cond_.notify_one();
+	}
+
+	bool ready() const
+	{
+		return rings_[high_priority]->ready() || rings_[normal_priority]->ready();
+	}
+
+	void wait_for_work()
+	{
+		for(size_t n = 0; n < spin_count_; ++n)
+		{
+			if(ready() || !is_running_)
+				return;
+			YieldProcessor();
+		}
+
+		boost::unique_lock<boost::mutex> lock(mutex_);
+		sleeping_.fetch_and_store(true);
+		if(ready() || !is_running_)
+		{
+			sleeping_ = false;
+			return;
+		}
+		while(sleeping_)
+			ready_cond_.wait(lock);
+	}
+
+	void execute(detail::small_task& task) // noexcept
+	{
+		try
+		{
+			task();
+		}
+		catch(...)
+		{
+			CASPAR_LOG_CURRENT_EXCEPTION();
+		}
+		task.reset();
+	}
+
+	size_t execute_rest(task_priority priority) // noexcept
+	{
+		size_t count = 0;
+		detail::small_task task;
+		while(pop(priority, task))
+		{
+			execute(task);
+			++count;
+		}
+		return count;
+	}
+
+	void execute_batch() // noexcept
+	{
+		size_t count = execute_rest(high_priority);
+
+		detail::small_task task;
+		for(size_t n = 0; n < batch_size && pop(normal_priority, task); ++n)
+		{
+			execute(task);
+			count += 1 + execute_rest(high_priority);
+		}
+
+		if(count == 0)
+			wait_for_work();
+	}
+
+	void run() // noexcept
+	{
+		win32_exception::install_handler();
+		detail::SetThreadName(GetCurrentThreadId(), name_.c_str());
+		while(is_running_)
+			execute_batch();
+
+		execute_rest(high_priority);
+		execute_rest(normal_priority);
+	}
+};
+
+}
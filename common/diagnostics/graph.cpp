@@ -43,6 +43,7 @@
 #include <array>
 #include <numeric>
 #include <tuple>
+#include <vector>
 
 namespace caspar { namespace diagnostics {
 		
@@ -260,6 +261,55 @@ public:
 	}
 };
 
+class sink_registry
+{
+	tbb::atomic<int>					count_;
+	tbb::spin_mutex						mutex_;
+	std::vector<std::shared_ptr<sink>>	sinks_;
+public:
+	sink_registry()
+	{
+		count_ = 0;
+	}
+
+	bool empty() const
+	{
+		return count_ == 0;
+	}
+
+	void add(const std::shared_ptr<sink>& sink)
+	{
+		tbb::spin_mutex::scoped_lock lock(mutex_);
+		sinks_.push_back(sink);
+		count_ = static_cast<int>(sinks_.size());
+	}
+
+	void remove(const std::shared_ptr<sink>& sink)
+	{
+		tbb::spin_mutex::scoped_lock lock(mutex_);
+		boost::remove_erase(sinks_, sink);
+		count_ = static_cast<int>(sinks_.size());
+	}
+
+	template<typename Func>
+	void for_each(const Func& func)
+	{
+		std::vector<std::shared_ptr<sink>> sinks;
+		{
+			tbb::spin_mutex::scoped_lock lock(mutex_);
+			sinks = sinks_;
+		}
+		BOOST_FOREACH(auto& s, sinks)
+			func(*s);
+	}
+
+	static sink_registry& get_instance()
+	{
+		static sink_registry instance;
+		return instance;
+	}
+};
+
 struct graph::impl : public drawable
 {
 	tbb::concurrent_unordered_map<std::string, diagnostics::line> lines_;
@@ -284,11 +334,25 @@ struct graph::impl : public drawable
 	void set_value(const std::string& name, double value)
 	{
 		lines_[name].set_value(value);
+
+		auto& sinks = sink_registry::get_instance();
+		if(!sinks.empty())
+		{
+			auto text = get_text();
+			sinks.for_each([&](sink& s){s.on_value(text, name, value);});
+		}
 	}
 
 	void set_tag(const std::string& name)
 	{
 		lines_[name].set_tag();
+		
+		auto& sinks = sink_registry::get_instance();
+		if(!sinks.empty())
+		{
+			auto text = get_text();
+			sinks.for_each([&](sink& s){s.on_tag(text, name);});
+		}
 	}
 
 	void set_color(const std::string& name, int color)
@@ -305,6 +369,12 @@ struct graph::impl : public drawable
 	}
 		
 private:
+	std::wstring get_text()
+	{
+		tbb::spin_mutex::scoped_lock lock(mutex_);
+		return text_;
+	}
+
 	void render(sf::RenderTarget& target)
 	{
 		const size_t text_size = 15;
@@ -407,6 +477,17 @@ void show_graphs(bool value)
 	context::show(value);
 }
 
+void register_sink(const std::shared_ptr<sink>& sink)
+{
+	if(sink)
+		sink_registry::get_instance().add(sink);
+}
+
+void unregister_sink(const std::shared_ptr<sink>& sink)
+{
+	sink_registry::get_instance().remove(sink);
+}
+
 //namespace v2
 //{	
 //	
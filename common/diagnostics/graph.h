@@ -49,4 +49,16 @@ private:
 void register_graph(const safe_ptr<graph>& graph);
 void show_graphs(bool value);
 
+// Receives the values and tags written to any graph, e.g. to record timings without the
+// diagnostics window. Called on the thread writing the value and must not block.
+struct sink
+{
+	virtual ~sink(){}
+	virtual void on_value(const std::wstring& graph_text, const std::string& name, double value) = 0;
+	virtual void on_tag(const std::wstring& graph_text, const std::string& name) = 0;
+};
+
+void register_sink(const std::shared_ptr<sink>& sink);
+void unregister_sink(const std::shared_ptr<sink>& sink);
+
 }}
\ No newline at end of file
@@ -0,0 +1,234 @@
+/*
+* Copyright 2013 Sveriges Television AB http://casparcg.com/
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+#include "../stdafx.h"
+
+#include "memcpy.h"
+
+#include "../utility/assert.h"
+
+#include <tbb/parallel_for.h>
+
+#include <emmintrin.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+// AVX intrinsics are available from VS2010 SP1, the avx path is only selected at runtime when
+// both the cpu and the os (xsave) support it.
+#if defined(_MSC_VER) && _MSC_FULL_VER >= 160040219
+	#include <immintrin.h>
+	#include <intrin.h>
+	#define CASPAR_MEMCPY_AVX
+	#define CASPAR_MEMCPY_AVX_TARGET
+#elif defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+	#include <immintrin.h>
+	#define CASPAR_MEMCPY_AVX
+	#define CASPAR_MEMCPY_AVX_TARGET __attribute__((target("avx")))
+#endif
+
+namespace caspar { namespace detail {
+
+static const size_t parallel_threshold	= 512 * 1024;	// Below this the tbb overhead outweighs the gain.
+static const size_t parallel_chunk		= 64 * 1024;
+static const size_t streaming_threshold	= 256 * 1024;	// Roughly the per core L2 size.
+
+typedef void (*copy_func)(char* dest, const char* source, size_t count, bool stream);
+
+// Copies until dest is aligned to "alignment" and returns the number of bytes copied.
+static size_t copy_head(char* dest, const char* source, size_t count, size_t alignment)
+{
+	auto head = (alignment - (reinterpret_cast<std::uintptr_t>(dest) & (alignment - 1))) & (alignment - 1);
+	if(head > count)
+		head = count;
+	memcpy(dest, source, head);
+	return head;
+}
+
+static void copy_sse2(char* dest, const char* source, size_t count, bool stream)
+{
+	auto head = copy_head(dest, source, count, 16);
+	dest	+= head;
+	source	+= head;
+	count	-= head;
+
+	auto rest = count & 127;
+	auto end  = dest + (count - rest);
+
+	if(stream)
+	{
+		for(; dest != end; dest += 128, source += 128)
+		{
+			auto xmm0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source) + 0);
+			auto xmm1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source) + 1);
+			auto xmm2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source) + 2);
+			auto xmm3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source) + 3);
+			auto xmm4 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source) + 4);
+			auto xmm5 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source) + 5);
+			auto xmm6 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source) + 6);
+			auto xmm7 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source) + 7);
+
+			_mm_stream_si128(reinterpret_cast<__m128i*>(dest) + 0, xmm0);
+			_mm_stream_si128(reinterpret_cast<__m128i*>(dest) + 1, xmm1);
+			_mm_stream_si128(reinterpret_cast<__m128i*>(dest) + 2, xmm2);
+			_mm_stream_si128(reinterpret_cast<__m128i*>(dest) + 3, xmm3);
+			_mm_stream_si128(reinterpret_cast<__m128i*>(dest) + 4, xmm4);
+			_mm_stream_si128(reinterpret_cast<__m128i*>(dest) + 5, xmm5);
+			_mm_stream_si128(reinterpret_cast<__m128i*>(dest) + 6, xmm6);
+			_mm_stream_si128(reinterpret_cast<__m128i*>(dest) + 7, xmm7);
+		}
+		_mm_sfence();
+	}
+	else
+	{
+		for(; dest != end; dest += 128, source += 128)
+		{
+			auto xmm0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source) + 0);
+			auto xmm1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source) + 1);
+			auto xmm2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source) + 2);
+			auto xmm3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source) + 3);
+			auto xmm4 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source) + 4);
+			auto xmm5 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source) + 5);
+			auto xmm6 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source) + 6);
+			auto xmm7 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source) + 7);
+
+			_mm_store_si128(reinterpret_cast<__m128i*>(dest) + 0, xmm0);
+			_mm_store_si128(reinterpret_cast<__m128i*>(dest) + 1, xmm1);
+			_mm_store_si128(reinterpret_cast<__m128i*>(dest) + 2, xmm2);
+			_mm_store_si128(reinterpret_cast<__m128i*>(dest) + 3, xmm3);
+			_mm_store_si128(reinterpret_cast<__m128i*>(dest) + 4, xmm4);
+			_mm_store_si128(reinterpret_cast<__m128i*>(dest) + 5, xmm5);
+			_mm_store_si128(reinterpret_cast<__m128i*>(dest) + 6, xmm6);
+			_mm_store_si128(reinterpret_cast<__m128i*>(dest) + 7, xmm7);
+		}
+	}
+
+	memcpy(dest, source, rest);
+}
+
+#ifdef CASPAR_MEMCPY_AVX
+
+CASPAR_MEMCPY_AVX_TARGET
+static void copy_avx(char* dest, const char* source, size_t count, bool stream)
+{
+	auto head = copy_head(dest, source, count, 32);
+	dest	+= head;
+	source	+= head;
+	count	-= head;
+
+	auto rest = count & 127;
+	auto end  = dest + (count - rest);
+
+	if(stream)
+	{
+		for(; dest != end; dest += 128, source += 128)
+		{
+			auto ymm0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source) + 0);
+			auto ymm1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source) + 1);
+			auto ymm2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source) + 2);
+			auto ymm3 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source) + 3);
+
+			_mm256_stream_si256(reinterpret_cast<__m256i*>(dest) + 0, ymm0);
+			_mm256_stream_si256(reinterpret_cast<__m256i*>(dest) + 1, ymm1);
+			_mm256_stream_si256(reinterpret_cast<__m256i*>(dest) + 2, ymm2);
+			_mm256_stream_si256(reinterpret_cast<__m256i*>(dest) + 3, ymm3);
+		}
+		_mm_sfence();
+	}
+	else
+	{
+		for(; dest != end; dest += 128, source += 128)
+		{
+			auto ymm0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source) + 0);
+			auto ymm1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source) + 1);
+			auto ymm2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source) + 2);
+			auto ymm3 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source) + 3);
+
+			_mm256_store_si256(reinterpret_cast<__m256i*>(dest) + 0, ymm0);
+			_mm256_store_si256(reinterpret_cast<__m256i*>(dest) + 1, ymm1);
+			_mm256_store_si256(reinterpret_cast<__m256i*>(dest) + 2, ymm2);
+			_mm256_store_si256(reinterpret_cast<__m256i*>(dest) + 3, ymm3);
+		}
+	}
+
+	_mm256_zeroupper(); // Avoid the avx to sse transition penalty in the caller.
+
+	memcpy(dest, source, rest);
+}
+
+static bool has_avx()
+{
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 1);
+	bool osxsave	= (info[2] & (1 << 27)) != 0;
+	bool avx		= (info[2] & (1 << 28)) != 0;
+	return osxsave && avx && (_xgetbv(0) & 6) == 6; // xmm and ymm state enabled by the os.
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx") != 0;
+#endif
+}
+
+#endif
+
+static copy_func select_copy()
+{
+#ifdef CASPAR_MEMCPY_AVX
+	if(has_avx())
+		return &copy_avx;
+#endif
+	return &copy_sse2;
+}
+
+static const copy_func g_copy = select_copy();
+
+void* fast_memcpy(void* dest, const void* source, size_t count, memcpy_mode::type mode)
+{
+	CASPAR_ASSERT(dest != nullptr || count == 0);
+	CASPAR_ASSERT(source != nullptr || count == 0);
+
+	if(count < 128)
+		return memcpy(dest, source, count);
+
+	auto dest8		= reinterpret_cast<char*>(dest);
+	auto source8	= reinterpret_cast<const char*>(source);
+	bool stream		= mode == memcpy_mode::streaming || (mode == memcpy_mode::automatic && count >= streaming_threshold);
+	auto copy		= g_copy;
+
+	if(count < parallel_threshold)
+	{
+		copy(dest8, source8, count, stream);
+		return dest;
+	}
+
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, (count + parallel_chunk - 1) / parallel_chunk), [&](const tbb::blocked_range<size_t>& r)
+	{
+		auto begin	= r.begin() * parallel_chunk;
+		auto end	= std::min(r.end() * parallel_chunk, count);
+		copy(dest8 + begin, source8 + begin, end - begin, stream);
+	});
+
+	return dest;
+}
+
+}}
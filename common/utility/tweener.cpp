@@ -42,6 +42,9 @@
 
 #include "tweener.h"
 
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/algorithm/string/split.hpp>
+#include <boost/algorithm/string/classification.hpp>
 #include <boost/assign/list_of.hpp>
 #include <boost/regex.hpp>
 #include <boost/lexical_cast.hpp>
@@ -377,6 +380,56 @@ double ease_out_in_bounce (double t, double b, double c, double d, const std::ve
 	return ease_in_bounce((t*2)-d, b+c/2, c/2, d, params);
 }
 
+// Same as css cubic-bezier(x1, y1, x2, y2), the curve goes from (0, 0) to (1, 1) and x is time.
+double ease_cubic_bezier (double t, double b, double c, double d, const std::vector<double>& params)
+{
+	auto x1 = std::max(0.0, std::min(1.0, params[0]));
+	auto y1 = params[1];
+	auto x2 = std::max(0.0, std::min(1.0, params[2]));
+	auto y2 = params[3];
+
+	auto bezier = [](double s, double p1, double p2) 
+	{
+		return 3.0*(1.0-s)*(1.0-s)*s*p1 + 3.0*(1.0-s)*s*s*p2 + s*s*s;
+	};
+	auto bezier_slope = [](double s, double p1, double p2) 
+	{
+		return 3.0*(1.0-s)*(1.0-s)*p1 + 6.0*(1.0-s)*s*(p2-p1) + 3.0*s*s*(1.0-p2);
+	};
+	
+	auto x = std::max(0.0, std::min(1.0, t/d));
+
+	// x(s) is monotonic since x1 and x2 are within [0, 1]. Newton usually converges in a few 
+	// iterations, bisection handles flat slopes.
+	auto s = x;
+	for(int n = 0; n < 8; ++n)
+	{
+		auto error = bezier(s, x1, x2) - x;
+		if(std::abs(error) < 1.0e-7)
+			return c*bezier(s, y1, y2) + b;
+
+		auto slope = bezier_slope(s, x1, x2);
+		if(std::abs(slope) < 1.0e-6)
+			break;
+
+		s -= error/slope;
+	}
+
+	double lower = 0.0;
+	double upper = 1.0;
+	s = x;
+	for(int n = 0; n < 64 && std::abs(bezier(s, x1, x2) - x) >= 1.0e-7; ++n)
+	{
+		if(bezier(s, x1, x2) < x)
+			lower = s;
+		else
+			upper = s;
+		s = (lower + upper) * 0.5;
+	}
+
+	return c*bezier(s, y1, y2) + b;
+}
+
 tweener_t get_tweener(std::wstring name)
 {
 	std::transform(name.begin(), name.end(), name.begin(), std::tolower);
@@ -385,6 +438,32 @@ tweener_t get_tweener(std::wstring name)
 		return [](double t, double b, double c, double d){return ease_none(t, b, c, d, std::vector<double>());};
 	
 	std::vector<double> params;
+
+	if(boost::starts_with(name, L"cubicbezier")) // e.g. cubicbezier:0.25:0.1:0.25:1
+	{
+		std::vector<std::wstring> values;
+		boost::split(values, name, boost::is_any_of(L":"));
+
+		try
+		{
+			for(size_t n = 1; n < values.size(); ++n)
+				params.push_back(boost::lexical_cast<double>(values[n]));
+		}
+		catch(boost::bad_lexical_cast&)
+		{
+			params.clear();
+		}
+
+		if(params.size() == 4)
+		{
+			return [=](double t, double b, double c, double d)
+			{
+				return ease_cubic_bezier(t, b, c, d, params);
+			};
+		}
+
+		params.clear();
+	}
 	
 	static const boost::wregex expr(L"(?<NAME>\\w*)(:(?<V0>\\d+\\.?\\d?))?(:(?<V1>\\d+\\.?\\d?))?"); // boost::regex has no repeated captures?
 	boost::wsmatch what;
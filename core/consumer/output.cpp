@@ -37,13 +37,250 @@
 #include <common/memory/memshfl.h>
 #include <common/env.h>
 
+#include <boost/algorithm/string/predicate.hpp>
 #include <boost/circular_buffer.hpp>
+#include <boost/lexical_cast.hpp>
 #include <boost/timer.hpp>
 #include <boost/range/algorithm.hpp>
 #include <boost/range/adaptors.hpp>
 #include <boost/property_tree/ptree.hpp>
 
+#include <tbb/atomic.h>
+#include <tbb/concurrent_queue.h>
+
+#include <functional>
+
 namespace caspar { namespace core {
+
+consumer_queue_policy::type consumer_queue_policy::parse(const std::wstring& value, consumer_queue_policy::type default_value)
+{
+	if(boost::iequals(value, L"auto"))
+		return automatic;
+	if(boost::iequals(value, L"block"))
+		return block;
+	if(boost::iequals(value, L"drop-oldest"))
+		return drop_oldest;
+	if(boost::iequals(value, L"drop-newest"))
+		return drop_newest;
+	return default_value;
+}
+
+std::wstring consumer_queue_policy::print(consumer_queue_policy::type value)
+{
+	switch(value)
+	{
+	case block:			return L"block";
+	case drop_oldest:	return L"drop-oldest";
+	case drop_newest:	return L"drop-newest";
+	default:			return L"auto";
+	}
+}
+
+static const int default_queue_depth = 4;
+
+// Delivers frames to a consumer on its own thread. Frames are queued according to the policy, 
+// blocking queues keep the channel tick ticket until the frame has been sent.
+class consumer_queue : boost::noncopyable
+{
+	struct item
+	{
+		std::shared_ptr<read_frame>	frame;
+		std::shared_ptr<void>		ticket;
+		boost::timer				queue_timer;
+	};
+
+	const safe_ptr<frame_consumer>				consumer_;
+	const consumer_queue_policy::type			policy_;
+	const safe_ptr<diagnostics::graph>			graph_;
+	const std::function<void(const consumer_queue*)> on_failure_;
+
+	video_format_desc							format_desc_;
+	int											channel_index_;
+
+	tbb::concurrent_bounded_queue<item>			frames_;
+	tbb::atomic<int64_t>						dropped_;
+	tbb::atomic<int64_t>						latency_micros_;
+	tbb::atomic<bool>							failed_;
+
+	monitor::subject							monitor_subject_;
+
+	executor									executor_;
+public:
+	consumer_queue(int index, const safe_ptr<frame_consumer>& consumer, consumer_queue_policy::type policy, int depth, const safe_ptr<diagnostics::graph>& graph, const std::function<void(const consumer_queue*)>& on_failure)
+		: consumer_(consumer)
+		, policy_(policy != consumer_queue_policy::automatic ? policy : (consumer->has_synchronization_clock() ? consumer_queue_policy::block : consumer_queue_policy::drop_oldest))
+		, graph_(graph)
+		, on_failure_(on_failure)
+		, channel_index_(-1)
+		, monitor_subject_("/consumer/" + boost::lexical_cast<std::string>(index))
+		, executor_(L"consumer_queue " + consumer->print())
+	{
+		frames_.set_capacity(depth > 0 ? depth : default_queue_depth);
+		dropped_		= 0;
+		latency_micros_	= 0;
+		failed_			= false;
+	}
+
+	~consumer_queue()
+	{
+		clear();
+	}
+	
+	void initialize(const video_format_desc& format_desc, int channel_index)
+	{
+		clear();
+
+		executor_.invoke([&]
+		{
+			consumer_->initialize(format_desc, channel_index);
+			format_desc_	= format_desc;
+			channel_index_	= channel_index;
+		}, high_priority);
+	}
+
+	void send(const safe_ptr<read_frame>& frame, const std::shared_ptr<void>& ticket, bool offline)
+	{
+		if(failed_)
+			return;
+
+		auto policy = offline ? consumer_queue_policy::block : policy_;
+
+		item new_item;
+		new_item.frame	= frame;
+		if(policy == consumer_queue_policy::block)
+			new_item.ticket = ticket;
+
+		if(policy == consumer_queue_policy::drop_oldest)
+		{
+			item oldest;
+			while(!frames_.try_push(new_item))
+			{
+				if(frames_.try_pop(oldest))
+					drop();
+			}
+		}
+		else if(policy == consumer_queue_policy::drop_newest)
+		{
+			if(!frames_.try_push(new_item))
+			{
+				drop();
+				return;
+			}
+		}
+		else
+			frames_.push(new_item);
+
+		executor_.begin_invoke([this]
+		{
+			deliver();
+		});
+	}
+
+	void publish()
+	{
+		monitor_subject_ << monitor::message("/queue/depth")	% static_cast<int32_t>(depth()) % static_cast<int32_t>(capacity())
+						 << monitor::message("/queue/dropped")	% static_cast<int64_t>(dropped_)
+						 << monitor::message("/queue/latency")	% latency_millis();
+	}
+
+	boost::property_tree::wptree info() const
+	{
+		boost::property_tree::wptree info;
+		info.add(L"policy",		consumer_queue_policy::print(policy_));
+		info.add(L"depth",		depth());
+		info.add(L"capacity",	capacity());
+		info.add(L"dropped",	static_cast<int64_t>(dropped_));
+		info.add(L"latency",	latency_millis());
+		return info;
+	}
+
+	int depth() const
+	{
+		return std::max(0, static_cast<int>(frames_.size()));
+	}
+
+	int capacity() const
+	{
+		return static_cast<int>(frames_.capacity());
+	}
+
+	double latency_millis() const
+	{
+		return static_cast<double>(latency_micros_) / 1000.0;
+	}
+
+	bool is_blocking() const
+	{
+		return policy_ == consumer_queue_policy::block;
+	}
+
+	frame_consumer& consumer()
+	{
+		return *consumer_;
+	}
+
+	const frame_consumer& consumer() const
+	{
+		return *consumer_;
+	}
+
+	monitor::source& monitor_output()
+	{
+		return monitor_subject_;
+	}
+private:
+	void clear()
+	{
+		item discarded;
+		while(frames_.try_pop(discarded));
+	}
+
+	void drop()
+	{
+		++dropped_;
+		graph_->set_tag("consumer-drop");
+	}
+
+	void deliver()
+	{
+		item next;
+		if(failed_ || !frames_.try_pop(next))
+			return;
+		
+		if(!send_frame(make_safe_ptr(next.frame)))
+		{
+			failed_ = true;
+			clear();
+			on_failure_(this);
+		}
+
+		latency_micros_ = static_cast<int64_t>(next.queue_timer.elapsed()*1000000.0);
+	}
+
+	// Returns false if the consumer should be removed.
+	bool send_frame(const safe_ptr<read_frame>& frame)
+	{
+		try
+		{
+			return consumer_->send(frame).get();
+		}
+		catch(...)
+		{
+			CASPAR_LOG_CURRENT_EXCEPTION();
+			try
+			{
+				consumer_->initialize(format_desc_, channel_index_);
+				return consumer_->send(frame).get();
+			}
+			catch(...)
+			{
+				CASPAR_LOG_CURRENT_EXCEPTION();
+				CASPAR_LOG(error) << "Failed to recover consumer: " << consumer_->print() << L". Removing it.";
+				return false;
+			}
+		}
+	}
+};
 	
 struct output::implementation
 {		
@@ -53,13 +290,17 @@ struct output::implementation
 
 	video_format_desc								format_desc_;
 
-	std::map<int, safe_ptr<frame_consumer>>			consumers_;
+	monitor::subject								monitor_subject_;
+
+	std::map<int, safe_ptr<consumer_queue>>			consumers_;
 	
 	high_prec_timer									sync_timer_;
 
 	boost::circular_buffer<safe_ptr<read_frame>>	frames_;
 	std::map<int, int64_t>							send_to_consumers_delays_;
 
+	bool											offline_;
+
 	executor										executor_;
 		
 public:
@@ -67,34 +308,62 @@ public:
 		: channel_index_(channel_index)
 		, graph_(graph)
 		, format_desc_(format_desc)
+		, offline_(false)
+		, monitor_subject_("/output")
 		, executor_(L"output")
 	{
 		graph_->set_color("consume-time", diagnostics::color(1.0f, 0.4f, 0.0f, 0.8));
+		graph_->set_color("consumer-drop", diagnostics::color(0.9f, 0.3f, 0.6f));
+	}
+
+	~implementation()
+	{
+		// Delivery threads may post to the executor until they have been joined.
+		std::map<int, safe_ptr<consumer_queue>> consumers;
+		executor_.invoke([&]
+		{
+			consumers.swap(consumers_);
+		});
 	}
 
-	void add(int index, safe_ptr<frame_consumer> consumer)
+	void add(int index, safe_ptr<frame_consumer> consumer, consumer_queue_policy::type policy, int queue_depth)
 	{		
 		remove(index);
 
 		consumer = create_consumer_cadence_guard(consumer);
-		consumer->initialize(format_desc_, channel_index_);
+
+		auto queue = make_safe<consumer_queue>(index, consumer, policy, queue_depth, graph_, [=](const consumer_queue* failed)
+		{
+			executor_.begin_invoke([=]
+			{
+				auto it = consumers_.find(index);
+				if(it != consumers_.end() && it->second.get() == failed)
+				{
+					CASPAR_LOG(info) << print() << L" " << it->second->consumer().print() << L" Removed.";
+					send_to_consumers_delays_.erase(it->first);
+					consumers_.erase(it);
+				}
+			});
+		});
+		queue->initialize(format_desc_, channel_index_);
 
 		executor_.invoke([&]
 		{
-			consumers_.insert(std::make_pair(index, consumer));
+			queue->monitor_output().link_target(&monitor_subject_);
+			consumers_.insert(std::make_pair(index, queue));
 			CASPAR_LOG(info) << print() << L" " << consumer->print() << L" Added.";
 		}, high_priority);
 	}
 
-	void add(const safe_ptr<frame_consumer>& consumer)
+	void add(const safe_ptr<frame_consumer>& consumer, consumer_queue_policy::type policy, int queue_depth)
 	{
-		add(consumer->index(), consumer);
+		add(consumer->index(), consumer, policy, queue_depth);
 	}
 
 	void remove(int index)
 	{		
 		// Destroy  consumer on calling thread:
-		std::shared_ptr<frame_consumer> old_consumer;
+		std::shared_ptr<consumer_queue> old_consumer;
 
 		executor_.invoke([&]
 		{
@@ -109,7 +378,7 @@ public:
 
 		if(old_consumer)
 		{
-			auto str = old_consumer->print();
+			auto str = old_consumer->consumer().print();
 			old_consumer.reset();
 			CASPAR_LOG(info) << print() << L" " << str << L" Removed.";
 		}
@@ -135,7 +404,7 @@ public:
 				catch(...)
 				{
 					CASPAR_LOG_CURRENT_EXCEPTION();
-					CASPAR_LOG(info) << print() << L" " << it->second->print() << L" Removed.";
+					CASPAR_LOG(info) << print() << L" " << it->second->consumer().print() << L" Removed.";
 					send_to_consumers_delays_.erase(it->first);
 					consumers_.erase(it++);
 				}
@@ -145,6 +414,14 @@ public:
 			frames_.clear();
 		});
 	}
+
+	void set_offline(bool offline)
+	{
+		executor_.begin_invoke([=]
+		{
+			offline_ = offline;
+		}, high_priority);
+	}
 	
 	std::map<int, size_t> buffer_depths_snapshot() const
 	{
@@ -153,7 +430,7 @@ public:
 		BOOST_FOREACH(auto& consumer, consumers_)
 			result.insert(std::make_pair(
 					consumer.first,
-					consumer.second->buffer_depth()));
+					consumer.second->consumer().buffer_depth()));
 
 		return std::move(result);
 	}
@@ -171,9 +448,13 @@ public:
 				*boost::range::max_element(depths));
 	}
 
+	// Only consumers the channel waits for can pace it.
 	bool has_synchronization_clock() const
 	{
-		return boost::range::count_if(consumers_ | boost::adaptors::map_values, [](const safe_ptr<frame_consumer>& x){return x->has_synchronization_clock();}) > 0;
+		return boost::range::count_if(consumers_ | boost::adaptors::map_values, [](const safe_ptr<consumer_queue>& x)
+		{
+			return x->is_blocking() && x->consumer().has_synchronization_clock();
+		}) > 0;
 	}
 
 	void send(const std::pair<safe_ptr<read_frame>, std::shared_ptr<void>>& packet)
@@ -186,12 +467,13 @@ public:
 
 				auto input_frame = packet.first;
 
-				if(!has_synchronization_clock())
+				if(!offline_ && !has_synchronization_clock())
 					sync_timer_.tick(1.0/format_desc_.fps);
 
 				if(input_frame->image_size() != format_desc_.size)
 				{
-					sync_timer_.tick(1.0/format_desc_.fps);
+					if(!offline_)
+						sync_timer_.tick(1.0/format_desc_.fps);
 					return;
 				}
 				
@@ -204,76 +486,16 @@ public:
 				if(!frames_.full())
 					return;
 
-				std::map<int, boost::unique_future<bool>> send_results;
-
-				// Start invocations
-				for (auto it = consumers_.begin(); it != consumers_.end();)
+				// Blocking queues hold the ticket until their frame has been sent, the other
+				// queues return immediately. Offline every queue blocks so that nothing is dropped.
+				BOOST_FOREACH(auto& consumer, consumers_)
 				{
-					auto consumer	= it->second;
-					auto frame		= frames_.at(buffer_depths[it->first]-minmax.first);
+					auto frame = frames_.at(buffer_depths[consumer.first]-minmax.first);
 
-					send_to_consumers_delays_[it->first] = frame->get_age_millis();
-						
-					try
-					{
-						send_results.insert(std::make_pair(it->first, consumer->send(frame)));
-						++it;
-					}
-					catch(...)
-					{
-						CASPAR_LOG_CURRENT_EXCEPTION();
-						try
-						{
-							send_results.insert(std::make_pair(it->first, consumer->send(frame)));
-							++it;
-						}
-						catch(...)
-						{
-							CASPAR_LOG_CURRENT_EXCEPTION();
-							CASPAR_LOG(error) << "Failed to recover consumer: " << consumer->print() << L". Removing it.";
-							send_to_consumers_delays_.erase(it->first);
-							it = consumers_.erase(it);
-						}
-					}
-				}
+					send_to_consumers_delays_[consumer.first] = frame->get_age_millis();
 
-				// Retrieve results
-				for (auto result_it = send_results.begin(); result_it != send_results.end(); ++result_it)
-				{
-					auto consumer		= consumers_.at(result_it->first);
-					auto frame			= frames_.at(buffer_depths[result_it->first]-minmax.first);
-					auto& result_future	= result_it->second;
-						
-					try
-					{
-						if(!result_future.get())
-						{
-							CASPAR_LOG(info) << print() << L" " << consumer->print() << L" Removed.";
-							send_to_consumers_delays_.erase(result_it->first);
-							consumers_.erase(result_it->first);
-						}
-					}
-					catch(...)
-					{
-						CASPAR_LOG_CURRENT_EXCEPTION();
-						try
-						{
-							consumer->initialize(format_desc_, channel_index_);
-							if(!consumer->send(frame).get())
-							{
-								CASPAR_LOG(info) << print() << L" " << consumer->print() << L" Removed.";
-								send_to_consumers_delays_.erase(result_it->first);
-								consumers_.erase(result_it->first);
-							}
-						}
-						catch(...)
-						{
-							CASPAR_LOG_CURRENT_EXCEPTION();
-							CASPAR_LOG(error) << "Failed to recover consumer: " << consumer->print() << L". Removing it.";
-							send_to_consumers_delays_.erase(result_it->first);
-							consumers_.erase(result_it->first);
-						}
-					}
+					consumer.second->send(frame, packet.second, offline_);
+					consumer.second->publish();
 				}
 						
 				graph_->set_value("consume-time", consume_timer_.elapsed()*format_desc_.fps*0.5);
@@ -297,8 +519,9 @@ public:
 			boost::property_tree::wptree info;
 			BOOST_FOREACH(auto& consumer, consumers_)
 			{
-				info.add_child(L"consumers.consumer", consumer.second->info())
-					.add(L"index", consumer.first); 
+				auto& child = info.add_child(L"consumers.consumer", consumer.second->consumer().info());
+				child.add(L"index", consumer.first); 
+				child.add_child(L"queue", consumer.second->info());
 			}
 			return info;
 		}, high_priority));
@@ -312,15 +535,16 @@ public:
 			BOOST_FOREACH(auto& consumer, consumers_)
 			{
 				auto total_age =
-						consumer.second->presentation_frame_age_millis();
+						consumer.second->consumer().presentation_frame_age_millis();
 				auto sendoff_age = send_to_consumers_delays_[consumer.first];
 				auto presentation_time = total_age - sendoff_age;
 
 				boost::property_tree::wptree child;
-				child.add(L"name", consumer.second->print());
+				child.add(L"name", consumer.second->consumer().print());
 				child.add(L"age-at-arrival", sendoff_age);
 				child.add(L"presentation-time", presentation_time);
 				child.add(L"age-at-presentation", total_age);
+				child.add(L"queue-latency", consumer.second->latency_millis());
 
 				info.add_child(L"consumer", child);
 			}
@@ -338,13 +562,15 @@ public:
 };
 
 output::output(const safe_ptr<diagnostics::graph>& graph, const video_format_desc& format_desc, int channel_index) : impl_(new implementation(graph, format_desc, channel_index)){}
-void output::add(int index, const safe_ptr<frame_consumer>& consumer){impl_->add(index, consumer);}
-void output::add(const safe_ptr<frame_consumer>& consumer){impl_->add(consumer);}
+void output::add(int index, const safe_ptr<frame_consumer>& consumer, consumer_queue_policy::type policy, int queue_depth){impl_->add(index, consumer, policy, queue_depth);}
+void output::add(const safe_ptr<frame_consumer>& consumer, consumer_queue_policy::type policy, int queue_depth){impl_->add(consumer, policy, queue_depth);}
 void output::remove(int index){impl_->remove(index);}
 void output::remove(const safe_ptr<frame_consumer>& consumer){impl_->remove(consumer);}
 void output::send(const std::pair<safe_ptr<read_frame>, std::shared_ptr<void>>& frame) {impl_->send(frame); }
 void output::set_video_format_desc(const video_format_desc& format_desc){impl_->set_video_format_desc(format_desc);}
+void output::set_offline(bool offline){impl_->set_offline(offline);}
 boost::unique_future<boost::property_tree::wptree> output::info() const{return impl_->info();}
 boost::unique_future<boost::property_tree::wptree> output::delay_info() const{return impl_->delay_info();}
 bool output::empty() const{return impl_->empty();}
+monitor::source& output::monitor_output(){return impl_->monitor_subject_;}
 }}
\ No newline at end of file
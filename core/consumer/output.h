@@ -22,6 +22,7 @@
 #pragma once
 
 #include "../consumer/frame_consumer.h"
+#include "../monitor/monitor.h"
 
 #include <common/memory/safe_ptr.h>
 #include <common/concurrency/target.h>
@@ -31,7 +32,25 @@
 #include <boost/property_tree/ptree_fwd.hpp>
 #include <boost/thread/future.hpp>
 
+#include <string>
+
 namespace caspar { namespace core {
+
+// How frames are queued for a consumer which can't keep up with the channel.
+struct consumer_queue_policy
+{
+	enum type
+	{
+		automatic,		// block for consumers with a synchronization clock, drop_oldest for the rest.
+		block,			// The channel waits for the consumer.
+		drop_oldest,	// The oldest queued frame is dropped.
+		drop_newest,	// The new frame is dropped.
+		count
+	};
+
+	static consumer_queue_policy::type parse(const std::wstring& value, consumer_queue_policy::type default_value = automatic);
+	static std::wstring print(consumer_queue_policy::type value);
+};
 	
 class output : public target<std::pair<safe_ptr<read_frame>, std::shared_ptr<void>>>
 			 , boost::noncopyable
@@ -45,17 +64,23 @@ public:
 
 	// output
 	
-	void add(const safe_ptr<frame_consumer>& consumer);
-	void add(int index, const safe_ptr<frame_consumer>& consumer);
+	// Every consumer gets its own bounded queue and delivery thread.
+	void add(const safe_ptr<frame_consumer>& consumer, consumer_queue_policy::type policy = consumer_queue_policy::automatic, int queue_depth = 0);
+	void add(int index, const safe_ptr<frame_consumer>& consumer, consumer_queue_policy::type policy = consumer_queue_policy::automatic, int queue_depth = 0);
 	void remove(const safe_ptr<frame_consumer>& consumer);
 	void remove(int index);
 	
 	void set_video_format_desc(const video_format_desc& format_desc);
 
+	// An offline output is not paced, every consumer queue blocks regardless of its policy.
+	void set_offline(bool offline);
+
 	boost::unique_future<boost::property_tree::wptree> info() const;
 	boost::unique_future<boost::property_tree::wptree> delay_info() const;
 
 	bool empty() const;
+
+	monitor::source& monitor_output(); // /output/consumer/[index]/queue/...
 private:
 	struct implementation;
 	safe_ptr<implementation> impl_;
@@ -0,0 +1,488 @@
+/*
+* Copyright 2013 Sveriges Television AB http://casparcg.com/
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+#include "stdafx.h"
+
+#include "media_library.h"
+
+#include <common/concurrency/executor.h>
+#include <common/log/log.h>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/foreach.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <tbb/atomic.h>
+
+#include <map>
+#include <set>
+
+namespace caspar { namespace core {
+
+static const uint32_t MEDIA_LIBRARY_MAGIC		= 0x5842494c; // "LIBX"
+static const uint32_t MEDIA_LIBRARY_VERSION		= 1;
+static const int64_t  SAVE_INTERVAL_MILLIS		= 5000;
+
+media_info::media_info()
+	: size(0)
+	, last_modified(0)
+	, duration(0)
+	, width(0)
+	, height(0)
+	, fps(0.0)
+{
+}
+
+// Relative path with '/' separators, throws if file is not inside folder.
+static boost::filesystem::wpath get_relative_path(const boost::filesystem::wpath& file, const boost::filesystem::wpath& folder)
+{
+	// The monitor reports paths below the folder it was given, so this also works for removed files.
+	auto folder_string = folder.string();
+	if (boost::starts_with(file.string(), folder_string) && file.string().size() > folder_string.size())
+		return boost::filesystem::wpath(boost::trim_left_copy_if(file.string().substr(folder_string.size()), boost::is_any_of(L"/\\")));
+
+	auto result = file.filename();
+
+	boost::filesystem::wpath current_path = file;
+
+	while (true)
+	{
+		current_path = current_path.parent_path();
+
+		if (current_path.empty())
+			throw std::runtime_error("File not relative to folder");
+
+		if (boost::filesystem::equivalent(current_path, folder))
+			break;
+
+		result = current_path.filename() + L"/" + result;
+	}
+
+	return boost::filesystem::wpath(result);
+}
+
+static std::wstring get_name(const boost::filesystem::wpath& relative_path)
+{
+	return boost::filesystem::wpath(relative_path).replace_extension(L"").string();
+}
+
+static std::wstring get_key(const boost::filesystem::wpath& relative_path)
+{
+	return boost::to_upper_copy(relative_path.string());
+}
+
+static std::wstring get_filename_key(const boost::filesystem::wpath& relative_path)
+{
+	return boost::to_upper_copy(relative_path.stem());
+}
+
+struct media_library::implementation : boost::noncopyable
+{
+	const boost::filesystem::wpath				folder_;
+	const boost::filesystem::wpath				index_file_;
+	const media_info_extractor					extractor_;
+
+	mutable boost::mutex						mutex_;
+	std::map<std::wstring, media_info>			files_;			// By upper case relative path.
+	std::multimap<std::wstring, std::wstring>	by_filename_;	// Upper case filename without extension -> files_ key.
+	int64_t										extracted_;
+	int64_t										reused_;
+
+	tbb::atomic<bool>							dirty_;
+	boost::posix_time::ptime					last_save_;
+	executor									executor_;
+	filesystem_monitor::ptr						monitor_;
+
+	implementation(
+			filesystem_monitor_factory& monitor_factory,
+			const boost::filesystem::wpath& folder,
+			const boost::filesystem::wpath& index_file,
+			const media_info_extractor& extractor)
+		: folder_(folder)
+		, index_file_(index_file)
+		, extractor_(extractor)
+		, extracted_(0)
+		, reused_(0)
+		, last_save_(boost::posix_time::microsec_clock::universal_time())
+		, executor_(L"media_library")
+		, monitor_(create_monitor(monitor_factory))
+	{
+	}
+
+	~implementation()
+	{
+		executor_.invoke([=]
+		{
+			if (dirty_.fetch_and_store(false))
+				save();
+		});
+	}
+
+	// Loads the persisted index before the monitor starts reporting the files in the folder.
+	filesystem_monitor::ptr create_monitor(filesystem_monitor_factory& monitor_factory)
+	{
+		dirty_ = false;
+		executor_.set_priority_class(below_normal_priority_class);
+
+		try
+		{
+			load();
+		}
+		catch (...)
+		{
+			CASPAR_LOG_CURRENT_EXCEPTION();
+			files_.clear();
+			by_filename_.clear();
+		}
+
+		return monitor_factory.create(
+				folder_,
+				ALL,
+				true,
+				[this] (filesystem_event event, const boost::filesystem::wpath& file)
+				{
+					this->on_file_event(event, file);
+				},
+				[this] (const std::set<boost::filesystem::wpath>& initial_files) 
+				{
+					this->on_initial_files(initial_files);
+				});
+	}
+
+	std::vector<media_info> find(const std::wstring& prefix, const std::wstring& clip_type) const
+	{
+		auto key = boost::to_upper_copy(prefix);
+		std::vector<media_info> result;
+
+		boost::lock_guard<boost::mutex> lock(mutex_);
+
+		for (auto it = files_.lower_bound(key); it != files_.end() && boost::starts_with(it->first, key); ++it)
+		{
+			if (clip_type.empty() || boost::iequals(it->second.clip_type, clip_type))
+				result.push_back(it->second);
+		}
+
+		return result;
+	}
+
+	std::vector<media_info> find_by_filename(const std::wstring& filename) const
+	{
+		std::vector<media_info> result;
+
+		boost::lock_guard<boost::mutex> lock(mutex_);
+
+		auto range = by_filename_.equal_range(boost::to_upper_copy(filename));
+
+		for (auto it = range.first; it != range.second; ++it)
+			result.push_back(files_.find(it->second)->second);
+
+		return result;
+	}
+
+	boost::property_tree::wptree info() const
+	{
+		boost::property_tree::wptree info;
+
+		boost::lock_guard<boost::mutex> lock(mutex_);
+		info.add(L"folder",		folder_.string());
+		info.add(L"files",		files_.size());
+		info.add(L"extracted",	extracted_);
+		info.add(L"reused",		reused_);
+		return info;
+	}
+
+	void on_file_event(filesystem_event event, const boost::filesystem::wpath& file)
+	{
+		try
+		{
+			auto relative_path = get_relative_path(file, folder_);
+
+			if (event == REMOVED)
+			{
+				boost::lock_guard<boost::mutex> lock(mutex_);
+				erase(get_key(relative_path));
+			}
+			else 
+				update(file, relative_path);
+		}
+		catch (...)
+		{
+			// Probably removed while being indexed.
+			CASPAR_LOG(trace) << L"[media_library] Failed to index " << file.string();
+			return;
+		}
+
+		dirty_ = true;
+
+		if ((boost::posix_time::microsec_clock::universal_time() - last_save_).total_milliseconds() > SAVE_INTERVAL_MILLIS)
+			begin_save();
+	}
+
+	void on_initial_files(const std::set<boost::filesystem::wpath>& initial_files)
+	{
+		std::set<std::wstring> keys;
+
+		BOOST_FOREACH(auto& file, initial_files)
+		{
+			try
+			{
+				keys.insert(get_key(get_relative_path(file, folder_)));
+			}
+			catch (...)
+			{
+			}
+		}
+
+		{
+			boost::lock_guard<boost::mutex> lock(mutex_);
+
+			// Files which were removed while the server was not running.
+			std::vector<std::wstring> removed;
+			BOOST_FOREACH(auto& entry, files_)
+			{
+				if (keys.find(entry.first) == keys.end())
+					removed.push_back(entry.first);
+			}
+
+			BOOST_FOREACH(auto& key, removed)
+				erase(key);
+
+			CASPAR_LOG(info) << L"[media_library] Indexed " << files_.size() << L" files in " << folder_.string() 
+							 << L" (" << extracted_ << L" extracted, " << reused_ << L" from " << index_file_.filename() << L").";
+		}
+
+		dirty_ = true;
+		begin_save();
+	}
+
+	void update(const boost::filesystem::wpath& file, const boost::filesystem::wpath& relative_path)
+	{
+		auto key			= get_key(relative_path);
+		auto size			= boost::filesystem::file_size(file);
+		auto last_modified	= boost::filesystem::last_write_time(file);
+
+		{
+			boost::lock_guard<boost::mutex> lock(mutex_);
+
+			auto it = files_.find(key);
+			if (it != files_.end() && it->second.size == size && it->second.last_modified == last_modified)
+			{
+				++reused_;
+				return; // Unchanged since it was indexed, e.g. reported as CREATED when the monitor starts.
+			}
+		}
+
+		media_info info;
+		info.path			= relative_path;
+		info.name			= get_name(relative_path);
+		info.size			= size;
+		info.last_modified	= last_modified;
+
+		bool is_media = extractor_(file, info);
+
+		boost::lock_guard<boost::mutex> lock(mutex_);
+
+		erase(key);
+
+		if (is_media)
+		{
+			files_[key] = info;
+			by_filename_.insert(std::make_pair(get_filename_key(relative_path), key));
+			++extracted_;
+		}
+	}
+
+	void erase(const std::wstring& key)
+	{
+		auto it = files_.find(key);
+		if (it == files_.end())
+			return;
+
+		auto range = by_filename_.equal_range(get_filename_key(it->second.path));
+		for (auto filename_it = range.first; filename_it != range.second; ++filename_it)
+		{
+			if (filename_it->second == key)
+			{
+				by_filename_.erase(filename_it);
+				break;
+			}
+		}
+
+		files_.erase(it);
+	}
+
+	void begin_save()
+	{
+		last_save_ = boost::posix_time::microsec_clock::universal_time();
+
+		executor_.begin_invoke([=]
+		{
+			if (dirty_.fetch_and_store(false))
+				save();
+		});
+	}
+
+	template<typename T>
+	static void write(boost::filesystem::ofstream& stream, const T& value)
+	{
+		stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	static void write(boost::filesystem::ofstream& stream, const std::wstring& value)
+	{
+		write(stream, static_cast<uint32_t>(value.size()));
+		stream.write(reinterpret_cast<const char*>(value.data()), value.size() * sizeof(wchar_t));
+	}
+
+	template<typename T>
+	static bool read(boost::filesystem::ifstream& stream, T& value)
+	{
+		return stream.read(reinterpret_cast<char*>(&value), sizeof(T)).good();
+	}
+
+	static bool read(boost::filesystem::ifstream& stream, std::wstring& value)
+	{
+		uint32_t length = 0;
+		if (!read(stream, length) || length > 32768)
+			return false;
+
+		value.resize(length);
+		return length == 0 || stream.read(reinterpret_cast<char*>(&value[0]), length * sizeof(wchar_t)).good();
+	}
+
+	void save() const
+	{
+		try
+		{
+			std::vector<media_info> files;
+			{
+				boost::lock_guard<boost::mutex> lock(mutex_);
+				BOOST_FOREACH(auto& entry, files_)
+					files.push_back(entry.second);
+			}
+
+			boost::filesystem::create_directories(index_file_.parent_path());
+			boost::filesystem::ofstream stream(index_file_, std::ios::binary | std::ios::trunc);
+
+			write(stream, MEDIA_LIBRARY_MAGIC);
+			write(stream, MEDIA_LIBRARY_VERSION);
+			write(stream, static_cast<uint32_t>(sizeof(wchar_t)));
+			write(stream, static_cast<uint32_t>(files.size()));
+
+			BOOST_FOREACH(auto& info, files)
+			{
+				write(stream, info.path.string());
+				write(stream, info.clip_type);
+				write(stream, info.size);
+				write(stream, static_cast<int64_t>(info.last_modified));
+				write(stream, info.duration);
+				write(stream, static_cast<int32_t>(info.width));
+				write(stream, static_cast<int32_t>(info.height));
+				write(stream, info.fps);
+				write(stream, info.audio_layout);
+			}
+		}
+		catch (...)
+		{
+			CASPAR_LOG_CURRENT_EXCEPTION();
+		}
+	}
+
+	void load()
+	{
+		if (!boost::filesystem::exists(index_file_))
+			return;
+
+		boost::filesystem::ifstream stream(index_file_, std::ios::binary);
+
+		uint32_t magic		= 0;
+		uint32_t version	= 0;
+		uint32_t char_size	= 0;
+		uint32_t count		= 0;
+
+		if (!read(stream, magic) || magic != MEDIA_LIBRARY_MAGIC || !read(stream, version) || version != MEDIA_LIBRARY_VERSION)
+			return;
+
+		if (!read(stream, char_size) || char_size != sizeof(wchar_t) || !read(stream, count))
+			return;
+
+		for (uint32_t n = 0; n < count; ++n)
+		{
+			media_info	info;
+			std::wstring path;
+			int64_t		last_modified = 0;
+			int32_t		width = 0;
+			int32_t		height = 0;
+
+			if (!read(stream, path) || !read(stream, info.clip_type) || !read(stream, info.size) || !read(stream, last_modified) ||
+				!read(stream, info.duration) || !read(stream, width) || !read(stream, height) || !read(stream, info.fps) || 
+				!read(stream, info.audio_layout))
+			{
+				CASPAR_LOG(warning) << L"[media_library] " << index_file_.string() << L" is truncated.";
+				break;
+			}
+
+			info.path			= boost::filesystem::wpath(path);
+			info.name			= get_name(info.path);
+			info.last_modified	= static_cast<std::time_t>(last_modified);
+			info.width			= width;
+			info.height			= height;
+
+			auto key = get_key(info.path);
+			files_[key] = info;
+			by_filename_.insert(std::make_pair(get_filename_key(info.path), key));
+		}
+	}
+};
+
+media_library::media_library(
+		filesystem_monitor_factory& monitor_factory,
+		const boost::filesystem::wpath& folder,
+		const boost::filesystem::wpath& index_file,
+		const media_info_extractor& extractor)
+	: impl_(new implementation(monitor_factory, folder, index_file, extractor))
+{
+}
+
+media_library::~media_library()
+{
+}
+
+std::vector<media_info> media_library::find(const std::wstring& prefix, const std::wstring& clip_type) const
+{
+	return impl_->find(prefix, clip_type);
+}
+
+std::vector<media_info> media_library::find_by_filename(const std::wstring& filename) const
+{
+	return impl_->find_by_filename(filename);
+}
+
+boost::property_tree::wptree media_library::info() const
+{
+	return impl_->info();
+}
+
+}}
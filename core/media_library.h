@@ -0,0 +1,81 @@
+/*
+* Copyright 2013 Sveriges Television AB http://casparcg.com/
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+#pragma once
+
+#include <common/memory/safe_ptr.h>
+#include <common/filesystem/filesystem_monitor.h>
+
+#include <boost/noncopyable.hpp>
+#include <boost/property_tree/ptree_fwd.hpp>
+
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace caspar { namespace core {
+
+struct media_info
+{
+	boost::filesystem::wpath	path;			// Relative to the library folder.
+	std::wstring				name;			// path without extension, '/' separated.
+	std::wstring				clip_type;		// STILL, MOVIE, AUDIO, TEMPLATE...
+	uint64_t					size;
+	std::time_t					last_modified;
+	int64_t						duration;		// In frames, 0 if unknown.
+	int							width;			// 0 if unknown.
+	int							height;			// 0 if unknown.
+	double						fps;			// 0.0 if unknown.
+	std::wstring				audio_layout;	// Empty if there is no audio.
+
+	media_info();
+};
+
+// Fills in everything but path, name, size and last_modified. Returns false if file is not part of the library.
+typedef std::function<bool (const boost::filesystem::wpath& file, media_info& info)> media_info_extractor;
+
+// Index of the files under a folder which is kept up to date by a filesystem monitor and persisted between runs,
+// files which have not been modified since they were indexed are never extracted again.
+class media_library : boost::noncopyable
+{
+public:
+	media_library(
+			filesystem_monitor_factory& monitor_factory,
+			const boost::filesystem::wpath& folder,
+			const boost::filesystem::wpath& index_file,
+			const media_info_extractor& extractor);
+	~media_library();
+
+	// Ordered by path. Case insensitive, an empty prefix or clip_type matches everything.
+	std::vector<media_info> find(const std::wstring& prefix, const std::wstring& clip_type = L"") const;
+
+	// Files in any folder whose name without extension is filename. Case insensitive.
+	std::vector<media_info> find_by_filename(const std::wstring& filename) const;
+
+	boost::property_tree::wptree info() const;
+private:
+	struct implementation;
+	safe_ptr<implementation> impl_;
+};
+
+}}
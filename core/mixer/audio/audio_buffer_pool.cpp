@@ -0,0 +1,244 @@
+/*
+* Copyright 2013 Sveriges Television AB http://casparcg.com/
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+#include "../../stdafx.h"
+
+#include "audio_buffer_pool.h"
+
+#include <boost/property_tree/ptree.hpp>
+#include <boost/thread/tss.hpp>
+
+#include <tbb/atomic.h>
+#include <tbb/cache_aligned_allocator.h>
+#include <tbb/spin_mutex.h>
+
+#include <array>
+
+namespace caspar { namespace core {
+	
+namespace {
+
+const size_t MIN_CLASS_SHIFT	= 8;				// 256 bytes.
+const size_t MAX_CLASS_SHIFT	= 24;				// 16 MB, larger blocks bypass the pool.
+const size_t CLASS_BUDGET		= 32 * 1024 * 1024;	// Bytes cached per size class before blocks are released to the heap.
+
+boost::thread_specific_ptr<int64_t>& get_thread_heap_allocations()
+{
+	// Never destroyed, same as the pool.
+	static auto& thread_heap_allocations = *new boost::thread_specific_ptr<int64_t>();
+	return thread_heap_allocations;
+}
+
+struct free_block
+{
+	free_block* next;
+};
+
+struct size_class
+{
+	tbb::atomic<free_block*>	returned;	// Blocks are pushed one at a time by any thread and taken all at once, i.e. no aba.
+	tbb::spin_mutex				mutex;
+	free_block*					free;		// Guarded by mutex.
+	tbb::atomic<size_t>			cached;
+};
+
+class audio_buffer_pool
+{
+	std::array<size_class, MAX_CLASS_SHIFT - MIN_CLASS_SHIFT + 1> classes_;
+
+	tbb::atomic<int64_t> allocations_;
+	tbb::atomic<int64_t> heap_allocations_;
+	tbb::atomic<int64_t> heap_deallocations_;
+	tbb::atomic<int64_t> outstanding_bytes_;
+	tbb::atomic<int64_t> pooled_bytes_;
+public:
+	audio_buffer_pool()
+	{
+		for(size_t n = 0; n < classes_.size(); ++n)
+		{
+			classes_[n].returned	= nullptr;
+			classes_[n].free		= nullptr;
+			classes_[n].cached		= 0;
+		}
+
+		allocations_		= 0;
+		heap_allocations_	= 0;
+		heap_deallocations_	= 0;
+		outstanding_bytes_	= 0;
+		pooled_bytes_		= 0;
+	}
+
+	void* allocate(size_t size)
+	{
+		++allocations_;
+
+		auto index = class_index(size);
+		if(index >= classes_.size())
+		{
+			outstanding_bytes_ += size;
+			return heap_allocate(size);
+		}
+
+		auto& size_class	= classes_[index];
+		auto block_size		= class_size(index);
+
+		free_block* block = nullptr;
+		{
+			tbb::spin_mutex::scoped_lock lock(size_class.mutex);
+
+			if(!size_class.free)
+				size_class.free = size_class.returned.fetch_and_store(nullptr);
+
+			block = size_class.free;
+			if(block)
+				size_class.free = block->next;
+		}
+
+		outstanding_bytes_ += block_size;
+
+		if(!block)
+			return heap_allocate(block_size);
+
+		--size_class.cached;
+		pooled_bytes_ -= block_size;
+		return block;
+	}
+
+	void deallocate(void* p, size_t size)
+	{
+		if(!p)
+			return;
+
+		auto index = class_index(size);
+		if(index >= classes_.size())
+		{
+			outstanding_bytes_ -= size;
+			heap_deallocate(p, size);
+			return;
+		}
+
+		auto& size_class	= classes_[index];
+		auto block_size		= class_size(index);
+
+		outstanding_bytes_ -= block_size;
+
+		if(++size_class.cached > std::max<size_t>(2, CLASS_BUDGET / block_size))
+		{
+			--size_class.cached;
+			heap_deallocate(p, block_size);
+			return;
+		}
+
+		pooled_bytes_ += block_size;
+
+		auto block = static_cast<free_block*>(p);
+		free_block* head;
+		do
+		{
+			head		= size_class.returned;
+			block->next = head;
+		}
+		while(size_class.returned.compare_and_swap(block, head) != head);
+	}
+
+	audio_buffer_pool_stats stats() const
+	{
+		audio_buffer_pool_stats stats;
+		stats.allocations			= allocations_;
+		stats.heap_allocations		= heap_allocations_;
+		stats.heap_deallocations	= heap_deallocations_;
+		stats.outstanding_bytes		= outstanding_bytes_;
+		stats.pooled_bytes			= pooled_bytes_;
+		return stats;
+	}
+private:
+	static size_t class_index(size_t size)
+	{
+		size_t index = 0;
+		while(size > class_size(index) && index <= MAX_CLASS_SHIFT - MIN_CLASS_SHIFT)
+			++index;
+		return index;
+	}
+
+	static size_t class_size(size_t index)
+	{
+		return static_cast<size_t>(1) << (index + MIN_CLASS_SHIFT);
+	}
+
+	void* heap_allocate(size_t size)
+	{
+		++heap_allocations_;
+
+		auto& thread_heap_allocations = get_thread_heap_allocations();
+		if(!thread_heap_allocations.get())
+			thread_heap_allocations.reset(new int64_t(0));
+		++*thread_heap_allocations;
+
+		return tbb::cache_aligned_allocator<uint8_t>().allocate(size);
+	}
+
+	void heap_deallocate(void* p, size_t size)
+	{
+		++heap_deallocations_;
+		tbb::cache_aligned_allocator<uint8_t>().deallocate(static_cast<uint8_t*>(p), size);
+	}
+};
+
+// Never destroyed, audio buffers owned by other statics can be released during static destruction.
+audio_buffer_pool& g_pool = *new audio_buffer_pool();
+
+}
+
+void* allocate_audio_block(size_t size)
+{
+	return g_pool.allocate(size);
+}
+
+void deallocate_audio_block(void* block, size_t size)
+{
+	g_pool.deallocate(block, size);
+}
+
+audio_buffer_pool_stats get_audio_buffer_pool_stats()
+{
+	return g_pool.stats();
+}
+
+int64_t get_thread_audio_heap_allocations()
+{
+	auto thread_heap_allocations = get_thread_heap_allocations().get();
+	return thread_heap_allocations ? *thread_heap_allocations : 0;
+}
+
+boost::property_tree::wptree audio_buffer_pool_info()
+{
+	auto stats = get_audio_buffer_pool_stats();
+
+	boost::property_tree::wptree info;
+	info.add(L"allocations",		stats.allocations);
+	info.add(L"heap-allocations",	stats.heap_allocations);
+	info.add(L"heap-deallocations",	stats.heap_deallocations);
+	info.add(L"outstanding-bytes",	stats.outstanding_bytes);
+	info.add(L"pooled-bytes",		stats.pooled_bytes);
+	return info;
+}
+
+}}
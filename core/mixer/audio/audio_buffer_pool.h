@@ -0,0 +1,121 @@
+/*
+* Copyright 2013 Sveriges Television AB http://casparcg.com/
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+#pragma once
+
+#include <boost/property_tree/ptree_fwd.hpp>
+
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include <stdint.h>
+
+namespace caspar { namespace core {
+
+// Size classed pool which backs the sample storage of the decode -> mix -> consume audio path.
+// Blocks are cache aligned. Freed blocks are returned to their size class without locking and are
+// reused by the next allocation of the same class, so once a channel has reached steady state its
+// audio buffers never touch the heap.
+void* allocate_audio_block(size_t size);
+void deallocate_audio_block(void* block, size_t size);
+
+// Allocation counters, see INFO SYSTEM.
+struct audio_buffer_pool_stats
+{
+	int64_t allocations;		// Blocks handed out.
+	int64_t heap_allocations;	// Blocks which had to be allocated from the heap.
+	int64_t heap_deallocations;	// Blocks released to the heap instead of the pool.
+	int64_t outstanding_bytes;	// Bytes currently in use.
+	int64_t pooled_bytes;		// Bytes currently cached by the pool.
+};
+
+audio_buffer_pool_stats get_audio_buffer_pool_stats();
+
+// Blocks the calling thread has had to allocate from the heap, e.g. the mixer thread of one channel.
+int64_t get_thread_audio_heap_allocations();
+boost::property_tree::wptree audio_buffer_pool_info();
+
+template<typename T>
+class audio_allocator
+{
+public:
+	typedef T					value_type;
+	typedef T*					pointer;
+	typedef const T*			const_pointer;
+	typedef T&					reference;
+	typedef const T&			const_reference;
+	typedef size_t				size_type;
+	typedef ptrdiff_t			difference_type;
+
+	template<typename U> 
+	struct rebind
+	{
+		typedef audio_allocator<U> other;
+	};
+
+	audio_allocator() throw() {}
+	audio_allocator(const audio_allocator&) throw() {}
+	template<typename U> 
+	audio_allocator(const audio_allocator<U>&) throw() {}
+
+	pointer address(reference x) const {return &x;}
+	const_pointer address(const_reference x) const {return &x;}
+	
+	pointer allocate(size_type n, const void* = nullptr)
+	{
+		return static_cast<pointer>(allocate_audio_block(n * sizeof(value_type)));
+	}
+
+	void deallocate(pointer p, size_type n)
+	{
+		deallocate_audio_block(p, n * sizeof(value_type));
+	}
+
+	size_type max_size() const throw()
+	{
+		return (~static_cast<size_t>(0) >> 1) / sizeof(value_type);
+	}
+
+	template<typename U>
+	void construct(pointer p, U&& value)
+	{
+		::new(static_cast<void*>(p)) value_type(std::forward<U>(value));
+	}
+
+	void destroy(pointer p)
+	{
+		p->~value_type();
+	}
+};
+
+template<typename T, typename U>
+inline bool operator==(const audio_allocator<T>&, const audio_allocator<U>&) {return true;}
+
+template<typename T, typename U>
+inline bool operator!=(const audio_allocator<T>&, const audio_allocator<U>&) {return false;}
+
+typedef std::vector<int32_t, audio_allocator<int32_t>>	audio_buffer;
+typedef std::vector<int16_t, audio_allocator<int16_t>>	audio_buffer_16;
+typedef std::vector<int8_t, audio_allocator<int8_t>>	audio_buffer_8;	// Packed 24 bit samples.
+
+}}
@@ -0,0 +1,647 @@
+/*
+* Copyright 2013 Sveriges Television AB http://casparcg.com/
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+#include "../../stdafx.h"
+
+#include "audio_convert.h"
+
+#include <emmintrin.h>
+
+#include <algorithm>
+#include <cmath>
+
+// AVX2 intrinsics are available from VS2012, the avx2 path is only selected at runtime when
+// both the cpu and the os (xsave) support it.
+#if defined(_MSC_VER) && _MSC_VER >= 1700
+	#include <immintrin.h>
+	#include <intrin.h>
+	#define CASPAR_AUDIO_AVX2
+	#define CASPAR_AUDIO_AVX2_TARGET
+#elif defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+	#include <immintrin.h>
+	#define CASPAR_AUDIO_AVX2
+	#define CASPAR_AUDIO_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
+namespace caspar { namespace core {
+
+namespace {
+
+const float FLOAT_SCALE		= 2147483648.0f;
+const float FLOAT_MAX		= 2147483520.0f;	// Largest float below 2^31.
+const float FLOAT_MIN		= -2147483648.0f;
+
+struct audio_kernels
+{
+	void (*s32_to_s16)(int16_t* dest, const int32_t* source, size_t count);
+	void (*s32_to_s16_dither)(int16_t* dest, const int32_t* source, size_t count, uint32_t position);
+	void (*s16_to_s32)(int32_t* dest, const int16_t* source, size_t count);
+	void (*s32_to_s24)(uint8_t* dest, const int32_t* source, size_t count);
+	void (*s24_to_s32)(int32_t* dest, const uint8_t* source, size_t count);
+	void (*s32_to_s24_in_32)(int32_t* dest, const int32_t* source, size_t count);
+	void (*s24_in_32_to_s32)(int32_t* dest, const int32_t* source, size_t count);
+	void (*s32_to_f32)(float* dest, const int32_t* source, size_t count);
+	void (*f32_to_s32)(int32_t* dest, const float* source, size_t count);
+};
+
+// Scalar reference, the simd kernels use these for the tails.
+
+uint32_t dither_hash(uint32_t x)
+{
+	x *= 0x9E3779B1u;
+	x ^= x >> 15;
+	x *= 0x85EBCA77u;
+	x ^= x >> 13;
+	return x;
+}
+
+int16_t dither_to_16(int32_t sample, uint32_t position)
+{
+	auto hash	= dither_hash(position);
+	auto noise	= static_cast<int32_t>(hash & 0xFFFF) - static_cast<int32_t>(hash >> 16);
+
+	// Same as floor((sample + noise + 0x8000) / 0x10000) without overflowing.
+	auto value	= (sample >> 16) + ((static_cast<int32_t>(sample & 0xFFFF) + noise + 0x8000) >> 16);
+	return static_cast<int16_t>(std::max(-32768, std::min(32767, value)));
+}
+
+int32_t float_to_32(float sample)
+{
+	// Same comparisons, and therefore the same nan handling, as minps/maxps.
+	float x = sample * FLOAT_SCALE;
+	x = x < FLOAT_MAX ? x : FLOAT_MAX;
+	x = x > FLOAT_MIN ? x : FLOAT_MIN;
+
+	// Round to nearest even, as cvtps2dq does.
+	double value	= x;
+	double result	= std::floor(value);
+	double fraction = value - result;
+	if(fraction > 0.5 || (fraction == 0.5 && std::fmod(result, 2.0) != 0.0))
+		result += 1.0;
+	return static_cast<int32_t>(result);
+}
+
+void s32_to_s16_scalar(int16_t* dest, const int32_t* source, size_t count)
+{
+	for(size_t n = 0; n < count; ++n)
+		dest[n] = static_cast<int16_t>(source[n] >> 16);
+}
+
+void s32_to_s16_dither_scalar(int16_t* dest, const int32_t* source, size_t count, uint32_t position)
+{
+	for(size_t n = 0; n < count; ++n)
+		dest[n] = dither_to_16(source[n], position + static_cast<uint32_t>(n));
+}
+
+void s16_to_s32_scalar(int32_t* dest, const int16_t* source, size_t count)
+{
+	for(size_t n = 0; n < count; ++n)
+		dest[n] = static_cast<int32_t>(static_cast<uint32_t>(static_cast<uint16_t>(source[n])) << 16);
+}
+
+void s32_to_s24_scalar(uint8_t* dest, const int32_t* source, size_t count)
+{
+	for(size_t n = 0; n < count; ++n)
+	{
+		auto sample = static_cast<uint32_t>(source[n]);
+		dest[n*3+0] = static_cast<uint8_t>(sample >> 8);
+		dest[n*3+1] = static_cast<uint8_t>(sample >> 16);
+		dest[n*3+2] = static_cast<uint8_t>(sample >> 24);
+	}
+}
+
+void s24_to_s32_scalar(int32_t* dest, const uint8_t* source, size_t count)
+{
+	for(size_t n = 0; n < count; ++n)
+		dest[n] = static_cast<int32_t>(static_cast<uint32_t>(source[n*3+0]) << 8 | static_cast<uint32_t>(source[n*3+1]) << 16 | static_cast<uint32_t>(source[n*3+2]) << 24);
+}
+
+void s32_to_s24_in_32_scalar(int32_t* dest, const int32_t* source, size_t count)
+{
+	for(size_t n = 0; n < count; ++n)
+		dest[n] = source[n] >> 8;
+}
+
+void s24_in_32_to_s32_scalar(int32_t* dest, const int32_t* source, size_t count)
+{
+	for(size_t n = 0; n < count; ++n)
+		dest[n] = static_cast<int32_t>(static_cast<uint32_t>(source[n]) << 8);
+}
+
+void s32_to_f32_scalar(float* dest, const int32_t* source, size_t count)
+{
+	for(size_t n = 0; n < count; ++n)
+		dest[n] = static_cast<float>(source[n]) * (1.0f / FLOAT_SCALE);
+}
+
+void f32_to_s32_scalar(int32_t* dest, const float* source, size_t count)
+{
+	for(size_t n = 0; n < count; ++n)
+		dest[n] = float_to_32(source[n]);
+}
+
+// SSE2.
+
+__m128i mullo_epi32_sse2(__m128i a, __m128i b)
+{
+	auto even	= _mm_mul_epu32(a, b);
+	auto odd	= _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+	return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+void s32_to_s16_sse2(int16_t* dest, const int32_t* source, size_t count)
+{
+	size_t n = 0;
+	for(; n + 8 <= count; n += 8)
+	{
+		auto a = _mm_srai_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(source + n) + 0), 16);
+		auto b = _mm_srai_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(source + n) + 1), 16);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + n), _mm_packs_epi32(a, b));
+	}
+	s32_to_s16_scalar(dest + n, source + n, count - n);
+}
+
+__m128i dither_to_16_sse2(__m128i sample, __m128i position)
+{
+	auto hash	= mullo_epi32_sse2(position, _mm_set1_epi32(0x9E3779B1u));
+	hash		= _mm_xor_si128(hash, _mm_srli_epi32(hash, 15));
+	hash		= mullo_epi32_sse2(hash, _mm_set1_epi32(0x85EBCA77u));
+	hash		= _mm_xor_si128(hash, _mm_srli_epi32(hash, 13));
+
+	auto low16	= _mm_set1_epi32(0xFFFF);
+	auto noise	= _mm_sub_epi32(_mm_and_si128(hash, low16), _mm_srli_epi32(hash, 16));
+	auto low	= _mm_add_epi32(_mm_add_epi32(_mm_and_si128(sample, low16), noise), _mm_set1_epi32(0x8000));
+	return _mm_add_epi32(_mm_srai_epi32(sample, 16), _mm_srai_epi32(low, 16));
+}
+
+void s32_to_s16_dither_sse2(int16_t* dest, const int32_t* source, size_t count, uint32_t position)
+{
+	auto lanes = _mm_setr_epi32(0, 1, 2, 3);
+
+	size_t n = 0;
+	for(; n + 8 <= count; n += 8)
+	{
+		auto pos = _mm_add_epi32(_mm_set1_epi32(position + static_cast<uint32_t>(n)), lanes);
+		auto a	 = dither_to_16_sse2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(source + n) + 0), pos);
+		auto b	 = dither_to_16_sse2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(source + n) + 1), _mm_add_epi32(pos, _mm_set1_epi32(4)));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + n), _mm_packs_epi32(a, b));
+	}
+	s32_to_s16_dither_scalar(dest + n, source + n, count - n, position + static_cast<uint32_t>(n));
+}
+
+void s16_to_s32_sse2(int32_t* dest, const int16_t* source, size_t count)
+{
+	auto zero = _mm_setzero_si128();
+
+	size_t n = 0;
+	for(; n + 8 <= count; n += 8)
+	{
+		auto x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + n));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + n) + 0, _mm_unpacklo_epi16(zero, x));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + n) + 1, _mm_unpackhi_epi16(zero, x));
+	}
+	s16_to_s32_scalar(dest + n, source + n, count - n);
+}
+
+// 4 samples per 16 byte register, 12 bytes are packed or unpacked and 16 are read or written, 
+// hence the simd loops stop 6 samples before the end.
+
+void s32_to_s24_sse2(uint8_t* dest, const int32_t* source, size_t count)
+{
+	auto even	= _mm_setr_epi32(0x00FFFFFF, 0, 0x00FFFFFF, 0);
+	auto odd	= _mm_setr_epi32(0, 0x00FFFFFF, 0, 0x00FFFFFF);
+	auto low48	= _mm_setr_epi32(-1, 0xFFFF, 0, 0);
+	auto high48	= _mm_setr_epi32(0, 0, -1, 0xFFFF);
+
+	size_t n = 0;
+	for(; n + 6 <= count; n += 4)
+	{
+		auto x = _mm_srli_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(source + n)), 8);
+		x = _mm_or_si128(_mm_and_si128(x, even), _mm_srli_epi64(_mm_and_si128(x, odd), 8));
+		x = _mm_or_si128(_mm_and_si128(x, low48), _mm_srli_si128(_mm_and_si128(x, high48), 2));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + n*3), x);
+	}
+	s32_to_s24_scalar(dest + n*3, source + n, count - n);
+}
+
+void s24_to_s32_sse2(int32_t* dest, const uint8_t* source, size_t count)
+{
+	auto even	= _mm_setr_epi32(0x00FFFFFF, 0, 0x00FFFFFF, 0);
+	auto odd	= _mm_setr_epi32(0xFF000000, 0xFFFF, 0xFF000000, 0xFFFF);
+	auto low48	= _mm_setr_epi32(-1, 0xFFFF, 0, 0);
+	auto high48	= _mm_setr_epi32(0, 0, -1, 0xFFFF);
+
+	size_t n = 0;
+	for(; n + 6 <= count; n += 4)
+	{
+		auto x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + n*3));
+		x = _mm_or_si128(_mm_and_si128(x, low48), _mm_and_si128(_mm_slli_si128(x, 2), high48));
+		x = _mm_or_si128(_mm_and_si128(x, even), _mm_slli_epi64(_mm_and_si128(x, odd), 8));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + n), _mm_slli_epi32(x, 8));
+	}
+	s24_to_s32_scalar(dest + n, source + n*3, count - n);
+}
+
+void s32_to_s24_in_32_sse2(int32_t* dest, const int32_t* source, size_t count)
+{
+	size_t n = 0;
+	for(; n + 4 <= count; n += 4)
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + n), _mm_srai_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(source + n)), 8));
+	s32_to_s24_in_32_scalar(dest + n, source + n, count - n);
+}
+
+void s24_in_32_to_s32_sse2(int32_t* dest, const int32_t* source, size_t count)
+{
+	size_t n = 0;
+	for(; n + 4 <= count; n += 4)
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + n), _mm_slli_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(source + n)), 8));
+	s24_in_32_to_s32_scalar(dest + n, source + n, count - n);
+}
+
+void s32_to_f32_sse2(float* dest, const int32_t* source, size_t count)
+{
+	auto scale = _mm_set1_ps(1.0f / FLOAT_SCALE);
+
+	size_t n = 0;
+	for(; n + 4 <= count; n += 4)
+		_mm_storeu_ps(dest + n, _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(source + n))), scale));
+	s32_to_f32_scalar(dest + n, source + n, count - n);
+}
+
+void f32_to_s32_sse2(int32_t* dest, const float* source, size_t count)
+{
+	auto scale	= _mm_set1_ps(FLOAT_SCALE);
+	auto max	= _mm_set1_ps(FLOAT_MAX);
+	auto min	= _mm_set1_ps(FLOAT_MIN);
+
+	size_t n = 0;
+	for(; n + 4 <= count; n += 4)
+	{
+		auto x = _mm_mul_ps(_mm_loadu_ps(source + n), scale);
+		x = _mm_max_ps(_mm_min_ps(x, max), min);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + n), _mm_cvtps_epi32(x));
+	}
+	f32_to_s32_scalar(dest + n, source + n, count - n);
+}
+
+// AVX2, same algorithms on 256 bit registers. Byte shifts and packs work within 128 bit lanes.
+
+#ifdef CASPAR_AUDIO_AVX2
+
+CASPAR_AUDIO_AVX2_TARGET
+void s32_to_s16_avx2(int16_t* dest, const int32_t* source, size_t count)
+{
+	size_t n = 0;
+	for(; n + 16 <= count; n += 16)
+	{
+		auto a = _mm256_srai_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + n) + 0), 16);
+		auto b = _mm256_srai_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + n) + 1), 16);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + n), _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), _MM_SHUFFLE(3, 1, 2, 0)));
+	}
+	_mm256_zeroupper();
+	s32_to_s16_sse2(dest + n, source + n, count - n);
+}
+
+CASPAR_AUDIO_AVX2_TARGET
+__m256i dither_to_16_avx2(__m256i sample, __m256i position)
+{
+	auto hash	= _mm256_mullo_epi32(position, _mm256_set1_epi32(0x9E3779B1u));
+	hash		= _mm256_xor_si256(hash, _mm256_srli_epi32(hash, 15));
+	hash		= _mm256_mullo_epi32(hash, _mm256_set1_epi32(0x85EBCA77u));
+	hash		= _mm256_xor_si256(hash, _mm256_srli_epi32(hash, 13));
+
+	auto low16	= _mm256_set1_epi32(0xFFFF);
+	auto noise	= _mm256_sub_epi32(_mm256_and_si256(hash, low16), _mm256_srli_epi32(hash, 16));
+	auto low	= _mm256_add_epi32(_mm256_add_epi32(_mm256_and_si256(sample, low16), noise), _mm256_set1_epi32(0x8000));
+	return _mm256_add_epi32(_mm256_srai_epi32(sample, 16), _mm256_srai_epi32(low, 16));
+}
+
+CASPAR_AUDIO_AVX2_TARGET
+void s32_to_s16_dither_avx2(int16_t* dest, const int32_t* source, size_t count, uint32_t position)
+{
+	auto lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+	size_t n = 0;
+	for(; n + 16 <= count; n += 16)
+	{
+		auto pos = _mm256_add_epi32(_mm256_set1_epi32(position + static_cast<uint32_t>(n)), lanes);
+		auto a	 = dither_to_16_avx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + n) + 0), pos);
+		auto b	 = dither_to_16_avx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + n) + 1), _mm256_add_epi32(pos, _mm256_set1_epi32(8)));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + n), _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), _MM_SHUFFLE(3, 1, 2, 0)));
+	}
+	_mm256_zeroupper();
+	s32_to_s16_dither_sse2(dest + n, source + n, count - n, position + static_cast<uint32_t>(n));
+}
+
+CASPAR_AUDIO_AVX2_TARGET
+void s16_to_s32_avx2(int32_t* dest, const int16_t* source, size_t count)
+{
+	size_t n = 0;
+	for(; n + 8 <= count; n += 8)
+	{
+		auto x = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(source + n)));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + n), _mm256_slli_epi32(x, 16));
+	}
+	_mm256_zeroupper();
+	s16_to_s32_scalar(dest + n, source + n, count - n);
+}
+
+// The two 12 byte halves are stored separately, the second store overwrites the 4 garbage bytes
+// of the first, hence the loops stop 10 samples before the end.
+
+CASPAR_AUDIO_AVX2_TARGET
+void s32_to_s24_avx2(uint8_t* dest, const int32_t* source, size_t count)
+{
+	auto even	= _mm256_setr_epi32(0x00FFFFFF, 0, 0x00FFFFFF, 0, 0x00FFFFFF, 0, 0x00FFFFFF, 0);
+	auto odd	= _mm256_setr_epi32(0, 0x00FFFFFF, 0, 0x00FFFFFF, 0, 0x00FFFFFF, 0, 0x00FFFFFF);
+	auto low48	= _mm256_setr_epi32(-1, 0xFFFF, 0, 0, -1, 0xFFFF, 0, 0);
+	auto high48	= _mm256_setr_epi32(0, 0, -1, 0xFFFF, 0, 0, -1, 0xFFFF);
+
+	size_t n = 0;
+	for(; n + 10 <= count; n += 8)
+	{
+		auto x = _mm256_srli_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + n)), 8);
+		x = _mm256_or_si256(_mm256_and_si256(x, even), _mm256_srli_epi64(_mm256_and_si256(x, odd), 8));
+		x = _mm256_or_si256(_mm256_and_si256(x, low48), _mm256_srli_si256(_mm256_and_si256(x, high48), 2));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + n*3 + 0),  _mm256_castsi256_si128(x));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + n*3 + 12), _mm256_extracti128_si256(x, 1));
+	}
+	_mm256_zeroupper();
+	s32_to_s24_sse2(dest + n*3, source + n, count - n);
+}
+
+CASPAR_AUDIO_AVX2_TARGET
+void s24_to_s32_avx2(int32_t* dest, const uint8_t* source, size_t count)
+{
+	auto even	= _mm256_setr_epi32(0x00FFFFFF, 0, 0x00FFFFFF, 0, 0x00FFFFFF, 0, 0x00FFFFFF, 0);
+	auto odd	= _mm256_setr_epi32(0xFF000000, 0xFFFF, 0xFF000000, 0xFFFF, 0xFF000000, 0xFFFF, 0xFF000000, 0xFFFF);
+	auto low48	= _mm256_setr_epi32(-1, 0xFFFF, 0, 0, -1, 0xFFFF, 0, 0);
+	auto high48	= _mm256_setr_epi32(0, 0, -1, 0xFFFF, 0, 0, -1, 0xFFFF);
+
+	size_t n = 0;
+	for(; n + 10 <= count; n += 8)
+	{
+		auto lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + n*3 + 0));
+		auto hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + n*3 + 12));
+		auto x	= _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+		x = _mm256_or_si256(_mm256_and_si256(x, low48), _mm256_and_si256(_mm256_slli_si256(x, 2), high48));
+		x = _mm256_or_si256(_mm256_and_si256(x, even), _mm256_slli_epi64(_mm256_and_si256(x, odd), 8));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + n), _mm256_slli_epi32(x, 8));
+	}
+	_mm256_zeroupper();
+	s24_to_s32_sse2(dest + n, source + n*3, count - n);
+}
+
+CASPAR_AUDIO_AVX2_TARGET
+void s32_to_s24_in_32_avx2(int32_t* dest, const int32_t* source, size_t count)
+{
+	size_t n = 0;
+	for(; n + 8 <= count; n += 8)
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + n), _mm256_srai_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + n)), 8));
+	_mm256_zeroupper();
+	s32_to_s24_in_32_scalar(dest + n, source + n, count - n);
+}
+
+CASPAR_AUDIO_AVX2_TARGET
+void s24_in_32_to_s32_avx2(int32_t* dest, const int32_t* source, size_t count)
+{
+	size_t n = 0;
+	for(; n + 8 <= count; n += 8)
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + n), _mm256_slli_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + n)), 8));
+	_mm256_zeroupper();
+	s24_in_32_to_s32_scalar(dest + n, source + n, count - n);
+}
+
+CASPAR_AUDIO_AVX2_TARGET
+void s32_to_f32_avx2(float* dest, const int32_t* source, size_t count)
+{
+	auto scale = _mm256_set1_ps(1.0f / FLOAT_SCALE);
+
+	size_t n = 0;
+	for(; n + 8 <= count; n += 8)
+		_mm256_storeu_ps(dest + n, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + n))), scale));
+	_mm256_zeroupper();
+	s32_to_f32_scalar(dest + n, source + n, count - n);
+}
+
+CASPAR_AUDIO_AVX2_TARGET
+void f32_to_s32_avx2(int32_t* dest, const float* source, size_t count)
+{
+	auto scale	= _mm256_set1_ps(FLOAT_SCALE);
+	auto max	= _mm256_set1_ps(FLOAT_MAX);
+	auto min	= _mm256_set1_ps(FLOAT_MIN);
+
+	size_t n = 0;
+	for(; n + 8 <= count; n += 8)
+	{
+		auto x = _mm256_mul_ps(_mm256_loadu_ps(source + n), scale);
+		x = _mm256_max_ps(_mm256_min_ps(x, max), min);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + n), _mm256_cvtps_epi32(x));
+	}
+	_mm256_zeroupper();
+	f32_to_s32_scalar(dest + n, source + n, count - n);
+}
+
+bool has_avx2()
+{
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if(info[0] < 7)
+		return false;
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	__cpuidex(info, 7, 0);
+	bool avx2	 = (info[1] & (1 << 5)) != 0;
+	return osxsave && avx2 && (_xgetbv(0) & 6) == 6; // xmm and ymm state enabled by the os.
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+#endif
+
+audio_simd_level::type get_supported_level()
+{
+#ifdef CASPAR_AUDIO_AVX2
+	if(has_avx2())
+		return audio_simd_level::avx2;
+#endif
+	return audio_simd_level::sse2;
+}
+
+audio_kernels select_kernels(audio_simd_level::type level)
+{
+	audio_kernels kernels;
+
+	kernels.s32_to_s16			= &s32_to_s16_scalar;
+	kernels.s32_to_s16_dither	= &s32_to_s16_dither_scalar;
+	kernels.s16_to_s32			= &s16_to_s32_scalar;
+	kernels.s32_to_s24			= &s32_to_s24_scalar;
+	kernels.s24_to_s32			= &s24_to_s32_scalar;
+	kernels.s32_to_s24_in_32	= &s32_to_s24_in_32_scalar;
+	kernels.s24_in_32_to_s32	= &s24_in_32_to_s32_scalar;
+	kernels.s32_to_f32			= &s32_to_f32_scalar;
+	kernels.f32_to_s32			= &f32_to_s32_scalar;
+
+	if(level >= audio_simd_level::sse2)
+	{
+		kernels.s32_to_s16			= &s32_to_s16_sse2;
+		kernels.s32_to_s16_dither	= &s32_to_s16_dither_sse2;
+		kernels.s16_to_s32			= &s16_to_s32_sse2;
+		kernels.s32_to_s24			= &s32_to_s24_sse2;
+		kernels.s24_to_s32			= &s24_to_s32_sse2;
+		kernels.s32_to_s24_in_32	= &s32_to_s24_in_32_sse2;
+		kernels.s24_in_32_to_s32	= &s24_in_32_to_s32_sse2;
+		kernels.s32_to_f32			= &s32_to_f32_sse2;
+		kernels.f32_to_s32			= &f32_to_s32_sse2;
+	}
+
+#ifdef CASPAR_AUDIO_AVX2
+	if(level >= audio_simd_level::avx2)
+	{
+		kernels.s32_to_s16			= &s32_to_s16_avx2;
+		kernels.s32_to_s16_dither	= &s32_to_s16_dither_avx2;
+		kernels.s16_to_s32			= &s16_to_s32_avx2;
+		kernels.s32_to_s24			= &s32_to_s24_avx2;
+		kernels.s24_to_s32			= &s24_to_s32_avx2;
+		kernels.s32_to_s24_in_32	= &s32_to_s24_in_32_avx2;
+		kernels.s24_in_32_to_s32	= &s24_in_32_to_s32_avx2;
+		kernels.s32_to_f32			= &s32_to_f32_avx2;
+		kernels.f32_to_s32			= &f32_to_s32_avx2;
+	}
+#endif
+
+	return kernels;
+}
+
+const audio_simd_level::type g_supported_level	= get_supported_level();
+audio_simd_level::type g_level					= g_supported_level;
+audio_kernels g_kernels							= select_kernels(g_level);
+
+}
+
+audio_simd_level::type get_audio_simd_level()
+{
+	return g_level;
+}
+
+void set_audio_simd_level(audio_simd_level::type level)
+{
+	g_level		= std::min(level, g_supported_level);
+	g_kernels	= select_kernels(g_level);
+}
+
+void audio_32_to_16(int16_t* dest, const int32_t* source, size_t count, audio_dither* dither)
+{
+	if(!dither)
+		return g_kernels.s32_to_s16(dest, source, count);
+
+	g_kernels.s32_to_s16_dither(dest, source, count, dither->position);
+	dither->position += static_cast<uint32_t>(count);
+}
+
+void audio_16_to_32(int32_t* dest, const int16_t* source, size_t count)
+{
+	g_kernels.s16_to_s32(dest, source, count);
+}
+
+void audio_32_to_24(uint8_t* dest, const int32_t* source, size_t count)
+{
+	g_kernels.s32_to_s24(dest, source, count);
+}
+
+void audio_24_to_32(int32_t* dest, const uint8_t* source, size_t count)
+{
+	g_kernels.s24_to_s32(dest, source, count);
+}
+
+void audio_32_to_24_in_32(int32_t* dest, const int32_t* source, size_t count)
+{
+	g_kernels.s32_to_s24_in_32(dest, source, count);
+}
+
+void audio_24_in_32_to_32(int32_t* dest, const int32_t* source, size_t count)
+{
+	g_kernels.s24_in_32_to_s32(dest, source, count);
+}
+
+void audio_32_to_float(float* dest, const int32_t* source, size_t count)
+{
+	g_kernels.s32_to_f32(dest, source, count);
+}
+
+void audio_float_to_32(int32_t* dest, const float* source, size_t count)
+{
+	g_kernels.f32_to_s32(dest, source, count);
+}
+
+// Stereo, by far the most common layout, is shuffled with sse2. Other layouts are strided copies 
+// which the compiler handles well enough.
+
+void audio_interleave(int32_t* dest, const int32_t* const* planes, size_t num_channels, size_t num_frames)
+{
+	size_t n = 0;
+
+	if(num_channels == 2 && g_level >= audio_simd_level::sse2)
+	{
+		for(; n + 4 <= num_frames; n += 4)
+		{
+			auto left	= _mm_loadu_si128(reinterpret_cast<const __m128i*>(planes[0] + n));
+			auto right	= _mm_loadu_si128(reinterpret_cast<const __m128i*>(planes[1] + n));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + n*2) + 0, _mm_unpacklo_epi32(left, right));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + n*2) + 1, _mm_unpackhi_epi32(left, right));
+		}
+	}
+
+	for(size_t c = 0; c < num_channels; ++c)
+	{
+		auto plane = planes[c];
+		for(size_t f = n; f < num_frames; ++f)
+			dest[f*num_channels + c] = plane[f];
+	}
+}
+
+void audio_deinterleave(int32_t* const* planes, const int32_t* source, size_t num_channels, size_t num_frames)
+{
+	size_t n = 0;
+
+	if(num_channels == 2 && g_level >= audio_simd_level::sse2)
+	{
+		for(; n + 4 <= num_frames; n += 4)
+		{
+			auto a = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(source + n*2) + 0), _MM_SHUFFLE(3, 1, 2, 0));
+			auto b = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(source + n*2) + 1), _MM_SHUFFLE(3, 1, 2, 0));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(planes[0] + n), _mm_unpacklo_epi64(a, b));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(planes[1] + n), _mm_unpackhi_epi64(a, b));
+		}
+	}
+
+	for(size_t c = 0; c < num_channels; ++c)
+	{
+		auto plane = planes[c];
+		for(size_t f = n; f < num_frames; ++f)
+			plane[f] = source[f*num_channels + c];
+	}
+}
+
+}}
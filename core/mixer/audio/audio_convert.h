@@ -0,0 +1,79 @@
+/*
+* Copyright 2013 Sveriges Television AB http://casparcg.com/
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+#pragma once
+
+#include <cstddef>
+
+#include <stdint.h>
+
+namespace caspar { namespace core {
+
+// Sample format conversions for the audio consumers. Mixer samples are signed 32 bit with the
+// significant bits at the top. Every function has a scalar, an sse2 and an avx2 kernel which
+// produce bit identical output, the widest one supported by the cpu is selected at startup.
+
+struct audio_simd_level
+{
+	enum type
+	{
+		scalar,
+		sse2,
+		avx2
+	};
+};
+
+audio_simd_level::type get_audio_simd_level();
+
+// Limited to what the cpu supports. Only meant for verification and benchmarks, call before any 
+// conversion runs.
+void set_audio_simd_level(audio_simd_level::type level);
+
+// Triangular (tpdf) dither of +-1 lsb applied when reducing to 16 bit. The noise only depends on 
+// position, which advances by the number of samples converted.
+struct audio_dither
+{
+	uint32_t position;
+
+	audio_dither() : position(0) {}
+};
+
+// Truncates unless dither is given, in which case the result is dithered, rounded and clamped.
+void audio_32_to_16(int16_t* dest, const int32_t* source, size_t count, audio_dither* dither = nullptr);
+void audio_16_to_32(int32_t* dest, const int16_t* source, size_t count);
+
+// 24 bit little endian packed into 3 bytes per sample.
+void audio_32_to_24(uint8_t* dest, const int32_t* source, size_t count);
+void audio_24_to_32(int32_t* dest, const uint8_t* source, size_t count);
+
+// 24 bit sign extended into the low bits of 32.
+void audio_32_to_24_in_32(int32_t* dest, const int32_t* source, size_t count);
+void audio_24_in_32_to_32(int32_t* dest, const int32_t* source, size_t count);
+
+// [-1.0, 1.0), values outside are clamped and rounded to nearest even.
+void audio_32_to_float(float* dest, const int32_t* source, size_t count);
+void audio_float_to_32(int32_t* dest, const float* source, size_t count);
+
+// Between interleaved samples and one plane per channel. Works on any 32 bit sample format.
+void audio_interleave(int32_t* dest, const int32_t* const* planes, size_t num_channels, size_t num_frames);
+void audio_deinterleave(int32_t* const* planes, const int32_t* source, size_t num_channels, size_t num_frames);
+
+}}
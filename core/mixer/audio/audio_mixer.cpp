@@ -30,9 +30,13 @@
 
 #include <tbb/cache_aligned_allocator.h>
 
+#include <emmintrin.h>
+
 #include <boost/range/adaptors.hpp>
 #include <boost/range/distance.hpp>
 
+#include <algorithm>
+#include <cmath>
 #include <map>
 #include <stack>
 #include <vector>
@@ -58,11 +62,183 @@ struct audio_item
 };
 
 typedef std::vector<float, tbb::cache_aligned_allocator<float>> audio_buffer_ps;
+
+// Multiplies samples with a gain that steps by gain_step every frame (num_channels samples). 
+// Samples are processed in blocks of lcm(4, num_channels) so that each sse lane keeps a fixed frame offset.
+class gain_ramp
+{
+	size_t			num_channels_;
+	audio_buffer_ps	frame_offsets_;
+public:
+	explicit gain_ramp(size_t num_channels = 2)
+		: num_channels_(num_channels)
+	{
+		auto block_size = num_channels % 4 == 0 ? num_channels : (num_channels % 2 == 0 ? num_channels * 2 : num_channels * 4);
+		for(size_t n = 0; n < block_size; ++n)
+			frame_offsets_.push_back(static_cast<float>(n / num_channels));
+	}
+
+	void operator()(float* dest, const int32_t* src, size_t count, float gain, float gain_step) const
+	{
+		const size_t block_size		 = frame_offsets_.size();
+		const size_t block_frames	 = block_size / num_channels_;
+		const auto	 step			 = _mm_set1_ps(gain_step);
+
+		size_t n = 0;
+		for(size_t frame = 0; n + block_size <= count; n += block_size, frame += block_frames)
+		{
+			auto base = _mm_set1_ps(gain + static_cast<float>(frame) * gain_step);
+			for(size_t k = 0; k < block_size; k += 4)
+			{
+				auto g = _mm_add_ps(base, _mm_mul_ps(_mm_loadu_ps(&frame_offsets_[k]), step));
+				auto x = _mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + n + k)));
+				_mm_storeu_ps(dest + n + k, _mm_mul_ps(x, g));
+			}
+		}
+
+		for(; n < count; ++n)
+			dest[n] = static_cast<float>(src[n]) * (gain + static_cast<float>(n / num_channels_) * gain_step);
+	}
+
+	size_t num_channels() const
+	{
+		return num_channels_;
+	}
+};
+
+static void accumulate(float* dest, const float* src, size_t count)
+{
+	size_t n = 0;
+	for(; n + 8 <= count; n += 8)
+	{
+		_mm_storeu_ps(dest + n + 0, _mm_add_ps(_mm_loadu_ps(dest + n + 0), _mm_loadu_ps(src + n + 0)));
+		_mm_storeu_ps(dest + n + 4, _mm_add_ps(_mm_loadu_ps(dest + n + 4), _mm_loadu_ps(src + n + 4)));
+	}
+
+	for(; n < count; ++n)
+		dest[n] += src[n];
+}
+
+// Saturating float to int32 conversion (truncating, as static_cast), returns the peak absolute sample value.
+static float convert_to_int32(int32_t* dest, const float* src, size_t count)
+{
+	const float max_sample = 2147483520.0f; // Largest float below 2^31.
+	const float min_sample = -2147483648.0f;
+
+	const auto max_value = _mm_set1_ps(max_sample);
+	const auto min_value = _mm_set1_ps(min_sample);
+	const auto abs_mask	 = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+
+	auto peak = _mm_setzero_ps();
+
+	size_t n = 0;
+	for(; n + 4 <= count; n += 4)
+	{
+		auto x = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + n), min_value), max_value);
+		peak = _mm_max_ps(peak, _mm_and_ps(x, abs_mask));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + n), _mm_cvttps_epi32(x));
+	}
+
+	peak = _mm_max_ps(peak, _mm_shuffle_ps(peak, peak, _MM_SHUFFLE(1, 0, 3, 2)));
+	peak = _mm_max_ps(peak, _mm_shuffle_ps(peak, peak, _MM_SHUFFLE(2, 3, 0, 1)));
+
+	float result = _mm_cvtss_f32(peak);
+
+	for(; n < count; ++n)
+	{
+		auto x = std::min(std::max(src[n], min_sample), max_sample);
+		result = std::max(result, std::abs(x));
+		dest[n] = static_cast<int32_t>(x);
+	}
+
+	return result;
+}
+
+// Fifo of mixed samples per stream. Capacity is a multiple of the channel count and data is always
+// pushed and popped in whole frames, so a wrap around never splits a frame.
+class audio_ring
+{
+	audio_buffer_ps	buffer_;
+	size_t			read_;
+	size_t			size_;
+public:
+	audio_ring()
+		: read_(0)
+		, size_(0)
+	{
+	}
+
+	size_t size() const
+	{
+		return size_;
+	}
+
+	void push(const int32_t* src, size_t count, const gain_ramp& ramp, float gain, float gain_step)
+	{
+		reserve(size_ + count, ramp.num_channels());
+
+		auto capacity	= buffer_.size();
+		auto write		= (read_ + size_) % capacity;
+		auto first		= std::min(count, capacity - write);
+
+		ramp(buffer_.data() + write, src, first, gain, gain_step);
+		if(first < count)
+			ramp(buffer_.data(), src + first, count - first, gain + static_cast<float>(first / ramp.num_channels()) * gain_step, gain_step);
+
+		size_ += count;
+	}
+
+	// Adds up to count samples to dest, returns the number of samples consumed.
+	size_t pop_into(float* dest, size_t count)
+	{
+		count = std::min(count, size_);
+		if(count == 0)
+			return 0;
+
+		auto capacity	= buffer_.size();
+		auto first		= std::min(count, capacity - read_);
+
+		accumulate(dest, buffer_.data() + read_, first);
+		if(first < count)
+			accumulate(dest + first, buffer_.data(), count - first);
+
+		read_  = (read_ + count) % capacity;
+		size_ -= count;
+
+		return count;
+	}
+
+	void reserve(size_t count, size_t num_channels)
+	{
+		if(count <= buffer_.size())
+			return;
+
+		auto capacity = std::max(count, buffer_.size() * 2);
+		capacity += (num_channels - capacity % num_channels) % num_channels;
+
+		audio_buffer_ps buffer(capacity, 0.0f);
+		if(size_ > 0)
+		{
+			auto first = std::min(size_, buffer_.size() - read_);
+			std::copy(buffer_.begin() + read_, buffer_.begin() + read_ + first, buffer.begin());
+			std::copy(buffer_.begin(), buffer_.begin() + (size_ - first), buffer.begin() + first);
+		}
+
+		buffer_ = std::move(buffer);
+		read_	= 0;
+	}
+};
 	
 struct audio_stream
 {
 	frame_transform prev_transform;
-	audio_buffer_ps audio_data;
+	audio_ring		audio_data;
+	bool			is_active;
+
+	audio_stream()
+		: is_active(false)
+	{
+	}
 };
 
 struct audio_mixer::implementation
@@ -76,6 +252,9 @@ struct audio_mixer::implementation
 	channel_layout						channel_layout_;
 	float								master_volume_;
 	float								previous_master_volume_;
+	gain_ramp							ramp_;
+	audio_buffer_ps						mix_buffer_;
+	int64_t								heap_allocations_;
 	
 public:
 	implementation(const safe_ptr<diagnostics::graph>& graph)
@@ -84,8 +263,10 @@ public:
 		, channel_layout_(channel_layout::stereo())
 		, master_volume_(1.0f)
 		, previous_master_volume_(master_volume_)
+		, heap_allocations_(0)
 	{
 		graph_->set_color("volume", diagnostics::color(1.0f, 0.8f, 0.1f));
+		graph_->set_color("audio-heap-alloc", diagnostics::color(0.6f, 0.3f, 0.9f));
 		transform_stack_.push(core::frame_transform());
 	}
 	
@@ -162,22 +343,24 @@ public:
 			audio_cadence_ = format_desc.audio_cadence;
 			format_desc_ = format_desc;
 			channel_layout_ = layout;
+			ramp_ = gain_ramp(channel_layout_.num_channels);
 		}
 		
-		std::map<const void*, audio_stream>	next_audio_streams;
+		for(auto it = audio_streams_.begin(); it != audio_streams_.end(); ++it)
+			it->second.is_active = false;
 
 		BOOST_FOREACH(auto& item, items_)
 		{			
-			audio_buffer_ps next_audio;
-
 			auto next_transform = item.transform;
 			auto prev_transform = next_transform;
 
-			const auto it = audio_streams_.find(item.tag);
+			auto it = audio_streams_.find(item.tag);
 			if(it != audio_streams_.end())
 			{	
-				prev_transform	= it->second.prev_transform;
-				next_audio		= std::move(it->second.audio_data);
+				if(it->second.is_active) // The same stream has already been mixed for this frame.
+					continue;
+
+				prev_transform = it->second.prev_transform;
 			}
 
 			if(prev_transform.volume < 0.001 && next_transform.volume < 0.001)
@@ -188,64 +371,69 @@ public:
 									
 			auto alpha = (next_volume-prev_volume)/static_cast<float>(item.audio_data.size()/channel_layout_.num_channels);
 			
-			for(size_t n = 0; n < item.audio_data.size(); ++n)
-			{
-				auto sample_multiplier = (prev_volume + (n/channel_layout_.num_channels) * alpha);
-				next_audio.push_back(item.audio_data[n] * sample_multiplier);
-			}
-										
-			next_audio_streams[item.tag].prev_transform  = std::move(next_transform); // Store all active tags, inactive tags will be removed at the end.
-			next_audio_streams[item.tag].audio_data		 = std::move(next_audio);			
+			auto& stream = it != audio_streams_.end() ? it->second : new_stream(item.tag);
+
+			stream.audio_data.push(item.audio_data.data(), item.audio_data.size(), ramp_, prev_volume, alpha);
+			stream.prev_transform	= std::move(next_transform);
+			stream.is_active		= true; // Inactive streams will be removed below.
+		}
+
+		for(auto it = audio_streams_.begin(); it != audio_streams_.end();)
+		{
+			if(it->second.is_active)
+				++it;
+			else
+				it = audio_streams_.erase(it);
 		}
 
 		previous_master_volume_ = master_volume_;
 		items_.clear();
-
-		audio_streams_ = std::move(next_audio_streams);
 		
-		if(audio_streams_.empty())		
-			audio_streams_[nullptr].audio_data = audio_buffer_ps(audio_size(audio_cadence_.front()), 0.0f);
-				
+		const auto mix_size = audio_size(audio_cadence_.front());
+
 		{ // sanity check
 
 			auto nb_invalid_streams = boost::count_if(audio_streams_ | boost::adaptors::map_values, [&](const audio_stream& x)
 			{
-				return x.audio_data.size() < audio_size(audio_cadence_.front());
+				return x.audio_data.size() < mix_size;
 			});
 
 			if(nb_invalid_streams > 0)		
 				CASPAR_LOG(trace) << "[audio_mixer] Incorrect frame audio cadence detected.";			
 		}
 
-		std::vector<float> result_ps(audio_size(audio_cadence_.front()), 0.0f);
+		mix_buffer_.assign(mix_size, 0.0f);
 
 		BOOST_FOREACH(auto& stream, audio_streams_ | boost::adaptors::map_values)
 		{
-			//CASPAR_LOG(debug) << stream.audio_data.size() << L" : " << result_ps.size();
-
-			if(stream.audio_data.size() < result_ps.size())
-			{
-				stream.audio_data.resize(result_ps.size(), 0.0f);
+			if(stream.audio_data.pop_into(mix_buffer_.data(), mix_size) < mix_size)
 				CASPAR_LOG(trace) << L"[audio_mixer] Appended zero samples";
-			}
-
-			auto out = boost::range::transform(result_ps, stream.audio_data, std::begin(result_ps), std::plus<float>());
-			stream.audio_data.erase(std::begin(stream.audio_data), std::begin(stream.audio_data) + std::distance(std::begin(result_ps), out));
 		}
 		
 		boost::range::rotate(audio_cadence_, std::begin(audio_cadence_)+1);
 		
-		audio_buffer result;
-		result.reserve(result_ps.size());
-		boost::range::transform(result_ps, std::back_inserter(result), [](float sample){return static_cast<int32_t>(sample);});		
+		audio_buffer result(mix_size);
+		auto peak = convert_to_int32(result.data(), mix_buffer_.data(), mix_size);
 
-		auto max = boost::range::max_element(result);
+		graph_->set_value("volume", static_cast<double>(peak)/std::numeric_limits<int32_t>::max());
 
-		graph_->set_value("volume", static_cast<double>(std::abs(*max))/std::numeric_limits<int32_t>::max());
+		// The audio buffer pool should not need to grow once playout has reached steady state. Only the 
+		// allocations of this channel's mixer thread are counted, other channels don't raise the tag.
+		auto heap_allocations = get_thread_audio_heap_allocations();
+		if(heap_allocations != heap_allocations_)
+			graph_->set_tag("audio-heap-alloc");
+		heap_allocations_ = heap_allocations;
 
 		return result;
 	}
 
+	audio_stream& new_stream(const void* tag)
+	{
+		auto& stream = audio_streams_[tag];
+		stream.audio_data.reserve(audio_size(*boost::range::max_element(audio_cadence_)) * 4, channel_layout_.num_channels);
+		return stream;
+	}
+
 	size_t audio_size(size_t num_samples) const
 	{
 		return num_samples * channel_layout_.num_channels;
@@ -21,16 +21,14 @@
 
 #pragma once
 
+#include "audio_buffer_pool.h"
+
 #include <common/memory/safe_ptr.h>
 
 #include <core/producer/frame/frame_visitor.h>
 
 #include <boost/noncopyable.hpp>
 
-#include <tbb/cache_aligned_allocator.h>
-
-#include <vector>
-
 namespace caspar {
 	
 namespace diagnostics {
@@ -43,8 +41,6 @@ namespace core {
 
 struct video_format_desc;
 struct channel_layout;
-	
-typedef std::vector<int32_t, tbb::cache_aligned_allocator<int32_t>> audio_buffer;
 
 class audio_mixer : public core::frame_visitor, boost::noncopyable
 {
@@ -26,11 +26,15 @@
 #include <boost/algorithm/string/split.hpp>
 #include <boost/algorithm/string.hpp>
 #include <boost/thread/mutex.hpp>
+#include <boost/thread/shared_mutex.hpp>
+#include <boost/functional/hash.hpp>
 #include <boost/foreach.hpp>
 #include <boost/assign.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/property_tree/exceptions.hpp>
 
+#include <emmintrin.h>
+
 namespace caspar { namespace core {
 
 channel_layout::channel_layout()
@@ -201,10 +205,304 @@ channel_layout_repository& default_channel_layout_repository()
 	return repository;
 }
 
+channel_mix_matrix::channel_mix_matrix(
+		int num_source_channels, int num_destination_channels)
+	: num_source_channels(num_source_channels)
+	, num_destination_channels(num_destination_channels)
+	, gains(num_source_channels * num_destination_channels, 0.0f)
+	, satisfactory(true)
+	, is_shuffle(false)
+{
+}
+
+void channel_mix_matrix::compile()
+{
+	int padded = (num_destination_channels + 3) & ~3;
+
+	active_sources.clear();
+	columns.clear();
+	stereo_columns.clear();
+	shuffle.assign(num_destination_channels, -1);
+	is_shuffle = true;
+
+	for (int d = 0; d < num_destination_channels; ++d)
+	{
+		for (int s = 0; s < num_source_channels; ++s)
+		{
+			auto gain = gains[d * num_source_channels + s];
+
+			if (gain == 0.0f)
+				continue;
+
+			if (gain != 1.0f || shuffle[d] != -1)
+				is_shuffle = false;
+
+			shuffle[d] = s;
+		}
+	}
+
+	for (int s = 0; s < num_source_channels; ++s)
+	{
+		bool active = false;
+
+		for (int d = 0; d < num_destination_channels; ++d)
+			active |= gains[d * num_source_channels + s] != 0.0f;
+
+		if (!active)
+			continue;
+
+		active_sources.push_back(s);
+
+		for (int d = 0; d < padded; ++d)
+			columns.push_back(d < num_destination_channels
+					? gains[d * num_source_channels + s] : 0.0f);
+
+		if (num_destination_channels == 2)
+			for (int n = 0; n < 4; ++n)
+				stereo_columns.push_back(gains[(n % 2) * num_source_channels + s]);
+	}
+}
+
+static __m128i to_int32(__m128 samples)
+{
+	samples = _mm_max_ps(samples, _mm_set1_ps(-2147483648.0f));
+	samples = _mm_min_ps(samples, _mm_set1_ps(2147483520.0f)); // Largest float below 2^31.
+
+	return _mm_cvttps_epi32(samples);
+}
+
+void channel_mix_matrix::apply(
+		const int32_t* source,
+		int source_stride,
+		int32_t* destination,
+		int destination_stride,
+		int num_samples) const
+{
+	const int rows		= std::min(num_destination_channels, destination_stride);
+	const int padded	= (num_destination_channels + 3) & ~3;
+
+	if (is_shuffle)
+	{ // Copied as integers, going through float would lose the low bits of int32 samples.
+		for (int sample = 0; sample < num_samples; ++sample)
+		{
+			auto in		= source + sample * source_stride;
+			auto out	= destination + sample * destination_stride;
+
+			for (int d = 0; d < rows; ++d)
+				out[d] = shuffle[d] != -1 && shuffle[d] < source_stride ? in[shuffle[d]] : 0;
+
+			for (int d = rows; d < destination_stride; ++d)
+				out[d] = 0;
+		}
+
+		return;
+	}
+
+	// Sources outside of the source stride are ignored.
+	int num_active = 0;
+	while (num_active < static_cast<int>(active_sources.size())
+			&& active_sources[num_active] < source_stride)
+		++num_active;
+
+	int sample = 0;
+
+	if (num_destination_channels == 2 && destination_stride == 2)
+	{ // Two stereo frames per vector, the common case.
+		for (; sample + 2 <= num_samples; sample += 2)
+		{
+			auto in0 = source + sample * source_stride;
+			auto in1 = in0 + source_stride;
+			auto acc = _mm_setzero_ps();
+
+			for (int n = 0; n < num_active; ++n)
+			{
+				auto s = active_sources[n];
+				auto x = _mm_set_ps(
+						static_cast<float>(in1[s]),
+						static_cast<float>(in1[s]),
+						static_cast<float>(in0[s]),
+						static_cast<float>(in0[s]));
+
+				acc = _mm_add_ps(
+						acc, _mm_mul_ps(x, _mm_loadu_ps(&stereo_columns[n * 4])));
+			}
+
+			_mm_storeu_si128(
+					reinterpret_cast<__m128i*>(destination + sample * 2),
+					to_int32(acc));
+		}
+	}
+
+	for (; sample < num_samples; ++sample)
+	{
+		auto in		= source + sample * source_stride;
+		auto out	= destination + sample * destination_stride;
+
+		for (int d = 0; d < padded; d += 4)
+		{
+			auto acc = _mm_setzero_ps();
+
+			for (int n = 0; n < num_active; ++n)
+				acc = _mm_add_ps(acc, _mm_mul_ps(
+						_mm_set1_ps(static_cast<float>(in[active_sources[n]])),
+						_mm_loadu_ps(&columns[n * padded + d])));
+
+			if (d + 4 <= rows)
+			{
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + d), to_int32(acc));
+			}
+			else
+			{
+				int32_t result[4];
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(result), to_int32(acc));
+
+				for (int n = d; n < rows; ++n)
+					out[n] = result[n - d];
+			}
+		}
+
+		for (int d = rows; d < destination_stride; ++d)
+			out[d] = 0;
+	}
+}
+
+static void add_rearrange(
+		channel_mix_matrix& matrix,
+		const channel_layout& source,
+		const channel_layout& destination)
+{
+	if (source.no_channel_names() || destination.no_channel_names())
+	{
+		int num_channels = std::min(
+				source.num_channels, destination.num_channels);
+
+		for (int i = 0; i < num_channels; ++i)
+			matrix.gains[i * matrix.num_source_channels + i] = 1.0f;
+	}
+	else
+	{
+		for (int s = 0; s < static_cast<int>(source.channel_names.size()); ++s)
+		{
+			auto& source_channel_name = source.channel_names[s];
+
+			if (source_channel_name.empty() 
+					|| source.channel_index(source_channel_name) != s)
+				continue;
+
+			int d = destination.channel_index(source_channel_name);
+
+			if (d != -1 && s < matrix.num_source_channels 
+					&& d < matrix.num_destination_channels)
+				matrix.gains[d * matrix.num_source_channels + s] = 1.0f;
+		}
+	}
+}
+
+static void add_mix(
+		channel_mix_matrix& matrix,
+		const channel_layout& source,
+		const channel_layout& destination,
+		const mix_config& config)
+{
+	std::vector<int> num_mixed_to_channel(matrix.num_destination_channels, 0);
+
+	BOOST_FOREACH(auto& elem, config.destination_ch_by_source_ch)
+	{
+		int s = source.channel_index(elem.first);
+		int d = destination.channel_index(elem.second.channel_name);
+
+		if (s == -1 || d == -1 || s >= matrix.num_source_channels 
+				|| d >= matrix.num_destination_channels)
+			continue;
+
+		matrix.gains[d * matrix.num_source_channels + s] +=
+				static_cast<float>(elem.second.influence);
+		++num_mixed_to_channel[d];
+	}
+
+	if (config.strategy != mix_config::average)
+		return;
+
+	for (int d = 0; d < matrix.num_destination_channels; ++d)
+	{
+		if (num_mixed_to_channel[d] < 2)
+			continue;
+
+		for (int s = 0; s < matrix.num_source_channels; ++s)
+			matrix.gains[d * matrix.num_source_channels + s] /=
+					static_cast<float>(num_mixed_to_channel[d]);
+	}
+}
+
+static size_t layout_hash(const channel_layout& layout)
+{
+	size_t seed = 0;
+
+	boost::hash_combine(seed, layout.layout_type);
+	BOOST_FOREACH(auto& channel_name, layout.channel_names)
+		boost::hash_combine(seed, channel_name);
+	boost::hash_combine(seed, layout.num_channels);
+
+	return seed;
+}
+
+struct compiled_mix_matrix
+{
+	channel_layout							source;
+	channel_layout							destination;
+	safe_ptr<const channel_mix_matrix>		matrix;
+
+	compiled_mix_matrix(
+			const channel_layout& source,
+			const channel_layout& destination,
+			const safe_ptr<const channel_mix_matrix>& matrix)
+		: source(source)
+		, destination(destination)
+		, matrix(matrix)
+	{
+	}
+
+	bool matches(
+			const channel_layout& other_source,
+			const channel_layout& other_destination) const
+	{
+		return source.layout_type == other_source.layout_type
+				&& source == other_source
+				&& destination.layout_type == other_destination.layout_type
+				&& destination == other_destination;
+	}
+};
+
 struct mix_config_repository::impl
 {
 	std::map<std::wstring, std::map<std::wstring, const mix_config>> configs;
 	boost::mutex mutex;
+
+	// Looked up for every frame, so the key is a hash and readers share the lock.
+	std::multimap<std::pair<size_t, size_t>, compiled_mix_matrix> matrices;
+	boost::shared_mutex matrices_mutex;
+	int64_t version; // Of the configs the matrices were built from.
+
+	impl()
+		: version(0)
+	{
+	}
+
+	std::shared_ptr<const channel_mix_matrix> find_matrix(
+			const std::pair<size_t, size_t>& key,
+			const channel_layout& source,
+			const channel_layout& destination) const
+	{
+		auto range = matrices.equal_range(key);
+
+		for (auto iter = range.first; iter != range.second; ++iter)
+		{
+			if (iter->second.matches(source, destination))
+				return iter->second.matrix;
+		}
+
+		return nullptr;
+	}
 };
 
 mix_config_repository::mix_config_repository()
@@ -223,6 +521,11 @@ void mix_config_repository::register_mix_config(const mix_config& config)
 	impl_->configs[config.from_layout_type].erase(config.to_layout_type);
 	impl_->configs[config.from_layout_type].insert(
 			std::make_pair(config.to_layout_type, config));
+
+	boost::unique_lock<boost::shared_mutex> matrices_lock(
+			impl_->matrices_mutex);
+	impl_->matrices.clear();
+	++impl_->version;
 }
 
 boost::optional<mix_config> mix_config_repository::get_mix_config(
@@ -239,6 +542,69 @@ boost::optional<mix_config> mix_config_repository::get_mix_config(
 	return iter->second;
 }
 
+safe_ptr<const channel_mix_matrix> mix_config_repository::get_mix_matrix(
+		const channel_layout& source,
+		const channel_layout& destination) const
+{
+	auto key = std::make_pair(layout_hash(source), layout_hash(destination));
+	int64_t version;
+
+	{
+		boost::shared_lock<boost::shared_mutex> lock(impl_->matrices_mutex);
+
+		auto cached = impl_->find_matrix(key, source, destination);
+
+		if (cached)
+			return make_safe_ptr(cached);
+
+		version = impl_->version;
+	}
+
+	auto matrix = make_safe<channel_mix_matrix>(
+			source.num_channels, destination.num_channels);
+
+	if (source.no_channel_names() 
+			|| destination.no_channel_names() 
+			|| source.layout_type == destination.layout_type)
+	{
+		add_rearrange(*matrix, source, destination);
+	}
+	else
+	{
+		auto config = get_mix_config(
+				source.layout_type, destination.layout_type);
+
+		if (config)
+		{
+			add_mix(*matrix, source, destination, *config);
+		}
+		else
+		{
+			add_rearrange(*matrix, source, destination);
+			matrix->satisfactory = false;
+		}
+	}
+
+	matrix->compile();
+
+	boost::unique_lock<boost::shared_mutex> lock(impl_->matrices_mutex);
+
+	// A config was registered while building, so the matrix may come from the replaced one. It is not 
+	// cached, and the next lookup builds it again.
+	if (impl_->version != version)
+		return matrix;
+
+	auto cached = impl_->find_matrix(key, source, destination);
+
+	if (cached)
+		return make_safe_ptr(cached);
+
+	impl_->matrices.insert(std::make_pair(
+			key, compiled_mix_matrix(source, destination, matrix)));
+
+	return matrix;
+}
+
 mix_config create_mix_config_from_string(
 		const std::wstring& from_layout_type,
 		const std::wstring& to_layout_type,
@@ -38,6 +38,9 @@
 
 #include <tbb/cache_aligned_allocator.h>
 
+#include "audio_buffer_pool.h"
+#include "audio_convert.h"
+
 #include <common/exception/exceptions.h>
 #include <common/utility/iterator.h>
 #include <common/utility/string.h>
@@ -46,33 +49,25 @@
 namespace caspar { namespace core {
 	
 template<typename T>
-static std::vector<int8_t, tbb::cache_aligned_allocator<int8_t>> audio_32_to_24(const T& audio_data)
+static audio_buffer_8 audio_32_to_24(const T& audio_data)
 {	
 	auto size		 = std::distance(std::begin(audio_data), std::end(audio_data));
-	auto input8		 = reinterpret_cast<const int8_t*>(&(*std::begin(audio_data)));
-	auto output8	 = std::vector<int8_t, tbb::cache_aligned_allocator<int8_t>>();
+	auto output8	 = audio_buffer_8(size*3);
 			
-	output8.reserve(size*3);
-	for(int n = 0; n < size; ++n)
-	{
-		output8.push_back(input8[n*4+1]);
-		output8.push_back(input8[n*4+2]);
-		output8.push_back(input8[n*4+3]);
-	}
+	if(size > 0)
+		audio_32_to_24(reinterpret_cast<uint8_t*>(output8.data()), &(*std::begin(audio_data)), size);
 
 	return output8;
 }
 
 template<typename T>
-static std::vector<int16_t, tbb::cache_aligned_allocator<int16_t>> audio_32_to_16(const T& audio_data)
+static audio_buffer_16 audio_32_to_16(const T& audio_data)
 {	
 	auto size		 = std::distance(std::begin(audio_data), std::end(audio_data));
-	auto input32	 = &(*std::begin(audio_data));
-	auto output16	 = std::vector<int16_t, tbb::cache_aligned_allocator<int16_t>>();
+	auto output16	 = audio_buffer_16(size);
 			
-	output16.reserve(size);
-	for(int n = 0; n < size; ++n)
-		output16.push_back((input32[n] >> 16) & 0xFFFF);
+	if(size > 0)
+		audio_32_to_16(output16.data(), &(*std::begin(audio_data)), size);
 
 	return output16;
 }
@@ -489,6 +484,42 @@ void parse_channel_layouts(
 		const boost::property_tree::wptree& layouts_element);
 channel_layout_repository& default_channel_layout_repository();
 
+/**
+ * The rearrange/mix_config rules from a source to a destination channel layout
+ * compiled into a dense gain matrix (destination x source), so that a frame can
+ * be converted without resolving channel names per sample.
+ */
+struct channel_mix_matrix
+{
+	int					num_source_channels;
+	int					num_destination_channels;
+	std::vector<float>	gains;			// gains[destination * num_source_channels + source]
+	bool				satisfactory;	// false if no mix config was found and channels might be lost.
+
+	// Precomputed from gains by compile().
+	std::vector<int>	active_sources;	// Source channels with at least one non zero gain.
+	std::vector<float>	columns;		// Gains of each active source, padded to a multiple of 4 destinations.
+	std::vector<float>	stereo_columns;	// Gains of each active source for two stereo frames (L R L R).
+	bool				is_shuffle;		// Every gain is 0 or 1 and each destination has at most one source.
+	std::vector<int>	shuffle;		// Source of each destination, -1 for silence. Only used if is_shuffle.
+
+	channel_mix_matrix(int num_source_channels, int num_destination_channels);
+
+	void compile();
+
+	/**
+	 * Mixes interleaved int32 samples. Strides may be larger than the layouts,
+	 * destination channels without any source are zeroed. Pure rearranges
+	 * are copied bit exact, real mixes go through float.
+	 */
+	void apply(
+			const int32_t* source,
+			int source_stride,
+			int32_t* destination,
+			int destination_stride,
+			int num_samples) const;
+};
+
 class mix_config_repository
 {
 public:
@@ -498,6 +529,14 @@ public:
 	boost::optional<mix_config> get_mix_config(
 			const std::wstring& from_layout_type,
 			const std::wstring& to_layout_type) const;
+
+	/**
+	 * Gets the compiled mix matrix for a pair of layouts, compiled on first use
+	 * and cached by layout identity until the next register_mix_config().
+	 */
+	safe_ptr<const channel_mix_matrix> get_mix_matrix(
+			const channel_layout& source,
+			const channel_layout& destination) const;
 private:
 	struct impl;
 	safe_ptr<impl> impl_;
@@ -524,33 +563,27 @@ bool rearrange_or_rearrange_and_mix(
 		multichannel_view<DstSampleT, DstIter>& destination,
 		const mix_config_repository& repository)
 {
-	if (source.channel_layout().no_channel_names() 
-			|| destination.channel_layout().no_channel_names() 
-			|| source.channel_layout().layout_type
-					== destination.channel_layout().layout_type)
-	{
-		rearrange(source, destination);
-
-		return true;
-	}
-	else
-	{
-		auto mix_config = repository.get_mix_config(
-				source.channel_layout().layout_type,
-				destination.channel_layout().layout_type);
-
-		if (!mix_config)
-		{
-			rearrange(source, destination);
-
-			return false; // Non-satisfactory mixing, some channels might be
-			              // lost
-		}
-
-		rearrange_and_mix(source, destination, *mix_config);
-
-		return true;
-	}
+	static_assert(
+			sizeof(SrcSampleT) == sizeof(int32_t)
+					&& sizeof(DstSampleT) == sizeof(int32_t),
+			"only int32 samples are supported");
+
+	auto matrix = repository.get_mix_matrix(
+			source.channel_layout(), destination.channel_layout());
+
+	auto num_samples = std::min(
+			source.num_samples(), destination.num_samples());
+
+	if (num_samples > 0)
+		matrix->apply(
+				reinterpret_cast<const int32_t*>(&*source.raw_begin()),
+				source.num_channels(),
+				reinterpret_cast<int32_t*>(&*destination.raw_begin()),
+				destination.num_channels(),
+				num_samples);
+
+	return matrix->satisfactory; // Non-satisfactory mixing, some channels
+	                             // might be lost
 }
 
 channel_layout create_custom_channel_layout(
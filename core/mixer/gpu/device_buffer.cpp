@@ -53,12 +53,14 @@ struct device_buffer::implementation : boost::noncopyable
 	const size_t stride_;
 
 	fence		 fence_;
+	int			 generation_;
 
 public:
 	implementation(size_t width, size_t height, size_t stride) 
 		: width_(width)
 		, height_(height)
 		, stride_(stride)
+		, generation_(0)
 	{	
 		GL(glGenTextures(1, &id_));
 		GL(glBindTexture(GL_TEXTURE_2D, id_));
@@ -106,6 +108,17 @@ public:
 		GL(glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width_, height_, FORMAT[stride_], GL_UNSIGNED_BYTE, NULL));
 		unbind();
 		fence_.set();
+		++generation_;
+	}
+
+	void begin_read(const void* data)
+	{
+		bind();
+		GL(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
+		GL(glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width_, height_, FORMAT[stride_], GL_UNSIGNED_BYTE, data));
+		unbind();
+		fence_.set();
+		++generation_;
 	}
 	
 	bool ready() const
@@ -121,8 +134,10 @@ size_t device_buffer::height() const { return impl_->height_; }
 void device_buffer::bind(int index){impl_->bind(index);}
 void device_buffer::unbind(){impl_->unbind();}
 void device_buffer::begin_read(){impl_->begin_read();}
+void device_buffer::begin_read(const void* data){impl_->begin_read(data);}
 bool device_buffer::ready() const{return impl_->ready();}
 int device_buffer::id() const{ return impl_->id_;}
+int device_buffer::generation() const{ return impl_->generation_;}
 
 
 }}
\ No newline at end of file
@@ -41,7 +41,10 @@ public:
 	void unbind();
 		
 	void begin_read();
+	void begin_read(const void* data); // Uploads directly from client memory, e.g. a buffer shared with another frame.
 	bool ready() const;
+
+	int generation() const; // Incremented by every upload, i.e. changes whenever the content does.
 private:
 	friend class ogl_device;
 	device_buffer(size_t width, size_t height, size_t stride);
@@ -29,15 +29,20 @@
 
 #include <common/exception/exceptions.h>
 #include <common/gl/gl_check.h>
+#include <common/utility/assert.h>
 
 #include <gl/glew.h>
 
 #include <tbb/atomic.h>
+#include <tbb/concurrent_unordered_map.h>
+#include <tbb/scalable_allocator.h>
 
 namespace caspar { namespace core {
 
 static tbb::atomic<int> g_w_total_count;
 static tbb::atomic<int> g_r_total_count;
+static tbb::atomic<int> g_s_total_count;
+static tbb::concurrent_unordered_map<size_t, safe_ptr<buffer_pool<host_buffer>>> g_system_pools;
 																																								
 struct host_buffer::implementation : boost::noncopyable
 {	
@@ -68,10 +73,29 @@ public:
 		CASPAR_LOG(trace) << "[host_buffer] [" << ++(usage_ == write_only ? g_w_total_count : g_r_total_count) << L"] allocated size:" << size_ << " usage: " << (usage == write_only ? "write_only" : "read_only");
 	}	
 
+	implementation(size_t size) 
+		: size_(size)
+		, data_(scalable_aligned_malloc(size, 64))
+		, pbo_(0)
+		, target_(0)
+		, usage_(0)
+	{
+		if(!data_)
+			BOOST_THROW_EXCEPTION(caspar_exception() << msg_info("Failed to allocate buffer."));
+
+		CASPAR_LOG(trace) << "[host_buffer] [" << ++g_s_total_count << L"] allocated size:" << size_ << " usage: system_memory";
+	}
+
 	~implementation()
 	{
 		try
 		{
+			if(!pbo_)
+			{
+				scalable_aligned_free(data_);
+				return;
+			}
+
 			GL(glDeleteBuffers(1, &pbo_));
 			//CASPAR_LOG(trace) << "[host_buffer] [" << --(usage_ == write_only ? g_w_total_count : g_r_total_count) << L"] deallocated size:" << size_ << " usage: " << (usage_ == write_only ? "write_only" : "read_only");
 		}
@@ -83,7 +107,7 @@ public:
 
 	void map()
 	{
-		if(data_)
+		if(data_ || !pbo_)
 			return;
 
 		if(usage_ == write_only)			
@@ -98,12 +122,13 @@ public:
 
 	void wait(ogl_device& ogl)
 	{
-		fence_.wait(ogl);
+		if(pbo_)
+			fence_.wait(ogl);
 	}
 
 	void unmap()
 	{
-		if(!data_)
+		if(!data_ || !pbo_)
 			return;
 		
 		GL(glBindBuffer(target_, pbo_));
@@ -114,16 +139,21 @@ public:
 
 	void bind()
 	{
-		GL(glBindBuffer(target_, pbo_));
+		if(pbo_)
+			GL(glBindBuffer(target_, pbo_));
 	}
 
 	void unbind()
 	{
-		GL(glBindBuffer(target_, 0));
+		if(pbo_)
+			GL(glBindBuffer(target_, 0));
 	}
 
 	void begin_read(size_t width, size_t height, GLuint format)
 	{
+		if(!pbo_)
+			BOOST_THROW_EXCEPTION(invalid_operation() << msg_info("Cannot read back into system memory buffer."));
+
 		unmap();
 		bind();
 		GL(glReadPixels(0, 0, width, height, format, GL_UNSIGNED_BYTE, NULL));
@@ -133,11 +163,12 @@ public:
 
 	bool ready() const
 	{
-		return fence_.ready();
+		return !pbo_ || fence_.ready();
 	}
 };
 
 host_buffer::host_buffer(size_t size, usage_t usage) : impl_(new implementation(size, usage)){}
+host_buffer::host_buffer(size_t size) : impl_(new implementation(size)){}
 const void* host_buffer::data() const {return impl_->data_;}
 void* host_buffer::data() {return impl_->data_;}
 void host_buffer::map(){impl_->map();}
@@ -148,5 +179,20 @@ void host_buffer::begin_read(size_t width, size_t height, GLuint format){impl_->
 size_t host_buffer::size() const { return impl_->size_; }
 bool host_buffer::ready() const{return impl_->ready();}
 void host_buffer::wait(ogl_device& ogl){impl_->wait(ogl);}
+bool host_buffer::is_system_memory() const{return impl_->pbo_ == 0;}
+
+safe_ptr<host_buffer> create_system_host_buffer(size_t size)
+{
+	CASPAR_VERIFY(size > 0);
+	auto pool = g_system_pools[size];
+	std::shared_ptr<host_buffer> buffer;
+	if(!pool->items.try_pop(buffer))
+		buffer.reset(new host_buffer(size));
+
+	return safe_ptr<host_buffer>(buffer.get(), [=](host_buffer*) mutable
+	{
+		pool->items.push(buffer);
+	});
+}
 
 }}
\ No newline at end of file
@@ -51,12 +51,20 @@ public:
 	void begin_read(size_t width, size_t height, unsigned int format);
 	bool ready() const;
 	void wait(ogl_device& ogl);
+
+	bool is_system_memory() const;
 private:
 	friend class ogl_device;
+	friend safe_ptr<host_buffer> create_system_host_buffer(size_t size);
 	host_buffer(size_t size, usage_t usage);
+	explicit host_buffer(size_t size);
 
 	struct implementation;
 	safe_ptr<implementation> impl_;
 };
 
+// Pooled buffer in plain (cache aligned) system memory which is always mapped. 
+// Used by the cpu image mixer, does not require an OpenGL context.
+safe_ptr<host_buffer> create_system_host_buffer(size_t size);
+
 }}
\ No newline at end of file
@@ -0,0 +1,738 @@
+/*
+* Copyright 2013 Sveriges Television AB http://casparcg.com/
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+#include "../../stdafx.h"
+
+#include "cpu_image_kernel.h"
+
+#include "../gpu/host_buffer.h"
+
+#include <common/exception/exceptions.h>
+#include <common/utility/assert.h>
+
+#include <core/producer/frame/pixel_format.h>
+#include <core/producer/frame/frame_transform.h>
+
+#include <tbb/parallel_for.h>
+
+#include <emmintrin.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <cstring>
+
+namespace caspar { namespace core {
+
+cpu_buffer::cpu_buffer(size_t width, size_t height, size_t stride)
+	: width_(width)
+	, height_(height)
+	, stride_(stride)
+	, buffer_(create_system_host_buffer(width*height*stride))
+{
+	CASPAR_VERIFY(stride == 1 || stride == 4);
+}
+
+size_t cpu_buffer::stride() const { return stride_; }
+size_t cpu_buffer::width() const { return width_; }
+size_t cpu_buffer::height() const { return height_; }
+uint8_t* cpu_buffer::data() { return static_cast<uint8_t*>(buffer_->data()); }
+const uint8_t* cpu_buffer::data() const { return static_cast<const uint8_t*>(buffer_->data()); }
+void cpu_buffer::clear() { std::memset(buffer_->data(), 0, buffer_->size()); }
+const safe_ptr<host_buffer>& cpu_buffer::host() const { return buffer_; }
+
+namespace {
+
+/*
+	Everything below mirrors image_shader.cpp and blending_glsl.h. Colors are kept in the same
+	(b, g, r, a) order as inside the shader, e.g. the "r" component of the blend functions is blue.
+*/
+
+static const double epsilon = 0.001;
+
+inline float clamp01(float value)
+{
+	return std::min(std::max(value, 0.0f), 1.0f);
+}
+
+inline float smoothstep(float edge0, float edge1, float x)
+{
+	if(edge1 <= edge0)
+		return x < edge0 ? 0.0f : 1.0f;
+
+	float t = clamp01((x - edge0) / (edge1 - edge0));
+	return t * t * (3.0f - 2.0f * t);
+}
+
+inline float mix(float x, float y, float a)
+{
+	return x + (y - x) * a;
+}
+
+// Blend modes
+
+inline float blend_linear_dodge(float base, float blend)	{ return std::min(base + blend, 1.0f); }
+inline float blend_linear_burn(float base, float blend)		{ return std::max(base + blend - 1.0f, 0.0f); }
+inline float blend_lighten(float base, float blend)			{ return std::max(blend, base); }
+inline float blend_darken(float base, float blend)			{ return std::min(blend, base); }
+inline float blend_screen(float base, float blend)			{ return 1.0f - ((1.0f - base) * (1.0f - blend)); }
+inline float blend_overlay(float base, float blend)			{ return base < 0.5f ? (2.0f * base * blend) : (1.0f - 2.0f * (1.0f - base) * (1.0f - blend)); }
+inline float blend_soft_light(float base, float blend)		{ return blend < 0.5f ? (2.0f * base * blend + base * base * (1.0f - 2.0f * blend)) : (std::sqrt(base) * (2.0f * blend - 1.0f) + 2.0f * base * (1.0f - blend)); }
+inline float blend_color_dodge(float base, float blend)		{ return blend == 1.0f ? blend : std::min(base / (1.0f - blend), 1.0f); }
+inline float blend_color_burn(float base, float blend)		{ return blend == 0.0f ? blend : std::max((1.0f - ((1.0f - base) / blend)), 0.0f); }
+inline float blend_linear_light(float base, float blend)	{ return blend < 0.5f ? blend_linear_burn(base, (2.0f * blend)) : blend_linear_dodge(base, (2.0f * (blend - 0.5f))); }
+inline float blend_vivid_light(float base, float blend)		{ return blend < 0.5f ? blend_color_burn(base, (2.0f * blend)) : blend_color_dodge(base, (2.0f * (blend - 0.5f))); }
+inline float blend_pin_light(float base, float blend)		{ return blend < 0.5f ? blend_darken(base, (2.0f * blend)) : blend_lighten(base, (2.0f *(blend - 0.5f))); }
+inline float blend_hard_mix(float base, float blend)		{ return blend_vivid_light(base, blend) < 0.5f ? 0.0f : 1.0f; }
+inline float blend_reflect(float base, float blend)			{ return blend == 1.0f ? blend : std::min(base * base / (1.0f - blend), 1.0f); }
+
+template<typename F>
+inline void blend_each(const float* base, const float* blend, float* out, const F& func)
+{
+	for(int n = 0; n < 3; ++n)
+		out[n] = func(base[n], blend[n]);
+}
+
+void rgb_to_hsl(const float* color, float* hsl)
+{
+	float fmin  = std::min(std::min(color[0], color[1]), color[2]);
+	float fmax  = std::max(std::max(color[0], color[1]), color[2]);
+	float delta = fmax - fmin;
+
+	hsl[2] = (fmax + fmin) / 2.0f;
+
+	if(delta == 0.0f)
+	{
+		hsl[0] = 0.0f;
+		hsl[1] = 0.0f;
+		return;
+	}
+
+	hsl[1] = hsl[2] < 0.5f ? delta / (fmax + fmin) : delta / (2.0f - fmax - fmin);
+
+	float delta_r = (((fmax - color[0]) / 6.0f) + (delta / 2.0f)) / delta;
+	float delta_g = (((fmax - color[1]) / 6.0f) + (delta / 2.0f)) / delta;
+	float delta_b = (((fmax - color[2]) / 6.0f) + (delta / 2.0f)) / delta;
+
+	if(color[0] == fmax)
+		hsl[0] = delta_b - delta_g;
+	else if(color[1] == fmax)
+		hsl[0] = (1.0f / 3.0f) + delta_r - delta_b;
+	else
+		hsl[0] = (2.0f / 3.0f) + delta_g - delta_r;
+
+	if(hsl[0] < 0.0f)
+		hsl[0] += 1.0f;
+	else if(hsl[0] > 1.0f)
+		hsl[0] -= 1.0f;
+}
+
+float hue_to_rgb(float f1, float f2, float hue)
+{
+	if(hue < 0.0f)
+		hue += 1.0f;
+	else if(hue > 1.0f)
+		hue -= 1.0f;
+
+	if((6.0f * hue) < 1.0f)
+		return f1 + (f2 - f1) * 6.0f * hue;
+	else if((2.0f * hue) < 1.0f)
+		return f2;
+	else if((3.0f * hue) < 2.0f)
+		return f1 + (f2 - f1) * ((2.0f / 3.0f) - hue) * 6.0f;
+
+	return f1;
+}
+
+void hsl_to_rgb(const float* hsl, float* rgb)
+{
+	if(hsl[1] == 0.0f)
+	{
+		rgb[0] = rgb[1] = rgb[2] = hsl[2];
+		return;
+	}
+
+	float f2 = hsl[2] < 0.5f ? hsl[2] * (1.0f + hsl[1]) : (hsl[2] + hsl[1]) - (hsl[1] * hsl[2]);
+	float f1 = 2.0f * hsl[2] - f2;
+
+	rgb[0] = hue_to_rgb(f1, f2, hsl[0] + (1.0f/3.0f));
+	rgb[1] = hue_to_rgb(f1, f2, hsl[0]);
+	rgb[2] = hue_to_rgb(f1, f2, hsl[0] - (1.0f/3.0f));
+}
+
+void blend_hsl(const float* base, const float* blend, float* out, bool hue_from_blend, bool sat_from_blend, bool lum_from_blend)
+{
+	float base_hsl[3];
+	float blend_hsl[3];
+	rgb_to_hsl(base, base_hsl);
+	rgb_to_hsl(blend, blend_hsl);
+
+	float hsl[3] =
+	{
+		hue_from_blend ? blend_hsl[0] : base_hsl[0],
+		sat_from_blend ? blend_hsl[1] : base_hsl[1],
+		lum_from_blend ? blend_hsl[2] : base_hsl[2]
+	};
+
+	hsl_to_rgb(hsl, out);
+}
+
+void blend_color(blend_mode::type mode, const float* back, const float* fore, float* out)
+{
+	switch(mode)
+	{
+	case blend_mode::lighten:		blend_each(back, fore, out, blend_lighten);													break;
+	case blend_mode::darken:		blend_each(back, fore, out, blend_darken);													break;
+	case blend_mode::multiply:		blend_each(back, fore, out, [](float b, float f){return b * f;});							break;
+	case blend_mode::average:		blend_each(back, fore, out, [](float b, float f){return (b + f) / 2.0f;});					break;
+	case blend_mode::add:			blend_each(back, fore, out, blend_linear_dodge);											break;
+	case blend_mode::subtract:		blend_each(back, fore, out, blend_linear_burn);												break;
+	case blend_mode::difference:	blend_each(back, fore, out, [](float b, float f){return std::abs(b - f);});					break;
+	case blend_mode::negation:		blend_each(back, fore, out, [](float b, float f){return 1.0f - std::abs(1.0f - b - f);});	break;
+	case blend_mode::exclusion:		blend_each(back, fore, out, [](float b, float f){return b + f - 2.0f * b * f;});			break;
+	case blend_mode::screen:		blend_each(back, fore, out, blend_screen);													break;
+	case blend_mode::overlay:		blend_each(back, fore, out, blend_overlay);													break;
+	case blend_mode::soft_light:	blend_each(back, fore, out, blend_soft_light);												break;
+	case blend_mode::hard_light:	blend_each(fore, back, out, blend_overlay);													break;
+	case blend_mode::color_dodge:	blend_each(back, fore, out, blend_color_dodge);												break;
+	case blend_mode::color_burn:	blend_each(back, fore, out, blend_color_burn);												break;
+	case blend_mode::linear_dodge:	blend_each(back, fore, out, blend_linear_dodge);											break;
+	case blend_mode::linear_burn:	blend_each(back, fore, out, blend_linear_burn);												break;
+	case blend_mode::linear_light:	blend_each(back, fore, out, blend_linear_light);											break;
+	case blend_mode::vivid_light:	blend_each(back, fore, out, blend_vivid_light);												break;
+	case blend_mode::pin_light:		blend_each(back, fore, out, blend_pin_light);												break;
+	case blend_mode::hard_mix:		blend_each(back, fore, out, blend_hard_mix);												break;
+	case blend_mode::reflect:		blend_each(back, fore, out, blend_reflect);													break;
+	case blend_mode::glow:			blend_each(fore, back, out, blend_reflect);													break;
+	case blend_mode::phoenix:		blend_each(back, fore, out, [](float b, float f){return std::min(b, f) - std::max(b, f) + 1.0f;}); break;
+	case blend_mode::contrast:		blend_hsl(back, fore, out, true,  false, false);											break; // Hue, same as the shader.
+	case blend_mode::saturation:	blend_hsl(back, fore, out, false, true,  false);											break;
+	case blend_mode::color:			blend_hsl(back, fore, out, true,  true,  false);											break;
+	case blend_mode::luminosity:	blend_hsl(back, fore, out, false, false, true);												break;
+	default:						std::copy(fore, fore + 3, out);																break;
+	}
+}
+
+// Image adjustments
+
+void chroma_key(int chroma_mode, const chroma& key, float* color)
+{
+	// The shader keys on rgba order.
+	float r = color[2];
+	float g = color[1];
+	float b = color[0];
+
+	float d = (chroma_mode == 1 ? (2.0f * g - r - b) : (2.0f * b - r - g)) / 2.0f;
+	float alpha = 1.0f - smoothstep(key.threshold, key.softness, d);
+
+	for(int n = 0; n < 4; ++n)
+		color[n] *= alpha;
+
+	float ds = smoothstep(key.spill, 1.0f, key.softness > 0.0f ? d / key.softness : (d > 0.0f ? 1.0f : 0.0f));
+	float gl = 0.3f * color[2] + 0.59f * color[1] + 0.11f * color[0];
+
+	for(int n = 0; n < 3; ++n)
+		color[n] = mix(color[n], gl * gl, ds);
+
+	color[3] = mix(color[3], gl, ds);
+}
+
+void apply_levels(const levels& lvl, float* color)
+{
+	float range = static_cast<float>(lvl.max_input - lvl.min_input);
+	float gamma = static_cast<float>(1.0 / lvl.gamma);
+
+	for(int n = 0; n < 3; ++n)
+	{
+		float value = std::min(std::max(color[n] - static_cast<float>(lvl.min_input), 0.0f) / range, 1.0f);
+		value = std::pow(value, gamma);
+		color[n] = mix(static_cast<float>(lvl.min_output), static_cast<float>(lvl.max_output), value);
+	}
+}
+
+void apply_csb(float brt, float sat, float con, float* color)
+{
+	bool demultiply_remultiply = con < 1.0f && color[3] != 1.0f;
+
+	float rgb[3] = {color[0], color[1], color[2]};
+
+	if(demultiply_remultiply && color[3] > 0.0f)
+	{
+		for(int n = 0; n < 3; ++n)
+			rgb[n] /= color[3];
+	}
+
+	for(int n = 0; n < 3; ++n)
+		rgb[n] *= brt;
+
+	float intensity = rgb[0] * 0.2125f + rgb[1] * 0.7154f + rgb[2] * 0.0721f;
+
+	for(int n = 0; n < 3; ++n)
+	{
+		float value = mix(mix(intensity, rgb[n], sat) , 0.5f, 1.0f - con);
+		color[n] = demultiply_remultiply ? value * color[3] : value;
+	}
+}
+
+// Sampling
+
+inline __m128 load_pixel(const uint8_t* ptr)
+{
+	const __m128i zero = _mm_setzero_si128();
+
+	__m128i value = _mm_cvtsi32_si128(*reinterpret_cast<const int*>(ptr));
+	value = _mm_unpacklo_epi8(value, zero);
+	value = _mm_unpacklo_epi16(value, zero);
+
+	return _mm_mul_ps(_mm_cvtepi32_ps(value), _mm_set1_ps(1.0f/255.0f));
+}
+
+inline void store_pixel(uint8_t* ptr, __m128 color)
+{
+	color = _mm_min_ps(_mm_max_ps(color, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+
+	__m128i value = _mm_cvtps_epi32(_mm_mul_ps(color, _mm_set1_ps(255.0f)));
+	value = _mm_packs_epi32(value, value);
+	value = _mm_packus_epi16(value, value);
+
+	*reinterpret_cast<int*>(ptr) = _mm_cvtsi128_si32(value);
+}
+
+inline __m128 lerp(__m128 a, __m128 b, __m128 t)
+{
+	return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t));
+}
+
+struct axis_sample
+{
+	int		i0;
+	int		i1;
+	float	f;
+};
+
+inline axis_sample make_axis_sample(double coord, int size)
+{
+	double texel = coord * size - 0.5;
+	double i0	 = std::floor(texel);
+	float  f	 = static_cast<float>(texel - i0);
+
+	axis_sample sample;
+	sample.i0 = static_cast<int>(i0);
+
+	if(f < 0.0001f) // Integer aligned, no filtering needed.
+		f = 0.0f;
+	else if(f > 0.9999f)
+	{
+		f = 0.0f;
+		++sample.i0;
+	}
+
+	sample.i1 = std::min(std::max(sample.i0 + 1, 0), size - 1);
+	sample.i0 = std::min(std::max(sample.i0, 0), size - 1);
+	sample.f  = f;
+
+	return sample;
+}
+
+// Bilinear sampling of one plane, equivalent to a GL_LINEAR / GL_CLAMP_TO_EDGE texture.
+struct plane_sampler
+{
+	const uint8_t*				data;
+	int							width;
+	int							height;
+	int							channels;
+	int							linesize;
+	std::vector<axis_sample>	columns;
+	bool						filter_columns;
+
+	plane_sampler(const uint8_t* data, const pixel_format_desc::plane& plane)
+		: data(data)
+		, width(static_cast<int>(plane.width))
+		, height(static_cast<int>(plane.height))
+		, channels(static_cast<int>(plane.channels))
+		, linesize(static_cast<int>(plane.linesize))
+		, filter_columns(false)
+	{
+	}
+
+	void set_columns(int x_begin, int x_end, int target_width, double translation, double scale)
+	{
+		columns.reserve(x_end - x_begin);
+		for(int x = x_begin; x < x_end; ++x)
+		{
+			auto sample = make_axis_sample(((x + 0.5) / target_width - translation) / scale, width);
+			filter_columns |= sample.f != 0.0f;
+			columns.push_back(sample);
+		}
+	}
+
+	float sample1(int column, const axis_sample& row) const
+	{
+		const auto& col = columns[column];
+		const uint8_t* line0 = data + row.i0 * linesize;
+
+		float value = line0[col.i0];
+		if(filter_columns)
+			value = mix(value, line0[col.i1], col.f);
+
+		if(row.f != 0.0f)
+		{
+			const uint8_t* line1 = data + row.i1 * linesize;
+
+			float value1 = line1[col.i0];
+			if(filter_columns)
+				value1 = mix(value1, line1[col.i1], col.f);
+
+			value = mix(value, value1, row.f);
+		}
+
+		return value * (1.0f/255.0f);
+	}
+
+	__m128 sample4(int column, const axis_sample& row) const
+	{
+		const auto& col = columns[column];
+		const uint8_t* line0 = data + row.i0 * linesize;
+
+		__m128 value = load_pixel(line0 + col.i0 * 4);
+		if(filter_columns)
+			value = lerp(value, load_pixel(line0 + col.i1 * 4), _mm_set1_ps(col.f));
+
+		if(row.f != 0.0f)
+		{
+			const uint8_t* line1 = data + row.i1 * linesize;
+
+			__m128 value1 = load_pixel(line1 + col.i0 * 4);
+			if(filter_columns)
+				value1 = lerp(value1, load_pixel(line1 + col.i1 * 4), _mm_set1_ps(col.f));
+
+			value = lerp(value, value1, _mm_set1_ps(row.f));
+		}
+
+		return value;
+	}
+};
+
+inline __m128 ycbcra_to_bgra(float y, float cb, float cr, float a, bool is_hd)
+{
+	y  = y  * 255.0f - 16.0f;
+	cb = cb * 255.0f - 128.0f;
+	cr = cr * 255.0f - 128.0f;
+
+	if(is_hd)
+		return _mm_set_ps(a, (1.164f*y + 1.793f*cr)/255.0f, (1.164f*y - 0.534f*cr - 0.213f*cb)/255.0f, (1.164f*y + 2.115f*cb)/255.0f);
+	else
+		return _mm_set_ps(a, (1.164f*y + 1.596f*cr)/255.0f, (1.164f*y - 0.813f*cr - 0.391f*cb)/255.0f, (1.164f*y + 2.018f*cb)/255.0f);
+}
+
+}
+
+struct cpu_image_kernel::implementation : boost::noncopyable
+{
+	void draw(cpu_draw_params&& params)
+	{
+		CASPAR_ASSERT(params.pix_desc.planes.size() == params.planes.size());
+
+		if(params.planes.empty() || !params.background)
+			return;
+
+		if(params.transform.opacity < epsilon)
+			return;
+
+		if(params.transform.is_key)
+			params.blend_mode = blend_mode::normal;
+
+		auto& background = *params.background;
+		const int width  = static_cast<int>(background.width());
+		const int height = static_cast<int>(background.height());
+
+		// Setup drawing area, the pixels whose centers are covered by the fill rectangle.
+
+		auto f_p = params.transform.fill_translation;
+		auto f_s = params.transform.fill_scale;
+
+		if(std::abs(f_s[0]) < std::numeric_limits<double>::epsilon() || std::abs(f_s[1]) < std::numeric_limits<double>::epsilon())
+			return;
+
+		int x_begin = std::max(0,	   static_cast<int>(std::ceil(std::min(f_p[0], f_p[0] + f_s[0]) * width  - 0.5)));
+		int x_end	= std::min(width,  static_cast<int>(std::ceil(std::max(f_p[0], f_p[0] + f_s[0]) * width  - 0.5)));
+		int y_begin = std::max(0,	   static_cast<int>(std::ceil(std::min(f_p[1], f_p[1] + f_s[1]) * height - 0.5)));
+		int y_end	= std::min(height, static_cast<int>(std::ceil(std::max(f_p[1], f_p[1] + f_s[1]) * height - 0.5)));
+
+		auto m_p = params.transform.clip_translation;
+		auto m_s = params.transform.clip_scale;
+
+		bool scissor = m_p[0] > std::numeric_limits<double>::epsilon()			|| m_p[1] > std::numeric_limits<double>::epsilon() ||
+					   m_s[0] < (1.0 - std::numeric_limits<double>::epsilon())	|| m_s[1] < (1.0 - std::numeric_limits<double>::epsilon());
+
+		if(scissor) // Same rounding as ogl_device::scissor.
+		{
+			int clip_x = static_cast<int>(m_p[0]*width);
+			int clip_y = static_cast<int>(m_p[1]*height);
+
+			x_begin = std::max(x_begin, clip_x);
+			y_begin = std::max(y_begin, clip_y);
+			x_end	= std::min(x_end, clip_x + static_cast<int>(m_s[0]*width));
+			y_end	= std::min(y_end, clip_y + static_cast<int>(m_s[1]*height));
+		}
+
+		if(x_begin >= x_end || y_begin >= y_end)
+			return;
+
+		// Setup samplers
+
+		std::vector<plane_sampler> samplers;
+		for(size_t n = 0; n < params.planes.size(); ++n)
+		{
+			samplers.push_back(plane_sampler(static_cast<const uint8_t*>(params.planes[n]->data()), params.pix_desc.planes[n]));
+			samplers.back().set_columns(x_begin, x_end, width, f_p[0], f_s[0]);
+		}
+
+		CASPAR_VERIFY(samplers.size() <= 4);
+
+		// Setup shading
+
+		const auto pix_fmt		= params.pix_desc.pix_fmt;
+		const bool is_hd		= params.pix_desc.planes.at(0).height > 700;
+		const int  chroma_mode	= params.blend_mode.chroma.key == chroma::green ? 1 : (params.blend_mode.chroma.key == chroma::blue ? 2 : 0);
+		const auto key			= params.blend_mode.chroma;
+		const auto mode			= params.blend_mode.mode;
+		const auto keyer_type	= params.keyer;
+		const auto fields		= params.transform.field_mode;
+		const auto opacity		= _mm_set1_ps(static_cast<float>(params.transform.is_key ? 1.0 : params.transform.opacity));
+		const auto& transform	= params.transform;
+
+		const bool has_levels	= transform.levels.min_input  > epsilon		||
+								  transform.levels.max_input  < 1.0-epsilon	||
+								  transform.levels.min_output > epsilon		||
+								  transform.levels.max_output < 1.0-epsilon	||
+								  std::abs(transform.levels.gamma - 1.0) > epsilon;
+
+		const bool has_csb		= std::abs(transform.brightness - 1.0) > epsilon ||
+								  std::abs(transform.saturation - 1.0) > epsilon ||
+								  std::abs(transform.contrast - 1.0)   > epsilon;
+
+		const float brt = static_cast<float>(transform.brightness);
+		const float sat = static_cast<float>(transform.saturation);
+		const float con = static_cast<float>(transform.contrast);
+
+		const uint8_t* local_key = params.local_key ? params.local_key->data() : nullptr;
+		const uint8_t* layer_key = params.layer_key ? params.layer_key->data() : nullptr;
+
+		uint8_t*	 target		   = background.data();
+		const size_t target_stride = background.stride();
+
+		// Draw, in bands of rows.
+
+		tbb::parallel_for(tbb::blocked_range<int>(y_begin, y_end, 16), [&](const tbb::blocked_range<int>& r)
+		{
+			std::array<axis_sample, 4> rows;
+
+			for(int y = r.begin(); y < r.end(); ++y)
+			{
+				// Polygon stipple, see upper_pattern and lower_pattern in image_kernel.cpp.
+				if((fields == field_mode::upper && (y & 1) != 0) || (fields == field_mode::lower && (y & 1) == 0))
+					continue;
+
+				double v = ((y + 0.5) / height - f_p[1]) / f_s[1];
+				for(size_t n = 0; n < samplers.size(); ++n)
+					rows[n] = make_axis_sample(v, samplers[n].height);
+
+				uint8_t* target_line = target + y * width * target_stride;
+
+				for(int x = x_begin; x < x_end; ++x)
+				{
+					const int column = x - x_begin;
+
+					__m128 color;
+
+					switch(pix_fmt)
+					{
+					case pixel_format::gray:
+						{
+							float value = samplers[0].sample1(column, rows[0]);
+							color = _mm_set_ps(1.0f, value, value, value);
+							break;
+						}
+					case pixel_format::bgra:
+						color = samplers[0].sample4(column, rows[0]);
+						break;
+					case pixel_format::rgba:
+						color = samplers[0].sample4(column, rows[0]);
+						color = _mm_shuffle_ps(color, color, _MM_SHUFFLE(3, 0, 1, 2));
+						break;
+					case pixel_format::argb:
+						color = samplers[0].sample4(column, rows[0]);
+						color = _mm_shuffle_ps(color, color, _MM_SHUFFLE(0, 1, 2, 3));
+						break;
+					case pixel_format::abgr:
+						color = samplers[0].sample4(column, rows[0]);
+						color = _mm_shuffle_ps(color, color, _MM_SHUFFLE(0, 3, 2, 1));
+						break;
+					case pixel_format::ycbcr:
+						color = ycbcra_to_bgra(
+								samplers[0].sample1(column, rows[0]),
+								samplers[1].sample1(column, rows[1]),
+								samplers[2].sample1(column, rows[2]),
+								1.0f,
+								is_hd);
+						break;
+					case pixel_format::ycbcra:
+						color = ycbcra_to_bgra(
+								samplers[0].sample1(column, rows[0]),
+								samplers[1].sample1(column, rows[1]),
+								samplers[2].sample1(column, rows[2]),
+								samplers[3].sample1(column, rows[3]),
+								is_hd);
+						break;
+					case pixel_format::luma:
+						{
+							float value = (samplers[0].sample1(column, rows[0]) - 0.065f) / 0.859f;
+							color = _mm_set_ps(1.0f, value, value, value);
+							break;
+						}
+					default:
+						color = _mm_setzero_ps();
+					}
+
+					if(chroma_mode != 0 || has_levels || has_csb)
+					{
+						float c[4];
+						_mm_storeu_ps(c, color);
+
+						if(chroma_mode != 0)
+							chroma_key(chroma_mode, key, c);
+
+						if(has_levels)
+							apply_levels(transform.levels, c);
+
+						if(has_csb)
+							apply_csb(brt, sat, con, c);
+
+						color = _mm_loadu_ps(c);
+					}
+
+					if(local_key)
+						color = _mm_mul_ps(color, _mm_set1_ps(local_key[y * width + x] * (1.0f/255.0f)));
+
+					if(layer_key)
+						color = _mm_mul_ps(color, _mm_set1_ps(layer_key[y * width + x] * (1.0f/255.0f)));
+
+					color = _mm_mul_ps(color, opacity);
+
+					// Blend
+
+					uint8_t* target_ptr = target_line + x * target_stride;
+
+					__m128 back = target_stride == 4
+							? load_pixel(target_ptr)
+							: _mm_set_ps(1.0f, *target_ptr * (1.0f/255.0f), 0.0f, 0.0f);
+
+					if(mode != blend_mode::normal)
+					{
+						float f[4];
+						float b[4];
+						_mm_storeu_ps(f, color);
+						_mm_storeu_ps(b, back);
+
+						float fore_rgb[3];
+						float back_rgb[3];
+						for(int n = 0; n < 3; ++n)
+						{
+							fore_rgb[n] = f[n] / (f[3] + 0.0000001f);
+							back_rgb[n] = b[n] / (b[3] + 0.0000001f);
+						}
+
+						blend_color(mode, back_rgb, fore_rgb, f);
+
+						for(int n = 0; n < 3; ++n)
+							f[n] *= f[3];
+
+						color = _mm_loadu_ps(f);
+					}
+
+					if(keyer_type == keyer::additive)
+						color = _mm_add_ps(color, back);
+					else
+					{
+						__m128 alpha = _mm_shuffle_ps(color, color, _MM_SHUFFLE(3, 3, 3, 3));
+						color = _mm_add_ps(color, _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(1.0f), alpha), back));
+					}
+
+					if(target_stride == 4)
+						store_pixel(target_ptr, color);
+					else
+					{
+						float c[4];
+						_mm_storeu_ps(c, color);
+						*target_ptr = static_cast<uint8_t>(clamp01(c[2]) * 255.0f + 0.5f);
+					}
+				}
+			}
+		});
+	}
+
+	void post_process(
+			const safe_ptr<cpu_buffer>& background, bool straighten_alpha)
+	{
+		if(!straighten_alpha || background->stride() != 4)
+			return;
+
+		const int width  = static_cast<int>(background->width());
+		uint8_t*  data	 = background->data();
+
+		tbb::parallel_for(tbb::blocked_range<int>(0, static_cast<int>(background->height()), 16), [&](const tbb::blocked_range<int>& r)
+		{
+			for(int y = r.begin(); y < r.end(); ++y)
+			{
+				uint8_t* line = data + y * width * 4;
+
+				for(int x = 0; x < width; ++x)
+				{
+					uint8_t* ptr = line + x * 4;
+					uint8_t	 a	 = ptr[3];
+
+					if(a == 0 || a == 255)
+						continue;
+
+					__m128 color = load_pixel(ptr);
+					color = _mm_div_ps(color, _mm_set_ps(1.0f, a/255.0f, a/255.0f, a/255.0f));
+					store_pixel(ptr, color);
+				}
+			}
+		});
+	}
+};
+
+cpu_image_kernel::cpu_image_kernel() : impl_(new implementation()){}
+void cpu_image_kernel::draw(cpu_draw_params&& params)
+{
+	impl_->draw(std::move(params));
+}
+
+void cpu_image_kernel::post_process(
+		const safe_ptr<cpu_buffer>& background, bool straighten_alpha)
+{
+	impl_->post_process(background, straighten_alpha);
+}
+
+}}
@@ -0,0 +1,96 @@
+/*
+* Copyright 2013 Sveriges Television AB http://casparcg.com/
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+#pragma once
+
+#include "blend_modes.h"
+#include "image_kernel.h"
+
+#include <common/memory/safe_ptr.h>
+
+#include <core/producer/frame/pixel_format.h>
+#include <core/producer/frame/frame_transform.h>
+
+#include <boost/noncopyable.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace caspar { namespace core {
+
+class host_buffer;
+
+// Render target of the cpu image kernel. Same layout as the device_buffer
+// it replaces, i.e. 1 (key) or 4 (bgra, premultiplied) bytes per pixel.
+class cpu_buffer : boost::noncopyable
+{
+public:
+	cpu_buffer(size_t width, size_t height, size_t stride);
+
+	size_t stride() const;
+	size_t width() const;
+	size_t height() const;
+
+	uint8_t* data();
+	const uint8_t* data() const;
+
+	void clear();
+
+	const safe_ptr<host_buffer>& host() const;
+private:
+	const size_t			width_;
+	const size_t			height_;
+	const size_t			stride_;
+	safe_ptr<host_buffer>	buffer_;
+};
+
+// Same contract as draw_params, with planes in system memory instead of textures.
+struct cpu_draw_params
+{
+	pixel_format_desc							pix_desc;
+	std::vector<std::shared_ptr<host_buffer>>	planes;
+	frame_transform								transform;
+	blend_mode									blend_mode;
+	keyer::type									keyer;
+	std::shared_ptr<cpu_buffer>					background;
+	std::shared_ptr<cpu_buffer>					local_key;
+	std::shared_ptr<cpu_buffer>					layer_key;
+
+	cpu_draw_params()
+		: blend_mode(blend_mode::normal)
+		, keyer(keyer::linear)
+	{
+	}
+};
+
+class cpu_image_kernel : boost::noncopyable
+{
+public:
+	cpu_image_kernel();
+	void draw(cpu_draw_params&& params);
+	void post_process(
+			const safe_ptr<cpu_buffer>& background, bool straighten_alpha);
+private:
+	struct implementation;
+	safe_ptr<implementation> impl_;
+};
+
+}}
@@ -24,15 +24,19 @@
 #include "image_mixer.h"
 
 #include "image_kernel.h"
+#include "cpu_image_kernel.h"
 #include "../write_frame.h"
 #include "../gpu/ogl_device.h"
 #include "../gpu/host_buffer.h"
 #include "../gpu/device_buffer.h"
 
+#include <common/concurrency/executor.h>
+#include <common/diagnostics/graph.h>
 #include <common/exception/exceptions.h>
 #include <common/gl/gl_check.h>
 #include <common/utility/move_on_copy.h>
 
+#include <core/monitor/monitor.h>
 #include <core/producer/frame/frame_transform.h>
 #include <core/producer/frame/pixel_format.h>
 #include <core/video_format.h>
@@ -40,10 +44,14 @@
 #include <gl/glew.h>
 
 #include <boost/foreach.hpp>
+#include <boost/property_tree/ptree.hpp>
 #include <boost/range/algorithm_ext/erase.hpp>
 
+#include <tbb/atomic.h>
+
 #include <algorithm>
 #include <deque>
+#include <iterator>
 
 using namespace boost::assign;
 
@@ -53,20 +61,185 @@ struct item
 {
 	pixel_format_desc						pix_desc;
 	std::vector<safe_ptr<device_buffer>>	textures;
+	std::vector<std::shared_ptr<host_buffer>>	buffers; // cpu image mixer only.
 	frame_transform							transform;
 };
 
 typedef std::pair<blend_mode, std::vector<item>> layer;
 
+struct render_cache_stats
+{
+	tbb::atomic<int64_t> layers;	// Layers rendered.
+	tbb::atomic<int64_t> hits;		// Layers drawn from a cached composite.
+	tbb::atomic<int64_t> misses;	// Layers composited into a new cache entry.
+
+	render_cache_stats()
+	{
+		layers	= 0;
+		hits	= 0;
+		misses	= 0;
+	}
+};
+
+// Caches the composite of runs of consecutive layers which are identical to the previous tick, e.g.
+// still images and paused clips. A run is replaced by a single item which draws its cached composite,
+// with normal blending on a premultiplied buffer this gives the same result as drawing the layers.
+// Composites are rendered progressive and shared by both fields of interlaced formats.
+class render_cache : boost::noncopyable
+{
+	// Identifies what a layer draws. Holds on to the planes so that pooled buffers can't be recycled,
+	// and thereby compare equal, while the signature is in use.
+	struct signature
+	{
+		bool							cacheable;
+		bool							has_key;
+		std::vector<frame_transform>	transforms;
+		std::vector<std::shared_ptr<void>>	planes;
+		std::vector<int>				generations;
+
+		bool operator==(const signature& other) const
+		{
+			return cacheable == other.cacheable && transforms == other.transforms && planes == other.planes && generations == other.generations;
+		}
+	};
+
+	struct entry
+	{
+		size_t					begin;
+		std::vector<signature>	signatures;
+		item					composite;
+	};
+
+	safe_ptr<diagnostics::graph>	graph_;
+	render_cache_stats&		stats_;
+	video_format_desc		format_desc_;
+	std::vector<signature>	previous_;
+	std::vector<entry>		entries_;
+public:
+	render_cache(const safe_ptr<diagnostics::graph>& graph, render_cache_stats& stats)
+		: graph_(graph)
+		, stats_(stats)
+		, format_desc_(video_format_desc::get(video_format::invalid))
+	{
+	}
+
+	// Returns the layers to draw. render_run composites a run of layers into a bgra item.
+	template<typename F>
+	std::vector<layer> apply(std::vector<layer>&& layers, const video_format_desc& format_desc, const F& render_run)
+	{
+		if(format_desc_ != format_desc)
+		{
+			previous_.clear();
+			entries_.clear();
+			format_desc_ = format_desc;
+		}
+
+		std::vector<signature> signatures;
+		BOOST_FOREACH(auto& layer, layers)
+			signatures.push_back(make_signature(layer));
+
+		std::vector<entry>	entries;
+		std::vector<layer>	result;
+		int64_t				hits	= 0;
+		int64_t				misses	= 0;
+
+		for(size_t begin = 0; begin < layers.size();)
+		{
+			auto end			= begin;
+			size_t num_items	= 0;
+			while(end < layers.size() && is_static(signatures, end))
+				num_items += layers[end++].second.size();
+
+			// A single item is as cheap to draw as its composite. A run can't start where the layer 
+			// below passes on a key.
+			if(num_items < 2 || (begin > 0 && signatures[begin-1].has_key))
+			{
+				result.push_back(std::move(layers[begin]));
+				++begin;
+				continue;
+			}
+			
+			std::vector<signature> run_signatures(signatures.begin() + begin, signatures.begin() + end);
+
+			auto it = std::find_if(entries_.begin(), entries_.end(), [&](const entry& e)
+			{
+				return e.begin == begin && e.signatures == run_signatures;
+			});
+
+			entry entry;
+			if(it != entries_.end())
+			{
+				entry = std::move(*it);
+				hits += end - begin;
+			}
+			else
+			{
+				entry.begin			= begin;
+				entry.signatures	= std::move(run_signatures);
+				entry.composite		= render_run(std::vector<layer>(std::make_move_iterator(layers.begin() + begin), std::make_move_iterator(layers.begin() + end)));
+				misses += end - begin;
+			}
+
+			result.push_back(std::make_pair(blend_mode(), std::vector<item>(1, entry.composite)));
+			entries.push_back(std::move(entry));
+
+			begin = end;
+		}
+
+		entries_	= std::move(entries); // Entries which weren't used this tick are released.
+		previous_	= std::move(signatures);
+
+		stats_.layers	+= layers.size();
+		stats_.hits		+= hits;
+		stats_.misses	+= misses;
+
+		graph_->set_value("render-cache-hit", layers.empty() ? 0.0 : static_cast<double>(hits) / static_cast<double>(layers.size()));
+
+		return result;
+	}
+private:
+	bool is_static(const std::vector<signature>& signatures, size_t index) const
+	{
+		return signatures[index].cacheable && index < previous_.size() && signatures[index] == previous_[index];
+	}
+
+	static signature make_signature(const layer& layer)
+	{
+		signature signature;
+		signature.cacheable = layer.first.mode == blend_mode::normal && layer.first.chroma.key == chroma::none;
+		signature.has_key	= false;
+
+		BOOST_FOREACH(auto& item, layer.second)
+		{
+			signature.cacheable = signature.cacheable && !item.transform.is_key && !item.transform.is_mix && item.transform.field_mode == field_mode::progressive;
+			signature.has_key	= signature.has_key || item.transform.is_key;
+			signature.transforms.push_back(item.transform);
+
+			BOOST_FOREACH(auto& texture, item.textures)
+			{
+				signature.planes.push_back(std::shared_ptr<device_buffer>(texture));
+				signature.generations.push_back(texture->generation());
+			}
+
+			BOOST_FOREACH(auto& buffer, item.buffers)
+				signature.planes.push_back(buffer);
+		}
+
+		return signature;
+	}
+};
+
 class image_renderer
 {
 	safe_ptr<ogl_device>			ogl_;
 	image_kernel					kernel_;	
 	std::shared_ptr<device_buffer>	transferring_buffer_;
+	render_cache					cache_;
 public:
-	image_renderer(const safe_ptr<ogl_device>& ogl)
+	image_renderer(const safe_ptr<ogl_device>& ogl, const safe_ptr<diagnostics::graph>& graph, render_cache_stats& stats)
 		: ogl_(ogl)
 		, kernel_(ogl_)
+		, cache_(graph, stats)
 	{
 	}
 	
@@ -86,6 +259,18 @@ public:
 private:
 	safe_ptr<host_buffer> do_render(std::vector<layer>&& layers, const video_format_desc& format_desc, bool straighten_alpha)
 	{
+		layers = cache_.apply(std::move(layers), format_desc, [&](std::vector<layer>&& run) -> item
+		{
+			auto composite = create_mixer_buffer(4, format_desc);
+			draw(std::move(run), composite, format_desc);
+
+			item item;
+			item.pix_desc.pix_fmt = pixel_format::bgra;
+			item.pix_desc.planes.push_back(pixel_format_desc::plane(composite->width(), composite->height(), 4));
+			item.textures.push_back(composite);
+			return item;
+		});
+
 		auto draw_buffer = create_mixer_buffer(4, format_desc);
 
 		if(format_desc.field_mode != field_mode::progressive)
@@ -242,19 +427,372 @@ private:
 		return buffer;
 	}
 };
+
+// Same layer/key/mix semantics as image_renderer, composited in system memory without a gpu.
+class cpu_image_renderer
+{
+	cpu_image_kernel	kernel_;
+	render_cache		cache_;
+	executor			executor_;
+public:
+	cpu_image_renderer(const safe_ptr<diagnostics::graph>& graph, render_cache_stats& stats)
+		: cache_(graph, stats)
+		, executor_(L"cpu_image_renderer")
+	{
+	}
+	
+	boost::unique_future<safe_ptr<host_buffer>> operator()(
+			std::vector<layer>&& layers,
+			const video_format_desc& format_desc,
+			bool straighten_alpha)
+	{		
+		auto layers2 = make_move_on_copy(std::move(layers));
+		return executor_.begin_invoke([=]
+		{
+			return do_render(
+					std::move(layers2.value), format_desc, straighten_alpha);
+		});
+	}
+
+private:
+	safe_ptr<host_buffer> do_render(std::vector<layer>&& layers, const video_format_desc& format_desc, bool straighten_alpha)
+	{
+		layers = cache_.apply(std::move(layers), format_desc, [&](std::vector<layer>&& run) -> item
+		{
+			auto composite = create_mixer_buffer(4, format_desc);
+			draw(std::move(run), composite, format_desc);
+
+			item item;
+			item.pix_desc.pix_fmt = pixel_format::bgra;
+			item.pix_desc.planes.push_back(pixel_format_desc::plane(composite->width(), composite->height(), 4));
+			item.buffers.push_back(composite->host());
+			return item;
+		});
+
+		auto draw_buffer = create_mixer_buffer(4, format_desc);
+
+		if(format_desc.field_mode != field_mode::progressive)
+		{
+			auto upper = layers;
+			auto lower = std::move(layers);
+
+			BOOST_FOREACH(auto& layer, upper)
+			{
+				BOOST_FOREACH(auto& item, layer.second)
+					item.transform.field_mode = static_cast<field_mode::type>(item.transform.field_mode & field_mode::upper);
+			}
+
+			BOOST_FOREACH(auto& layer, lower)
+			{
+				BOOST_FOREACH(auto& item, layer.second)
+					item.transform.field_mode = static_cast<field_mode::type>(item.transform.field_mode & field_mode::lower);
+			}
+
+			draw(std::move(upper), draw_buffer, format_desc);
+			draw(std::move(lower), draw_buffer, format_desc);
+		}
+		else
+		{
+			draw(std::move(layers), draw_buffer, format_desc);
+		}
+
+		kernel_.post_process(draw_buffer, straighten_alpha);
+
+		return draw_buffer->host(); // No read back, the frame is already in system memory.
+	}
+
+	void draw(std::vector<layer>&&		layers, 
+			  safe_ptr<cpu_buffer>&		draw_buffer, 
+			  const video_format_desc&	format_desc)
+	{
+		std::shared_ptr<cpu_buffer> layer_key_buffer;
+
+		BOOST_FOREACH(auto& layer, layers)
+			draw_layer(std::move(layer), draw_buffer, layer_key_buffer, format_desc);
+	}
+
+	void draw_layer(layer&&							layer, 
+					safe_ptr<cpu_buffer>&			draw_buffer,
+					std::shared_ptr<cpu_buffer>&	layer_key_buffer,
+					const video_format_desc&		format_desc)
+	{				
+		boost::remove_erase_if(layer.second, [](const item& item){return item.transform.field_mode == field_mode::empty;});
+
+		if(layer.second.empty())
+			return;
+
+		std::shared_ptr<cpu_buffer> local_key_buffer;
+		std::shared_ptr<cpu_buffer> local_mix_buffer;
+				
+		if(layer.first.mode != blend_mode::normal || layer.first.chroma.key != chroma::none)
+		{
+			auto layer_draw_buffer = create_mixer_buffer(4, format_desc);
+
+			BOOST_FOREACH(auto& item, layer.second)
+				draw_item(std::move(item), layer_draw_buffer, layer_key_buffer, local_key_buffer, local_mix_buffer, format_desc);	
+		
+			draw_mixer_buffer(layer_draw_buffer, std::move(local_mix_buffer), blend_mode::normal);							
+			draw_mixer_buffer(draw_buffer, std::move(layer_draw_buffer), layer.first);
+		}
+		else // fast path
+		{
+			BOOST_FOREACH(auto& item, layer.second)		
+				draw_item(std::move(item), draw_buffer, layer_key_buffer, local_key_buffer, local_mix_buffer, format_desc);		
+					
+			draw_mixer_buffer(draw_buffer, std::move(local_mix_buffer), layer.first);
+		}					
+
+		layer_key_buffer = std::move(local_key_buffer);
+	}
+
+	void draw_item(item&&							item, 
+				   safe_ptr<cpu_buffer>&			draw_buffer, 
+				   std::shared_ptr<cpu_buffer>&		layer_key_buffer, 
+				   std::shared_ptr<cpu_buffer>&		local_key_buffer, 
+				   std::shared_ptr<cpu_buffer>&		local_mix_buffer,
+				   const video_format_desc&			format_desc)
+	{			
+		cpu_draw_params draw_params;
+		draw_params.pix_desc				= std::move(item.pix_desc);
+		draw_params.planes					= std::move(item.buffers);
+		draw_params.transform				= std::move(item.transform);
+
+		if(item.transform.is_key)
+		{
+			local_key_buffer = local_key_buffer ? local_key_buffer : create_mixer_buffer(1, format_desc);
+
+			draw_params.background			= local_key_buffer;
+			draw_params.local_key			= nullptr;
+			draw_params.layer_key			= nullptr;
+
+			kernel_.draw(std::move(draw_params));
+		}
+		else if(item.transform.is_mix)
+		{
+			local_mix_buffer = local_mix_buffer ? local_mix_buffer : create_mixer_buffer(4, format_desc);
+
+			draw_params.background			= local_mix_buffer;
+			draw_params.local_key			= std::move(local_key_buffer);
+			draw_params.layer_key			= layer_key_buffer;
+
+			draw_params.keyer				= keyer::additive;
+
+			kernel_.draw(std::move(draw_params));
+		}
+		else
+		{
+			draw_mixer_buffer(draw_buffer, std::move(local_mix_buffer), blend_mode::normal);
+			
+			draw_params.background			= draw_buffer;
+			draw_params.local_key			= std::move(local_key_buffer);
+			draw_params.layer_key			= layer_key_buffer;
+
+			kernel_.draw(std::move(draw_params));
+		}	
+	}
+
+	void draw_mixer_buffer(safe_ptr<cpu_buffer>&			draw_buffer, 
+						   std::shared_ptr<cpu_buffer>&&	source_buffer, 
+						   blend_mode   			        blend_mode = blend_mode::normal)
+	{
+		if(!source_buffer)
+			return;
+
+		cpu_draw_params draw_params;
+		draw_params.pix_desc.pix_fmt	= pixel_format::bgra;
+		draw_params.pix_desc.planes		= list_of(pixel_format_desc::plane(source_buffer->width(), source_buffer->height(), 4));
+		draw_params.planes				= list_of(std::shared_ptr<host_buffer>(source_buffer->host()));
+		draw_params.transform			= frame_transform();
+		draw_params.blend_mode			= blend_mode;
+		draw_params.background			= draw_buffer;
+
+		kernel_.draw(std::move(draw_params));
+	}
+			
+	safe_ptr<cpu_buffer> create_mixer_buffer(size_t stride, const video_format_desc& format_desc)
+	{
+		auto buffer = make_safe<cpu_buffer>(format_desc.width, format_desc.height, stride);
+		buffer->clear();
+		return buffer;
+	}
+};
+		
+// Visibility culling, runs on the mixer thread before the layers are handed to a renderer.
+
+static bool is_visible(const item& item)
+{
+	static const double epsilon = 0.001; // Same as image_kernel::draw.
+
+	auto& transform = item.transform;
+
+	if(transform.field_mode == field_mode::empty)
+		return false;
+
+	if(!transform.is_key && transform.opacity < epsilon)
+		return false;
+
+	if(transform.is_key) // An empty key still masks what it is applied to.
+		return true;
+
+	auto fill_x0 = std::min(transform.fill_translation[0], transform.fill_translation[0] + transform.fill_scale[0]);
+	auto fill_x1 = std::max(transform.fill_translation[0], transform.fill_translation[0] + transform.fill_scale[0]);
+	auto fill_y0 = std::min(transform.fill_translation[1], transform.fill_translation[1] + transform.fill_scale[1]);
+	auto fill_y1 = std::max(transform.fill_translation[1], transform.fill_translation[1] + transform.fill_scale[1]);
+
+	auto x0 = std::max(std::max(fill_x0, transform.clip_translation[0]), 0.0);
+	auto x1 = std::min(std::min(fill_x1, transform.clip_translation[0] + transform.clip_scale[0]), 1.0);
+	auto y0 = std::max(std::max(fill_y0, transform.clip_translation[1]), 0.0);
+	auto y1 = std::min(std::min(fill_y1, transform.clip_translation[1] + transform.clip_scale[1]), 1.0);
+
+	return x1 > x0 && y1 > y0;
+}
+
+// True if the item replaces every pixel beneath it.
+static bool is_opaque(const item& item)
+{
+	auto& transform = item.transform;
+
+	return item.pix_desc.pix_fmt == pixel_format::ycbcr		&&
+		   !transform.is_key && !transform.is_mix			&&
+		   transform.opacity >= 1.0							&&
+		   transform.field_mode == field_mode::progressive	&&
+		   transform.fill_translation[0] <= 0.0 && transform.fill_translation[0] + transform.fill_scale[0] >= 1.0 &&
+		   transform.fill_translation[1] <= 0.0 && transform.fill_translation[1] + transform.fill_scale[1] >= 1.0 &&
+		   transform.clip_translation[0] <= 0.0 && transform.clip_translation[0] + transform.clip_scale[0] >= 1.0 &&
+		   transform.clip_translation[1] <= 0.0 && transform.clip_translation[1] + transform.clip_scale[1] >= 1.0;
+}
+
+static bool ends_with_key(const layer& layer)
+{
+	return !layer.second.empty() && layer.second.back().transform.is_key;
+}
+
+// Removes invisible items, together with the keys that would only have been applied to them, and 
+// empty layers. Everything beneath the top most layer with an opaque full frame item is removed 
+// as well. Returns the number of culled items and layers.
+static std::pair<int, int> cull(std::vector<layer>& layers)
+{
+	int culled_items = 0;
+	
+	std::vector<layer> kept_layers;
+
+	BOOST_FOREACH(auto& layer, layers)
+	{
+		// Only a layer without any drawable items passes the key of the layer below through, 
+		// see draw_layer.
+		bool consumes_key = std::any_of(layer.second.begin(), layer.second.end(), [](const item& item)
+		{
+			return item.transform.field_mode != field_mode::empty;
+		});
+
+		std::vector<item> items;
+		std::vector<item> keys; // Applied to the next item, or to the next layer if none follows.
+
+		BOOST_FOREACH(auto& item, layer.second)
+		{
+			if(item.transform.is_key)
+			{
+				keys.push_back(std::move(item));
+				continue;
+			}
+
+			if(is_visible(item))
+			{
+				std::move(keys.begin(), keys.end(), std::back_inserter(items));
+				items.push_back(std::move(item));
+			}
+			else
+				culled_items += static_cast<int>(keys.size()) + 1;
+
+			keys.clear();
+		}
+		
+		std::move(keys.begin(), keys.end(), std::back_inserter(items));
+		layer.second = std::move(items);
+
+		if(!layer.second.empty())
+		{
+			kept_layers.push_back(std::move(layer));
+			continue;
+		}
+
+		if(!consumes_key)
+			continue;
+
+		// The culled layer would have consumed the key of the layer below, which would otherwise 
+		// mask the next visible layer instead. Layers holding nothing but that key consumed the 
+		// key beneath them as well.
+		while(!kept_layers.empty() && ends_with_key(kept_layers.back()))
+		{
+			auto& below = kept_layers.back().second;
+			while(!below.empty() && below.back().transform.is_key)
+			{
+				below.pop_back();
+				++culled_items;
+			}
+
+			if(!below.empty())
+				break;
+
+			kept_layers.pop_back();
+		}
+	}
+
+	int culled_layers = static_cast<int>(layers.size());
+
+	layers = std::move(kept_layers);
+
+	// A layer is only occluding when the layer below doesn't key it and the item isn't keyed 
+	// by a preceding item.
+	for(size_t n = layers.size(); n-- > 1;)
+	{
+		auto& layer = layers[n];
+
+		if(layer.first.mode != blend_mode::normal || layer.first.chroma.key != chroma::none || ends_with_key(layers[n-1]))
+			continue;
+
+		bool occluding = false;
+		for(size_t i = 0; i < layer.second.size() && !occluding; ++i)
+			occluding = is_opaque(layer.second[i]) && (i == 0 || !layer.second[i-1].transform.is_key);
+
+		if(!occluding)
+			continue;
+
+		for(size_t i = 0; i < n; ++i)
+			culled_items += static_cast<int>(layers[i].second.size());
+
+		layers.erase(layers.begin(), layers.begin() + n);
+		break;
+	}
+
+	culled_layers -= static_cast<int>(layers.size());
+
+	return std::make_pair(culled_items, culled_layers);
+}
 		
 struct image_mixer::implementation : boost::noncopyable
 {	
-	safe_ptr<ogl_device>			ogl_;
-	image_renderer					renderer_;
-	std::vector<frame_transform>	transform_stack_;
-	std::vector<layer>				layers_; // layer/stream/items
+	safe_ptr<diagnostics::graph>		graph_;
+	render_cache_stats					cache_stats_;
+	std::shared_ptr<ogl_device>			ogl_;
+	std::unique_ptr<image_renderer>		renderer_;
+	std::unique_ptr<cpu_image_renderer>	cpu_renderer_;
+	std::vector<frame_transform>		transform_stack_;
+	std::vector<layer>					layers_; // layer/stream/items
+	monitor::subject					monitor_subject_;
 public:
-	implementation(const safe_ptr<ogl_device>& ogl) 
-		: ogl_(ogl)
-		, renderer_(ogl)
+	implementation(const safe_ptr<diagnostics::graph>& graph, const std::shared_ptr<ogl_device>& ogl) 
+		: graph_(graph)
+		, ogl_(ogl)
 		, transform_stack_(1)	
+		, monitor_subject_("/image")
 	{
+		graph_->set_color("render-cache-hit", diagnostics::color(0.3f, 0.8f, 0.8f));
+
+		if(ogl_)
+			renderer_.reset(new image_renderer(make_safe_ptr(ogl_), graph_, cache_stats_));
+		else
+			cpu_renderer_.reset(new cpu_image_renderer(graph_, cache_stats_));
 	}
 
 	void begin_layer(blend_mode blend_mode)
@@ -272,6 +810,7 @@ public:
 		item item;
 		item.pix_desc	= frame.get_pixel_format_desc();
 		item.textures	= frame.get_textures();
+		item.buffers	= frame.get_system_buffers();
 		item.transform	= transform_stack_.back();
 
 		layers_.back().second.push_back(item);
@@ -288,16 +827,38 @@ public:
 	
 	boost::unique_future<safe_ptr<host_buffer>> render(const video_format_desc& format_desc, bool straighten_alpha)
 	{
-		return renderer_(std::move(layers_), format_desc, straighten_alpha);
+		auto culled = cull(layers_);
+
+		monitor_subject_ << monitor::message("/culled") % static_cast<int32_t>(culled.first) % static_cast<int32_t>(culled.second);
+
+		if(renderer_)
+			return (*renderer_)(std::move(layers_), format_desc, straighten_alpha);
+		else
+			return (*cpu_renderer_)(std::move(layers_), format_desc, straighten_alpha);
+	}
+
+	boost::property_tree::wptree info() const
+	{
+		int64_t layers	= cache_stats_.layers;
+		int64_t hits	= cache_stats_.hits;
+
+		boost::property_tree::wptree info;
+		info.add(L"render-cache.layers",	layers);
+		info.add(L"render-cache.hits",		hits);
+		info.add(L"render-cache.misses",	cache_stats_.misses);
+		info.add(L"render-cache.hit-rate",	layers > 0 ? static_cast<double>(hits) / static_cast<double>(layers) : 0.0);
+		return info;
 	}
 };
 
-image_mixer::image_mixer(const safe_ptr<ogl_device>& ogl) : impl_(new implementation(ogl)){}
+image_mixer::image_mixer(const safe_ptr<diagnostics::graph>& graph, const std::shared_ptr<ogl_device>& ogl) : impl_(new implementation(graph, ogl)){}
 void image_mixer::begin(basic_frame& frame){impl_->begin(frame);}
 void image_mixer::visit(write_frame& frame){impl_->visit(frame);}
 void image_mixer::end(){impl_->end();}
 boost::unique_future<safe_ptr<host_buffer>> image_mixer::operator()(const video_format_desc& format_desc, bool straighten_alpha){return impl_->render(format_desc, straighten_alpha);}
 void image_mixer::begin_layer(blend_mode blend_mode){impl_->begin_layer(blend_mode);}
 void image_mixer::end_layer(){impl_->end_layer();}
+boost::property_tree::wptree image_mixer::info() const{return impl_->info();}
+monitor::source& image_mixer::monitor_output(){return impl_->monitor_subject_;}
 
 }}
\ No newline at end of file
@@ -23,15 +23,26 @@
 
 #include "blend_modes.h"
 
+#include "../../monitor/monitor.h"
+
 #include <common/memory/safe_ptr.h>
 
 #include <core/producer/frame/frame_visitor.h>
 
 #include <boost/noncopyable.hpp>
+#include <boost/property_tree/ptree_fwd.hpp>
 
 #include <boost/thread/future.hpp>
 
-namespace caspar { namespace core {
+namespace caspar { 
+	
+namespace diagnostics {
+	
+class graph;
+
+}
+
+namespace core {
 
 class write_frame;
 class host_buffer;
@@ -42,7 +53,7 @@ struct pixel_format_desc;
 class image_mixer : public core::frame_visitor, boost::noncopyable
 {
 public:
-	image_mixer(const safe_ptr<ogl_device>& ogl);
+	image_mixer(const safe_ptr<diagnostics::graph>& graph, const std::shared_ptr<ogl_device>& ogl); // nullptr selects the cpu image mixer.
 	
 	virtual void begin(core::basic_frame& frame);
 	virtual void visit(core::write_frame& frame);
@@ -53,6 +64,10 @@ public:
 		
 	boost::unique_future<safe_ptr<host_buffer>> operator()(
 			const video_format_desc& format_desc, bool straighten_alpha);
+
+	boost::property_tree::wptree info() const; // Render cache hit rate.
+
+	monitor::source& monitor_output(); // /image/culled items layers, once per frame.
 		
 private:
 	struct implementation;
@@ -30,7 +30,7 @@
 #include "image/image_mixer.h"
 
 #include <common/env.h>
-#include <common/concurrency/executor.h>
+#include <common/concurrency/ring_executor.h>
 #include <common/concurrency/future_util.h>
 #include <common/exception/exceptions.h>
 #include <common/gl/gl_check.h>
@@ -67,36 +67,40 @@ struct mixer::implementation : boost::noncopyable
 	safe_ptr<mixer::target_t>		target_;
 	mutable tbb::spin_mutex			format_desc_mutex_;
 	video_format_desc				format_desc_;
-	safe_ptr<ogl_device>			ogl_;
+	std::shared_ptr<ogl_device>		ogl_;
 	channel_layout					audio_channel_layout_;
 	bool							straighten_alpha_;
+	monitor::subject				monitor_subject_;
 	
 	audio_mixer	audio_mixer_;
 	image_mixer image_mixer_;
 	
 	std::unordered_map<int, blend_mode> blend_modes_;
 			
-	executor executor_;
+	ring_executor executor_;
 
 public:
-	implementation(const safe_ptr<diagnostics::graph>& graph, const safe_ptr<mixer::target_t>& target, const video_format_desc& format_desc, const safe_ptr<ogl_device>& ogl, const channel_layout& audio_channel_layout) 
+	implementation(const safe_ptr<diagnostics::graph>& graph, const safe_ptr<mixer::target_t>& target, const video_format_desc& format_desc, const std::shared_ptr<ogl_device>& ogl, const channel_layout& audio_channel_layout) 
 		: graph_(graph)
 		, target_(target)
 		, format_desc_(format_desc)
 		, ogl_(ogl)
 		, audio_channel_layout_(audio_channel_layout)
 		, straighten_alpha_(false)
+		, monitor_subject_("/mixer")
 		, audio_mixer_(graph_)
-		, image_mixer_(ogl)
+		, image_mixer_(graph_, ogl)
 		, executor_(L"mixer")
 	{			
 		graph_->set_color("mix-time", diagnostics::color(1.0f, 0.0f, 0.9f, 0.8));
 		current_mix_time_ = 0;
+
+		image_mixer_.monitor_output().link_target(&monitor_subject_);
 	}
 	
 	void send(const std::pair<std::map<int, safe_ptr<core::basic_frame>>, std::shared_ptr<void>>& packet)
 	{			
-		executor_.begin_invoke([=]
+		executor_.post([=]
 		{		
 			try
 			{
@@ -137,7 +141,18 @@ public:
 			const core::pixel_format_desc& desc,
 			const channel_layout& audio_channel_layout)
 	{		
-		return make_safe<write_frame>(ogl_, tag, desc, audio_channel_layout);
+		if(ogl_)
+			return make_safe<write_frame>(make_safe_ptr(ogl_), tag, desc, audio_channel_layout);
+		else
+			return make_safe<write_frame>(tag, desc, audio_channel_layout);
+	}
+
+	std::shared_ptr<core::write_frame> create_shared_frame(const void* tag, const core::pixel_format_desc& desc, const safe_ptr<read_frame>& frame)
+	{
+		if(desc.planes.size() != 1 || frame->image_size() < desc.planes.at(0).size || !frame->image_buffer())
+			return nullptr;
+
+		return std::make_shared<write_frame>(ogl_, tag, desc, frame);
 	}
 
 	blend_mode::type get_blend_mode(int index)
@@ -150,7 +165,7 @@ public:
 				
 	void set_blend_mode(int index, blend_mode::type value)
 	{
-		executor_.begin_invoke([=]
+		executor_.post([=]
 		{
 			blend_modes_[index].mode = value;
 		}, high_priority);
@@ -158,7 +173,7 @@ public:
 
 	void clear_blend_mode(int index)
 	{
-		executor_.begin_invoke([=]
+		executor_.post([=]
 		{
 			blend_modes_.erase(index);
 		}, high_priority);
@@ -166,7 +181,7 @@ public:
 
 	void clear_blend_modes()
 	{
-		executor_.begin_invoke([=]
+		executor_.post([=]
 		{
 			blend_modes_.clear();
 		}, high_priority);
@@ -182,7 +197,7 @@ public:
 
     void set_chroma(int index, const chroma & value)
     {
-        executor_.begin_invoke([=]
+        executor_.post([=]
         {
             blend_modes_[index].chroma = value;
         }, high_priority);
@@ -190,7 +205,7 @@ public:
 
 	void set_straight_alpha_output(bool value)
 	{
-        executor_.begin_invoke([=]
+        executor_.post([=]
         {
 			straighten_alpha_ = value;
         }, high_priority);
@@ -214,7 +229,7 @@ public:
 
 	void set_master_volume(float volume)
 	{
-		executor_.begin_invoke([=]
+		executor_.post([=]
 		{
 			audio_mixer_.set_master_volume(volume);
 		}, high_priority);
@@ -222,7 +237,7 @@ public:
 	
 	void set_video_format_desc(const video_format_desc& format_desc)
 	{
-		executor_.begin_invoke([=]
+		executor_.post([=]
 		{
 			tbb::spin_mutex::scoped_lock lock(format_desc_mutex_);
 			format_desc_ = format_desc;
@@ -239,6 +254,7 @@ public:
 	{
 		boost::property_tree::wptree info;
 		info.add(L"mix-time", current_mix_time_);
+		info.add_child(L"image-mixer", image_mixer_.info());
 
 		return wrap_as_future(std::move(info));
 	}
@@ -252,11 +268,12 @@ public:
 	}
 };
 	
-mixer::mixer(const safe_ptr<diagnostics::graph>& graph, const safe_ptr<target_t>& target, const video_format_desc& format_desc, const safe_ptr<ogl_device>& ogl, const channel_layout& audio_channel_layout) 
+mixer::mixer(const safe_ptr<diagnostics::graph>& graph, const safe_ptr<target_t>& target, const video_format_desc& format_desc, const std::shared_ptr<ogl_device>& ogl, const channel_layout& audio_channel_layout) 
 	: impl_(new implementation(graph, target, format_desc, ogl, audio_channel_layout)){}
 void mixer::send(const std::pair<std::map<int, safe_ptr<core::basic_frame>>, std::shared_ptr<void>>& frames){ impl_->send(frames);}
 core::video_format_desc mixer::get_video_format_desc() const { return impl_->get_video_format_desc(); }
 safe_ptr<core::write_frame> mixer::create_frame(const void* tag, const core::pixel_format_desc& desc, const channel_layout& audio_channel_layout){ return impl_->create_frame(tag, desc, audio_channel_layout); }		
+std::shared_ptr<core::write_frame> mixer::create_shared_frame(const void* tag, const core::pixel_format_desc& desc, const safe_ptr<read_frame>& frame){ return impl_->create_shared_frame(tag, desc, frame); }
 blend_mode::type mixer::get_blend_mode(int index) { return impl_->get_blend_mode(index); }
 void mixer::set_blend_mode(int index, blend_mode::type value){impl_->set_blend_mode(index, value);}
 chroma mixer::get_chroma(int index) { return impl_->get_chroma(index); }
@@ -270,4 +287,5 @@ void mixer::set_master_volume(float volume) { impl_->set_master_volume(volume);
 void mixer::set_video_format_desc(const video_format_desc& format_desc){impl_->set_video_format_desc(format_desc);}
 boost::unique_future<boost::property_tree::wptree> mixer::info() const{return impl_->info();}
 boost::unique_future<boost::property_tree::wptree> mixer::delay_info() const{return impl_->delay_info();}
+monitor::source& mixer::monitor_output(){return impl_->monitor_subject_;}
 }}
\ No newline at end of file
@@ -23,6 +23,8 @@
 
 #include "image/blend_modes.h"
 
+#include "../monitor/monitor.h"
+
 #include "../producer/frame/frame_factory.h"
 
 #include <common/memory/safe_ptr.h>
@@ -54,7 +56,7 @@ class mixer : public target<std::pair<std::map<int, safe_ptr<core::basic_frame>>
 public:	
 	typedef target<std::pair<safe_ptr<read_frame>, std::shared_ptr<void>>> target_t;
 
-	explicit mixer(const safe_ptr<diagnostics::graph>& graph, const safe_ptr<target_t>& target, const video_format_desc& format_desc, const safe_ptr<ogl_device>& ogl, const channel_layout& audio_channel_layout);
+	explicit mixer(const safe_ptr<diagnostics::graph>& graph, const safe_ptr<target_t>& target, const video_format_desc& format_desc, const std::shared_ptr<ogl_device>& ogl, const channel_layout& audio_channel_layout);
 		
 	// target
 
@@ -63,6 +65,7 @@ public:
 	// mixer
 
 	safe_ptr<core::write_frame> create_frame(const void* tag, const core::pixel_format_desc& desc, const channel_layout& audio_channel_layout);		
+	virtual std::shared_ptr<core::write_frame> create_shared_frame(const void* tag, const core::pixel_format_desc& desc, const safe_ptr<read_frame>& frame) override;
 	
 	core::video_format_desc get_video_format_desc() const; // nothrow
 	void set_video_format_desc(const video_format_desc& format_desc);
@@ -81,6 +84,8 @@ public:
 
 	boost::unique_future<boost::property_tree::wptree> info() const;
 	boost::unique_future<boost::property_tree::wptree> delay_info() const;
+
+	monitor::source& monitor_output();
 	
 private:
 	struct implementation;
@@ -43,7 +43,7 @@ int64_t get_current_time_millis()
 																																							
 struct read_frame::implementation : boost::noncopyable
 {
-	safe_ptr<ogl_device>		ogl_;
+	std::shared_ptr<ogl_device>	ogl_;
 	size_t						size_;
 	safe_ptr<host_buffer>		image_data_;
 	tbb::mutex					mutex_;
@@ -53,7 +53,7 @@ struct read_frame::implementation : boost::noncopyable
 
 public:
 	implementation(
-			const safe_ptr<ogl_device>& ogl,
+			const std::shared_ptr<ogl_device>& ogl,
 			size_t size,
 			safe_ptr<host_buffer>&& image_data,
 			audio_buffer&& audio_data,
@@ -82,6 +82,12 @@ public:
 		auto ptr = static_cast<const uint8_t*>(image_data_->data());
 		return boost::iterator_range<const uint8_t*>(ptr, ptr + image_data_->size());
 	}
+
+	std::shared_ptr<host_buffer> image_buffer()
+	{
+		image_data(); // Make sure it is mapped.
+		return image_data_;
+	}
 	const boost::iterator_range<const int32_t*> audio_data()
 	{
 		return boost::iterator_range<const int32_t*>(audio_data_.data(), audio_data_.data() + audio_data_.size());
@@ -89,7 +95,7 @@ public:
 };
 
 read_frame::read_frame(
-		const safe_ptr<ogl_device>& ogl,
+		const std::shared_ptr<ogl_device>& ogl,
 		size_t size,
 		safe_ptr<host_buffer>&& image_data,
 		audio_buffer&& audio_data,
@@ -104,6 +110,11 @@ const boost::iterator_range<const uint8_t*> read_frame::image_data()
 	return impl_ ? impl_->image_data() : boost::iterator_range<const uint8_t*>();
 }
 
+std::shared_ptr<host_buffer> read_frame::image_buffer()
+{
+	return impl_ ? impl_->image_buffer() : nullptr;
+}
+
 const boost::iterator_range<const int32_t*> read_frame::audio_data()
 {
 	return impl_ ? impl_->audio_data() : boost::iterator_range<const int32_t*>();
@@ -43,13 +43,16 @@ class read_frame : boost::noncopyable
 public:
 	read_frame();
 	read_frame(
-			const safe_ptr<ogl_device>& ogl,
+			const std::shared_ptr<ogl_device>& ogl, // nullptr when image_data is in system memory.
 			size_t size,
 			safe_ptr<host_buffer>&& image_data,
 			audio_buffer&& audio_data,
 			const channel_layout& audio_channel_layout);
 
 	virtual const boost::iterator_range<const uint8_t*> image_data();
+
+	// The mapped image buffer, shared read-only by frames which reference this frame instead of copying it.
+	virtual std::shared_ptr<host_buffer> image_buffer();
 	virtual const boost::iterator_range<const int32_t*> audio_data();
 
 	virtual size_t image_size() const;
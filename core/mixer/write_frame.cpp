@@ -22,6 +22,7 @@
 #include "../stdafx.h"
 
 #include "write_frame.h"
+#include "read_frame.h"
 
 #include "gpu/ogl_device.h"
 #include "gpu/host_buffer.h"
@@ -31,6 +32,8 @@
 #include <core/producer/frame/pixel_format.h>
 #include <core/mixer/audio/audio_util.h>
 
+#include <common/memory/memcpy.h>
+
 #include <boost/lexical_cast.hpp>
 #include <boost/timer.hpp>
 
@@ -43,6 +46,7 @@ struct write_frame::implementation
 	std::shared_ptr<ogl_device>					ogl_;
 	std::vector<std::shared_ptr<host_buffer>>	buffers_;
 	std::vector<safe_ptr<device_buffer>>		textures_;
+	std::shared_ptr<read_frame>					shared_image_;	// Owner of buffers_ when they are shared read-only.
 	audio_buffer								audio_data_;
 	const core::pixel_format_desc				desc_;
 	const channel_layout						channel_layout_;
@@ -76,6 +80,50 @@ struct write_frame::implementation
 
 		recorded_frame_age_ = -1;
 	}
+
+	implementation(const void* tag, const core::pixel_format_desc& desc, const channel_layout& channel_layout) 
+		: desc_(desc)
+		, channel_layout_(channel_layout)
+		, tag_(tag)
+		, mode_(core::field_mode::progressive)
+	{
+		std::transform(desc.planes.begin(), desc.planes.end(), std::back_inserter(buffers_), [&](const core::pixel_format_desc::plane& plane) -> std::shared_ptr<host_buffer>
+		{
+			return create_system_host_buffer(plane.size);
+		});
+
+		recorded_frame_age_ = -1;
+	}
+
+	implementation(const void* tag, const channel_layout& channel_layout, const implementation& image) 
+		: ogl_(image.ogl_)
+		, buffers_(image.buffers_)
+		, textures_(image.textures_)
+		, shared_image_(image.shared_image_)
+		, desc_(image.desc_)
+		, channel_layout_(channel_layout)
+		, tag_(tag)
+		, mode_(image.mode_)
+	{
+		recorded_frame_age_ = -1;
+	}
+
+	implementation(const std::shared_ptr<ogl_device>& ogl, const void* tag, const core::pixel_format_desc& desc, const safe_ptr<read_frame>& image) 
+		: ogl_(ogl)
+		, shared_image_(image)
+		, desc_(desc)
+		, channel_layout_(channel_layout::stereo())
+		, tag_(tag)
+		, mode_(core::field_mode::progressive)
+	{
+		CASPAR_VERIFY(desc.planes.size() == 1);
+
+		buffers_.push_back(image->image_buffer());
+		if(ogl_)
+			textures_.push_back(ogl_->create_device_buffer(desc.planes[0].width, desc.planes[0].height, desc.planes[0].channels));
+
+		recorded_frame_age_ = -1;
+	}
 			
 	void accept(write_frame& self, core::frame_visitor& visitor)
 	{
@@ -95,8 +143,12 @@ struct write_frame::implementation
 
 	boost::iterator_range<uint8_t*> image_data(size_t index)
 	{
-		if(index >= buffers_.size() || !buffers_[index]->data())
+		if(index >= buffers_.size() || !buffers_[index] || !buffers_[index]->data())
 			return boost::iterator_range<uint8_t*>();
+
+		if(shared_image_)
+			copy_on_write();
+
 		auto ptr = static_cast<uint8_t*>(buffers_[index]->data());
 		return boost::iterator_range<uint8_t*>(ptr, ptr+buffers_[index]->size());
 	}
@@ -109,7 +161,7 @@ struct write_frame::implementation
 
 	void commit(size_t plane_index)
 	{
-		if(plane_index >= buffers_.size())
+		if(!ogl_ || plane_index >= buffers_.size()) // System memory buffers are read directly by the cpu image mixer.
 			return;
 				
 		auto buffer = std::move(buffers_[plane_index]); // Release buffer once done.
@@ -118,6 +170,17 @@ struct write_frame::implementation
 			return;
 
 		auto texture = textures_.at(plane_index);
+
+		if(shared_image_)
+		{
+			// The buffer belongs to another frame and stays mapped, upload straight from its memory. The captured 
+			// buffer keeps it from being recycled until the upload has been issued.
+			ogl_->begin_invoke([=]
+			{			
+				texture->begin_read(buffer->data());
+			}, high_priority);
+			return;
+		}
 		
 		ogl_->begin_invoke([=]
 		{			
@@ -127,6 +190,21 @@ struct write_frame::implementation
 			buffer->unbind();
 		}, high_priority);
 	}
+
+	void copy_on_write()
+	{
+		for(size_t n = 0; n < buffers_.size(); ++n)
+		{
+			if(!buffers_[n])
+				continue;
+
+			auto size	= desc_.planes.at(n).size;
+			auto buffer = ogl_ ? std::shared_ptr<host_buffer>(ogl_->create_host_buffer(size, host_buffer::write_only)) : std::shared_ptr<host_buffer>(create_system_host_buffer(size));
+			fast_memcpy(buffer->data(), buffers_[n]->data(), size);
+			buffers_[n] = buffer;
+		}
+		shared_image_.reset();
+	}
 };
 	
 write_frame::write_frame(const void* tag, const channel_layout& channel_layout)
@@ -141,6 +219,28 @@ write_frame::write_frame(
 	: impl_(new implementation(ogl, tag, desc, channel_layout))
 {
 }
+write_frame::write_frame(
+		const void* tag,
+		const core::pixel_format_desc& desc,
+		const channel_layout& channel_layout)
+	: impl_(new implementation(tag, desc, channel_layout))
+{
+}
+write_frame::write_frame(
+		const void* tag,
+		const channel_layout& channel_layout,
+		const write_frame& image)
+	: impl_(new implementation(tag, channel_layout, *image.impl_))
+{
+}
+write_frame::write_frame(
+		const std::shared_ptr<ogl_device>& ogl,
+		const void* tag,
+		const core::pixel_format_desc& desc,
+		const safe_ptr<read_frame>& image)
+	: impl_(new implementation(ogl, tag, desc, image))
+{
+}
 write_frame::write_frame(const write_frame& other) : impl_(new implementation(*other.impl_)){}
 write_frame::write_frame(write_frame&& other) : impl_(std::move(other.impl_)){}
 write_frame& write_frame::operator=(const write_frame& other)
@@ -167,6 +267,7 @@ multichannel_view<int32_t, audio_buffer::iterator> write_frame::get_multichannel
 	return make_multichannel_view<int32_t>(impl_->audio_data_.begin(), impl_->audio_data_.end(), impl_->channel_layout_);
 }
 const std::vector<safe_ptr<device_buffer>>& write_frame::get_textures() const{return impl_->textures_;}
+const std::vector<std::shared_ptr<host_buffer>>& write_frame::get_system_buffers() const{return impl_->buffers_;}
 void write_frame::commit(size_t plane_index){impl_->commit(plane_index);}
 void write_frame::commit(){impl_->commit();}
 void write_frame::set_type(const field_mode::type& mode){impl_->mode_ = mode;}
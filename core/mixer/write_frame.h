@@ -37,6 +37,8 @@
 namespace caspar { namespace core {
 
 class device_buffer;
+class host_buffer;
+class read_frame;
 struct frame_visitor;
 struct pixel_format_desc;
 class ogl_device;	
@@ -46,6 +48,9 @@ class write_frame : public core::basic_frame, boost::noncopyable
 public:	
 	explicit write_frame(const void* tag, const channel_layout& channel_layout);
 	explicit write_frame(const safe_ptr<ogl_device>& ogl, const void* tag, const core::pixel_format_desc& desc, const channel_layout& channel_layout);
+	explicit write_frame(const void* tag, const core::pixel_format_desc& desc, const channel_layout& channel_layout); // System memory frame, used by the cpu image mixer.
+	write_frame(const void* tag, const channel_layout& channel_layout, const write_frame& image); // Shares the uncommitted image planes of another frame, e.g. one a decoder rendered into.
+	write_frame(const std::shared_ptr<ogl_device>& ogl, const void* tag, const core::pixel_format_desc& desc, const safe_ptr<read_frame>& image); // References the image of a read_frame read-only, image_data() copies on write.
 
 	write_frame(const write_frame& other);
 	write_frame(write_frame&& other);
@@ -80,6 +85,7 @@ private:
 	friend class image_mixer;
 	
 	const std::vector<safe_ptr<device_buffer>>& get_textures() const;
+	const std::vector<std::shared_ptr<host_buffer>>& get_system_buffers() const;
 
 	struct implementation;
 	safe_ptr<implementation> impl_;
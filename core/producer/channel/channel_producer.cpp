@@ -189,15 +189,20 @@ public:
 
 		desc.pix_fmt = core::pixel_format::bgra;
 		desc.planes.push_back(core::pixel_format_desc::plane(format_desc.width, format_desc.height, 4));
-		auto frame = frame_factory_->create_frame(this, desc);
 
-		fast_memcpy(frame->image_data().begin(), read_frame->image_data().begin(), read_frame->image_data().size());
+		// Reference the image of the source channel when the frame factory can, it is never written to.
+		std::shared_ptr<write_frame> frame = frame_factory_->create_shared_frame(this, desc, make_safe_ptr(read_frame));
+		if(!frame)
+		{
+			frame = frame_factory_->create_frame(this, desc);
+			fast_memcpy(frame->image_data().begin(), read_frame->image_data().begin(), std::min(read_frame->image_data().size(), frame->image_data().size()));
+		}
 		frame->commit();
 
-		frame_buffer_.push(frame);	
+		frame_buffer_.push(make_safe_ptr(frame));	
 		
 		if(double_speed)	
-			frame_buffer_.push(frame);
+			frame_buffer_.push(make_safe_ptr(frame));
 
 		return receive(0);
 	}	
@@ -0,0 +1,451 @@
+/*
+* Copyright 2013 Sveriges Television AB http://casparcg.com/
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+
+#include "../../stdafx.h"
+
+#include "tween_engine.h"
+
+#include <common/utility/tweener.h>
+
+#include <boost/algorithm/string/case_conv.hpp>
+#include <boost/foreach.hpp>
+
+#include <emmintrin.h>
+
+#include <algorithm>
+#include <map>
+
+namespace caspar { namespace core {
+
+enum 
+{ 
+	value_count = 18,	// Tweened doubles in frame_transform.
+	max_fields	= 2
+};
+
+static void get_values(const frame_transform& transform, double* values)
+{
+	*values++ = transform.volume;
+	*values++ = transform.opacity;
+	*values++ = transform.contrast;
+	*values++ = transform.brightness;
+	*values++ = transform.saturation;
+	*values++ = transform.fill_translation[0];
+	*values++ = transform.fill_translation[1];
+	*values++ = transform.fill_scale[0];
+	*values++ = transform.fill_scale[1];
+	*values++ = transform.clip_translation[0];
+	*values++ = transform.clip_translation[1];
+	*values++ = transform.clip_scale[0];
+	*values++ = transform.clip_scale[1];
+	*values++ = transform.levels.min_input;
+	*values++ = transform.levels.max_input;
+	*values++ = transform.levels.gamma;
+	*values++ = transform.levels.min_output;
+	*values++ = transform.levels.max_output;
+}
+
+static void set_values(const double* values, frame_transform& transform)
+{
+	transform.volume				= *values++;
+	transform.opacity				= *values++;
+	transform.contrast				= *values++;
+	transform.brightness			= *values++;
+	transform.saturation			= *values++;
+	transform.fill_translation[0]	= *values++;
+	transform.fill_translation[1]	= *values++;
+	transform.fill_scale[0]			= *values++;
+	transform.fill_scale[1]			= *values++;
+	transform.clip_translation[0]	= *values++;
+	transform.clip_translation[1]	= *values++;
+	transform.clip_scale[0]			= *values++;
+	transform.clip_scale[1]			= *values++;
+	transform.levels.min_input		= *values++;
+	transform.levels.max_input		= *values++;
+	transform.levels.gamma			= *values++;
+	transform.levels.min_output		= *values++;
+	transform.levels.max_output		= *values++;
+}
+
+// The easing equations are linear in the start and change values, i.e. b + c*f(t, 0, 1, d), so
+// the eased progress only needs to be computed once per track. The exception is elastic with an 
+// explicit amplitude, which depends on the change and is evaluated per value.
+static bool is_separable(std::wstring tween)
+{
+	boost::to_lower(tween);
+	return tween.find(L"elastic") == std::wstring::npos || std::count(tween.begin(), tween.end(), L':') < 2;
+}
+
+static void interpolate(const double* source, const double* delta, const double* progress, double* dest, size_t count)
+{
+	size_t n = 0;
+	for(; n + 2 <= count; n += 2)
+		_mm_storeu_pd(dest + n, _mm_add_pd(_mm_loadu_pd(source + n), _mm_mul_pd(_mm_loadu_pd(delta + n), _mm_loadu_pd(progress + n))));
+	for(; n < count; ++n)
+		dest[n] = source[n] + delta[n]*progress[n];
+}
+
+template<typename T>
+static void swap_remove(std::vector<T>& container, size_t n)
+{
+	std::swap(container[n], container.back());
+	container.pop_back();
+}
+
+struct tween_segment
+{
+	frame_transform	dest;
+	int				duration;
+	tweener_t		tweener;
+	bool			separable;
+};
+
+struct tween_engine::implementation : boost::noncopyable
+{
+	std::map<int, size_t>				slots_;		// layer -> slot
+	std::vector<int>					indices_;	// slot -> layer
+
+	// Per track.
+	std::vector<std::vector<tween_segment>>	segments_;
+	std::vector<frame_transform>		sources_;
+	std::vector<frame_transform>		bases_;		// Untweened members of the active segment.
+
+	// Active segments, structure of arrays.
+	std::vector<size_t>					segment_;	// == segments_[slot].size() once the track has ended.
+	std::vector<int>					time_;
+	std::vector<int>					duration_;
+	std::vector<double>					progress_;
+	std::vector<double>					source_[value_count];
+	std::vector<double>					delta_[value_count];
+	std::vector<double>					values_[value_count];
+
+	std::vector<frame_transform>		results_[max_fields];
+	int									num_fields_;
+
+	implementation()
+		: num_fields_(1)
+	{
+	}
+
+	void set(int index, const frame_transform& source, const std::vector<transform_keyframe>& keyframes)
+	{
+		auto slot = get_slot(index);
+
+		auto& segments = segments_[slot];
+		segments.clear();
+		BOOST_FOREACH(auto& keyframe, keyframes)
+			segments.push_back(create_segment(keyframe));
+
+		sources_[slot]	= source;
+		segment_[slot]	= 0;
+		time_[slot]		= 0;
+
+		if(segments.empty())
+			end_track(slot);
+		else
+			load_segment(slot);
+
+		advance(slot, 0);
+
+		auto current = evaluate(slot);
+		for(int n = 0; n < max_fields; ++n)
+			results_[n][slot] = current;
+	}
+
+	void append(int index, const transform_keyframe& keyframe)
+	{
+		auto slot = get_slot(index);
+
+		if(!is_active(slot))
+		{
+			frame_transform source = results_[num_fields_-1][slot];
+			set(index, source, std::vector<transform_keyframe>(1, keyframe));
+			return;
+		}
+
+		segments_[slot].push_back(create_segment(keyframe)); // Loaded once the segments before it have ended.
+	}
+
+	void clear(int index)
+	{
+		auto it = slots_.find(index);
+		if(it == slots_.end())
+			return;
+
+		auto slot = it->second;
+		slots_.erase(it);
+
+		if(slot != indices_.size()-1)
+			slots_[indices_.back()] = slot;
+
+		swap_remove(indices_, slot);
+		swap_remove(segments_, slot);
+		swap_remove(sources_, slot);
+		swap_remove(bases_, slot);
+		swap_remove(segment_, slot);
+		swap_remove(time_, slot);
+		swap_remove(duration_, slot);
+		swap_remove(progress_, slot);
+		for(int k = 0; k < value_count; ++k)
+		{
+			swap_remove(source_[k], slot);
+			swap_remove(delta_[k], slot);
+			swap_remove(values_[k], slot);
+		}
+		for(int n = 0; n < max_fields; ++n)
+			swap_remove(results_[n], slot);
+	}
+
+	void clear()
+	{
+		slots_.clear();
+		indices_.clear();
+		segments_.clear();
+		sources_.clear();
+		bases_.clear();
+		segment_.clear();
+		time_.clear();
+		duration_.clear();
+		progress_.clear();
+		for(int k = 0; k < value_count; ++k)
+		{
+			source_[k].clear();
+			delta_[k].clear();
+			values_[k].clear();
+		}
+		for(int n = 0; n < max_fields; ++n)
+			results_[n].clear();
+	}
+
+	void tick(int num_fields, const std::vector<int>& running)
+	{
+		num_fields_ = std::max(1, std::min<int>(num_fields, max_fields));
+
+		auto count = indices_.size();
+
+		for(int field = 0; field < num_fields_; ++field)
+		{
+			for(size_t slot = 0; slot < count; ++slot)
+			{
+				if(std::binary_search(running.begin(), running.end(), indices_[slot]))
+					advance(slot, 1);
+				progress_[slot] = is_active(slot) ? segments_[slot][segment_[slot]].tweener(time_[slot], 0.0, 1.0, duration_[slot]) : 0.0;
+			}
+
+			for(int k = 0; k < value_count; ++k)
+				interpolate(source_[k].data(), delta_[k].data(), progress_.data(), values_[k].data(), count);
+
+			auto& results = results_[field];
+			for(size_t slot = 0; slot < count; ++slot)
+			{
+				if(is_active(slot) && !segments_[slot][segment_[slot]].separable)
+				{
+					results[slot] = evaluate(slot);
+					continue;
+				}
+
+				double values[value_count];
+				for(int k = 0; k < value_count; ++k)
+					values[k] = values_[k][slot];
+
+				results[slot] = bases_[slot];
+				set_values(values, results[slot]);
+			}
+		}
+	}
+
+	const frame_transform& fetch(int index, int field) const
+	{
+		static const frame_transform identity;
+
+		auto it = slots_.find(index);
+		if(it == slots_.end())
+			return identity;
+
+		return results_[std::max(0, std::min(field, num_fields_-1))][it->second];
+	}
+
+	const frame_transform& dest(int index) const
+	{
+		static const frame_transform identity;
+
+		auto it = slots_.find(index);
+		if(it == slots_.end())
+			return identity;
+
+		auto& segments = segments_[it->second];
+		return segments.empty() ? sources_[it->second] : segments.back().dest;
+	}
+
+	int size() const
+	{
+		return static_cast<int>(indices_.size());
+	}
+
+private:
+	static tween_segment create_segment(const transform_keyframe& keyframe)
+	{
+		tween_segment segment;
+		segment.dest		= keyframe.transform;
+		segment.duration	= std::max(0, keyframe.duration);
+		segment.tweener		= get_tweener(keyframe.tween);
+		segment.separable	= is_separable(keyframe.tween);
+		return segment;
+	}
+
+	size_t get_slot(int index)
+	{
+		auto it = slots_.find(index);
+		if(it != slots_.end())
+			return it->second;
+
+		auto slot = indices_.size();
+		slots_[index] = slot;
+
+		indices_.push_back(index);
+		segments_.push_back(std::vector<tween_segment>());
+		sources_.push_back(frame_transform());
+		bases_.push_back(frame_transform());
+		segment_.push_back(0);
+		time_.push_back(0);
+		duration_.push_back(0);
+		progress_.push_back(0.0);
+		for(int k = 0; k < value_count; ++k)
+		{
+			source_[k].push_back(0.0);
+			delta_[k].push_back(0.0);
+			values_[k].push_back(0.0);
+		}
+		for(int n = 0; n < max_fields; ++n)
+			results_[n].push_back(frame_transform());
+
+		return slot;
+	}
+
+	bool is_active(size_t slot) const
+	{
+		return segment_[slot] < segments_[slot].size();
+	}
+
+	void advance(size_t slot, int ticks)
+	{
+		if(!is_active(slot))
+			return;
+
+		time_[slot] += ticks;
+		while(is_active(slot) && time_[slot] >= duration_[slot])
+		{
+			time_[slot] -= duration_[slot];
+			if(++segment_[slot] < segments_[slot].size())
+				load_segment(slot);
+			else
+				end_track(slot);
+		}
+	}
+
+	void load_segment(size_t slot)
+	{
+		auto& segments	= segments_[slot];
+		auto& segment	= segments[segment_[slot]];
+		auto& from		= segment_[slot] == 0 ? sources_[slot] : segments[segment_[slot]-1].dest;
+		
+		double source[value_count];
+		double dest[value_count];
+		get_values(from, source);
+		get_values(segment.dest, dest);
+
+		for(int k = 0; k < value_count; ++k)
+		{
+			source_[k][slot]	= source[k];
+			delta_[k][slot]		= dest[k] - source[k];
+		}
+
+		auto& base		= bases_[slot];
+		base			= from;
+		base.field_mode	= static_cast<field_mode::type>(from.field_mode & segment.dest.field_mode);
+		base.is_key		= from.is_key | segment.dest.is_key;
+		base.is_mix		= from.is_mix | segment.dest.is_mix;
+
+		duration_[slot]	= segment.duration;
+	}
+
+	void end_track(size_t slot)
+	{
+		auto& segments	= segments_[slot];
+		auto& dest		= segments.empty() ? sources_[slot] : segments.back().dest;
+
+		double values[value_count];
+		get_values(dest, values);
+
+		for(int k = 0; k < value_count; ++k)
+		{
+			source_[k][slot]	= values[k];
+			delta_[k][slot]		= 0.0;
+		}
+
+		bases_[slot]	= dest;
+		segment_[slot]	= segments.size();
+		time_[slot]		= 0;
+		duration_[slot]	= 0;
+	}
+
+	frame_transform evaluate(size_t slot) const
+	{
+		double values[value_count];
+		for(int k = 0; k < value_count; ++k)
+			values[k] = source_[k][slot];
+
+		if(is_active(slot))
+		{
+			auto& segment = segments_[slot][segment_[slot]];
+			if(segment.separable)
+			{
+				auto progress = segment.tweener(time_[slot], 0.0, 1.0, duration_[slot]);
+				for(int k = 0; k < value_count; ++k)
+					values[k] += delta_[k][slot]*progress;
+			}
+			else
+			{
+				for(int k = 0; k < value_count; ++k)
+					values[k] = segment.tweener(time_[slot], source_[k][slot], delta_[k][slot], duration_[slot]);
+			}
+		}
+
+		auto result = bases_[slot];
+		set_values(values, result);
+		return result;
+	}
+};
+
+tween_engine::tween_engine() : impl_(new implementation()){}
+void tween_engine::set(int index, const frame_transform& source, const frame_transform& dest, int duration, const std::wstring& tween){impl_->set(index, source, std::vector<transform_keyframe>(1, transform_keyframe(dest, duration, tween)));}
+void tween_engine::set(int index, const frame_transform& source, const std::vector<transform_keyframe>& keyframes){impl_->set(index, source, keyframes);}
+void tween_engine::append(int index, const transform_keyframe& keyframe){impl_->append(index, keyframe);}
+void tween_engine::clear(int index){impl_->clear(index);}
+void tween_engine::clear(){impl_->clear();}
+void tween_engine::tick(int num_fields, const std::vector<int>& running){impl_->tick(num_fields, running);}
+const frame_transform& tween_engine::fetch(int index, int field) const{return impl_->fetch(index, field);}
+const frame_transform& tween_engine::current(int index) const{return impl_->fetch(index, max_fields);}
+const frame_transform& tween_engine::dest(int index) const{return impl_->dest(index);}
+int tween_engine::size() const{return impl_->size();}
+
+}}
@@ -0,0 +1,83 @@
+/*
+* Copyright 2013 Sveriges Television AB http://casparcg.com/
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+
+#pragma once
+
+#include "frame_transform.h"
+
+#include <common/memory/safe_ptr.h>
+
+#include <boost/noncopyable.hpp>
+
+#include <string>
+#include <vector>
+
+namespace caspar { namespace core {
+
+struct transform_keyframe
+{
+	frame_transform	transform;
+	int				duration;	// Ticks from the previous keyframe.
+	std::wstring	tween;		// Any name accepted by get_tweener, e.g. "easeinsine" or "cubicbezier:0.25:0.1:0.25:1".
+
+	transform_keyframe(const frame_transform& transform = frame_transform(), int duration = 0, const std::wstring& tween = L"linear")
+		: transform(transform)
+		, duration(duration)
+		, tween(tween)
+	{
+	}
+};
+
+// Evaluates the transform tweens of all layers of a channel. Every layer has a track of keyframes,
+// the active segment of each track is stored as structure of arrays so that all tweened values of
+// all tracks are interpolated in one vectorized pass. Easing functions are resolved when a track is
+// set, ticking does not allocate. Not thread-safe, fetch may be called concurrently between ticks.
+class tween_engine : boost::noncopyable
+{
+public:
+	tween_engine();
+
+	// Replaces the track of the layer, starting at source.
+	void set(int index, const frame_transform& source, const frame_transform& dest, int duration, const std::wstring& tween = L"linear");
+	void set(int index, const frame_transform& source, const std::vector<transform_keyframe>& keyframes);
+
+	// Adds a keyframe to the end of the track of the layer, or starts a new track at the current transform if it has ended.
+	void append(int index, const transform_keyframe& keyframe);
+
+	void clear(int index);
+	void clear();
+
+	// Advances the tracks of the running layers, sorted in ascending order, num_fields ticks. The tracks of other layers 
+	// hold until their layer runs again. The transform of each tick can be fetched until the next tick.
+	void tick(int num_fields, const std::vector<int>& running);
+
+	const frame_transform& fetch(int index, int field = 0) const;
+	const frame_transform& current(int index) const;	// Transform at the current time.
+	const frame_transform& dest(int index) const;		// Transform at the end of the track.
+
+	int size() const;
+private:
+	struct implementation;
+	safe_ptr<implementation> impl_;
+};
+
+}}
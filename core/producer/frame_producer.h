@@ -55,7 +55,8 @@ public:
 	{
 		NO_HINT = 0,
 		ALPHA_HINT = 1,
-		DEINTERLACE_HINT
+		DEINTERLACE_HINT = 2,
+		OFFLINE_HINT = 4	// The channel has no deadline, wait for the next frame rather than returning late.
 	};
 
 	virtual ~frame_producer(){}	
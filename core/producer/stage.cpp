@@ -27,8 +27,9 @@
 
 #include "frame/basic_frame.h"
 #include "frame/frame_factory.h"
+#include "frame/tween_engine.h"
 
-#include <common/concurrency/executor.h>
+#include <common/concurrency/ring_executor.h>
 
 #include <core/producer/frame/frame_transform.h>
 #include <core/consumer/frame_consumer.h>
@@ -38,7 +39,6 @@
 #include <boost/timer.hpp>
 
 #include <tbb/parallel_for_each.h>
-#include <tbb/concurrent_unordered_map.h>
 
 #include <boost/property_tree/ptree.hpp>
 
@@ -46,48 +46,6 @@
 
 namespace caspar { namespace core {
 
-template<typename T>
-class tweened_transform
-{
-	T source_;
-	T dest_;
-	int duration_;
-	int time_;
-	tweener_t tweener_;
-public:	
-	tweened_transform()
-		: duration_(0)
-		, time_(0)
-		, tweener_(get_tweener(L"linear")){}
-	tweened_transform(const T& source, const T& dest, int duration, const std::wstring& tween = L"linear")
-		: source_(source)
-		, dest_(dest)
-		, duration_(duration)
-		, time_(0)
-		, tweener_(get_tweener(tween)){}
-	
-	const T& source() const
-	{
-		return source_;
-	}
-	
-	const T& dest() const
-	{
-		return dest_;
-	}
-
-	T fetch()
-	{
-		return time_ == duration_ ? dest_ : tween(static_cast<double>(time_), source_, dest_, static_cast<double>(duration_), tweener_);
-	}
-
-	T fetch_and_tick(int num)
-	{						
-		time_ = std::min(time_+num, duration_);
-		return fetch();
-	}
-};
-
 struct stage::implementation : public std::enable_shared_from_this<implementation>
 							 , boost::noncopyable
 {		
@@ -99,19 +57,27 @@ struct stage::implementation : public std::enable_shared_from_this<implementatio
 	boost::timer																 tick_timer_;
 																				 
 	std::map<int, std::shared_ptr<layer>>										 layers_;	
-	tbb::concurrent_unordered_map<int, tweened_transform<core::frame_transform>> transforms_;	
+	tween_engine																 tweens_;	
+	std::vector<int>															 running_layers_;	// Layers whose transforms are tweened this tick.
 	// map of layer -> map of tokens (src ref) -> layer_consumer
 	std::map<int, std::map<void*, std::shared_ptr<write_frame_consumer>>>		 layer_consumers_;
+
+	bool																		 offline_;
+	int64_t																		 frame_budget_;
+	int																			 held_tokens_;
 	
 	monitor::subject															 monitor_subject_;
 
-	executor																	 executor_;
+	ring_executor																 executor_;
 
 public:
 	implementation(const safe_ptr<diagnostics::graph>& graph, const safe_ptr<stage::target_t>& target, const video_format_desc& format_desc)  
 		: graph_(graph)
 		, format_desc_(format_desc)
 		, target_(target)
+		, offline_(false)
+		, frame_budget_(-1)
+		, held_tokens_(0)
 		, monitor_subject_("/stage")
 		, executor_(L"stage")
 	{
@@ -122,12 +88,45 @@ public:
 	void spawn_token()
 	{
 		std::weak_ptr<implementation> self = shared_from_this();
-		executor_.begin_invoke([=]{tick(self);});
+		executor_.post([=]{tick(self);});
+	}
+
+	void set_offline(bool offline)
+	{
+		executor_.post([=]
+		{
+			offline_ = offline;
+			release_held_tokens();
+		}, high_priority);
+	}
+
+	void set_frame_budget(int64_t count)
+	{
+		executor_.post([=]
+		{
+			frame_budget_ = count;
+			release_held_tokens();
+		}, high_priority);
+	}
+
+	bool is_held() const
+	{
+		return offline_ && frame_budget_ == 0;
+	}
+
+	void release_held_tokens()
+	{
+		if(is_held())
+			return;
+
+		std::weak_ptr<implementation> self = shared_from_this();
+		for(; held_tokens_ > 0; --held_tokens_)
+			executor_.post([=]{tick(self);});
 	}
 	
 	void add_layer_consumer(void* token, int layer, const std::shared_ptr<write_frame_consumer>& layer_consumer)
 	{
-		executor_.begin_invoke([=]
+		executor_.post([=]
 		{
 			layer_consumers_[layer][token] = layer_consumer;
 		}, high_priority);
@@ -135,7 +134,7 @@ public:
 
 	void remove_layer_consumer(void* token, int layer)
 	{
-		executor_.begin_invoke([=]
+		executor_.post([=]
 		{
 			auto& layer_map = layer_consumers_[layer];
 			layer_map.erase(token);
@@ -148,18 +147,34 @@ public:
 
 	void tick(const std::weak_ptr<implementation>& self)
 	{		
+		if(is_held())
+		{
+			++held_tokens_; // Until the budget is raised.
+			return;
+		}
+
+		if(offline_ && frame_budget_ > 0)
+			--frame_budget_;
+
 		try
 		{
 			produce_timer_.restart();
 
 			std::map<int, safe_ptr<basic_frame>> frames;
 		
+			running_layers_.clear();
 			for(auto it = layers_.begin(); it != layers_.end(); ++it)
+			{
 				frames[it->first] = basic_frame::empty();	
+				running_layers_.push_back(it->first);
+			}
+
+			// The transforms of layers that haven't been loaded hold until they are.
+			tweens_.tick(format_desc_.field_mode != field_mode::progressive ? 2 : 1, running_layers_);
 
 			tbb::parallel_for_each(layers_.begin(), layers_.end(), [&](std::map<int, std::shared_ptr<layer>>::value_type& layer) 
 			{
-				auto transform = transforms_[layer.first].fetch_and_tick(1);
+				auto& transform = tweens_.fetch(layer.first, 0);
 
 				int hints = frame_producer::NO_HINT;
 				if(format_desc_.field_mode != field_mode::progressive)
@@ -171,6 +186,9 @@ public:
 				if(transform.is_key)
 					hints |= frame_producer::ALPHA_HINT;
 
+				if(offline_)
+					hints |= frame_producer::OFFLINE_HINT;
+
 				auto frame = layer.second->receive(hints);	
 				auto layer_consumers_it = layer_consumers_.find(layer.first);
 				if (layer_consumers_it != layer_consumers_.end())
@@ -188,7 +206,7 @@ public:
 				if(format_desc_.field_mode != core::field_mode::progressive)
 				{				
 					auto frame2 = make_safe<core::basic_frame>(frame);
-					frame2->get_frame_transform() = transforms_[layer.first].fetch_and_tick(1);
+					frame2->get_frame_transform() = tweens_.fetch(layer.first, 1);
 					frame1 = core::basic_frame::interlace(frame1, frame2, format_desc_.field_mode);
 				}
 
@@ -201,7 +219,7 @@ public:
 			{
 				auto self2 = self.lock();
 				if(self2)				
-					self2->executor_.begin_invoke([=]{tick(self);});				
+					self2->executor_.post([=]{tick(self);});				
 			});
 
 			target_->send(std::make_pair(frames, ticket));
@@ -218,51 +236,62 @@ public:
 		
 	void set_transform(int index, const frame_transform& transform, unsigned int mix_duration, const std::wstring& tween)
 	{
-		executor_.begin_invoke([=]
+		executor_.post([=]
 		{
-			auto src = transforms_[index].fetch();
-			auto dst = transform;
-			transforms_[index] = tweened_transform<frame_transform>(src, dst, mix_duration, tween);
+			tweens_.set(index, tweens_.current(index), transform, mix_duration, tween);
 		}, high_priority);
 	}
 					
 	void apply_transforms(const std::vector<std::tuple<int, stage::transform_func_t, unsigned int, std::wstring>>& transforms)
 	{
-		executor_.begin_invoke([=]
+		executor_.post([=]
 		{
 			BOOST_FOREACH(auto& transform, transforms)
 			{
-				auto& tween = transforms_[std::get<0>(transform)];
-				auto src = tween.fetch();
-				auto dst = std::get<1>(transform)(tween.dest());
-				transforms_[std::get<0>(transform)] = tweened_transform<frame_transform>(src, dst, std::get<2>(transform), std::get<3>(transform));
+				auto index	= std::get<0>(transform);
+				auto src	= tweens_.current(index);
+				auto dst	= std::get<1>(transform)(tweens_.dest(index));
+				tweens_.set(index, src, dst, std::get<2>(transform), std::get<3>(transform));
 			}
 		}, high_priority);
 	}
 						
 	void apply_transform(int index, const stage::transform_func_t& transform, unsigned int mix_duration, const std::wstring& tween)
 	{
-		executor_.begin_invoke([=]
+		executor_.post([=]
 		{
-			auto src = transforms_[index].fetch();
+			auto src = tweens_.current(index);
 			auto dst = transform(src);
-			transforms_[index] = tweened_transform<frame_transform>(src, dst, mix_duration, tween);
+			tweens_.set(index, src, dst, mix_duration, tween);
+		}, high_priority);
+	}
+
+	void append_transforms(const std::vector<std::tuple<int, stage::transform_func_t, unsigned int, std::wstring>>& transforms)
+	{
+		executor_.post([=]
+		{
+			BOOST_FOREACH(auto& transform, transforms)
+			{
+				auto index	= std::get<0>(transform);
+				auto dst	= std::get<1>(transform)(tweens_.dest(index));
+				tweens_.append(index, transform_keyframe(dst, std::get<2>(transform), std::get<3>(transform)));
+			}
 		}, high_priority);
 	}
 
 	void clear_transforms(int index)
 	{
-		executor_.begin_invoke([=]
+		executor_.post([=]
 		{
-			transforms_[index] = tweened_transform<core::frame_transform>();
+			tweens_.clear(index);
 		}, high_priority);
 	}
 
 	void clear_transforms()
 	{
-		executor_.begin_invoke([=]
+		executor_.post([=]
 		{
-			transforms_.clear();
+			tweens_.clear();
 		}, high_priority);
 	}
 
@@ -270,7 +299,7 @@ public:
 	{
 		return executor_.invoke([=]
 		{
-			return transforms_[index].fetch();
+			return tweens_.current(index);
 		});
 	}
 		
@@ -287,7 +316,7 @@ public:
 
 	void load(int index, const safe_ptr<frame_producer>& producer, bool preview, int auto_play_delta)
 	{
-		executor_.begin_invoke([=]
+		executor_.post([=]
 		{
 			get_layer(index).load(producer, preview, auto_play_delta);
 		}, high_priority);
@@ -295,7 +324,7 @@ public:
 
 	void pause(int index)
 	{		
-		executor_.begin_invoke([=]
+		executor_.post([=]
 		{
 			get_layer(index).pause();
 		}, high_priority);
@@ -303,7 +332,7 @@ public:
 
 	void play(int index)
 	{		
-		executor_.begin_invoke([=]
+		executor_.post([=]
 		{
 			get_layer(index).play();
 		}, high_priority);
@@ -311,7 +340,7 @@ public:
 
 	void stop(int index)
 	{		
-		executor_.begin_invoke([=]
+		executor_.post([=]
 		{
 			get_layer(index).stop();
 		}, high_priority);
@@ -319,7 +348,7 @@ public:
 
 	void clear(int index)
 	{
-		executor_.begin_invoke([=]
+		executor_.post([=]
 		{
 			layers_.erase(index);
 		}, high_priority);
@@ -327,7 +356,7 @@ public:
 		
 	void clear()
 	{
-		executor_.begin_invoke([=]
+		executor_.post([=]
 		{
 			layers_.clear();
 		}, high_priority);
@@ -368,7 +397,7 @@ public:
 				layer->monitor_output().link_target(&monitor_subject_);
 		};		
 
-		executor_.begin_invoke([=]
+		executor_.post([=]
 		{
 			other_impl->executor_.invoke(func, task_priority::high_priority);
 		}, task_priority::high_priority);
@@ -376,7 +405,7 @@ public:
 
 	void swap_layer(int index, int other_index)
 	{
-		executor_.begin_invoke([=]
+		executor_.post([=]
 		{
 			std::swap(get_layer(index), get_layer(other_index));
 		}, task_priority::high_priority);
@@ -404,7 +433,7 @@ public:
 				other_layer.monitor_output().link_target(&other_impl->monitor_subject_);
 			};		
 
-			executor_.begin_invoke([=]
+			executor_.post([=]
 			{
 				other_impl->executor_.invoke(func, task_priority::high_priority);
 			}, task_priority::high_priority);
@@ -429,7 +458,7 @@ public:
 	
 	void set_video_format_desc(const video_format_desc& format_desc)
 	{
-		executor_.begin_invoke([=]
+		executor_.post([=]
 		{
 			format_desc_ = format_desc;
 		}, high_priority);
@@ -480,10 +509,13 @@ stage::stage(const safe_ptr<diagnostics::graph>& graph, const safe_ptr<target_t>
 	: impl_(new implementation(graph, target, format_desc)){}
 void stage::apply_transforms(const std::vector<stage::transform_tuple_t>& transforms){impl_->apply_transforms(transforms);}
 void stage::apply_transform(int index, const std::function<core::frame_transform(core::frame_transform)>& transform, unsigned int mix_duration, const std::wstring& tween){impl_->apply_transform(index, transform, mix_duration, tween);}
+void stage::append_transforms(const std::vector<stage::transform_tuple_t>& transforms){impl_->append_transforms(transforms);}
 void stage::clear_transforms(int index){impl_->clear_transforms(index);}
 void stage::clear_transforms(){impl_->clear_transforms();}
 frame_transform stage::get_current_transform(int index) { return impl_->get_current_transform(index); }
 void stage::spawn_token(){impl_->spawn_token();}
+void stage::set_offline(bool offline){impl_->set_offline(offline);}
+void stage::set_frame_budget(int64_t count){impl_->set_frame_budget(count);}
 void stage::load(int index, const safe_ptr<frame_producer>& producer, bool preview, int auto_play_delta){impl_->load(index, producer, preview, auto_play_delta);}
 void stage::pause(int index){impl_->pause(index);}
 void stage::play(int index){impl_->play(index);}
@@ -34,6 +34,7 @@
 #include <boost/thread/future.hpp>
 
 #include <functional>
+#include <vector>
 
 namespace caspar { namespace core {
 
@@ -59,11 +60,18 @@ public:
 	
 	void apply_transforms(const std::vector<transform_tuple_t>& transforms);
 	void apply_transform(int index, const transform_func_t& transform, unsigned int mix_duration = 0, const std::wstring& tween = L"linear");
+	void append_transforms(const std::vector<transform_tuple_t>& transforms); // As keyframes after the end of the current tweens.
 	void clear_transforms(int index);
 	void clear_transforms();
 	frame_transform get_current_transform(int index);
 
 	void spawn_token();
+
+	// Offline producers are hinted to wait for late frames. An offline stage renders count more frames
+	// and then holds until the next call, commands sent while it is held take effect from the next
+	// frame. A negative count never holds.
+	void set_offline(bool offline);
+	void set_frame_budget(int64_t count);
 			
 	void load(int index, const safe_ptr<frame_producer>& producer, bool preview = false, int auto_play_delta = -1);
 	void pause(int index);
@@ -23,19 +23,29 @@
 
 #include "thumbnail_generator.h"
 
+#include <algorithm>
+#include <deque>
 #include <iostream>
 #include <iterator>
+#include <map>
 #include <set>
+#include <vector>
 
 #include <boost/thread.hpp>
+#include <boost/foreach.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/property_tree/ptree.hpp>
 #include <boost/range/algorithm/transform.hpp>
 #include <boost/algorithm/string/predicate.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
 
 #include <tbb/atomic.h>
 
 #include "producer/frame_producer.h"
 #include "consumer/frame_consumer.h"
 #include "mixer/mixer.h"
+#include "mixer/read_frame.h"
+#include "mixer/gpu/host_buffer.h"
 #include "mixer/audio/audio_util.h"
 #include "video_format.h"
 #include "producer/frame/basic_frame.h"
@@ -67,6 +77,47 @@ std::wstring get_relative_without_extension(
 	return result;
 }
 
+// Box filter, every destination pixel is the average of the source pixels it covers.
+void scale_bgra(const uint8_t* source, int source_width, int source_height, uint8_t* dest, int dest_width, int dest_height)
+{
+	std::vector<int> columns(dest_width + 1);
+	for (int x = 0; x <= dest_width; ++x)
+		columns[x] = static_cast<int>(static_cast<int64_t>(x) * source_width / dest_width);
+
+	for (int y = 0; y < dest_height; ++y)
+	{
+		int y0 = static_cast<int>(static_cast<int64_t>(y) * source_height / dest_height);
+		int y1 = std::max(y0 + 1, static_cast<int>(static_cast<int64_t>(y + 1) * source_height / dest_height));
+		
+		for (int x = 0; x < dest_width; ++x)
+		{
+			int x0 = columns[x];
+			int x1 = std::max(x0 + 1, columns[x + 1]);
+			
+			uint32_t sum[4] = {0, 0, 0, 0};
+
+			for (int sy = y0; sy < y1; ++sy)
+			{
+				auto row = source + (sy * source_width + x0) * 4;
+
+				for (int sx = x0; sx < x1; ++sx, row += 4)
+				{
+					sum[0] += row[0];
+					sum[1] += row[1];
+					sum[2] += row[2];
+					sum[3] += row[3];
+				}
+			}
+
+			uint32_t count = (y1 - y0) * (x1 - x0);
+			auto pixel = dest + (y * dest_width + x) * 4;
+
+			for (int n = 0; n < 4; ++n)
+				pixel[n] = static_cast<uint8_t>((sum[n] + count / 2) / count);
+		}
+	}
+}
+
 struct thumbnail_output : public mixer::target_t
 {
 	tbb::atomic<int> sleep_millis;
@@ -89,6 +140,40 @@ struct thumbnail_output : public mixer::target_t
 	}
 };
 
+// An independent producer -> mixer -> output chain. The mixer has no ogl device so everything, including
+// the scaling to the thumbnail size, is done on the cpu without competing with the channels for the gpu.
+struct thumbnail_pipeline
+{
+	safe_ptr<diagnostics::graph>	graph;
+	safe_ptr<thumbnail_output>		output;
+	safe_ptr<core::mixer>			mixer;
+
+	thumbnail_pipeline(int index, const video_format_desc& format_desc, int generate_delay_millis)
+		: output(new thumbnail_output(generate_delay_millis))
+		, mixer(new core::mixer(graph, output, format_desc, nullptr, channel_layout::stereo()))
+	{
+		graph->set_text(L"thumbnail-channel[" + boost::lexical_cast<std::wstring>(index) + L"]");
+		graph->auto_reset();
+		diagnostics::register_graph(graph);
+	}
+};
+
+struct thumbnail_priority
+{
+	enum type
+	{
+		normal = 0,	// Filesystem events and GENERATE_ALL rescans.
+		high		// GENERATE requests, someone is waiting for the result.
+	};
+};
+
+struct thumbnail_request
+{
+	boost::filesystem::wpath		file;
+	thumbnail_priority::type		priority;
+	boost::posix_time::ptime		queued;
+};
+
 struct thumbnail_generator::implementation
 {
 private:
@@ -96,12 +181,26 @@ private:
 	boost::filesystem::wpath thumbnails_path_;
 	int width_;
 	int height_;
-	safe_ptr<ogl_device> ogl_;
-	safe_ptr<diagnostics::graph> graph_;
 	video_format_desc format_desc_;
-	safe_ptr<thumbnail_output> output_;
-	safe_ptr<mixer> mixer_;
 	thumbnail_creator thumbnail_creator_;
+
+	mutable boost::mutex mutex_;
+	boost::condition_variable cond_;
+	bool running_;
+	std::deque<thumbnail_request> queues_[2];								// Indexed by thumbnail_priority.
+	std::map<boost::filesystem::wpath, thumbnail_priority::type> pending_;	// Queued files, stale queue entries are skipped.
+	std::set<boost::filesystem::wpath> in_progress_;
+
+	int64_t generated_;
+	int64_t failed_;
+	int64_t total_latency_millis_;
+	int64_t peak_latency_millis_;
+	int64_t total_render_millis_;
+	int64_t busy_millis_;
+	boost::posix_time::ptime busy_since_;
+
+	std::vector<std::shared_ptr<thumbnail_pipeline>> pipelines_;
+	boost::thread_group workers_;
 	filesystem_monitor::ptr monitor_;
 public:
 	implementation(
@@ -111,24 +210,57 @@ public:
 			int width,
 			int height,
 			const video_format_desc& render_video_mode,
-			const safe_ptr<ogl_device>& ogl,
+			int workers,
 			int generate_delay_millis,
 			const thumbnail_creator& thumbnail_creator)
 		: media_path_(media_path)
 		, thumbnails_path_(thumbnails_path)
 		, width_(width)
 		, height_(height)
-		, ogl_(ogl)
 		, format_desc_(render_video_mode)
-		, output_(new thumbnail_output(generate_delay_millis))
-		, mixer_(new mixer(
-				graph_,
-				output_,
-				format_desc_,
-				ogl,
-				channel_layout::stereo()))
 		, thumbnail_creator_(thumbnail_creator)
-		, monitor_(monitor_factory.create(
+		, running_(true)
+		, generated_(0)
+		, failed_(0)
+		, total_latency_millis_(0)
+		, peak_latency_millis_(0)
+		, total_render_millis_(0)
+		, busy_millis_(0)
+		, monitor_(create_monitor(monitor_factory, media_path, std::max(1, workers), generate_delay_millis))
+	{
+		//monitor_->initial_scan_completion().get();
+		//output_->sleep_millis = 2000;
+	}
+
+	~implementation()
+	{
+		{
+			boost::lock_guard<boost::mutex> lock(mutex_);
+			running_ = false;
+		}
+
+		cond_.notify_all();
+		workers_.interrupt_all();
+		workers_.join_all();
+	}
+
+	// The pipelines and workers need to be running before the monitor starts emitting events.
+	filesystem_monitor::ptr create_monitor(
+			filesystem_monitor_factory& monitor_factory, 
+			const boost::filesystem::wpath& media_path,
+			int workers,
+			int generate_delay_millis)
+	{
+		for (int n = 0; n < workers; ++n)
+		{
+			auto pipeline = std::make_shared<thumbnail_pipeline>(n + 1, format_desc_, generate_delay_millis);
+			pipelines_.push_back(pipeline);
+			workers_.create_thread([=] { run(pipeline); });
+		}
+
+		CASPAR_LOG(info) << L"Thumbnail generator using " << workers << L" worker(s).";
+
+		return monitor_factory.create(
 				media_path,
 				ALL,
 				true,
@@ -139,13 +271,7 @@ public:
 				[this] (const std::set<boost::filesystem::wpath>& initial_files) 
 				{
 					this->on_initial_files(initial_files);
-				}))
-	{
-		graph_->set_text(L"thumbnail-channel");
-		graph_->auto_reset();
-		diagnostics::register_graph(graph_);
-		//monitor_->initial_scan_completion().get();
-		//output_->sleep_millis = 2000;
+				});
 	}
 
 	void on_initial_files(const std::set<boost::filesystem::wpath>& initial_files)
@@ -172,7 +298,7 @@ public:
 					== relative_without_extensions.end();
 
 			if (no_corresponding_media_file)
-				remove(thumbnails_path_ / (relative_without_extension + L".png"));
+				remove(path); // The thumbnail or any other file stored along with it, e.g. a seek index.
 		}
 	}
 
@@ -186,8 +312,8 @@ public:
 		{
 			auto stem = iter->path().stem();
 
-			if (boost::iequals(stem, base_file.filename()))
-				monitor_->reemmit(iter->path());
+			if (boost::iequals(stem, base_file.filename()) && is_regular_file(iter->path()))
+				enqueue(iter->path(), thumbnail_priority::high);
 		}
 	}
 
@@ -196,26 +322,190 @@ public:
 		monitor_->reemmit_all();
 	}
 
+	boost::property_tree::wptree info() const
+	{
+		boost::lock_guard<boost::mutex> lock(mutex_);
+
+		auto busy_millis = busy_millis_;
+		if (!busy_since_.is_not_a_date_time())
+			busy_millis += millis_since(busy_since_);
+
+		boost::property_tree::wptree info;
+		info.add(L"workers",					pipelines_.size());
+		info.add(L"queued.high",				count_queued(thumbnail_priority::high));
+		info.add(L"queued.normal",				count_queued(thumbnail_priority::normal));
+		info.add(L"in-progress",				in_progress_.size());
+		info.add(L"generated",					generated_);
+		info.add(L"failed",						failed_);
+		info.add(L"latency.average-millis",		generated_ > 0 ? total_latency_millis_ / generated_ : 0);
+		info.add(L"latency.peak-millis",		peak_latency_millis_);
+		info.add(L"render.average-millis",		generated_ > 0 ? total_render_millis_ / generated_ : 0);
+		info.add(L"throughput.per-minute",		busy_millis > 0 ? static_cast<double>(generated_) * 60000.0 / static_cast<double>(busy_millis) : 0.0);
+		return info;
+	}
+
 	void on_file_event(filesystem_event event, const boost::filesystem::wpath& file)
 	{
 		switch (event)
 		{
 		case CREATED:
 			if (needs_to_be_generated(file))
-				generate_thumbnail(file);
+				enqueue(file, thumbnail_priority::normal);
 
 			break;
 		case MODIFIED:
-			generate_thumbnail(file);
+			enqueue(file, thumbnail_priority::normal);
 
 			break;
 		case REMOVED:
+			{
+				boost::lock_guard<boost::mutex> lock(mutex_);
+				pending_.erase(file);
+			}
+
 			auto relative_without_extension = get_relative_without_extension(file, media_path_);
 			boost::filesystem::remove(thumbnails_path_ / (relative_without_extension + L".png"));
 
 			break;
 		}
 	}
+private:
+	static int64_t millis_since(const boost::posix_time::ptime& time)
+	{
+		return (boost::posix_time::microsec_clock::universal_time() - time).total_milliseconds();
+	}
+
+	size_t count_queued(thumbnail_priority::type priority) const
+	{
+		size_t count = 0;
+
+		BOOST_FOREACH(auto& entry, pending_)
+		{
+			if (entry.second == priority)
+				++count;
+		}
+
+		return count;
+	}
+
+	void enqueue(const boost::filesystem::wpath& file, thumbnail_priority::type priority)
+	{
+		{
+			boost::lock_guard<boost::mutex> lock(mutex_);
+
+			auto it = pending_.find(file);
+
+			if (it != pending_.end() && it->second >= priority)
+				return; // Already queued, the pending entry is bumped when the new request has a higher priority.
+
+			pending_[file] = priority;
+
+			thumbnail_request request = {file, priority, boost::posix_time::microsec_clock::universal_time()};
+			queues_[priority].push_back(request);
+
+			if (busy_since_.is_not_a_date_time())
+				busy_since_ = request.queued;
+		}
+
+		cond_.notify_one();
+	}
+
+	bool try_pop(thumbnail_request& result)
+	{
+		for (int priority = thumbnail_priority::high; priority >= thumbnail_priority::normal; --priority)
+		{
+			auto& queue = queues_[priority];
+
+			for (auto it = queue.begin(); it != queue.end();)
+			{
+				auto pending = pending_.find(it->file);
+
+				if (pending == pending_.end() || pending->second != priority)
+				{
+					it = queue.erase(it); // Removed or bumped to the high priority queue.
+					continue;
+				}
+
+				if (in_progress_.find(it->file) != in_progress_.end())
+				{
+					++it; // Regenerated once the current generation of the same file is done.
+					continue;
+				}
+
+				result = *it;
+				queue.erase(it);
+				pending_.erase(pending);
+				in_progress_.insert(result.file);
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	void run(const std::shared_ptr<thumbnail_pipeline>& pipeline)
+	{
+		try
+		{
+			while (true)
+			{
+				thumbnail_request request;
+				{
+					boost::unique_lock<boost::mutex> lock(mutex_);
+
+					while (running_ && !try_pop(request))
+						cond_.wait(lock);
+
+					if (!running_)
+						return;
+				}
+
+				auto started = boost::posix_time::microsec_clock::universal_time();
+				bool generated = false;
+				
+				try
+				{
+					generated = generate_thumbnail(*pipeline, request.file);
+				}
+				catch (const boost::thread_interrupted&)
+				{
+					throw;
+				}
+				catch (...)
+				{
+					CASPAR_LOG_CURRENT_EXCEPTION();
+				}
+
+				{
+					boost::lock_guard<boost::mutex> lock(mutex_);
+
+					in_progress_.erase(request.file);
+
+					if (generated)
+					{
+						auto latency = millis_since(request.queued);
+						++generated_;
+						total_latency_millis_ += latency;
+						total_render_millis_ += millis_since(started);
+						peak_latency_millis_ = std::max(peak_latency_millis_, latency);
+					}
+					else
+						++failed_;
+
+					if (pending_.empty() && in_progress_.empty() && !busy_since_.is_not_a_date_time())
+					{
+						busy_millis_ += millis_since(busy_since_);
+						busy_since_ = boost::posix_time::ptime();
+					}
+				}
+
+				cond_.notify_all(); // A request for the same file may have been waiting for this one.
+			}
+		}
+		catch (const boost::thread_interrupted&)
+		{
+		}
+	}
 
 	bool needs_to_be_generated(const boost::filesystem::wpath& file)
 	{
@@ -249,18 +539,31 @@ public:
 		}
 	}
 
-	void generate_thumbnail(const boost::filesystem::wpath& file)
+	safe_ptr<read_frame> scale(const safe_ptr<read_frame>& frame) const
+	{
+		auto size = static_cast<size_t>(width_ * height_ * 4);
+		auto buffer = create_system_host_buffer(size);
+
+		scale_bgra(
+				frame->image_data().begin(), static_cast<int>(format_desc_.width), static_cast<int>(format_desc_.height), 
+				static_cast<uint8_t*>(buffer->data()), width_, height_);
+
+		return make_safe<read_frame>(nullptr, size, std::move(buffer), audio_buffer(), channel_layout::stereo());
+	}
+
+	bool generate_thumbnail(thumbnail_pipeline& pipeline, const boost::filesystem::wpath& file)
 	{
 		auto media_file = get_relative_without_extension(file, media_path_);
 		auto png_file = thumbnails_path_ / (media_file + L".png");
-		boost::promise<void> thumbnail_ready;
+		auto thumbnail_ready = std::make_shared<boost::promise<void>>();
+		auto thumbnail_done = thumbnail_ready->get_future();
 
 		{
 			auto producer = frame_producer::empty();
 
 			try
 			{
-				producer = create_thumbnail_producer(mixer_, media_file);
+				producer = create_thumbnail_producer(pipeline.mixer, media_file);
 			}
 			catch (const boost::thread_interrupted&)
 			{
@@ -269,19 +572,27 @@ public:
 			catch (...)
 			{
 				CASPAR_LOG(debug) << L"Thumbnail producer failed to initialize for " << media_file;
-				return;
+				return false;
 			}
 
 			if (producer == frame_producer::empty())
 			{
 				CASPAR_LOG(trace) << L"No appropriate thumbnail producer found for " << media_file;
-				return;
+				return false;
 			}
 
 			boost::filesystem::create_directories(png_file.parent_path());
-			output_->on_send = [this, &png_file] (const safe_ptr<read_frame>& frame)
+
+			// The thumbnail is rendered at full size and scaled down here, the creator gets a frame which is
+			// exactly width x height.
+			auto thumbnail_desc		= format_desc_;
+			thumbnail_desc.width	= width_;
+			thumbnail_desc.height	= height_;
+			thumbnail_desc.size		= width_ * height_ * 4;
+
+			pipeline.output->on_send = [this, png_file, thumbnail_desc] (const safe_ptr<read_frame>& frame)
 			{
-				thumbnail_creator_(frame, format_desc_, png_file, width_, height_);
+				thumbnail_creator_(scale(frame), thumbnail_desc, png_file, width_, height_);
 			};
 
 			std::map<int, safe_ptr<basic_frame>> frames;
@@ -298,32 +609,28 @@ public:
 			catch (...)
 			{
 				CASPAR_LOG(debug) << L"Thumbnail producer failed to create thumbnail for " << media_file;
-				return;
+				return false;
 			}
 
 			if (raw_frame == basic_frame::empty()
-					|| raw_frame == basic_frame::empty()
 					|| raw_frame == basic_frame::eof()
 					|| raw_frame == basic_frame::late())
 			{
 				CASPAR_LOG(debug) << L"No thumbnail generated for " << media_file;
-				return;
+				return false;
 			}
 
-			auto transformed_frame = make_safe<basic_frame>(raw_frame);
-			transformed_frame->get_frame_transform().fill_scale[0] = static_cast<double>(width_) / format_desc_.width;
-			transformed_frame->get_frame_transform().fill_scale[1] = static_cast<double>(height_) / format_desc_.height;
-			frames.insert(std::make_pair(0, transformed_frame));
+			frames.insert(std::make_pair(0, raw_frame));
 
-			std::shared_ptr<void> ticket(nullptr, [&thumbnail_ready](void*)
+			std::shared_ptr<void> ticket(nullptr, [thumbnail_ready](void*)
 			{
-				thumbnail_ready.set_value();
+				thumbnail_ready->set_value();
 			});
 
-			mixer_->send(std::make_pair(frames, ticket));
+			pipeline.mixer->send(std::make_pair(frames, ticket));
 			ticket.reset();
 		}
-		thumbnail_ready.get_future().get();
+		thumbnail_done.get();
 
 		if (boost::filesystem::exists(png_file))
 		{
@@ -332,6 +639,7 @@ public:
 			{
 				boost::filesystem::last_write_time(png_file, boost::filesystem::last_write_time(file));
 				CASPAR_LOG(debug) << L"Generated thumbnail for " << media_file;
+				return true;
 			}
 			catch (...)
 			{
@@ -340,6 +648,8 @@ public:
 		}
 		else
 			CASPAR_LOG(debug) << L"No thumbnail generated for " << media_file;
+
+		return false;
 	}
 };
 
@@ -350,7 +660,7 @@ thumbnail_generator::thumbnail_generator(
 		int width,
 		int height,
 		const video_format_desc& render_video_mode,
-		const safe_ptr<ogl_device>& ogl,
+		int workers,
 		int generate_delay_millis,
 		const thumbnail_creator& thumbnail_creator)
 		: impl_(new implementation(
@@ -359,7 +669,7 @@ thumbnail_generator::thumbnail_generator(
 				thumbnails_path,
 				width, height,
 				render_video_mode,
-				ogl,
+				workers,
 				generate_delay_millis,
 				thumbnail_creator))
 {
@@ -379,4 +689,9 @@ void thumbnail_generator::generate_all()
 	impl_->generate_all();
 }
 
+boost::property_tree::wptree thumbnail_generator::info() const
+{
+	return impl_->info();
+}
+
 }}
@@ -22,13 +22,13 @@
 #pragma once
 
 #include <boost/noncopyable.hpp>
+#include <boost/property_tree/ptree_fwd.hpp>
 
 #include <common/memory/safe_ptr.h>
 #include <common/filesystem/filesystem_monitor.h>
 
 namespace caspar { namespace core {
 
-class ogl_device;
 class read_frame;
 struct video_format_desc;
 
@@ -49,12 +49,14 @@ public:
 			int width,
 			int height,
 			const video_format_desc& render_video_mode,
-			const safe_ptr<ogl_device>& ogl,
+			int workers,
 			int generate_delay_millis,
 			const thumbnail_creator& thumbnail_creator);
 	~thumbnail_generator();
 	void generate(const std::wstring& media_file);
 	void generate_all();
+
+	boost::property_tree::wptree info() const;
 private:
 	struct implementation;
 	safe_ptr<implementation> impl_;
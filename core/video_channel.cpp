@@ -34,18 +34,38 @@
 #include <common/diagnostics/graph.h>
 #include <common/env.h>
 
+#include <boost/algorithm/string/predicate.hpp>
 #include <boost/property_tree/ptree.hpp>
 
 #include <string>
 
 namespace caspar { namespace core {
 
+channel_clock::type channel_clock::parse(const std::wstring& value, channel_clock::type default_value)
+{
+	if(boost::iequals(value, L"realtime"))
+		return realtime;
+	if(boost::iequals(value, L"offline"))
+		return offline;
+	return default_value;
+}
+
+std::wstring channel_clock::print(channel_clock::type value)
+{
+	switch(value)
+	{
+	case offline:	return L"offline";
+	default:		return L"realtime";
+	}
+}
+
 struct video_channel::implementation : boost::noncopyable
 {
 	video_channel&							self_;
 	const int								index_;
 	video_format_desc						format_desc_;
-	const safe_ptr<ogl_device>				ogl_;
+	channel_clock::type						clock_;
+	const std::shared_ptr<ogl_device>			ogl_;
 	const safe_ptr<diagnostics::graph>		graph_;
 
 	const safe_ptr<caspar::core::output>	output_;
@@ -55,10 +75,11 @@ struct video_channel::implementation : boost::noncopyable
 	monitor::subject						monitor_subject_;
 	
 public:
-	implementation(video_channel& self, int index, const video_format_desc& format_desc, const safe_ptr<ogl_device>& ogl, const channel_layout& audio_channel_layout)  
+	implementation(video_channel& self, int index, const video_format_desc& format_desc, const std::shared_ptr<ogl_device>& ogl, const channel_layout& audio_channel_layout)  
 		: self_(self)
 		, index_(index)
 		, format_desc_(format_desc)
+		, clock_(channel_clock::realtime)
 		, ogl_(ogl)
 		, output_(new caspar::core::output(graph_, format_desc, index))
 		, mixer_(new caspar::core::mixer(graph_, output_, format_desc, ogl, audio_channel_layout))
@@ -72,6 +93,8 @@ public:
 			stage_->spawn_token();
 
 		stage_->monitor_output().link_target(&monitor_subject_);
+		mixer_->monitor_output().link_target(&monitor_subject_);
+		output_->monitor_output().link_target(&monitor_subject_);
 
 		CASPAR_LOG(info) << print() << " Successfully Initialized.";
 	}
@@ -86,7 +109,8 @@ public:
 			output_->set_video_format_desc(format_desc);
 			mixer_->set_video_format_desc(format_desc);
 			stage_->set_video_format_desc(format_desc);
-			ogl_->gc();
+			if(ogl_)
+				ogl_->gc();
 		}
 		catch(...)
 		{
@@ -97,6 +121,19 @@ public:
 		}
 		format_desc_ = format_desc;
 	}
+
+	void set_clock(channel_clock::type clock)
+	{
+		if(clock == clock_)
+			return;
+
+		// Offline consumers block before producers stop returning late frames.
+		output_->set_offline(clock == channel_clock::offline);
+		stage_->set_offline(clock == channel_clock::offline);
+		clock_ = clock;
+
+		CASPAR_LOG(info) << print() << L" Clock: " << channel_clock::print(clock_) << L".";
+	}
 		
 	std::wstring print() const
 	{
@@ -112,6 +149,7 @@ public:
 		auto output_info = output_->info();
 
 		info.add(L"video-mode", format_desc_.name);
+		info.add(L"clock", channel_clock::print(clock_));
 
 		if (stage_info.timed_wait(boost::posix_time::seconds(2)))
 			info.add_child(L"stage", stage_info.get());
@@ -146,13 +184,15 @@ public:
 	}
 };
 
-video_channel::video_channel(int index, const video_format_desc& format_desc, const safe_ptr<ogl_device>& ogl, const channel_layout& audio_channel_layout) 
+video_channel::video_channel(int index, const video_format_desc& format_desc, const std::shared_ptr<ogl_device>& ogl, const channel_layout& audio_channel_layout) 
 	: impl_(new implementation(*this, index, format_desc, ogl, audio_channel_layout)){}
 safe_ptr<stage> video_channel::stage() { return impl_->stage_;} 
 safe_ptr<mixer> video_channel::mixer() { return impl_->mixer_;} 
 safe_ptr<output> video_channel::output() { return impl_->output_;} 
 video_format_desc video_channel::get_video_format_desc() const{return impl_->format_desc_;}
 void video_channel::set_video_format_desc(const video_format_desc& format_desc){impl_->set_video_format_desc(format_desc);}
+channel_clock::type video_channel::get_clock() const{return impl_->clock_;}
+void video_channel::set_clock(channel_clock::type clock){impl_->set_clock(clock);}
 boost::property_tree::wptree video_channel::info() const{return impl_->info();}
 int video_channel::index() const {return impl_->index_;}
 monitor::source& video_channel::monitor_output(){return impl_->monitor_subject_;}
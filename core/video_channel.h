@@ -30,6 +30,8 @@
 
 #include <agents.h>
 
+#include <string>
+
 namespace caspar { namespace core {
 	
 class stage;
@@ -39,6 +41,20 @@ class ogl_device;
 struct video_format_desc;
 struct channel_layout;
 
+// What drives the channel tick.
+struct channel_clock
+{
+	enum type
+	{
+		realtime,	// The consumers with a synchronization clock, or the output at the frame rate.
+		offline,	// As fast as the pipeline allows. Consumers receive every frame and producers wait for late frames.
+		count
+	};
+
+	static channel_clock::type parse(const std::wstring& value, channel_clock::type default_value = realtime);
+	static std::wstring print(channel_clock::type value);
+};
+
 class video_channel : boost::noncopyable
 {
 public:
@@ -47,7 +63,7 @@ public:
 
 	// Constructors
 
-	explicit video_channel(int index, const video_format_desc& format_desc, const safe_ptr<ogl_device>& ogl, const channel_layout& audio_channel_layout);
+	explicit video_channel(int index, const video_format_desc& format_desc, const std::shared_ptr<ogl_device>& ogl, const channel_layout& audio_channel_layout);
 
 	// Methods
 
@@ -59,6 +75,9 @@ public:
 	
 	video_format_desc get_video_format_desc() const;
 	void set_video_format_desc(const video_format_desc& format_desc);
+
+	channel_clock::type get_clock() const;
+	void set_clock(channel_clock::type clock); // See stage::set_frame_budget for stepping an offline channel.
 	
 	boost::property_tree::wptree info() const;
 	boost::property_tree::wptree delay_info() const;
@@ -399,8 +399,9 @@ safe_ptr<core::frame_producer> create_producer(
 			params.get(L"CHANNEL_LAYOUT", L"STEREO"),
 			core::default_channel_layout_repository());
 	
-	boost::replace_all(filter_str, L"DEINTERLACE", L"YADIF=0:-1");
 	boost::replace_all(filter_str, L"DEINTERLACE_BOB", L"YADIF=1:-1");
+	boost::replace_all(filter_str, L"DEINTERLACE_BLEND", L"BLEND");
+	boost::replace_all(filter_str, L"DEINTERLACE", L"YADIF=0:-1");
 	
 	if(format_desc.format == core::video_format::invalid)
 		format_desc = frame_factory->get_video_format_desc();
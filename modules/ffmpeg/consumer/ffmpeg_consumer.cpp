@@ -44,10 +44,14 @@
 #include <boost/algorithm/string.hpp>
 #include <boost/timer.hpp>
 #include <boost/property_tree/ptree.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
 
 #include <tbb/cache_aligned_allocator.h>
+#include <tbb/parallel_for.h>
 #include <tbb/parallel_invoke.h>
 #include <tbb/atomic.h>
+#include <tbb/mutex.h>
 
 #include <boost/range/algorithm.hpp>
 #include <boost/range/algorithm_ext.hpp>
@@ -207,6 +211,13 @@ struct output_format
 
 typedef std::vector<uint8_t, tbb::cache_aligned_allocator<uint8_t>>	byte_vector;
 
+static const int	CONVERSION_BAND_ALIGNMENT	= 16;	// Rows, band edges fall on macroblock rows.
+static const size_t	MIN_LOOKAHEAD_FRAMES		= 2;	// Always allowed, regardless of size.
+static const size_t	MAX_LOOKAHEAD_FRAMES		= 64;
+
+// Frames are queued in a lookahead of at most lookahead_size bytes, send() blocks while it is full. 
+// Video is converted and encoded on one thread and audio on another, the muxer is shared.
+
 struct ffmpeg_consumer : boost::noncopyable
 {		
 	const std::string						filename_;
@@ -217,18 +228,31 @@ struct ffmpeg_consumer : boost::noncopyable
 	
 	const safe_ptr<diagnostics::graph>		graph_;
 
-	executor								encode_executor_;
+	const size_t							lookahead_capacity_;
+	size_t									lookahead_size_;
+	size_t									lookahead_count_;
+	boost::mutex							lookahead_mutex_;
+	boost::condition_variable				lookahead_cond_;
+	tbb::atomic<int64_t>					backpressure_frames_;
+	tbb::atomic<int64_t>					backpressure_micros_;
+	tbb::atomic<int64_t>					encoded_frames_;
+
+	tbb::mutex								mux_mutex_;
+
+	executor								video_executor_;
+	executor								audio_executor_;
 	
 	std::shared_ptr<AVStream>				audio_st_;
 	std::shared_ptr<AVStream>				video_st_;
 	
 	byte_vector								audio_outbuf_;
 	byte_vector								audio_buf_;
+	std::vector<int8_t, tbb::cache_aligned_allocator<int8_t>> audio_resample_buffer_;
 	byte_vector								video_outbuf_;
 	byte_vector								key_picture_buf_;
 	byte_vector								picture_buf_;
 	std::shared_ptr<audio_resampler>		swr_;
-	std::shared_ptr<SwsContext>				sws_;
+	std::vector<std::shared_ptr<SwsContext>> sws_;	// One context per row band.
 
 	int64_t									in_frame_number_;
 	int64_t									out_frame_number_;
@@ -238,31 +262,38 @@ struct ffmpeg_consumer : boost::noncopyable
 	tbb::atomic<int64_t>					current_encoding_delay_;
 	
 public:
-	ffmpeg_consumer(const std::string& filename, const core::video_format_desc& format_desc, std::vector<option> options, bool key_only, const core::channel_layout& audio_channel_layout)
+	ffmpeg_consumer(const std::string& filename, const core::video_format_desc& format_desc, std::vector<option> options, bool key_only, const core::channel_layout& audio_channel_layout, size_t lookahead_capacity)
 		: filename_(filename)
 		, video_outbuf_(1920*1080*8)
 		, audio_outbuf_(10000)
 		, oc_(avformat_alloc_context(), av_free)
 		, format_desc_(format_desc)
 		, channel_layout_(audio_channel_layout)
-		, encode_executor_(print())
+		, lookahead_capacity_(lookahead_capacity)
+		, lookahead_size_(0)
+		, lookahead_count_(0)
+		, video_executor_(print() + L" video")
+		, audio_executor_(print() + L" audio")
 		, in_frame_number_(0)
 		, out_frame_number_(0)
 		, output_format_(format_desc, filename, options)
 		, key_only_(key_only)
 	{
 		current_encoding_delay_ = 0;
+		backpressure_frames_	= 0;
+		backpressure_micros_	= 0;
+		encoded_frames_			= 0;
 
 		// TODO: Ask stakeholders about case where file already exists.
 		boost::filesystem2::remove(boost::filesystem2::wpath(env::media_folder() + widen(filename))); // Delete the file if it exists
 
 		graph_->set_color("frame-time", diagnostics::color(0.1f, 1.0f, 0.1f));
-		graph_->set_color("dropped-frame", diagnostics::color(0.3f, 0.6f, 0.3f));
+		graph_->set_color("audio-time", diagnostics::color(0.9f, 0.9f, 0.1f));
+		graph_->set_color("lookahead", diagnostics::color(0.9f, 0.9f, 0.5f));
+		graph_->set_color("backpressure", diagnostics::color(0.9f, 0.3f, 0.6f));
 		graph_->set_text(print());
 		diagnostics::register_graph(graph_);
 
-		encode_executor_.set_capacity(8);
-
 		oc_->oformat = output_format_.format;
 				
 		THROW_ON_ERROR2(av_set_parameters(oc_.get(), nullptr), "[ffmpeg_consumer]");
@@ -295,8 +326,14 @@ public:
 
 	~ffmpeg_consumer()
 	{    
-		encode_executor_.stop();
-		encode_executor_.join();
+		// Both encoders finish the frames in the lookahead before the trailer is written.
+		video_executor_.wait();
+		audio_executor_.wait();
+
+		video_executor_.stop();
+		audio_executor_.stop();
+		video_executor_.join();
+		audio_executor_.join();
 
 		// Flush
 		LOG_ON_ERROR2(av_interleaved_write_frame(oc_.get(), nullptr), "[ffmpeg_consumer]");
@@ -391,6 +428,10 @@ public:
 		}
 				
 		c->max_b_frames = 0; // b-frames not supported.
+
+		// The codec picks frame or slice threading, -threads overrides the count.
+		c->thread_type	= FF_THREAD_FRAME | FF_THREAD_SLICE;
+		c->thread_count = env::properties().get(L"configuration.ffmpeg.encode-threads", static_cast<int>(boost::thread::hardware_concurrency()));
 				
 		boost::range::remove_erase_if(options, [&](const option& o)
 		{
@@ -401,7 +442,6 @@ public:
 		if(output_format_.format->flags & AVFMT_GLOBALHEADER)
 			c->flags |= CODEC_FLAG_GLOBAL_HEADER;
 		
-		c->thread_count = boost::thread::hardware_concurrency();
 		if(avcodec_open(c, encoder) < 0)
 		{
 			c->thread_count = 1;
@@ -460,13 +500,37 @@ public:
 		});
 	}
 
+	// First row of band n out of count, the last band ends at the picture height.
+	int band_row(int n, int count) const
+	{
+		auto height = static_cast<int>(format_desc_.height);
+		if(n == count)
+			return height;
+
+		return (height * n / count) & ~(CONVERSION_BAND_ALIGNMENT-1);
+	}
+
+	// The picture is split into row bands with a conversion context each, which are converted in parallel.
+	// Rows are only independent when nothing is filtered vertically, a picture which is scaled vertically or
+	// has vertically subsampled chroma (4:2:0) is converted as a single band.
 	std::shared_ptr<AVFrame> convert_video(core::read_frame& frame, AVCodecContext* c)
 	{
-		if(!sws_) 
+		if(sws_.empty()) 
 		{
-			sws_.reset(sws_getContext(format_desc_.width, format_desc_.height, PIX_FMT_BGRA, c->width, c->height, c->pix_fmt, SWS_BICUBIC, nullptr, nullptr, nullptr), sws_freeContext);
-			if (sws_ == nullptr) 
-				BOOST_THROW_EXCEPTION(caspar_exception() << msg_info("Cannot initialize the conversion context"));
+			int count = 1;
+			if(c->height == format_desc_.height && av_pix_fmt_descriptors[c->pix_fmt].log2_chroma_h == 0)
+				count = std::max(1, std::min(static_cast<int>(boost::thread::hardware_concurrency()), static_cast<int>(format_desc_.height) / CONVERSION_BAND_ALIGNMENT));
+
+			for(int n = 0; n < count; ++n)
+			{
+				auto rows = band_row(n+1, count) - band_row(n, count);
+
+				std::shared_ptr<SwsContext> sws(sws_getContext(format_desc_.width, rows, PIX_FMT_BGRA, c->width, count > 1 ? rows : c->height, c->pix_fmt, SWS_BICUBIC, nullptr, nullptr, nullptr), sws_freeContext);
+				if (sws == nullptr) 
+					BOOST_THROW_EXCEPTION(caspar_exception() << msg_info("Cannot initialize the conversion context"));
+
+				sws_.push_back(sws);
+			}
 		}
 
 		std::shared_ptr<AVFrame> in_frame(avcodec_alloc_frame(), av_free);
@@ -477,8 +541,6 @@ public:
 			key_picture_buf_.resize(frame.image_data().size());
 			in_picture->linesize[0] = format_desc_.width * 4;
 			in_picture->data[0] = key_picture_buf_.data();
-
-			fast_memshfl(in_picture->data[0], frame.image_data().begin(), frame.image_data().size(), 0x0F0F0F0F, 0x0B0B0B0B, 0x07070707, 0x03030303);
 		}
 		else
 		{
@@ -489,7 +551,25 @@ public:
 		picture_buf_.resize(avpicture_get_size(c->pix_fmt, c->width, c->height));
 		avpicture_fill(reinterpret_cast<AVPicture*>(out_frame.get()), picture_buf_.data(), c->pix_fmt, c->width, c->height);
 
-		sws_scale(sws_.get(), in_frame->data, in_frame->linesize, 0, format_desc_.height, out_frame->data, out_frame->linesize);
+		auto count = static_cast<int>(sws_.size());
+
+		tbb::parallel_for(0, count, 1, [&](int n)
+		{
+			auto begin	= band_row(n, count);
+			auto end	= band_row(n+1, count);
+			auto offset	= begin * in_picture->linesize[0];
+
+			if (key_only_)
+				fast_memshfl(in_picture->data[0] + offset, frame.image_data().begin() + offset, (end - begin) * in_picture->linesize[0], 0x0F0F0F0F, 0x0B0B0B0B, 0x07070707, 0x03030303);
+
+			const uint8_t* src[4] = {in_picture->data[0] + offset, nullptr, nullptr, nullptr};
+
+			uint8_t* dst[4];
+			for(int plane = 0; plane < 4; ++plane)
+				dst[plane] = out_frame->data[plane] ? out_frame->data[plane] + begin * out_frame->linesize[plane] : nullptr;
+
+			sws_scale(sws_[n].get(), src, in_picture->linesize, 0, end - begin, dst, out_frame->linesize);
+		});
 
 		return out_frame;
 	}
@@ -532,10 +612,10 @@ public:
 		pkt->data			= video_outbuf_.data();
 		pkt->size			= out_size;
  			
-		av_interleaved_write_frame(oc_.get(), pkt.get());		
+		write_packet(*pkt);		
 	}
 		
-	byte_vector convert_audio(core::read_frame& frame, AVCodecContext* c)
+	void convert_audio(core::read_frame& frame, AVCodecContext* c)
 	{
 		if(!swr_) 		
 			swr_.reset(new audio_resampler(c->channels, frame.num_channels(), 
@@ -545,21 +625,20 @@ public:
 
 		auto audio_data = frame.audio_data();
 
-		std::vector<int8_t,  tbb::cache_aligned_allocator<int8_t>> audio_resample_buffer;
-		std::copy(reinterpret_cast<const uint8_t*>(audio_data.begin()), 
-				  reinterpret_cast<const uint8_t*>(audio_data.begin()) + audio_data.size()*4, 
-				  std::back_inserter(audio_resample_buffer));
+		// The resampler swaps buffers with us, both keep their capacity between frames.
+		audio_resample_buffer_.assign(reinterpret_cast<const int8_t*>(audio_data.begin()), 
+									  reinterpret_cast<const int8_t*>(audio_data.begin()) + audio_data.size()*4);
 		
-		audio_resample_buffer = swr_->resample(std::move(audio_resample_buffer));
+		audio_resample_buffer_ = swr_->resample(std::move(audio_resample_buffer_));
 		
-		return byte_vector(audio_resample_buffer.begin(), audio_resample_buffer.end());
+		audio_buf_.insert(audio_buf_.end(), audio_resample_buffer_.begin(), audio_resample_buffer_.end());
 	}
 
 	void encode_audio_frame(core::read_frame& frame)
 	{			
 		auto c = audio_st_->codec;
 
-		boost::range::push_back(audio_buf_, convert_audio(frame, c));
+		convert_audio(frame, c);
 		
 		std::size_t frame_size = c->frame_size;
 		auto input_audio_size = frame_size * av_get_bytes_per_sample(c->sample_fmt) * c->channels;
@@ -596,37 +675,99 @@ public:
 			pkt->stream_index = audio_st_->index;
 			pkt->data		  = reinterpret_cast<uint8_t*>(audio_outbuf_.data());
 		
-			av_interleaved_write_frame(oc_.get(), pkt.get());
+			write_packet(*pkt);
+		}
+	}
+
+	void write_packet(AVPacket& pkt)
+	{
+		tbb::mutex::scoped_lock lock(mux_mutex_);
+		av_interleaved_write_frame(oc_.get(), &pkt);
+	}
+
+	bool lookahead_has_room(size_t size) const
+	{
+		if(lookahead_count_ < MIN_LOOKAHEAD_FRAMES)
+			return true;
+
+		return lookahead_size_ + size <= lookahead_capacity_ && lookahead_count_ < MAX_LOOKAHEAD_FRAMES;
+	}
+
+	// Blocks until the frame fits in the lookahead. The space is released with the returned ticket.
+	std::shared_ptr<void> reserve_lookahead(const core::read_frame& frame)
+	{
+		auto size = frame.image_size() + frame.audio_data().size() * sizeof(int32_t);
+
+		boost::unique_lock<boost::mutex> lock(lookahead_mutex_);
+
+		if(!lookahead_has_room(size))
+		{
+			boost::timer wait_timer;
+			graph_->set_tag("backpressure");
+
+			while(!lookahead_has_room(size))
+				lookahead_cond_.wait(lock);
+
+			++backpressure_frames_;
+			backpressure_micros_ += static_cast<int64_t>(wait_timer.elapsed()*1000000.0);
 		}
+
+		lookahead_size_ += size;
+		++lookahead_count_;
+		graph_->set_value("lookahead", static_cast<double>(lookahead_size_)/static_cast<double>(lookahead_capacity_));
+
+		return std::shared_ptr<void>(nullptr, [this, size](void*)
+		{
+			{
+				boost::lock_guard<boost::mutex> lock(lookahead_mutex_);
+				lookahead_size_ -= size;
+				--lookahead_count_;
+			}
+			lookahead_cond_.notify_one();
+		});
 	}
 		 
 	void send(const safe_ptr<core::read_frame>& frame)
 	{
-		encode_executor_.begin_invoke([=]
+		auto ticket = reserve_lookahead(*frame);
+
+		video_executor_.begin_invoke([this, frame, ticket]
 		{		
 			boost::timer frame_timer;
 
 			encode_video_frame(*frame);
 
-			if (!key_only_)
-				encode_audio_frame(*frame);
-
 			graph_->set_value("frame-time", frame_timer.elapsed()*format_desc_.fps*0.5);
 			current_encoding_delay_ = frame->get_age_millis();
+			++encoded_frames_;
 		});
-	}
 
-	bool ready_for_frame()
-	{
-		return encode_executor_.size() < encode_executor_.capacity();
+		if (!key_only_)
+		{
+			audio_executor_.begin_invoke([this, frame, ticket]
+			{		
+				boost::timer frame_timer;
+
+				encode_audio_frame(*frame);
+
+				graph_->set_value("audio-time", frame_timer.elapsed()*format_desc_.fps*0.5);
+			});
+		}
 	}
 
-	void mark_dropped()
+	boost::property_tree::wptree info()
 	{
-		graph_->set_tag("dropped-frame");
-
-		// TODO: adjust PTS accordingly to make dropped frames contribute
-		//       to the total playing time
+		boost::property_tree::wptree info;
+		info.add(L"encoded-frames", static_cast<int64_t>(encoded_frames_));
+		{
+			boost::lock_guard<boost::mutex> lock(lookahead_mutex_);
+			info.add(L"lookahead.frames", lookahead_count_);
+			info.add(L"lookahead.bytes", lookahead_size_);
+			info.add(L"lookahead.capacity", lookahead_capacity_);
+		}
+		info.add(L"backpressure.frames", static_cast<int64_t>(backpressure_frames_));
+		info.add(L"backpressure.millis", static_cast<double>(backpressure_micros_)/1000.0);
+		return info;
 	}
 };
 
@@ -635,6 +776,7 @@ struct ffmpeg_consumer_proxy : public core::frame_consumer
 	const std::wstring				filename_;
 	const std::vector<option>		options_;
 	const bool						separate_key_;
+	const size_t					lookahead_capacity_;
 	core::video_format_desc			format_desc_;
 
 	std::unique_ptr<ffmpeg_consumer> consumer_;
@@ -642,10 +784,11 @@ struct ffmpeg_consumer_proxy : public core::frame_consumer
 
 public:
 
-	ffmpeg_consumer_proxy(const std::wstring& filename, const std::vector<option>& options, bool separate_key_)
+	ffmpeg_consumer_proxy(const std::wstring& filename, const std::vector<option>& options, bool separate_key_, size_t lookahead_capacity)
 		: filename_(filename)
 		, options_(options)
 		, separate_key_(separate_key_)
+		, lookahead_capacity_(lookahead_capacity)
 	{
 	}
 	
@@ -664,25 +807,12 @@ public:
 		if (!consumer_)
 			do_initialize(frame->multichannel_view().channel_layout());
 
-		bool ready_for_frame = consumer_->ready_for_frame();
-
-		if (ready_for_frame && separate_key_)
-			ready_for_frame = ready_for_frame && key_only_consumer_->ready_for_frame();
+		// Blocks while the lookahead is full. Frames are dropped by the consumer queue of the
+		// output according to its policy, offline channels wait for the encoders instead.
+		consumer_->send(frame);
 
-		if (ready_for_frame)
-		{
-			consumer_->send(frame);
-
-			if (separate_key_)
-				key_only_consumer_->send(frame);
-		}
-		else
-		{
-			consumer_->mark_dropped();
-
-			if (separate_key_)
-				key_only_consumer_->mark_dropped();
-		}
+		if (separate_key_)
+			key_only_consumer_->send(frame);
 
 		return caspar::wrap_as_future(true);
 	}
@@ -698,6 +828,10 @@ public:
 		info.add(L"type", L"ffmpeg-consumer");
 		info.add(L"filename", filename_);
 		info.add(L"separate_key", separate_key_);
+		if (consumer_)
+			info.add_child(L"encoder", consumer_->info());
+		if (key_only_consumer_)
+			info.add_child(L"key-encoder", key_only_consumer_->info());
 		return info;
 	}
 		
@@ -725,7 +859,8 @@ private:
 				format_desc_,
 				options_,
 				false,
-				channel_layout));
+				channel_layout,
+				lookahead_capacity_));
 
 		if (separate_key_)
 		{
@@ -738,7 +873,8 @@ private:
 					format_desc_,
 					options_,
 					true,
-					channel_layout));
+					channel_layout,
+					lookahead_capacity_));
 		}
 	}
 };	
@@ -775,7 +911,9 @@ safe_ptr<core::frame_consumer> create_consumer(const core::parameters& params)
 		}
 	}
 		
-	return make_safe<ffmpeg_consumer_proxy>(env::media_folder() + filename, options, separate_key);
+	auto lookahead_size = static_cast<size_t>(env::properties().get(L"configuration.ffmpeg.encode-lookahead-mb", 256)) * 1000000;
+		
+	return make_safe<ffmpeg_consumer_proxy>(env::media_folder() + filename, options, separate_key, lookahead_size);
 }
 
 safe_ptr<core::frame_consumer> create_consumer(const boost::property_tree::wptree& ptree)
@@ -783,11 +921,12 @@ safe_ptr<core::frame_consumer> create_consumer(const boost::property_tree::wptre
 	auto filename		= ptree.get<std::wstring>(L"path");
 	auto codec			= ptree.get(L"vcodec", L"libx264");
 	auto separate_key	= ptree.get(L"separate-key", false);
+	auto lookahead_size	= static_cast<size_t>(ptree.get(L"lookahead-mb", env::properties().get(L"configuration.ffmpeg.encode-lookahead-mb", 256))) * 1000000;
 
 	std::vector<option> options;
 	options.push_back(option("vcodec", narrow(codec)));
 	
-	return make_safe<ffmpeg_consumer_proxy>(env::media_folder() + filename, options, separate_key);
+	return make_safe<ffmpeg_consumer_proxy>(env::media_folder() + filename, options, separate_key, lookahead_size);
 }
 
 }}
@@ -52,6 +52,7 @@ namespace caspar { namespace ffmpeg {
 	
 struct audio_decoder::implementation : boost::noncopyable
 {	
+	const safe_ptr<AVFormatContext>								format_context_;
 	int															index_;
 	const safe_ptr<AVCodecContext>								codec_context_;		
 	const core::video_format_desc								format_desc_;
@@ -65,9 +66,13 @@ struct audio_decoder::implementation : boost::noncopyable
 	const int64_t												nb_frames_;
 	tbb::atomic<size_t>											file_frame_number_;
 	core::channel_layout										channel_layout_;
+
+	int64_t														seek_pts_;		// Samples before this are dropped after a frame accurate seek.
+	size_t														skip_samples_;
 public:
 	explicit implementation(const safe_ptr<AVFormatContext>& context, const core::video_format_desc& format_desc, const std::wstring& custom_channel_order) 
-		: format_desc_(format_desc)	
+		: format_context_(context)
+		, format_desc_(format_desc)	
 		, codec_context_(open_codec(*context, AVMEDIA_TYPE_AUDIO, index_))
 		, resampler_(codec_context_->channels,		codec_context_->channels,
 					 format_desc.audio_sample_rate, codec_context_->sample_rate,
@@ -75,6 +80,8 @@ public:
 		, buffer1_(AVCODEC_MAX_AUDIO_FRAME_SIZE*2)
 		, nb_frames_(0)//context->streams[index_]->nb_frames)
 		, channel_layout_(get_audio_channel_layout(*codec_context_, custom_channel_order))
+		, seek_pts_(AV_NOPTS_VALUE)
+		, skip_samples_(0)
 	{
 		file_frame_number_ = 0;
 
@@ -102,10 +109,28 @@ public:
 		{
 			packets_.pop();
 			file_frame_number_ = static_cast<size_t>(packet->pos);
+			seek_pts_		   = packet->pts != AV_NOPTS_VALUE ? av_rescale_q(packet->pts, format_context_->streams[packet->stream_index]->time_base, format_context_->streams[index_]->time_base) : AV_NOPTS_VALUE;
 			avcodec_flush_buffers(codec_context_.get());
 			return flush_audio();
 		}
 
+		if(seek_pts_ != AV_NOPTS_VALUE)
+		{
+			if(packet->pts != AV_NOPTS_VALUE)
+			{
+				if(packet->duration > 0 && packet->pts + packet->duration <= seek_pts_)
+				{
+					packets_.pop();
+					return poll();
+				}
+
+				// Drop the part of the first packet that precedes the video frame that was seeked to.
+				auto seconds	= static_cast<double>(seek_pts_ - packet->pts) * av_q2d(format_context_->streams[index_]->time_base);
+				skip_samples_	= seconds > 0.0 ? static_cast<size_t>(seconds * format_desc_.audio_sample_rate + 0.5) * codec_context_->channels : 0;
+			}
+			seek_pts_ = AV_NOPTS_VALUE;
+		}
+
 		auto audio = decode(*packet);
 
 		if(packet->size == 0)					
@@ -131,10 +156,13 @@ public:
 		
 		const auto n_samples = buffer1_.size() / av_get_bytes_per_sample(AV_SAMPLE_FMT_S32);
 		const auto samples = reinterpret_cast<int32_t*>(buffer1_.data());
+		const auto skipped = std::min(skip_samples_, n_samples);
+
+		skip_samples_ -= skipped;
 
 		++file_frame_number_;
 
-		return std::make_shared<core::audio_buffer>(samples, samples + n_samples);
+		return std::make_shared<core::audio_buffer>(samples + skipped, samples + n_samples);
 	}
 
 	bool ready() const
@@ -34,6 +34,7 @@
 #include "video/video_decoder.h"
 
 #include <common/env.h>
+#include <common/concurrency/executor.h>
 #include <common/utility/assert.h>
 #include <common/diagnostics/graph.h>
 
@@ -44,6 +45,8 @@
 #include <core/producer/frame/frame_factory.h>
 #include <core/producer/frame/basic_frame.h>
 #include <core/producer/frame/frame_transform.h>
+#include <core/producer/frame/frame_visitor.h>
+#include <core/mixer/write_frame.h>
 
 #include <boost/algorithm/string.hpp>
 #include <boost/assign.hpp>
@@ -54,14 +57,55 @@
 #include <boost/range/algorithm/find.hpp>
 #include <boost/regex.hpp>
 
+#include <tbb/atomic.h>
+#include <tbb/concurrent_queue.h>
 #include <tbb/parallel_invoke.h>
 
 #include <limits>
 #include <memory>
-#include <queue>
 
 namespace caspar { namespace ffmpeg {
 
+static const size_t MIN_DECODE_AHEAD_FRAMES	= 2;	// Always allowed, regardless of size.
+static const size_t MAX_DECODE_AHEAD_FRAMES	= 64;	// Bounds audio only files, whose frames are tiny.
+
+// Bytes of image and audio data referenced by a frame.
+class frame_size_visitor : public core::frame_visitor
+{
+	size_t size_;
+public:
+	frame_size_visitor() : size_(0){}
+
+	virtual void begin(core::basic_frame&) override{}
+	virtual void end() override{}
+	virtual void visit(core::write_frame& frame) override
+	{
+		BOOST_FOREACH(auto& plane, frame.get_pixel_format_desc().planes)
+			size_ += plane.size;
+		size_ += frame.audio_data().size() * sizeof(int32_t);
+	}
+
+	size_t size() const{return size_;}
+};
+
+static size_t get_frame_size(const safe_ptr<core::basic_frame>& frame)
+{
+	frame_size_visitor visitor;
+	frame->accept(visitor);
+	return visitor.size();
+}
+
+// A decoded frame waiting for receive(). Frames decoded before the latest seek have an older generation.
+struct decoded_frame
+{
+	safe_ptr<core::basic_frame>	frame;
+	uint32_t					file_frame_number;
+	size_t						size;
+	int							generation;
+
+	decoded_frame() : frame(core::basic_frame::empty()), file_frame_number(0), size(0), generation(0){}
+};
+
 std::wstring get_relative_or_original(
 		const std::wstring& filename,
 		const boost::filesystem::wpath& relative_to)
@@ -115,10 +159,21 @@ struct ffmpeg_producer : public core::frame_producer
 
 	safe_ptr<core::basic_frame>									last_frame_;
 	
-	std::queue<std::pair<safe_ptr<core::basic_frame>, size_t>>	frame_buffer_;
+	tbb::concurrent_queue<decoded_frame>						frame_buffer_;
+	tbb::atomic<size_t>											frame_buffer_size_;
+	tbb::atomic<size_t>											frame_buffer_count_;
+	const size_t												decode_ahead_size_;	// 0 decodes synchronously in receive().
+	tbb::atomic<int>											generation_;
+	tbb::atomic<int>											decode_generation_;	// Of the latest seek the decoders have passed.
+	tbb::atomic<int>											hints_;
+	tbb::atomic<bool>											decode_pending_;
+	tbb::atomic<bool>											drained_;
+	tbb::atomic<int64_t>										underruns_;
 
 	int64_t														frame_number_;
 	uint32_t													file_frame_number_;
+
+	std::unique_ptr<executor>									decode_executor_;
 		
 public:
 	explicit ffmpeg_producer(const safe_ptr<core::frame_factory>& frame_factory, const std::wstring& filename, FFMPEG_Resource resource_type, const std::wstring& filter, bool loop, uint32_t start, uint32_t length, bool thumbnail_mode, const std::wstring& custom_channel_order, const ffmpeg_producer_params& vid_params)
@@ -134,15 +189,28 @@ public:
 		, length_(length)
 		, thumbnail_mode_(thumbnail_mode)
 		, last_frame_(core::basic_frame::empty())
+		, decode_ahead_size_(thumbnail_mode ? 0 : env::properties().get(L"configuration.ffmpeg.decode-ahead-mb", 32) * 1000000)
 		, frame_number_(0)
+		, file_frame_number_(0)
 	{
+		frame_buffer_size_	= 0;
+		frame_buffer_count_	= 0;
+		generation_			= 0;
+		decode_generation_	= 0;
+		hints_				= 0;
+		decode_pending_		= false;
+		drained_			= false;
+		underruns_			= 0;
+
 		graph_->set_color("frame-time", diagnostics::color(0.1f, 1.0f, 0.1f));
 		graph_->set_color("underflow", diagnostics::color(0.6f, 0.3f, 0.9f));	
+		graph_->set_color("decode-time", diagnostics::color(0.0f, 0.6f, 0.9f));
+		graph_->set_color("decode-ahead", diagnostics::color(0.9f, 0.9f, 0.5f));
 		diagnostics::register_graph(graph_);
 	
 		try
 		{
-			video_decoder_.reset(new video_decoder(input_.context()));
+			video_decoder_.reset(new video_decoder(input_.context(), frame_factory));
 			if (!thumbnail_mode_)
 				CASPAR_LOG(info) << print() << L" " << video_decoder_->print();
 		}
@@ -184,6 +252,24 @@ public:
 			BOOST_THROW_EXCEPTION(averror_stream_not_found() << msg_info("No streams found"));
 
 		muxer_.reset(new frame_muxer(fps_, frame_factory, thumbnail_mode_, audio_channel_layout, filter));
+
+		if(decode_ahead_size_ > 0)
+		{
+			decode_executor_.reset(new executor(print()));
+			input_.set_packet_handler([this]
+			{
+				decode_tick();
+			});
+			decode_tick();
+		}
+	}
+
+	~ffmpeg_producer()
+	{
+		input_.set_packet_handler(nullptr);
+
+		// The decoders and muxer are owned by the decode thread until it has been joined.
+		decode_executor_.reset();
 	}
 
 	// frame_producer
@@ -202,45 +288,190 @@ public:
 	{		
 		frame_timer_.restart();
 		auto disable_logging = temporary_disable_logging_for_thread(thumbnail_mode_);
-				
-		for(int n = 0; n < 16 && frame_buffer_.size() < 2; ++n)
-			try_decode_frame(hints);
+
+		if(decode_executor_)
+			hints_ = hints;
+		else
+		{
+			for(int n = 0; n < 16 && frame_buffer_count_ < 2; ++n)
+				try_decode_frame(hints, decode_generation_);
+		}
+		
+		decoded_frame frame;
+		bool popped = try_pop_frame(frame);
+
+		if(!popped && (hints & core::frame_producer::OFFLINE_HINT) && resource_type_ == FFMPEG_FILE)
+			popped = wait_for_frame(hints, frame);
+
+		if(decode_executor_)
+		{
+			decode_tick(); // There is room in the buffer.
+			graph_->set_value("decode-ahead", static_cast<double>(frame_buffer_size_)/static_cast<double>(decode_ahead_size_));
+		}
 		
 		graph_->set_value("frame-time", frame_timer_.elapsed()*format_desc_.fps*0.5);
 
-		if (frame_buffer_.empty())
+		if (!popped)
 		{
-			if (input_.eof())
+			// Without a decode thread the decoders have been given their chance above.
+			if (input_.eof() && (!decode_executor_ || drained_))
 			{
 				send_osc();
 				return std::make_pair(last_frame(), -1);
 			}
 			else if (resource_type_ == FFMPEG_FILE)
 			{
+				++underruns_;
 				graph_->set_tag("underflow");  
 				send_osc();
 				return std::make_pair(core::basic_frame::late(), -1);     
 			}
 			else
 			{
+				++underruns_;
 				send_osc();
 				return std::make_pair(last_frame(), -1);
 			}
 		}
 		
-		auto frame = frame_buffer_.front(); 
-		frame_buffer_.pop();
-		
 		++frame_number_;
-		file_frame_number_ = frame.second;
+		file_frame_number_ = frame.file_frame_number;
 
 		graph_->set_text(print());
 
-		last_frame_ = frame.first;
+		last_frame_ = frame.frame;
 
 		send_osc();
 
-		return frame;
+		return std::make_pair(frame.frame, frame.file_frame_number);
+	}
+
+	bool try_pop_frame(decoded_frame& frame)
+	{
+		while(frame_buffer_.try_pop(frame))
+		{
+			frame_buffer_size_ -= frame.size;
+			--frame_buffer_count_;
+			if(frame.generation == generation_)
+				return true;
+		}
+		return false;
+	}
+
+	// An offline channel has no deadline, so rather than presenting a late frame we wait until the
+	// decoders have caught up. Returns false once the input has been drained.
+	bool wait_for_frame(int hints, decoded_frame& frame)
+	{
+		while(!try_pop_frame(frame))
+		{
+			if(decode_executor_)
+			{
+				if(drained_)
+					return false;
+
+				decode_tick();
+				boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+			}
+			else
+			{
+				auto count = frame_buffer_count_;
+				bool eof = input_.eof();
+
+				try_decode_frame(hints, decode_generation_);
+
+				if(frame_buffer_count_ == count)
+				{
+					if(eof)
+						return false;
+
+					boost::this_thread::sleep(boost::posix_time::milliseconds(1)); // Waiting for the input.
+				}
+			}
+		}
+		return true;
+	}
+
+	boost::unique_future<bool> seek(uint32_t target)
+	{
+		int generation = ++generation_; // Anything decoded before the seek is discarded by render_frame.
+		drained_ = false;
+
+		if(!decode_executor_)
+		{
+			// Decoded on the thread that seeks, see render_specific_frame.
+			decode_generation_ = generation;
+			return input_.seek(target);
+		}
+
+		// Runs in between two decodes, so that every frame decoded after the input has seeked is tagged with the
+		// new generation and every frame decoded before with an older one.
+		auto result = decode_executor_->begin_invoke([=]() -> bool
+		{
+			auto seeked = input_.seek(target).get();
+
+			decode_generation_	= generation;
+			drained_			= false;
+
+			return seeked;
+		}, high_priority);
+
+		decode_tick();
+		return std::move(result);
+	}
+
+	bool decode_ahead_full() const
+	{
+		if(frame_buffer_count_ < MIN_DECODE_AHEAD_FRAMES)
+			return false;
+
+		return frame_buffer_size_ >= decode_ahead_size_ || frame_buffer_count_ >= MAX_DECODE_AHEAD_FRAMES;
+	}
+
+	// Decodes on the decode thread until the buffer is full or the input has nothing more to give.
+	void decode_tick()
+	{
+		if(!decode_executor_ || decode_pending_.fetch_and_store(true))
+			return;
+
+		decode_executor_->begin_invoke([this]
+		{
+			decode_pending_ = false;
+
+			if(decode_ahead_full())
+				return;
+
+			try
+			{
+				auto disable_logging = temporary_disable_logging_for_thread(thumbnail_mode_);
+
+				boost::timer decode_timer;
+				auto count = frame_buffer_count_;
+				bool eof = input_.eof();
+
+				try_decode_frame(hints_, decode_generation_);
+
+				if(frame_buffer_count_ > count)
+					graph_->set_value("decode-time", decode_timer.elapsed()*format_desc_.fps*0.5);
+
+				if(frame_buffer_count_ == count)
+				{
+					if(eof)
+					{
+						drained_ = true;
+						return; // Until the next seek.
+					}
+
+					return; // Until the input has buffered another packet, see set_packet_handler.
+				}
+
+				decode_tick();
+			}
+			catch(...)
+			{
+				CASPAR_LOG_CURRENT_EXCEPTION();
+				drained_ = true;
+			}
+		});
 	}
 
 	void send_osc()
@@ -258,13 +489,16 @@ public:
 	
 	safe_ptr<core::basic_frame> render_specific_frame(uint32_t file_position, int hints)
 	{
+		if (input_.is_frame_accurate())
+			return render_indexed_frame(file_position, hints);
+
 		// Some trial and error and undeterministic stuff here
 		static const int NUM_RETRIES = 32;
 		
 		if (file_position > 0) // Assume frames are requested in sequential order,
 			                   // therefore no seeking should be necessary for the first frame.
 		{
-			input_.seek(file_position > 1 ? file_position - 2: file_position).get();
+			seek(file_position > 1 ? file_position - 2: file_position).get();
 			boost::this_thread::sleep(boost::posix_time::milliseconds(40));
 		}
 
@@ -289,7 +523,7 @@ public:
 				if (adjusted_seek > 1 && file_position > 0)
 				{
 					CASPAR_LOG(trace) << print() << L" adjusting to " << adjusted_seek;
-					input_.seek(static_cast<uint32_t>(adjusted_seek) - 1).get();
+					seek(static_cast<uint32_t>(adjusted_seek) - 1).get();
 					boost::this_thread::sleep(boost::posix_time::milliseconds(40));
 				}
 				else
@@ -301,6 +535,31 @@ public:
 		return core::basic_frame::empty();
 	}
 
+	// With a seek index the first frame decoded after the seek is the requested one, so this only has to wait
+	// for the input and decoders to catch up.
+	safe_ptr<core::basic_frame> render_indexed_frame(uint32_t file_position, int hints)
+	{
+		static const int NUM_RETRIES = 400;
+
+		if (file_position > 0)
+			seek(file_position).get();
+
+		for (int i = 0; i < NUM_RETRIES; ++i)
+		{
+			auto frame = render_frame(hints);
+
+			if (frame.second == std::numeric_limits<uint32_t>::max())
+				boost::this_thread::sleep(boost::posix_time::milliseconds(5));
+			else if (frame.second > file_position)
+				return frame.first;
+
+			// Otherwise a frame decoded before the seek.
+		}
+
+		CASPAR_LOG(trace) << print() << " Giving up finding frame at " << file_position;
+		return core::basic_frame::empty();
+	}
+
 	virtual safe_ptr<core::basic_frame> create_thumbnail_frame() override
 	{
 		auto disable_logging = temporary_disable_logging_for_thread(thumbnail_mode_);
@@ -350,7 +609,7 @@ public:
 	
 	uint32_t file_frame_number() const
 	{
-		return video_decoder_ ? video_decoder_->file_frame_number() : 0;
+		return file_frame_number_; // Of the frame last received, the decoders may be ahead.
 	}
 
 	virtual uint32_t nb_frames() const override
@@ -404,6 +663,12 @@ public:
 		info.add(L"nb-frames",			nb_frames2 == std::numeric_limits<int64_t>::max() ? -1 : nb_frames2);
 		info.add(L"file-frame-number",	file_frame_number_);
 		info.add(L"file-nb-frames",		file_nb_frames());
+		info.add_child(L"demux",		input_.info());
+		info.add(L"decode-ahead.enabled",	decode_executor_ != nullptr);
+		info.add(L"decode-ahead.frames",	static_cast<size_t>(frame_buffer_count_));
+		info.add(L"decode-ahead.size",		static_cast<size_t>(frame_buffer_size_));
+		info.add(L"decode-ahead.max-size",	decode_ahead_size_);
+		info.add(L"decode-ahead.underruns",	static_cast<int64_t>(underruns_));
 		return info;
 	}
 
@@ -428,14 +693,14 @@ public:
 		}
 		if(boost::regex_match(param, what, seek_exp))
 		{
-			input_.seek(boost::lexical_cast<uint32_t>(what["VALUE"].str()));
+			seek(boost::lexical_cast<uint32_t>(what["VALUE"].str()));
 			return L"";
 		}
 
 		BOOST_THROW_EXCEPTION(invalid_argument());
 	}
 
-	void try_decode_frame(int hints)
+	void try_decode_frame(int hints, int generation)
 	{
 		std::shared_ptr<AVPacket> pkt;
 
@@ -486,7 +751,17 @@ public:
 		//file_frame_number = std::max(file_frame_number, audio_decoder_ ? audio_decoder_->file_frame_number() : 0);
 
 		for(auto frame = muxer_->poll(); frame; frame = muxer_->poll())
-			frame_buffer_.push(std::make_pair(make_safe_ptr(frame), file_frame_number));
+		{
+			decoded_frame decoded;
+			decoded.frame				= make_safe_ptr(frame);
+			decoded.file_frame_number	= static_cast<uint32_t>(file_frame_number);
+			decoded.size				= get_frame_size(decoded.frame);
+			decoded.generation			= generation;
+
+			frame_buffer_size_ += decoded.size;
+			++frame_buffer_count_;
+			frame_buffer_.push(decoded);
+		}
 	}
 
 	core::monitor::source& monitor_output()
@@ -540,8 +815,9 @@ safe_ptr<core::frame_producer> create_producer(
 	auto filter_str = params.get(L"FILTER", L""); 	
 	auto custom_channel_order	= params.get(L"CHANNEL_LAYOUT", L"");
 
-	boost::replace_all(filter_str, L"DEINTERLACE", L"YADIF=0:-1");
 	boost::replace_all(filter_str, L"DEINTERLACE_BOB", L"YADIF=1:-1");
+	boost::replace_all(filter_str, L"DEINTERLACE_BLEND", L"BLEND");
+	boost::replace_all(filter_str, L"DEINTERLACE", L"YADIF=0:-1");
 	
 	ffmpeg_producer_params vid_params;
 	bool haveFFMPEGStartIndicator = false;
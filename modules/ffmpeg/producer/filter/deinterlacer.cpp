@@ -0,0 +1,885 @@
+/*
+* Copyright 2013 Sveriges Television AB http://casparcg.com/
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+#include "../../stdafx.h"
+
+#include "deinterlacer.h"
+
+#include "../../ffmpeg_error.h"
+
+#include <common/exception/exceptions.h>
+
+#include <tbb/parallel_for.h>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <emmintrin.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <queue>
+#include <vector>
+
+#if defined(_MSC_VER)
+#pragma warning (push)
+#pragma warning (disable : 4244)
+#endif
+extern "C"
+{
+	#define __STDC_CONSTANT_MACROS
+	#define __STDC_LIMIT_MACROS
+	#include <libavcodec/avcodec.h>
+	#include <libavutil/imgutils.h>
+	#include <libavutil/pixdesc.h>
+	#include <libswscale/swscale.h>
+}
+#if defined(_MSC_VER)
+#pragma warning (pop)
+#endif
+
+// AVX2 intrinsics are available from VS2012, the avx2 path is only selected at runtime when
+// both the cpu and the os (xsave) support it.
+#if defined(_MSC_VER) && _MSC_VER >= 1700
+	#include <immintrin.h>
+	#include <intrin.h>
+	#define CASPAR_DEINTERLACE_AVX2
+	#define CASPAR_DEINTERLACE_AVX2_TARGET
+#elif defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+	#include <immintrin.h>
+	#define CASPAR_DEINTERLACE_AVX2
+	#define CASPAR_DEINTERLACE_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
+namespace caspar { namespace ffmpeg {
+
+namespace {
+
+// Row pointers used to interpolate one missing line. "up" and "dn" are the kept lines above
+// and below, prev2/next2 are the two frames surrounding the missing field in time.
+struct yadif_rows
+{
+	const uint8_t* prev_up;
+	const uint8_t* prev_dn;
+	const uint8_t* cur_up;
+	const uint8_t* cur_dn;
+	const uint8_t* next_up;
+	const uint8_t* next_dn;
+	const uint8_t* prev2;
+	const uint8_t* next2;
+	const uint8_t* prev2_up2;
+	const uint8_t* prev2_dn2;
+	const uint8_t* next2_up2;
+	const uint8_t* next2_dn2;
+};
+
+typedef void (*yadif_line_func)(uint8_t* dst, const yadif_rows& rows, int width, int step, bool spatial_check);
+typedef void (*average_line_func)(uint8_t* dst, const uint8_t* a, const uint8_t* b, int width);
+typedef void (*blend_line_func)(uint8_t* dst, const uint8_t* above, const uint8_t* row, const uint8_t* below, int width);
+
+struct line_kernels
+{
+	yadif_line_func		yadif;
+	average_line_func	average;
+	blend_line_func		blend;
+};
+
+// Scalar
+
+inline int at(const uint8_t* row, int x, int offset, int width)
+{
+	auto n = x + offset;
+	return row[n < 0 || n >= width ? x : n];
+}
+
+inline bool try_direction(const yadif_rows& r, int x, int j, int step, int width, int& score, int& pred)
+{
+	auto s = std::abs(at(r.cur_up, x, (j-1)*step, width) - at(r.cur_dn, x, (-j-1)*step, width)) +
+			 std::abs(at(r.cur_up, x, j*step, width)	 - at(r.cur_dn, x, -j*step, width)) +
+			 std::abs(at(r.cur_up, x, (j+1)*step, width) - at(r.cur_dn, x, (1-j)*step, width));
+
+	if(s >= score)
+		return false;
+
+	score = s;
+	pred  = (at(r.cur_up, x, j*step, width) + at(r.cur_dn, x, -j*step, width)) >> 1;
+	return true;
+}
+
+void yadif_pixels(uint8_t* dst, const yadif_rows& r, int begin, int end, int width, int step, bool spatial_check)
+{
+	for(int x = begin; x < end; ++x)
+	{
+		int c = r.cur_up[x];
+		int d = (r.prev2[x] + r.next2[x]) >> 1;
+		int e = r.cur_dn[x];
+
+		int temporal_diff0 = std::abs(r.prev2[x] - r.next2[x]);
+		int temporal_diff1 = (std::abs(r.prev_up[x] - c) + std::abs(r.prev_dn[x] - e)) >> 1;
+		int temporal_diff2 = (std::abs(r.next_up[x] - c) + std::abs(r.next_dn[x] - e)) >> 1;
+		int diff = std::max(temporal_diff0 >> 1, std::max(temporal_diff1, temporal_diff2));
+
+		int spatial_pred  = (c + e) >> 1;
+		int spatial_score = std::abs(at(r.cur_up, x, -step, width) - at(r.cur_dn, x, -step, width)) + std::abs(c - e) +
+							std::abs(at(r.cur_up, x,  step, width) - at(r.cur_dn, x,  step, width)) - 1;
+
+		// The second direction on each side is only tried if the first one was an improvement.
+		if(try_direction(r, x, -1, step, width, spatial_score, spatial_pred))
+			try_direction(r, x, -2, step, width, spatial_score, spatial_pred);
+		if(try_direction(r, x,  1, step, width, spatial_score, spatial_pred))
+			try_direction(r, x,  2, step, width, spatial_score, spatial_pred);
+
+		if(spatial_check)
+		{
+			int b = (r.prev2_up2[x] + r.next2_up2[x]) >> 1;
+			int f = (r.prev2_dn2[x] + r.next2_dn2[x]) >> 1;
+			int max = std::max(d - e, std::max(d - c, std::min(b - c, f - e)));
+			int min = std::min(d - e, std::min(d - c, std::max(b - c, f - e)));
+			diff = std::max(diff, std::max(min, -max));
+		}
+
+		if(spatial_pred > d + diff)
+			spatial_pred = d + diff;
+		else if(spatial_pred < d - diff)
+			spatial_pred = d - diff;
+
+		dst[x] = static_cast<uint8_t>(spatial_pred);
+	}
+}
+
+// The reference the simd kernels are verified against, see set_deinterlace_simd_level.
+
+void yadif_line_scalar(uint8_t* dst, const yadif_rows& r, int width, int step, bool spatial_check)
+{
+	yadif_pixels(dst, r, 0, width, width, step, spatial_check);
+}
+
+void average_line_scalar(uint8_t* dst, const uint8_t* a, const uint8_t* b, int width)
+{
+	for(int x = 0; x < width; ++x)
+		dst[x] = static_cast<uint8_t>((a[x] + b[x] + 1) >> 1);
+}
+
+void blend_line_scalar(uint8_t* dst, const uint8_t* above, const uint8_t* row, const uint8_t* below, int width)
+{
+	for(int x = 0; x < width; ++x)
+		dst[x] = static_cast<uint8_t>((above[x] + 2*row[x] + below[x] + 2) >> 2);
+}
+
+// SSE2, 8 pixels per iteration in 16 bit lanes.
+
+inline __m128i load_sse2(const uint8_t* p)
+{
+	return _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)), _mm_setzero_si128());
+}
+
+inline __m128i abs_diff_sse2(__m128i a, __m128i b)
+{
+	return _mm_max_epi16(_mm_sub_epi16(a, b), _mm_sub_epi16(b, a));
+}
+
+inline __m128i select_sse2(__m128i mask, __m128i a, __m128i b)
+{
+	return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+inline __m128i try_direction_sse2(const uint8_t* up, const uint8_t* dn, int j, int step, __m128i mask, __m128i& score, __m128i& pred)
+{
+	auto s = _mm_add_epi16(_mm_add_epi16(
+				abs_diff_sse2(load_sse2(up + (j-1)*step), load_sse2(dn + (-j-1)*step)),
+				abs_diff_sse2(load_sse2(up + j*step),	  load_sse2(dn - j*step))),
+				abs_diff_sse2(load_sse2(up + (j+1)*step), load_sse2(dn + (1-j)*step)));
+	auto p = _mm_srli_epi16(_mm_add_epi16(load_sse2(up + j*step), load_sse2(dn - j*step)), 1);
+
+	auto better = _mm_and_si128(mask, _mm_cmplt_epi16(s, score));
+	score = select_sse2(better, s, score);
+	pred  = select_sse2(better, p, pred);
+	return better;
+}
+
+void yadif_line_sse2(uint8_t* dst, const yadif_rows& r, int width, int step, bool spatial_check)
+{
+	auto begin	= std::min(3*step, width);
+	auto end	= std::max(begin, width - 3*step);
+	auto simd_end = begin + ((end - begin) & ~7);
+
+	auto all = _mm_set1_epi16(-1);
+	auto one = _mm_set1_epi16(1);
+
+	for(int x = begin; x < simd_end; x += 8)
+	{
+		auto c		= load_sse2(r.cur_up + x);
+		auto e		= load_sse2(r.cur_dn + x);
+		auto prev2	= load_sse2(r.prev2 + x);
+		auto next2	= load_sse2(r.next2 + x);
+		auto d		= _mm_srli_epi16(_mm_add_epi16(prev2, next2), 1);
+
+		auto temporal_diff0 = abs_diff_sse2(prev2, next2);
+		auto temporal_diff1 = _mm_srli_epi16(_mm_add_epi16(abs_diff_sse2(load_sse2(r.prev_up + x), c), abs_diff_sse2(load_sse2(r.prev_dn + x), e)), 1);
+		auto temporal_diff2 = _mm_srli_epi16(_mm_add_epi16(abs_diff_sse2(load_sse2(r.next_up + x), c), abs_diff_sse2(load_sse2(r.next_dn + x), e)), 1);
+		auto diff = _mm_max_epi16(_mm_srli_epi16(temporal_diff0, 1), _mm_max_epi16(temporal_diff1, temporal_diff2));
+
+		auto pred  = _mm_srli_epi16(_mm_add_epi16(c, e), 1);
+		auto score = _mm_sub_epi16(_mm_add_epi16(_mm_add_epi16(
+						abs_diff_sse2(load_sse2(r.cur_up + x - step), load_sse2(r.cur_dn + x - step)),
+						abs_diff_sse2(c, e)),
+						abs_diff_sse2(load_sse2(r.cur_up + x + step), load_sse2(r.cur_dn + x + step))), one);
+
+		auto left = try_direction_sse2(r.cur_up + x, r.cur_dn + x, -1, step, all, score, pred);
+		try_direction_sse2(r.cur_up + x, r.cur_dn + x, -2, step, left, score, pred);
+		auto right = try_direction_sse2(r.cur_up + x, r.cur_dn + x, 1, step, all, score, pred);
+		try_direction_sse2(r.cur_up + x, r.cur_dn + x, 2, step, right, score, pred);
+
+		if(spatial_check)
+		{
+			auto b = _mm_srli_epi16(_mm_add_epi16(load_sse2(r.prev2_up2 + x), load_sse2(r.next2_up2 + x)), 1);
+			auto f = _mm_srli_epi16(_mm_add_epi16(load_sse2(r.prev2_dn2 + x), load_sse2(r.next2_dn2 + x)), 1);
+			auto de = _mm_sub_epi16(d, e);
+			auto dc = _mm_sub_epi16(d, c);
+			auto bc = _mm_sub_epi16(b, c);
+			auto fe = _mm_sub_epi16(f, e);
+			auto max = _mm_max_epi16(de, _mm_max_epi16(dc, _mm_min_epi16(bc, fe)));
+			auto min = _mm_min_epi16(de, _mm_min_epi16(dc, _mm_max_epi16(bc, fe)));
+			diff = _mm_max_epi16(diff, _mm_max_epi16(min, _mm_sub_epi16(_mm_setzero_si128(), max)));
+		}
+
+		pred = _mm_max_epi16(_mm_min_epi16(pred, _mm_add_epi16(d, diff)), _mm_sub_epi16(d, diff));
+
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16(pred, pred));
+	}
+
+	yadif_pixels(dst, r, 0, begin, width, step, spatial_check);
+	yadif_pixels(dst, r, simd_end, width, width, step, spatial_check);
+}
+
+// AVX2, 16 pixels per iteration in 16 bit lanes.
+
+#ifdef CASPAR_DEINTERLACE_AVX2
+
+CASPAR_DEINTERLACE_AVX2_TARGET
+inline __m256i load_avx2(const uint8_t* p)
+{
+	return _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+}
+
+CASPAR_DEINTERLACE_AVX2_TARGET
+inline __m256i abs_diff_avx2(__m256i a, __m256i b)
+{
+	return _mm256_abs_epi16(_mm256_sub_epi16(a, b));
+}
+
+CASPAR_DEINTERLACE_AVX2_TARGET
+inline __m256i try_direction_avx2(const uint8_t* up, const uint8_t* dn, int j, int step, __m256i mask, __m256i& score, __m256i& pred)
+{
+	auto s = _mm256_add_epi16(_mm256_add_epi16(
+				abs_diff_avx2(load_avx2(up + (j-1)*step), load_avx2(dn + (-j-1)*step)),
+				abs_diff_avx2(load_avx2(up + j*step),	  load_avx2(dn - j*step))),
+				abs_diff_avx2(load_avx2(up + (j+1)*step), load_avx2(dn + (1-j)*step)));
+	auto p = _mm256_srli_epi16(_mm256_add_epi16(load_avx2(up + j*step), load_avx2(dn - j*step)), 1);
+
+	auto better = _mm256_and_si256(mask, _mm256_cmpgt_epi16(score, s));
+	score = _mm256_blendv_epi8(score, s, better);
+	pred  = _mm256_blendv_epi8(pred, p, better);
+	return better;
+}
+
+CASPAR_DEINTERLACE_AVX2_TARGET
+void yadif_line_avx2(uint8_t* dst, const yadif_rows& r, int width, int step, bool spatial_check)
+{
+	auto begin	= std::min(3*step, width);
+	auto end	= std::max(begin, width - 3*step);
+	auto simd_end = begin + ((end - begin) & ~15);
+
+	auto all = _mm256_set1_epi16(-1);
+	auto one = _mm256_set1_epi16(1);
+
+	for(int x = begin; x < simd_end; x += 16)
+	{
+		auto c		= load_avx2(r.cur_up + x);
+		auto e		= load_avx2(r.cur_dn + x);
+		auto prev2	= load_avx2(r.prev2 + x);
+		auto next2	= load_avx2(r.next2 + x);
+		auto d		= _mm256_srli_epi16(_mm256_add_epi16(prev2, next2), 1);
+
+		auto temporal_diff0 = abs_diff_avx2(prev2, next2);
+		auto temporal_diff1 = _mm256_srli_epi16(_mm256_add_epi16(abs_diff_avx2(load_avx2(r.prev_up + x), c), abs_diff_avx2(load_avx2(r.prev_dn + x), e)), 1);
+		auto temporal_diff2 = _mm256_srli_epi16(_mm256_add_epi16(abs_diff_avx2(load_avx2(r.next_up + x), c), abs_diff_avx2(load_avx2(r.next_dn + x), e)), 1);
+		auto diff = _mm256_max_epi16(_mm256_srli_epi16(temporal_diff0, 1), _mm256_max_epi16(temporal_diff1, temporal_diff2));
+
+		auto pred  = _mm256_srli_epi16(_mm256_add_epi16(c, e), 1);
+		auto score = _mm256_sub_epi16(_mm256_add_epi16(_mm256_add_epi16(
+						abs_diff_avx2(load_avx2(r.cur_up + x - step), load_avx2(r.cur_dn + x - step)),
+						abs_diff_avx2(c, e)),
+						abs_diff_avx2(load_avx2(r.cur_up + x + step), load_avx2(r.cur_dn + x + step))), one);
+
+		auto left = try_direction_avx2(r.cur_up + x, r.cur_dn + x, -1, step, all, score, pred);
+		try_direction_avx2(r.cur_up + x, r.cur_dn + x, -2, step, left, score, pred);
+		auto right = try_direction_avx2(r.cur_up + x, r.cur_dn + x, 1, step, all, score, pred);
+		try_direction_avx2(r.cur_up + x, r.cur_dn + x, 2, step, right, score, pred);
+
+		if(spatial_check)
+		{
+			auto b = _mm256_srli_epi16(_mm256_add_epi16(load_avx2(r.prev2_up2 + x), load_avx2(r.next2_up2 + x)), 1);
+			auto f = _mm256_srli_epi16(_mm256_add_epi16(load_avx2(r.prev2_dn2 + x), load_avx2(r.next2_dn2 + x)), 1);
+			auto de = _mm256_sub_epi16(d, e);
+			auto dc = _mm256_sub_epi16(d, c);
+			auto bc = _mm256_sub_epi16(b, c);
+			auto fe = _mm256_sub_epi16(f, e);
+			auto max = _mm256_max_epi16(de, _mm256_max_epi16(dc, _mm256_min_epi16(bc, fe)));
+			auto min = _mm256_min_epi16(de, _mm256_min_epi16(dc, _mm256_max_epi16(bc, fe)));
+			diff = _mm256_max_epi16(diff, _mm256_max_epi16(min, _mm256_sub_epi16(_mm256_setzero_si256(), max)));
+		}
+
+		pred = _mm256_max_epi16(_mm256_min_epi16(pred, _mm256_add_epi16(d, diff)), _mm256_sub_epi16(d, diff));
+
+		// packus works per 128 bit lane, move the low half of each lane together.
+		auto packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(pred, pred), 0xD8);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm256_castsi256_si128(packed));
+	}
+
+	_mm256_zeroupper(); // Avoid the avx to sse transition penalty in the scalar tail and the caller.
+
+	yadif_pixels(dst, r, 0, begin, width, step, spatial_check);
+	yadif_pixels(dst, r, simd_end, width, width, step, spatial_check);
+}
+
+bool has_avx2()
+{
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if(info[0] < 7)
+		return false;
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	__cpuidex(info, 7, 0);
+	bool avx2	 = (info[1] & (1 << 5)) != 0;
+	return osxsave && avx2 && (_xgetbv(0) & 6) == 6; // xmm and ymm state enabled by the os.
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+#endif
+
+// Bob and blend are purely vertical and memory bound, sse2 is enough.
+
+void average_line_sse2(uint8_t* dst, const uint8_t* a, const uint8_t* b, int width)
+{
+	auto simd_end = width & ~15;
+	for(int x = 0; x < simd_end; x += 16)
+	{
+		auto xmm0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + x));
+		auto xmm1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + x));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_avg_epu8(xmm0, xmm1));
+	}
+	for(int x = simd_end; x < width; ++x)
+		dst[x] = static_cast<uint8_t>((a[x] + b[x] + 1) >> 1);
+}
+
+void blend_line_sse2(uint8_t* dst, const uint8_t* above, const uint8_t* row, const uint8_t* below, int width)
+{
+	auto zero = _mm_setzero_si128();
+	auto two  = _mm_set1_epi16(2);
+
+	auto simd_end = width & ~15;
+	for(int x = 0; x < simd_end; x += 16)
+	{
+		auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(above + x));
+		auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x));
+		auto c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(below + x));
+
+		auto lo = _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(c, zero)), _mm_add_epi16(_mm_slli_epi16(_mm_unpacklo_epi8(b, zero), 1), two));
+		auto hi = _mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(c, zero)), _mm_add_epi16(_mm_slli_epi16(_mm_unpackhi_epi8(b, zero), 1), two));
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16(_mm_srli_epi16(lo, 2), _mm_srli_epi16(hi, 2)));
+	}
+	for(int x = simd_end; x < width; ++x)
+		dst[x] = static_cast<uint8_t>((above[x] + 2*row[x] + below[x] + 2) >> 2);
+}
+
+deinterlace_simd_level::type get_supported_level()
+{
+#ifdef CASPAR_DEINTERLACE_AVX2
+	if(has_avx2())
+		return deinterlace_simd_level::avx2;
+#endif
+	return deinterlace_simd_level::sse2;
+}
+
+const deinterlace_simd_level::type g_supported_level	= get_supported_level();
+deinterlace_simd_level::type g_level					= g_supported_level;
+
+line_kernels select_kernels(deinterlace_simd_level::type level)
+{
+	line_kernels kernels;
+	kernels.yadif	= &yadif_line_scalar;
+	kernels.average	= &average_line_scalar;
+	kernels.blend	= &blend_line_scalar;
+
+	if(level >= deinterlace_simd_level::sse2)
+	{
+		kernels.yadif	= &yadif_line_sse2;
+		kernels.average	= &average_line_sse2;
+		kernels.blend	= &blend_line_sse2;
+	}
+
+#ifdef CASPAR_DEINTERLACE_AVX2
+	if(level >= deinterlace_simd_level::avx2)
+		kernels.yadif = &yadif_line_avx2;
+#endif
+
+	return kernels;
+}
+
+// Frames
+
+struct plane
+{
+	int width;	// In bytes.
+	int height;
+	int step;	// Distance in bytes between horizontally neighbouring samples of the same component.
+};
+
+int get_packed_pixel_size(PixelFormat pix_fmt)
+{
+	switch(pix_fmt)
+	{
+	case PIX_FMT_BGRA:
+	case PIX_FMT_RGBA:
+	case PIX_FMT_ARGB:
+	case PIX_FMT_ABGR:
+		return 4;
+	case PIX_FMT_RGB24:
+	case PIX_FMT_BGR24:
+		return 3;
+	default:
+		return 0;
+	}
+}
+
+// Formats the line kernels can work on directly, everything else is converted first.
+PixelFormat get_native_format(PixelFormat pix_fmt)
+{
+	switch(pix_fmt)
+	{
+	case PIX_FMT_GRAY8:
+	case PIX_FMT_YUV420P:
+	case PIX_FMT_YUVJ420P:
+	case PIX_FMT_YUVA420P:
+	case PIX_FMT_YUV422P:
+	case PIX_FMT_YUVJ422P:
+	case PIX_FMT_YUV440P:
+	case PIX_FMT_YUVJ440P:
+	case PIX_FMT_YUV444P:
+	case PIX_FMT_YUVJ444P:
+	case PIX_FMT_YUV411P:
+	case PIX_FMT_YUV410P:
+	case PIX_FMT_BGRA:
+	case PIX_FMT_RGBA:
+	case PIX_FMT_ARGB:
+	case PIX_FMT_ABGR:
+	case PIX_FMT_RGB24:
+	case PIX_FMT_BGR24:
+		return pix_fmt;
+	case PIX_FMT_UYVY422:
+	case PIX_FMT_YUYV422:
+	case PIX_FMT_YUV422P9:
+	case PIX_FMT_YUV422P10:
+	case PIX_FMT_YUV422P16:
+		return PIX_FMT_YUV422P;
+	case PIX_FMT_YUV420P9:
+	case PIX_FMT_YUV420P10:
+	case PIX_FMT_YUV420P16:
+		return PIX_FMT_YUV420P;
+	case PIX_FMT_YUV444P9:
+	case PIX_FMT_YUV444P10:
+	case PIX_FMT_YUV444P16:
+		return PIX_FMT_YUV444P;
+	case PIX_FMT_UYYVYY411:
+		return PIX_FMT_YUV411P;
+	default:
+		return PIX_FMT_BGRA;
+	}
+}
+
+std::vector<plane> get_planes(const AVFrame& frame)
+{
+	std::vector<plane> planes;
+
+	auto pix_fmt	= static_cast<PixelFormat>(frame.format);
+	auto pixel_size = get_packed_pixel_size(pix_fmt);
+	if(pixel_size > 0)
+	{
+		plane p = {frame.width * pixel_size, frame.height, pixel_size};
+		planes.push_back(p);
+		return planes;
+	}
+
+	const auto& desc = av_pix_fmt_descriptors[pix_fmt];
+
+	int count = 0;
+	for(int n = 0; n < desc.nb_components; ++n)
+		count = std::max(count, desc.comp[n].plane + 1);
+
+	for(int n = 0; n < count; ++n)
+	{
+		bool chroma = n == 1 || n == 2;
+		plane p =
+		{
+			chroma ? -((-frame.width)  >> desc.log2_chroma_w) : frame.width,
+			chroma ? -((-frame.height) >> desc.log2_chroma_h) : frame.height,
+			1
+		};
+		planes.push_back(p);
+	}
+
+	return planes;
+}
+
+void copy_frame_props(AVFrame& dest, const AVFrame& source)
+{
+	dest.width					= source.width;
+	dest.height					= source.height;
+	dest.pts					= source.pts;
+	dest.pkt_pts				= source.pkt_pts;
+	dest.pkt_pos				= source.pkt_pos;
+	dest.key_frame				= source.key_frame;
+	dest.pict_type				= source.pict_type;
+	dest.sample_aspect_ratio	= source.sample_aspect_ratio;
+	dest.interlaced_frame		= source.interlaced_frame;
+	dest.top_field_first		= source.top_field_first;
+}
+
+safe_ptr<AVFrame> alloc_frame(int width, int height, PixelFormat pix_fmt)
+{
+	safe_ptr<AVFrame> frame(avcodec_alloc_frame(), [](AVFrame* p)
+	{
+		av_free(p->data[0]);
+		av_free(p);
+	});
+	avcodec_get_frame_defaults(frame.get());
+
+	THROW_ON_ERROR2(av_image_alloc(frame->data, frame->linesize, width, height, pix_fmt, 32), "[deinterlacer]");
+
+	frame->format = pix_fmt;
+	frame->width  = width;
+	frame->height = height;
+
+	return frame;
+}
+
+}
+
+deinterlace_mode::type deinterlace_mode::parse(const std::wstring& value, deinterlace_mode::type default_value)
+{
+	if(boost::iequals(value, L"yadif"))
+		return yadif;
+	if(boost::iequals(value, L"bob"))
+		return bob;
+	if(boost::iequals(value, L"blend"))
+		return blend;
+	return default_value;
+}
+
+deinterlace_params::deinterlace_params(deinterlace_mode::type mode, bool double_rate, int parity)
+	: mode(mode)
+	, double_rate(double_rate && mode != deinterlace_mode::blend)
+	, parity(parity)
+	, spatial_check(true)
+{
+}
+
+bool deinterlace_params::try_parse(const std::wstring& filter, deinterlace_params& params)
+{
+	auto str = boost::to_lower_copy(boost::trim_copy(filter));
+
+	auto name = str.substr(0, str.find(L'='));
+	auto args = std::vector<std::wstring>();
+	if(name.size() < str.size())
+	{
+		auto arg_str = str.substr(name.size() + 1);
+		boost::split(args, arg_str, boost::is_any_of(L":"));
+	}
+
+	try
+	{
+		auto arg = [&](size_t index, int default_value)
+		{
+			return index < args.size() && !args[index].empty() ? boost::lexical_cast<int>(args[index]) : default_value;
+		};
+
+		if(name == L"yadif")
+		{
+			auto mode = arg(0, 0);
+			params = deinterlace_params(deinterlace_mode::yadif, (mode & 1) != 0, arg(1, -1));
+			params.spatial_check = mode < 2;
+			return true;
+		}
+		if(name == L"bob")
+		{
+			params = deinterlace_params(deinterlace_mode::bob, arg(0, 1) != 0, arg(1, -1));
+			return true;
+		}
+		if(name == L"blend")
+		{
+			params = deinterlace_params(deinterlace_mode::blend, false);
+			return true;
+		}
+	}
+	catch(boost::bad_lexical_cast&)
+	{
+		BOOST_THROW_EXCEPTION(invalid_argument() << arg_name_info(narrow(name)) << arg_value_info(narrow(filter)) << msg_info("Invalid deinterlacer arguments."));
+	}
+
+	return false;
+}
+
+deinterlace_simd_level::type get_deinterlace_simd_level()
+{
+	return g_level;
+}
+
+void set_deinterlace_simd_level(deinterlace_simd_level::type level)
+{
+	g_level = std::min(level, g_supported_level);
+}
+
+std::wstring make_deinterlace_filter(deinterlace_mode::type mode, bool double_rate)
+{
+	switch(mode)
+	{
+	case deinterlace_mode::bob:
+		return double_rate ? L"BOB=1:-1" : L"BOB=0:-1";
+	case deinterlace_mode::blend:
+		return double_rate ? L"BOB=1:-1" : L"BLEND"; // Blending can't produce one frame per field.
+	default:
+		return double_rate ? L"YADIF=1:-1" : L"YADIF=0:-1";
+	}
+}
+
+struct deinterlacer::implementation : boost::noncopyable
+{
+	enum { band_rows = 16 };
+
+	const deinterlace_params		params_;
+	const line_kernels				kernels_;
+
+	std::shared_ptr<AVFrame>		prev_;
+	std::shared_ptr<AVFrame>		cur_;
+	std::queue<safe_ptr<AVFrame>>	output_;
+
+	std::shared_ptr<SwsContext>		sws_;
+	int								sws_width_;
+	int								sws_height_;
+	int								sws_format_;
+
+	implementation(const deinterlace_params& params)
+		: params_(params)
+		, kernels_(select_kernels(get_deinterlace_simd_level()))
+		, sws_width_(0)
+		, sws_height_(0)
+		, sws_format_(PIX_FMT_NONE)
+	{
+	}
+
+	void push(const std::shared_ptr<AVFrame>& frame)
+	{
+		if(!frame)
+			return;
+
+		if(frame->data[0] == nullptr || frame->width < 1 || frame->height < 1)
+			BOOST_THROW_EXCEPTION(invalid_argument());
+
+		auto next = to_native(frame);
+
+		if(params_.mode != deinterlace_mode::yadif)
+		{
+			deinterlace(*next, *next, *next);
+			return;
+		}
+
+		// yadif needs one frame of look ahead, the first frame is its own previous frame.
+		if(cur_ && (cur_->width != next->width || cur_->height != next->height || cur_->format != next->format))
+		{
+			deinterlace(*prev_, *cur_, *cur_);
+			cur_.reset();
+		}
+
+		if(!cur_)
+		{
+			prev_ = next;
+			cur_  = next;
+			return;
+		}
+
+		deinterlace(*prev_, *cur_, *next);
+
+		prev_ = cur_;
+		cur_  = next;
+	}
+
+	std::shared_ptr<AVFrame> poll()
+	{
+		if(output_.empty())
+			return nullptr;
+
+		auto frame = output_.front();
+		output_.pop();
+		return frame;
+	}
+
+	int delay() const
+	{
+		return params_.mode == deinterlace_mode::yadif ? 1 : 0;
+	}
+
+	std::shared_ptr<AVFrame> to_native(const std::shared_ptr<AVFrame>& frame)
+	{
+		auto pix_fmt	= static_cast<PixelFormat>(frame->format);
+		auto target		= get_native_format(pix_fmt);
+
+		if(target == pix_fmt)
+			return frame;
+
+		if(!sws_ || sws_width_ != frame->width || sws_height_ != frame->height || sws_format_ != frame->format)
+		{
+			sws_.reset(sws_getContext(frame->width, frame->height, pix_fmt, frame->width, frame->height, target, SWS_POINT, nullptr, nullptr, nullptr), sws_freeContext);
+			if(!sws_)
+			{
+				BOOST_THROW_EXCEPTION(operation_failed() << msg_info("Could not create software scaling context.") <<
+										boost::errinfo_api_function("sws_getContext"));
+			}
+			sws_width_	= frame->width;
+			sws_height_ = frame->height;
+			sws_format_ = frame->format;
+		}
+
+		auto native = alloc_frame(frame->width, frame->height, target);
+		copy_frame_props(*native, *frame);
+		sws_scale(sws_.get(), frame->data, frame->linesize, 0, frame->height, native->data, native->linesize);
+
+		return native;
+	}
+
+	void deinterlace(const AVFrame& prev, const AVFrame& cur, const AVFrame& next)
+	{
+		if(params_.mode == deinterlace_mode::blend)
+		{
+			output_.push(render(prev, cur, next, 0, true));
+			return;
+		}
+
+		auto tff = params_.parity == -1 ? (cur.interlaced_frame ? cur.top_field_first != 0 : true) : params_.parity == 0;
+
+		// 0 keeps the even (top) lines, 1 keeps the odd (bottom) lines.
+		auto first = tff ? 0 : 1;
+
+		output_.push(render(prev, cur, next, first, true));
+		if(params_.double_rate)
+			output_.push(render(prev, cur, next, first ^ 1, false));
+	}
+
+	safe_ptr<AVFrame> render(const AVFrame& prev, const AVFrame& cur, const AVFrame& next, int keep, bool first_field)
+	{
+		auto dest = alloc_frame(cur.width, cur.height, static_cast<PixelFormat>(cur.format));
+		copy_frame_props(*dest, cur);
+		dest->interlaced_frame	= 0;
+		dest->top_field_first	= 0;
+
+		auto planes = get_planes(cur);
+		for(int n = 0; n < static_cast<int>(planes.size()); ++n)
+		{
+			auto geometry = planes[n];
+			tbb::parallel_for(tbb::blocked_range<int>(0, geometry.height, band_rows), [&](const tbb::blocked_range<int>& r)
+			{
+				for(int y = r.begin(); y != r.end(); ++y)
+					render_row(*dest, prev, cur, next, n, geometry, y, keep, first_field);
+			});
+		}
+
+		return dest;
+	}
+
+	void render_row(AVFrame& dest, const AVFrame& prev, const AVFrame& cur, const AVFrame& next, int n, const plane& geometry, int y, int keep, bool first_field)
+	{
+		auto row = [&](const AVFrame& frame, int line) -> const uint8_t*
+		{
+			return frame.data[n] + line * frame.linesize[n];
+		};
+
+		auto h		= geometry.height;
+		auto dst	= dest.data[n] + y * dest.linesize[n];
+		auto above	= y > 0	   ? y - 1 : std::min(y + 1, h - 1); // Mirror at the edges, any height works.
+		auto below	= y + 1 < h ? y + 1 : std::max(y - 1, 0);
+
+		if(params_.mode == deinterlace_mode::blend)
+		{
+			kernels_.blend(dst, row(cur, above), row(cur, y), row(cur, below), geometry.width);
+			return;
+		}
+
+		if((y & 1) == keep || above == y)
+		{
+			memcpy(dst, row(cur, y), geometry.width);
+			return;
+		}
+
+		if(params_.mode == deinterlace_mode::bob)
+		{
+			kernels_.average(dst, row(cur, above), row(cur, below), geometry.width);
+			return;
+		}
+
+		// The first field in time is interpolated from the previous frame, the second from the next.
+		const auto& prev2 = first_field ? prev : cur;
+		const auto& next2 = first_field ? cur  : next;
+
+		bool spatial_check = params_.spatial_check && y >= 2 && y + 2 < h;
+
+		yadif_rows rows;
+		rows.prev_up	= row(prev, above);
+		rows.prev_dn	= row(prev, below);
+		rows.cur_up		= row(cur, above);
+		rows.cur_dn		= row(cur, below);
+		rows.next_up	= row(next, above);
+		rows.next_dn	= row(next, below);
+		rows.prev2		= row(prev2, y);
+		rows.next2		= row(next2, y);
+		rows.prev2_up2	= row(prev2, spatial_check ? y - 2 : y);
+		rows.prev2_dn2	= row(prev2, spatial_check ? y + 2 : y);
+		rows.next2_up2	= row(next2, spatial_check ? y - 2 : y);
+		rows.next2_dn2	= row(next2, spatial_check ? y + 2 : y);
+
+		kernels_.yadif(dst, rows, geometry.width, geometry.step, spatial_check);
+	}
+};
+
+deinterlacer::deinterlacer(const deinterlace_params& params) : impl_(new implementation(params)){}
+void deinterlacer::push(const std::shared_ptr<AVFrame>& frame){impl_->push(frame);}
+std::shared_ptr<AVFrame> deinterlacer::poll(){return impl_->poll();}
+int deinterlacer::delay() const{return impl_->delay();}
+const deinterlace_params& deinterlacer::params() const{return impl_->params_;}
+
+}}
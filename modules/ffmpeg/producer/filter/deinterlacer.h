@@ -0,0 +1,101 @@
+/*
+* Copyright 2013 Sveriges Television AB http://casparcg.com/
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+#pragma once
+
+#include <common/memory/safe_ptr.h>
+
+#include <boost/noncopyable.hpp>
+
+#include <memory>
+#include <string>
+
+struct AVFrame;
+
+namespace caspar { namespace ffmpeg {
+
+struct deinterlace_mode
+{
+	enum type
+	{
+		yadif,	// Motion adaptive, edge directed (same algorithm as libavfilter yadif).
+		bob,	// Each field is line doubled by linear interpolation.
+		blend,	// Both fields are blended together, always single rate.
+		count
+	};
+
+	static deinterlace_mode::type parse(const std::wstring& value, deinterlace_mode::type default_value = yadif);
+};
+
+struct deinterlace_params
+{
+	deinterlace_mode::type	mode;
+	bool					double_rate;	// Output one frame per field.
+	int						parity;			// -1 = from frame, 0 = top field first, 1 = bottom field first.
+	bool					spatial_check;	// yadif only, see yadif mode 2 and 3.
+
+	deinterlace_params(deinterlace_mode::type mode = deinterlace_mode::yadif, bool double_rate = false, int parity = -1);
+
+	// Parses a single filter in a filter chain, e.g. "YADIF=1:-1", "BOB=0" or "BLEND".
+	static bool try_parse(const std::wstring& filter, deinterlace_params& params);
+};
+
+struct deinterlace_simd_level
+{
+	enum type
+	{
+		scalar,	// Reference the other kernels are verified against.
+		sse2,
+		avx2	// yadif only, bob and blend use sse2.
+	};
+};
+
+// The widest kernels supported by the cpu unless set_deinterlace_simd_level was called.
+deinterlace_simd_level::type get_deinterlace_simd_level();
+
+// Limited to what the cpu supports. Only meant for verification and benchmarks, applies to the 
+// deinterlacers created afterwards.
+void set_deinterlace_simd_level(deinterlace_simd_level::type level);
+
+// Returns the filter string that selects the given deinterlacer.
+std::wstring make_deinterlace_filter(deinterlace_mode::type mode, bool double_rate);
+
+// Cpu deinterlacer which works on any resolution. Each plane is split into row bands which are
+// processed in parallel, the line kernels are vectorized using sse2 or avx2 when available.
+// All state is owned by the instance, any number of deinterlacers can run concurrently.
+class deinterlacer : boost::noncopyable
+{
+public:
+	explicit deinterlacer(const deinterlace_params& params);
+
+	void push(const std::shared_ptr<AVFrame>& frame);
+	std::shared_ptr<AVFrame> poll();
+
+	// Number of frames which need to be pushed before the first frame can be polled.
+	int delay() const;
+
+	const deinterlace_params& params() const;
+private:
+	struct implementation;
+	safe_ptr<implementation> impl_;
+};
+
+}}
@@ -23,7 +23,7 @@
 
 #include "filter.h"
 
-#include "parallel_yadif.h"
+#include "deinterlacer.h"
 
 #include "../../ffmpeg_error.h"
 
@@ -35,6 +35,8 @@
 #include <boost/assign.hpp>
 #include <boost/algorithm/string.hpp>
 #include <boost/foreach.hpp>
+#include <boost/algorithm/string/regex.hpp>
+#include <boost/regex.hpp>
 
 #include <cstdio>
 #include <sstream>
@@ -102,21 +104,51 @@ static int query_formats_410(AVFilterContext *ctx)
     return 0;
 }
 
+// Splits a filter chain into its filters, link labels are removed.
+static std::vector<std::wstring> split_filters(const std::wstring& filters)
+{
+	std::vector<std::wstring> result;
+	boost::split(result, filters, boost::is_any_of(L",;"), boost::token_compress_on);
+	BOOST_FOREACH(auto& filter, result)
+	{
+		boost::erase_all_regex(filter, boost::wregex(L"\\[[^\\]]*\\]"));
+		boost::trim(filter);
+	}
+	return result;
+}
+
 struct filter::implementation
 {
 	std::wstring					filters_;
 	std::shared_ptr<AVFilterGraph>	graph_;	
 	AVFilterContext*				buffersink_ctx_;
 	AVFilterContext*				buffersrc_ctx_;
-	std::shared_ptr<void>			parallel_yadif_ctx_;
+	std::wstring					graph_filters_;
+	std::unique_ptr<deinterlacer>	deinterlacer_;
 	std::vector<PixelFormat>		pix_fmts_;
 	std::queue<safe_ptr<AVFrame>>	bypass_;
 		
 	implementation(const std::wstring& filters, const std::vector<PixelFormat>& pix_fmts) 
 		: filters_(filters)
-		, parallel_yadif_ctx_(nullptr)
 		, pix_fmts_(pix_fmts)
 	{
+		// Deinterlacing in simple filter chains is done by our own deinterlacer before the
+		// rest of the chain, which is also the correct order for interlaced material.
+		// Complex filter graphs are passed on to libavfilter as is.
+		if(filters_.find_first_of(L"[;") == std::wstring::npos)
+		{
+			BOOST_FOREACH(auto& filter, split_filters(filters_))
+			{
+				deinterlace_params params;
+				if(!deinterlacer_ && deinterlace_params::try_parse(filter, params))
+					deinterlacer_.reset(new deinterlacer(params));
+				else if(!filter.empty())
+					graph_filters_ = append_filter(graph_filters_, filter);
+			}
+		}
+		else
+			graph_filters_ = filters_;
+
 		if(pix_fmts_.empty())
 		{
 			pix_fmts_ = boost::assign::list_of
@@ -143,7 +175,19 @@ struct filter::implementation
 		if(frame->data[0] == nullptr || frame->width < 1)
 			BOOST_THROW_EXCEPTION(invalid_argument());
 
-		if(filters_.empty())
+		if(deinterlacer_)
+		{
+			deinterlacer_->push(frame);
+			for(auto deinterlaced = deinterlacer_->poll(); deinterlaced; deinterlaced = deinterlacer_->poll())
+				push_graph(deinterlaced);
+		}
+		else
+			push_graph(frame);
+	}
+
+	void push_graph(const std::shared_ptr<AVFrame>& frame)
+	{
+		if(graph_filters_.empty())
 		{
 			bypass_.push(make_safe_ptr(frame));
 			return;
@@ -182,7 +226,7 @@ struct filter::implementation
 					inputs->pad_idx			= 0;
 					inputs->next			= nullptr;
 			
-					std::string filters = boost::to_lower_copy(narrow(filters_));
+					std::string filters = boost::to_lower_copy(narrow(graph_filters_));
 					THROW_ON_ERROR2(avfilter_graph_parse(graph_.get(), filters.c_str(), &inputs, &outputs, NULL), "[filter]");
 			
 					auto yadif_filter = boost::adaptors::filtered([&](AVFilterContext* p){return strstr(p->name, "yadif") != 0;});
@@ -231,9 +275,6 @@ struct filter::implementation
 					}
 					
 					THROW_ON_ERROR2(avfilter_graph_config(graph_.get(), NULL), "[filter]");	
-					
-					BOOST_FOREACH(auto filter_ctx, boost::make_iterator_range(graph_->filters, graph_->filters + graph_->filter_count) | yadif_filter)						
-						parallel_yadif_ctx_ = make_parallel_yadif(filter_ctx);						
 				}
 				catch(...)
 				{
@@ -256,7 +297,7 @@ struct filter::implementation
 
 	std::shared_ptr<AVFrame> poll()
 	{
-		if(filters_.empty())
+		if(graph_filters_.empty())
 		{
 			if(bypass_.empty())
 				return nullptr;
@@ -320,6 +361,26 @@ filter& filter::operator=(filter&& other){impl_ = std::move(other.impl_); return
 void filter::push(const std::shared_ptr<AVFrame>& frame){impl_->push(frame);}
 std::shared_ptr<AVFrame> filter::poll(){return impl_->poll();}
 std::wstring filter::filter_str() const{return impl_->filters_;}
+bool filter::is_double_rate(const std::wstring& filters)
+{
+	BOOST_FOREACH(auto& filter, split_filters(filters))
+	{
+		deinterlace_params params;
+		if(deinterlace_params::try_parse(filter, params) && params.double_rate)
+			return true;
+	}
+	return false;
+}
+bool filter::is_deinterlacing(const std::wstring& filters)
+{
+	BOOST_FOREACH(auto& filter, split_filters(filters))
+	{
+		deinterlace_params params;
+		if(deinterlace_params::try_parse(filter, params))
+			return true;
+	}
+	return false;
+}
 std::vector<safe_ptr<AVFrame>> filter::poll_all()
 {	
 	std::vector<safe_ptr<AVFrame>> frames;
@@ -52,23 +52,8 @@ public:
 
 	std::wstring filter_str() const;
 			
-	static bool is_double_rate(const std::wstring& filters)
-	{
-		if(boost::to_upper_copy(filters).find(L"YADIF=1") != std::string::npos)
-			return true;
-	
-		if(boost::to_upper_copy(filters).find(L"YADIF=3") != std::string::npos)
-			return true;
-
-		return false;
-	}
-
-	static bool is_deinterlacing(const std::wstring& filters)
-	{
-		if(boost::to_upper_copy(filters).find(L"YADIF") != std::string::npos)
-			return true;	
-		return false;
-	}	
+	static bool is_double_rate(const std::wstring& filters);
+	static bool is_deinterlacing(const std::wstring& filters);
 	
 	static int delay(const std::wstring& filters)
 	{
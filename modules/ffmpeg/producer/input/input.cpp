@@ -22,6 +22,7 @@
 #include "../../stdafx.h"
 
 #include "input.h"
+#include "seek_index.h"
 
 #include "../util/util.h"
 #include "../util/flv.h"
@@ -31,6 +32,7 @@
 
 #include <core/video_format.h>
 
+#include <common/env.h>
 #include <common/diagnostics/graph.h>
 #include <common/concurrency/executor.h>
 #include <common/concurrency/future_util.h>
@@ -41,6 +43,8 @@
 #include <tbb/atomic.h>
 #include <tbb/recursive_mutex.h>
 
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/property_tree/ptree.hpp>
 #include <boost/range/algorithm.hpp>
 #include <boost/thread/condition_variable.hpp>
 #include <boost/thread/mutex.hpp>
@@ -60,12 +64,65 @@ extern "C"
 #pragma warning (pop)
 #endif
 
-static const size_t MAX_BUFFER_COUNT    = 100;
-static const size_t MAX_BUFFER_COUNT_RT = 3;
-static const size_t MIN_BUFFER_COUNT    = 50;
-static const size_t MAX_BUFFER_SIZE     = 64 * 1000000;
+static const size_t MAX_BUFFER_COUNT				= 100;
+static const size_t MAX_BUFFER_COUNT_RT				= 3;
+static const size_t MIN_BUFFER_COUNT				= 50;
+static const size_t MIN_BACKGROUND_BUFFER_COUNT		= 16;	// Enough for the decoders to be ready on the first frame.
+static const size_t MIN_BUFFER_SIZE					= 1000000;
+static const size_t MAX_BUFFER_SIZE					= 64 * 1000000;
+static const double BACKGROUND_READ_AHEAD			= 0.5;	// Seconds.
+static const int64_t PAUSE_TIMEOUT_MILLIS			= 500;
 
 namespace caspar { namespace ffmpeg {
+
+// Demuxed packet memory shared by all inputs in the process.
+struct demux_budget
+{
+	tbb::atomic<int64_t>	used;
+	tbb::atomic<int64_t>	limit;
+	tbb::atomic<int>		inputs;
+
+	demux_budget()
+	{
+		used	= 0;
+		limit	= 512 * 1000000;
+		inputs	= 0;
+	}
+
+	bool exceeded() const
+	{
+		return used >= limit;
+	}
+};
+
+static demux_budget g_demux_budget;
+
+struct playback_state
+{
+	enum type
+	{
+		background = 0,	// Loaded but not played yet.
+		foreground,
+		paused
+	};
+
+	static std::wstring print(type value)
+	{
+		switch(value)
+		{
+		case background:	return L"background";
+		case foreground:	return L"foreground";
+		case paused:		return L"paused";
+		default:			return L"invalid";
+		}
+	}
+};
+
+static int64_t now_millis()
+{
+	auto epoch = boost::posix_time::ptime(boost::gregorian::date(2000, 1, 1));
+	return (boost::posix_time::microsec_clock::universal_time() - epoch).total_milliseconds();
+}
 		
 struct input::implementation : boost::noncopyable
 {		
@@ -78,11 +135,27 @@ struct input::implementation : boost::noncopyable
 	const uint32_t												start_;		
 	const uint32_t												length_;
 	const bool													thumbnail_mode_;
+	const bool													is_file_;
 	tbb::atomic<bool>											loop_;
 	uint32_t													frame_number_;
 	
 	tbb::concurrent_bounded_queue<std::shared_ptr<AVPacket>>	buffer_;
 	tbb::atomic<size_t>											buffer_size_;
+
+	const double												read_ahead_;
+	tbb::atomic<int64_t>										last_pop_millis_;	// -1 until the first pop.
+	tbb::atomic<int64_t>										bytes_per_second_;
+	int64_t														rate_start_pts_;
+	int64_t														rate_bytes_;
+
+	std::shared_ptr<seek_index>									seek_index_;		// Only accessed on the executor once running.
+	tbb::atomic<bool>											frame_accurate_;
+	tbb::atomic<bool>											indexing_;
+	tbb::atomic<bool>											abort_indexing_;
+	std::unique_ptr<executor>									index_executor_;
+
+	boost::mutex												packet_handler_mutex_;
+	std::function<void()>										packet_handler_;
 		
 	executor													executor_;
 	
@@ -94,7 +167,11 @@ struct input::implementation : boost::noncopyable
 		, start_(start)
 		, length_(length)
 		, thumbnail_mode_(thumbnail_mode)
+		, is_file_(resource_type == FFMPEG_FILE)
 		, frame_number_(0)
+		, read_ahead_(env::properties().get(L"configuration.ffmpeg.read-ahead-millis", 2000) / 1000.0)
+		, rate_start_pts_(AV_NOPTS_VALUE)
+		, rate_bytes_(0)
 		, executor_(print())
 	{
 		if (thumbnail_mode_)
@@ -103,8 +180,34 @@ struct input::implementation : boost::noncopyable
 				disable_logging_for_thread();
 			});
 
-		loop_			= loop;
-		buffer_size_	= 0;
+		loop_				= loop;
+		buffer_size_		= 0;
+		last_pop_millis_	= -1;
+		bytes_per_second_	= format_context_->bit_rate / 8;
+
+		g_demux_budget.limit = static_cast<int64_t>(env::properties().get(L"configuration.ffmpeg.demux-budget-mb", 512)) * 1000000;
+		++g_demux_budget.inputs;
+
+		indexing_			= false;
+		abort_indexing_		= false;
+		frame_accurate_		= false;
+
+		if(is_file_)
+			set_seek_index(seek_index::load(filename_));
+
+		// Thumbnails seek into every clip, build the index right away so that it is ready for playout as well. The 
+		// input doesn't outlive the thumbnail, so the scan runs on the thumbnail worker instead of in the background.
+		if(thumbnail_mode_ && is_file_ && !frame_accurate_)
+		{
+			indexing_ = true; // Not retried on seek if the stream can't be indexed.
+
+			auto index = seek_index::build(filename_, abort_indexing_);
+			if(index)
+			{
+				index->save();
+				set_seek_index(index);
+			}
+		}
 
 		if(start_ > 0)			
 			queued_seek(start_);
@@ -112,9 +215,22 @@ struct input::implementation : boost::noncopyable
 		graph_->set_color("seek", diagnostics::color(1.0f, 0.5f, 0.0f));	
 		graph_->set_color("buffer-count", diagnostics::color(0.7f, 0.4f, 0.4f));
 		graph_->set_color("buffer-size", diagnostics::color(1.0f, 1.0f, 0.0f));	
+		graph_->set_color("demux-budget", diagnostics::color(0.4f, 0.8f, 1.0f));
 
 		tick();
 	}
+
+	~implementation()
+	{
+		abort_indexing_ = true;
+		index_executor_.reset();
+
+		executor_.stop();
+		executor_.join();
+
+		g_demux_budget.used -= buffer_size_;
+		--g_demux_budget.inputs;
+	}
 	
 	bool try_pop(std::shared_ptr<AVPacket>& packet)
 	{
@@ -122,17 +238,53 @@ struct input::implementation : boost::noncopyable
 		
 		if(result)
 		{
+			last_pop_millis_ = now_millis();
 			if(packet)
-				buffer_size_ -= packet->size;
+				release(packet->size);
 			tick();
 		}
 
-		graph_->set_value("buffer-size", (static_cast<double>(buffer_size_)+0.001)/MAX_BUFFER_SIZE);
-		graph_->set_value("buffer-count", (static_cast<double>(buffer_.size()+0.001)/MAX_BUFFER_COUNT));
+		update_graph();
 		
 		return result;
 	}
 
+	void set_packet_handler(const std::function<void()>& handler)
+	{
+		boost::lock_guard<boost::mutex> lock(packet_handler_mutex_); // Not called anymore once replaced.
+		packet_handler_ = handler;
+	}
+
+	void notify_packet()
+	{
+		boost::lock_guard<boost::mutex> lock(packet_handler_mutex_);
+		if(packet_handler_)
+			packet_handler_();
+	}
+
+	void release(size_t size)
+	{
+		buffer_size_			-= size;
+		g_demux_budget.used		-= size;
+	}
+
+	void update_graph()
+	{
+		graph_->set_value("buffer-size", (static_cast<double>(buffer_size_)+0.001)/get_target_buffer_size());
+		graph_->set_value("buffer-count", (static_cast<double>(buffer_.size()+0.001)/MAX_BUFFER_COUNT));
+		graph_->set_value("demux-budget", (static_cast<double>(g_demux_budget.used)+0.001)/std::max<int64_t>(1, g_demux_budget.limit));
+	}
+
+	playback_state::type get_playback_state() const
+	{
+		int64_t last_pop = last_pop_millis_;
+
+		if(last_pop < 0)
+			return playback_state::background;
+
+		return now_millis() - last_pop > PAUSE_TIMEOUT_MILLIS ? playback_state::paused : playback_state::foreground;
+	}
+
 	std::ptrdiff_t get_max_buffer_count() const
 	{
 		return thumbnail_mode_ ? 1 : MAX_BUFFER_COUNT;
@@ -140,7 +292,90 @@ struct input::implementation : boost::noncopyable
 
 	std::ptrdiff_t get_min_buffer_count() const
 	{
-		return thumbnail_mode_ ? 0 : MIN_BUFFER_COUNT;
+		if(thumbnail_mode_)
+			return 0;
+
+		return get_playback_state() == playback_state::foreground ? MIN_BUFFER_COUNT : MIN_BACKGROUND_BUFFER_COUNT;
+	}
+
+	// Read ahead by time rather than by a fixed size, so that low bitrate clips and layers that are not
+	// playing don't hold on to more memory than they need.
+	size_t get_target_buffer_size() const
+	{
+		int64_t bytes_per_second = bytes_per_second_;
+
+		if(bytes_per_second <= 0)
+			return MAX_BUFFER_SIZE;
+
+		auto seconds = get_playback_state() == playback_state::foreground ? read_ahead_ : BACKGROUND_READ_AHEAD;
+		auto size	 = static_cast<size_t>(static_cast<double>(bytes_per_second) * seconds);
+
+		return std::min(std::max(size, MIN_BUFFER_SIZE), MAX_BUFFER_SIZE);
+	}
+
+	// Measures the bitrate over the timestamps of the default stream, about once every media second.
+	void measure_bitrate(const AVPacket& packet)
+	{
+		rate_bytes_ += packet.size;
+
+		if(packet.stream_index != default_stream_index_ || packet.pts == AV_NOPTS_VALUE)
+			return;
+
+		if(rate_start_pts_ == AV_NOPTS_VALUE || packet.pts < rate_start_pts_)
+		{
+			rate_start_pts_ = packet.pts;
+			rate_bytes_		= 0;
+			return;
+		}
+
+		auto seconds = static_cast<double>(packet.pts - rate_start_pts_) * av_q2d(format_context_->streams[default_stream_index_]->time_base);
+		if(seconds < 1.0)
+			return;
+
+		auto measured		= static_cast<int64_t>(static_cast<double>(rate_bytes_) / seconds);
+		int64_t previous	= bytes_per_second_;
+		bytes_per_second_	= previous > 0 ? (previous + measured) / 2 : measured;
+		rate_start_pts_		= packet.pts;
+		rate_bytes_			= 0;
+	}
+
+	void set_seek_index(const std::shared_ptr<seek_index>& index)
+	{
+		if(!index || index->stream_index() != default_stream_index_)
+			return;
+
+		seek_index_		= index;
+		frame_accurate_ = true;
+	}
+
+	// The index is built lazily on the first seek, until it is ready seeks are timestamp based.
+	void begin_indexing()
+	{
+		if(!is_file_ || frame_accurate_ || indexing_.fetch_and_store(true))
+			return;
+
+		index_executor_.reset(new executor(L"seek_index[" + filename_ + L"]"));
+		index_executor_->set_priority_class(below_normal_priority_class);
+		index_executor_->begin_invoke([this]
+		{
+			auto index = seek_index::build(filename_, abort_indexing_);
+			if(!index)
+				return;
+
+			index->save();
+
+			try
+			{
+				executor_.begin_invoke([=]
+				{
+					set_seek_index(index);
+				});
+			}
+			catch(...)
+			{
+				// Reached the end of the file, nothing left to seek in.
+			}
+		});
 	}
 
 	boost::unique_future<bool> seek(uint32_t target)
@@ -148,11 +383,13 @@ struct input::implementation : boost::noncopyable
 		if (!executor_.is_running())
 			return wrap_as_future(false);
 
+		begin_indexing();
+
 		return executor_.begin_invoke([=]() -> bool
 		{
 			std::shared_ptr<AVPacket> packet;
 			while(buffer_.try_pop(packet) && packet)
-				buffer_size_ -= packet->size;
+				release(packet->size);
 
 			queued_seek(target);
 
@@ -169,7 +406,25 @@ struct input::implementation : boost::noncopyable
 	
 	bool full() const
 	{
-		return (buffer_size_ > MAX_BUFFER_SIZE || buffer_.size() > get_max_buffer_count()) && buffer_.size() > get_min_buffer_count();
+		if(buffer_.size() <= get_min_buffer_count())
+			return false;
+
+		return buffer_size_ > get_target_buffer_size() || buffer_.size() > get_max_buffer_count() || g_demux_budget.exceeded();
+	}
+
+	boost::property_tree::wptree info() const
+	{
+		boost::property_tree::wptree info;
+		info.add(L"state",					playback_state::print(get_playback_state()));
+		info.add(L"buffer-count",			buffer_.size());
+		info.add(L"buffer-size",			static_cast<size_t>(buffer_size_));
+		info.add(L"target-buffer-size",		get_target_buffer_size());
+		info.add(L"bitrate",				static_cast<int64_t>(bytes_per_second_) * 8);
+		info.add(L"frame-accurate",			static_cast<bool>(frame_accurate_));
+		info.add(L"budget.size",			static_cast<int64_t>(g_demux_budget.limit));
+		info.add(L"budget.used",			static_cast<int64_t>(g_demux_budget.used));
+		info.add(L"budget.inputs",			static_cast<int>(g_demux_budget.inputs));
+		return info;
 	}
 
 	void tick()
@@ -199,7 +454,10 @@ struct input::implementation : boost::noncopyable
 						CASPAR_LOG(trace) << print() << " Looping.";			
 					}		
 					else
+					{
 						executor_.stop();
+						notify_packet();
+					}
 				}
 				else
 				{		
@@ -209,6 +467,8 @@ struct input::implementation : boost::noncopyable
 						++frame_number_;
 
 					THROW_ON_ERROR2(av_dup_packet(packet.get()), print());
+
+					measure_bitrate(*packet);
 				
 					// Make sure that the packet is correctly deallocated even if size and data is modified during decoding.
 					auto size = packet->size;
@@ -221,10 +481,12 @@ struct input::implementation : boost::noncopyable
 					});
 
 					buffer_.try_push(packet);
-					buffer_size_ += packet->size;
+					buffer_size_			+= packet->size;
+					g_demux_budget.used		+= packet->size;
 				
-					graph_->set_value("buffer-size", (static_cast<double>(buffer_size_)+0.001)/MAX_BUFFER_SIZE);
-					graph_->set_value("buffer-count", (static_cast<double>(buffer_.size()+0.001)/MAX_BUFFER_COUNT));
+					update_graph();
+
+					notify_packet();
 				}	
 		
 				tick();		
@@ -234,6 +496,7 @@ struct input::implementation : boost::noncopyable
 				if (!thumbnail_mode_)
 					CASPAR_LOG_CURRENT_EXCEPTION();
 				executor_.stop();
+				notify_packet();
 			}
 		});
 	}	
@@ -335,6 +598,29 @@ struct input::implementation : boost::noncopyable
 		if (!thumbnail_mode_)
 			CASPAR_LOG(debug) << print() << " Seeking: " << target;
 
+		auto flush_packet	= create_packet();
+		flush_packet->data	= nullptr;
+		flush_packet->size	= 0;
+		flush_packet->pos	= target;
+
+		seek_index::seek_point point;
+		if(seek_index_ && seek_index_->find(target, point))
+		{
+			// Land on the keyframe at or before the target, the decoders drop everything before point.pts.
+			if(avformat_seek_file(format_context_.get(), default_stream_index_, std::numeric_limits<int64_t>::min(), point.timestamp, point.timestamp, 0) >= 0)
+			{
+				flush_packet->pts			= point.pts;
+				flush_packet->stream_index	= default_stream_index_;
+
+				buffer_.push(flush_packet);
+
+				rate_start_pts_ = AV_NOPTS_VALUE;
+				return;
+			}
+
+			CASPAR_LOG(warning) << print() << " Indexed seek failed, falling back to timestamp seek.";
+		}
+
 		int flags = AVSEEK_FLAG_FRAME;
 		if(target == 0)
 		{
@@ -353,13 +639,10 @@ struct input::implementation : boost::noncopyable
 		auto fixed_target = (target*stream->time_base.den*codec->time_base.num)/(stream->time_base.num*codec->time_base.den)*codec->ticks_per_frame;
 		
 		THROW_ON_ERROR2(avformat_seek_file(format_context_.get(), default_stream_index_, std::numeric_limits<int64_t>::min(), fixed_target, std::numeric_limits<int64_t>::max(), 0), print());		
-		
-		auto flush_packet	= create_packet();
-		flush_packet->data	= nullptr;
-		flush_packet->size	= 0;
-		flush_packet->pos	= target;
 
 		buffer_.push(flush_packet);
+
+		rate_start_pts_ = AV_NOPTS_VALUE;
 	}	
 
 	bool is_eof(int ret)
@@ -377,8 +660,11 @@ input::input(const safe_ptr<diagnostics::graph>& graph, const std::wstring& file
 	: impl_(new implementation(graph, filename, resource_type, loop, start, length, thumbnail_mode, vid_params)){}
 bool input::eof() const {return !impl_->executor_.is_running();}
 bool input::try_pop(std::shared_ptr<AVPacket>& packet){return impl_->try_pop(packet);}
+void input::set_packet_handler(const std::function<void()>& handler){impl_->set_packet_handler(handler);}
 safe_ptr<AVFormatContext> input::context(){return impl_->format_context_;}
 void input::loop(bool value){impl_->loop_ = value;}
 bool input::loop() const{return impl_->loop_;}
 boost::unique_future<bool> input::seek(uint32_t target){return impl_->seek(target);}
+boost::property_tree::wptree input::info() const{return impl_->info();}
+bool input::is_frame_accurate() const{return impl_->frame_accurate_;}
 }}
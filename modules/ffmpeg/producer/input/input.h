@@ -24,12 +24,14 @@
 
 #include <common/memory/safe_ptr.h>
 
+#include <functional>
 #include <memory>
 #include <string>
 #include <cstdint>
 
 #include <boost/noncopyable.hpp>
 #include <boost/thread/future.hpp>
+#include <boost/property_tree/ptree_fwd.hpp>
 
 struct AVFormatContext;
 struct AVPacket;
@@ -52,10 +54,16 @@ public:
 	bool try_pop(std::shared_ptr<AVPacket>& packet);
 	bool eof() const;
 
+	// Called on the demux thread whenever a packet has been buffered and when the input ends.
+	void set_packet_handler(const std::function<void()>& handler);
+
 	void loop(bool value);
 	bool loop() const;
 
 	boost::unique_future<bool> seek(uint32_t target);
+	bool is_frame_accurate() const; // Seeks land exactly on the target frame.
+
+	boost::property_tree::wptree info() const;
 
 	safe_ptr<AVFormatContext> context();
 private:
@@ -0,0 +1,307 @@
+/*
+* Copyright 2013 Sveriges Television AB http://casparcg.com/
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+#include "../../stdafx.h"
+
+#include "seek_index.h"
+
+#include "../util/util.h"
+#include "../../ffmpeg_error.h"
+
+#include <common/env.h>
+#include <common/log/log.h>
+#include <common/utility/string.h>
+
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/foreach.hpp>
+#include <boost/range/algorithm.hpp>
+
+#include <algorithm>
+#include <vector>
+
+#if defined(_MSC_VER)
+#pragma warning (push)
+#pragma warning (disable : 4244)
+#endif
+extern "C"
+{
+	#define __STDC_CONSTANT_MACROS
+	#define __STDC_LIMIT_MACROS
+	#include <libavformat/avformat.h>
+}
+#if defined(_MSC_VER)
+#pragma warning (pop)
+#endif
+
+namespace caspar { namespace ffmpeg {
+
+static const uint32_t SEEK_INDEX_MAGIC		= 0x58444953; // "SIDX"
+static const uint32_t SEEK_INDEX_VERSION	= 1;
+
+struct keyframe
+{
+	int64_t pts;
+	int64_t dts;
+};
+
+// <thumbnails-path>/<path relative to media without extension>.seekidx, same naming as the thumbnails.
+static boost::filesystem::wpath get_index_file(const std::wstring& filename)
+{
+	boost::filesystem::wpath file(filename);
+	auto result = file.stem();
+
+	boost::filesystem::wpath current_path = file;
+
+	while (true)
+	{
+		current_path = current_path.parent_path();
+
+		if (current_path.empty())
+			return boost::filesystem::wpath(); // Not in the media folder, the index is only kept in memory.
+
+		if (boost::filesystem::equivalent(current_path, boost::filesystem::wpath(env::media_folder())))
+			break;
+
+		result = current_path.filename() + L"/" + result;
+	}
+
+	return boost::filesystem::wpath(env::thumbnails_folder()) / (result + L".seekidx");
+}
+
+struct seek_index::implementation : boost::noncopyable
+{
+	std::wstring			filename_;
+	uint64_t				file_size_;
+	int64_t					file_time_;
+	int						stream_index_;
+	std::vector<int64_t>	pts_;		// Of every frame, in presentation order.
+	std::vector<keyframe>	keyframes_;	// Sorted by pts.
+
+	implementation(const std::wstring& filename)
+		: filename_(filename)
+		, file_size_(boost::filesystem::file_size(boost::filesystem::wpath(filename)))
+		, file_time_(boost::filesystem::last_write_time(boost::filesystem::wpath(filename)))
+		, stream_index_(-1)
+	{
+	}
+
+	bool find(uint32_t frame, seek_point& result) const
+	{
+		if(frame >= pts_.size() || keyframes_.empty())
+			return false;
+
+		auto pts = pts_[frame];
+		auto it	 = std::upper_bound(keyframes_.begin(), keyframes_.end(), pts, [](int64_t value, const keyframe& key)
+		{
+			return value < key.pts;
+		});
+
+		if(it != keyframes_.begin())
+			--it;
+
+		result.pts			= pts;
+		result.timestamp	= it->dts != AV_NOPTS_VALUE ? std::min(it->dts, it->pts) : it->pts;
+
+		return true;
+	}
+
+	template<typename T>
+	static void write(boost::filesystem::ofstream& stream, const T& value)
+	{
+		stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	template<typename T>
+	static bool read(boost::filesystem::ifstream& stream, T& value)
+	{
+		return stream.read(reinterpret_cast<char*>(&value), sizeof(T)).good();
+	}
+
+	void save() const
+	{
+		auto index_file = get_index_file(filename_);
+		if(index_file.empty())
+			return;
+
+		boost::filesystem::create_directories(index_file.parent_path());
+		boost::filesystem::ofstream stream(index_file, std::ios::binary | std::ios::trunc);
+
+		write(stream, SEEK_INDEX_MAGIC);
+		write(stream, SEEK_INDEX_VERSION);
+		write(stream, file_size_);
+		write(stream, file_time_);
+		write(stream, static_cast<int32_t>(stream_index_));
+		write(stream, static_cast<uint32_t>(pts_.size()));
+		write(stream, static_cast<uint32_t>(keyframes_.size()));
+
+		if(!pts_.empty())
+			stream.write(reinterpret_cast<const char*>(pts_.data()), pts_.size() * sizeof(int64_t));
+
+		BOOST_FOREACH(auto& key, keyframes_)
+		{
+			write(stream, key.pts);
+			write(stream, key.dts);
+		}
+	}
+
+	bool load()
+	{
+		auto index_file = get_index_file(filename_);
+		if(index_file.empty() || !boost::filesystem::exists(index_file))
+			return false;
+
+		boost::filesystem::ifstream stream(index_file, std::ios::binary);
+
+		uint32_t magic			= 0;
+		uint32_t version		= 0;
+		uint64_t file_size		= 0;
+		int64_t  file_time		= 0;
+		int32_t	 stream_index	= -1;
+		uint32_t nb_frames		= 0;
+		uint32_t nb_keyframes	= 0;
+
+		if(!read(stream, magic) || magic != SEEK_INDEX_MAGIC || !read(stream, version) || version != SEEK_INDEX_VERSION)
+			return false;
+
+		if(!read(stream, file_size) || file_size != file_size_ || !read(stream, file_time) || file_time != file_time_)
+			return false;
+
+		if(!read(stream, stream_index) || !read(stream, nb_frames) || !read(stream, nb_keyframes) || nb_keyframes > nb_frames)
+			return false;
+
+		pts_.resize(nb_frames);
+		if(nb_frames > 0 && !stream.read(reinterpret_cast<char*>(pts_.data()), nb_frames * sizeof(int64_t)).good())
+			return false;
+
+		keyframes_.resize(nb_keyframes);
+		BOOST_FOREACH(auto& key, keyframes_)
+		{
+			if(!read(stream, key.pts) || !read(stream, key.dts))
+				return false;
+		}
+
+		stream_index_ = stream_index;
+		return true;
+	}
+
+	bool build(const tbb::atomic<bool>& abort)
+	{
+		AVFormatContext* weak_context = nullptr;
+		THROW_ON_ERROR2(avformat_open_input(&weak_context, narrow(filename_).c_str(), nullptr, nullptr), filename_);
+		safe_ptr<AVFormatContext> context(weak_context, av_close_input_file);
+		THROW_ON_ERROR2(avformat_find_stream_info(weak_context, nullptr), filename_);
+
+		// Same stream as input seeks on.
+		stream_index_ = av_find_default_stream_index(context.get());
+		if(stream_index_ < 0 || context->streams[stream_index_]->codec->codec_type != AVMEDIA_TYPE_VIDEO)
+			return false;
+
+		auto packet = create_packet();
+
+		while(av_read_frame(context.get(), packet.get()) >= 0)
+		{
+			if(abort)
+				return false;
+
+			if(packet->stream_index == stream_index_)
+			{
+				// Without presentation timestamps decoded frames can't be matched against the index.
+				if(packet->pts == AV_NOPTS_VALUE)
+					return false;
+
+				pts_.push_back(packet->pts);
+
+				if(packet->flags & AV_PKT_FLAG_KEY)
+				{
+					keyframe key = {packet->pts, packet->dts};
+					keyframes_.push_back(key);
+				}
+			}
+
+			av_free_packet(packet.get());
+		}
+
+		boost::sort(pts_);
+		std::sort(keyframes_.begin(), keyframes_.end(), [](const keyframe& lhs, const keyframe& rhs)
+		{
+			return lhs.pts < rhs.pts;
+		});
+
+		return !keyframes_.empty();
+	}
+};
+
+seek_index::seek_index(implementation* impl) : impl_(impl){}
+
+std::shared_ptr<seek_index> seek_index::load(const std::wstring& filename)
+{
+	try
+	{
+		std::unique_ptr<implementation> impl(new implementation(filename));
+		if(!impl->load())
+			return nullptr;
+
+		return std::shared_ptr<seek_index>(new seek_index(impl.release()));
+	}
+	catch(...)
+	{
+		CASPAR_LOG_CURRENT_EXCEPTION();
+		return nullptr;
+	}
+}
+
+std::shared_ptr<seek_index> seek_index::build(const std::wstring& filename, const tbb::atomic<bool>& abort)
+{
+	try
+	{
+		std::unique_ptr<implementation> impl(new implementation(filename));
+		if(!impl->build(abort))
+			return nullptr;
+
+		CASPAR_LOG(debug) << L"[seek_index] Indexed " << impl->pts_.size() << L" frames and " << impl->keyframes_.size() << L" keyframes in " << filename;
+
+		return std::shared_ptr<seek_index>(new seek_index(impl.release()));
+	}
+	catch(...)
+	{
+		CASPAR_LOG_CURRENT_EXCEPTION();
+		return nullptr;
+	}
+}
+
+void seek_index::save() const
+{
+	try
+	{
+		impl_->save();
+	}
+	catch(...)
+	{
+		CASPAR_LOG_CURRENT_EXCEPTION();
+	}
+}
+
+int seek_index::stream_index() const{return impl_->stream_index_;}
+uint32_t seek_index::nb_frames() const{return static_cast<uint32_t>(impl_->pts_.size());}
+bool seek_index::find(uint32_t frame, seek_point& result) const{return impl_->find(frame, result);}
+
+}}
@@ -0,0 +1,65 @@
+/*
+* Copyright 2013 Sveriges Television AB http://casparcg.com/
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+#pragma once
+
+#include <common/memory/safe_ptr.h>
+
+#include <boost/noncopyable.hpp>
+
+#include <tbb/atomic.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace caspar { namespace ffmpeg {
+
+// Presentation timestamps of every frame and the keyframes of the default stream of a media file. Seeking
+// to the keyframe at or before a frame and decoding forward to its timestamp lands on exactly that frame.
+class seek_index : boost::noncopyable
+{
+public:
+	struct seek_point
+	{
+		int64_t timestamp;	// Where to seek the demuxer, in stream time base.
+		int64_t pts;		// Decode forward to this presentation timestamp.
+	};
+
+	// The index stored next to the thumbnails of filename, or nullptr if there is none or the file has changed since.
+	static std::shared_ptr<seek_index> load(const std::wstring& filename);
+
+	// Scans every packet of the file. Returns nullptr if the stream can't be indexed or abort is set while scanning.
+	static std::shared_ptr<seek_index> build(const std::wstring& filename, const tbb::atomic<bool>& abort);
+
+	void save() const;
+
+	int			stream_index() const;
+	uint32_t	nb_frames() const;
+	bool		find(uint32_t frame, seek_point& result) const;
+
+private:
+	struct implementation;
+	explicit seek_index(implementation* impl);
+	safe_ptr<implementation> impl_;
+};
+
+}}
@@ -24,6 +24,7 @@
 #include "frame_muxer.h"
 
 #include "../filter/filter.h"
+#include "../filter/deinterlacer.h"
 #include "../util/util.h"
 
 #include <core/producer/frame_producer.h>
@@ -75,6 +76,7 @@ struct frame_muxer::implementation : boost::noncopyable
 	const video_format_desc							format_desc_;
 	bool											auto_transcode_;
 	bool											auto_deinterlace_;
+	const deinterlace_mode::type					deinterlace_mode_;
 	
 	std::vector<size_t>								audio_cadence_;
 			
@@ -97,6 +99,7 @@ struct frame_muxer::implementation : boost::noncopyable
 		, format_desc_(frame_factory->get_video_format_desc())
 		, auto_transcode_(env::properties().get(L"configuration.auto-transcode", true))
 		, auto_deinterlace_(env::properties().get(L"configuration.auto-deinterlace", true))
+		, deinterlace_mode_(deinterlace_mode::parse(env::properties().get(L"configuration.ffmpeg.deinterlace-mode", std::wstring(L"yadif"))))
 		, audio_cadence_(format_desc_.audio_cadence)
 		, frame_factory_(frame_factory)
 		, filter_str_(filter_str)
@@ -171,7 +174,7 @@ struct frame_muxer::implementation : boost::noncopyable
 		}
 		else if(audio == empty_audio())
 		{
-			boost::range::push_back(audio_streams_.back(), core::audio_buffer(audio_cadence_.front() * audio_channel_layout_.num_channels, 0));
+			audio_streams_.back().resize(audio_streams_.back().size() + audio_cadence_.front() * audio_channel_layout_.num_channels, 0);
 		}
 		else
 		{
@@ -336,9 +339,9 @@ struct frame_muxer::implementation : boost::noncopyable
 			}
 
 			if(display_mode_ == display_mode::deinterlace)
-				filter_str = append_filter(filter_str, L"YADIF=0:-1");
+				filter_str = append_filter(filter_str, make_deinterlace_filter(deinterlace_mode_, false));
 			else if(display_mode_ == display_mode::deinterlace_bob || display_mode_ == display_mode::deinterlace_bob_reinterlace)
-				filter_str = append_filter(filter_str, L"YADIF=1:-1");
+				filter_str = append_filter(filter_str, make_deinterlace_filter(deinterlace_mode_, true));
 		}
 
 		if(display_mode_ == display_mode::invalid)
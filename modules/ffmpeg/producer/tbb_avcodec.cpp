@@ -29,9 +29,14 @@
 
 #include <tbb/task.h>
 #include <tbb/atomic.h>
+#include <tbb/mutex.h>
 #include <tbb/parallel_for.h>
+#include <tbb/partitioner.h>
 #include <tbb/tbb_thread.h>
 
+#include <algorithm>
+#include <map>
+
 #if defined(_MSC_VER)
 #pragma warning (push)
 #pragma warning (disable : 4244)
@@ -47,6 +52,9 @@ extern "C"
 #endif
 
 namespace caspar {
+
+static const int MAX_SLICE_CONTEXTS = 16; // See mpegvideo.h
+static const int MAX_FRAME_THREADS	= 8;  // Every frame thread adds a frame of decoding delay.
 		
 int thread_execute(AVCodecContext* s, int (*func)(AVCodecContext *c2, void *arg2), void* arg, int* ret, int count, int size)
 {
@@ -62,43 +70,43 @@ int thread_execute(AVCodecContext* s, int (*func)(AVCodecContext *c2, void *arg2
 
 int thread_execute2(AVCodecContext* s, int (*func)(AVCodecContext* c2, void* arg2, int, int), void* arg, int* ret, int count)
 {	
-	tbb::atomic<int> counter;   
-    counter = 0;   
+	// threadnr selects one of the thread_count slice contexts of the codec, so the jobs are split into at most 
+	// thread_count interleaved groups and each group gets its own context, regardless of how many cores tbb uses.
+	auto groups = std::min(count, s->thread_count);
 
-	CASPAR_VERIFY(tbb::tbb_thread::hardware_concurrency() < 16);
-	// Note: this will probably only work when tbb::task_scheduler_init::num_threads() < 16.
-    tbb::parallel_for(tbb::blocked_range<int>(0, count, 2), [&](const tbb::blocked_range<int> &r)    
+    tbb::parallel_for(tbb::blocked_range<int>(0, groups, 1), [&](const tbb::blocked_range<int>& r)    
     {   
-        int threadnr = counter++;   
-        for(int jobnr = r.begin(); jobnr != r.end(); ++jobnr)
-        {   
-            int r = func(s, arg, jobnr, threadnr);   
-            if (ret)   
-                ret[jobnr] = r;   
-        }
-        --counter;
-    });   
+		for(int threadnr = r.begin(); threadnr != r.end(); ++threadnr)
+		{
+			for(int jobnr = threadnr; jobnr < count; jobnr += groups)
+			{   
+				int r = func(s, arg, jobnr, threadnr);   
+				if (ret)   
+					ret[jobnr] = r;   
+			}
+		}
+    }, tbb::simple_partitioner());   
 
     return 0;  
 }
 
+static int dummy_opaque;
+
 void thread_init(AVCodecContext* s)
 {
-	static const size_t MAX_THREADS = 16; // See mpegvideo.h
-	static int dummy_opaque;
-
     s->active_thread_type = FF_THREAD_SLICE;
 	s->thread_opaque	  = &dummy_opaque; 
     s->execute			  = thread_execute;
     s->execute2			  = thread_execute2;
-    s->thread_count		  = MAX_THREADS; // We are using a task-scheduler, so use as many "threads/tasks" as possible. 
+    s->thread_count		  = MAX_SLICE_CONTEXTS; // We are using a task-scheduler, so use as many "threads/tasks" as possible. 
 
 	CASPAR_LOG(info) << "Initialized ffmpeg tbb context.";
 }
 
 void thread_free(AVCodecContext* s)
 {
-	if(!s->thread_opaque)
+	// Contexts which ffmpeg threads itself are released by ff_thread_free.
+	if(s->thread_opaque != &dummy_opaque)
 		return;
 
 	s->thread_opaque = nullptr;
@@ -106,27 +114,115 @@ void thread_free(AVCodecContext* s)
 	CASPAR_LOG(info) << "Released ffmpeg tbb context.";
 }
 
-int tbb_avcodec_open(AVCodecContext* avctx, AVCodec* codec)
+// Threads started by the decoders themselves are shared between all producers, configuration.ffmpeg.decode-threads 
+// in total. A decoder which opens when the budget is spent decodes in the calling thread.
+struct decode_thread_budget
+{
+	tbb::mutex						mutex;
+	bool							initialized;
+	int								available;
+	std::map<AVCodecContext*, int>	allocations;
+
+	decode_thread_budget()
+		: initialized(false)
+		, available(0)
+	{
+	}
+
+	int acquire(AVCodecContext* avctx, int wanted)
+	{
+		tbb::mutex::scoped_lock lock(mutex);
+
+		if(!initialized) // The configuration is not loaded during static initialization.
+		{
+			available	= env::properties().get(L"configuration.ffmpeg.decode-threads", static_cast<int>(tbb::tbb_thread::hardware_concurrency()));
+			initialized = true;
+		}
+
+		auto count = std::min(wanted, available);
+		if(count < 2)
+			return 1;
+
+		available -= count;
+		allocations[avctx] = count;
+		return count;
+	}
+
+	void release(AVCodecContext* avctx)
+	{
+		tbb::mutex::scoped_lock lock(mutex);
+
+		auto it = allocations.find(avctx);
+		if(it == allocations.end())
+			return;
+
+		available += it->second;
+		allocations.erase(it);
+	}
+};
+
+static decode_thread_budget g_decode_thread_budget;
+
+// Frame threading scales best but needs a codec which supports it and costs latency. The tbb slice context is only 
+// used for the codecs known to work with several multithreaded decoding instances, other slice threaded codecs
+// use their own threads.
+static bool can_use_tbb_slices(AVCodecContext* avctx, AVCodec* codec)
 {
 	CodecID supported_codecs[] = {CODEC_ID_MPEG2VIDEO, CODEC_ID_PRORES, CODEC_ID_FFV1};
 
+	return std::find(std::begin(supported_codecs), std::end(supported_codecs), codec->id) != std::end(supported_codecs) && 
+		   (codec->capabilities & CODEC_CAP_SLICE_THREADS) && 
+		   (avctx->thread_type & FF_THREAD_SLICE);
+}
+
+int tbb_avcodec_open(AVCodecContext* avctx, AVCodec* codec, int thread_count)
+{
 	avctx->thread_count = 1;
-	// Some codecs don't like to have multiple multithreaded decoding instances. Only enable for those we know work.
-	if(std::find(std::begin(supported_codecs), std::end(supported_codecs), codec->id) != std::end(supported_codecs) && 
-	  (codec->capabilities & CODEC_CAP_SLICE_THREADS) && 
-	  (avctx->thread_type & FF_THREAD_SLICE)) 
+
+	auto hardware_threads = static_cast<int>(tbb::tbb_thread::hardware_concurrency());
+
+	if(codec->type != AVMEDIA_TYPE_VIDEO)
+		return avcodec_open(avctx, codec);
+	
+	if(can_use_tbb_slices(avctx, codec) && thread_count == 0)
 	{
+		// ff_thread_init will not be executed since thread_opaque != nullptr || thread_count == 1.
 		thread_init(avctx);
-	}	
-	// ff_thread_init will not be executed since thread_opaque != nullptr || thread_count == 1.
-	return avcodec_open(avctx, codec); 
+		return avcodec_open(avctx, codec); 
+	}
+
+	int thread_type = 0;
+	if((codec->capabilities & CODEC_CAP_FRAME_THREADS) && (avctx->thread_type & FF_THREAD_FRAME))
+		thread_type = FF_THREAD_FRAME;
+	else if((codec->capabilities & CODEC_CAP_SLICE_THREADS) && (avctx->thread_type & FF_THREAD_SLICE))
+		thread_type = FF_THREAD_SLICE;
+
+	if(thread_type == 0)
+		return avcodec_open(avctx, codec);
+
+	auto wanted = thread_count > 0 ? thread_count : std::min(hardware_threads, thread_type == FF_THREAD_FRAME ? MAX_FRAME_THREADS : MAX_SLICE_CONTEXTS);
+	auto count	= thread_count > 0 ? thread_count : g_decode_thread_budget.acquire(avctx, wanted);
+
+	avctx->thread_type	= thread_type;
+	avctx->thread_count	= count;
+
+	auto ret = avcodec_open(avctx, codec);
+
+	if(ret < 0)
+		g_decode_thread_budget.release(avctx);
+	else
+		CASPAR_LOG(debug) << "[tbb_avcodec] " << codec->name << (thread_type == FF_THREAD_FRAME ? " frame" : " slice") << " threads: " << count;
+
+	return ret;
 }
 
 int tbb_avcodec_close(AVCodecContext* avctx)
 {
 	thread_free(avctx);
-	// ff_thread_free will not be executed since thread_opaque == nullptr.
-	return avcodec_close(avctx); 
+	// ff_thread_free will not be executed for the tbb context since thread_opaque == nullptr.
+	auto ret = avcodec_close(avctx); 
+	g_decode_thread_budget.release(avctx);
+	return ret;
 }
 
-}
\ No newline at end of file
+}
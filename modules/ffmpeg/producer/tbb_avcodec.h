@@ -26,7 +26,8 @@ struct AVCodec;
 
 namespace caspar {
 	
-int tbb_avcodec_open(AVCodecContext *avctx, AVCodec *codec);
+// thread_count 0 selects frame or slice threading and the number of threads from the decode thread budget.
+int tbb_avcodec_open(AVCodecContext *avctx, AVCodec *codec, int thread_count = 0);
 int tbb_avcodec_close(AVCodecContext *avctx);
 
 }
\ No newline at end of file
@@ -0,0 +1,565 @@
+/*
+* Copyright 2013 Sveriges Television AB http://casparcg.com/
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+#include "../../stdafx.h"
+
+#include "color_conversion.h"
+
+#include <common/exception/exceptions.h>
+
+#include <tbb/parallel_for.h>
+
+#include <emmintrin.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(_MSC_VER)
+#pragma warning (push)
+#pragma warning (disable : 4244)
+#endif
+extern "C"
+{
+	#define __STDC_CONSTANT_MACROS
+	#define __STDC_LIMIT_MACROS
+	#include <libavcodec/avcodec.h>
+	#include <libavutil/pixdesc.h>
+}
+#if defined(_MSC_VER)
+#pragma warning (pop)
+#endif
+
+namespace caspar { namespace ffmpeg {
+
+namespace {
+
+const int slice_rows = 16;
+
+// Calls func(begin, end) for slices of [0, count) rows in parallel.
+template<typename F>
+void parallel_rows(int count, const F& func)
+{
+	tbb::parallel_for(tbb::blocked_range<int>(0, count, slice_rows), [&](const tbb::blocked_range<int>& r)
+	{
+		func(r.begin(), r.end());
+	});
+}
+
+template<typename T>
+T* get_row(T* data, int linesize, int y)
+{
+	return reinterpret_cast<T*>(reinterpret_cast<uint8_t*>(data) + y * linesize);
+}
+
+template<typename T>
+const T* get_row(const T* data, int linesize, int y)
+{
+	return reinterpret_cast<const T*>(reinterpret_cast<const uint8_t*>(data) + y * linesize);
+}
+
+bool is_planar_ycbcr(PixelFormat pix_fmt)
+{
+	switch(pix_fmt)
+	{
+	case PIX_FMT_YUV420P:
+	case PIX_FMT_YUVJ420P:
+	case PIX_FMT_YUVA420P:
+	case PIX_FMT_YUV422P:
+	case PIX_FMT_YUVJ422P:
+	case PIX_FMT_YUV444P:
+	case PIX_FMT_YUVJ444P:
+	case PIX_FMT_YUV440P:
+	case PIX_FMT_YUVJ440P:
+	case PIX_FMT_YUV411P:
+	case PIX_FMT_YUV410P:
+	case PIX_FMT_YUV420P9:
+	case PIX_FMT_YUV420P10:
+	case PIX_FMT_YUV420P16:
+	case PIX_FMT_YUV422P9:
+	case PIX_FMT_YUV422P10:
+	case PIX_FMT_YUV422P16:
+	case PIX_FMT_YUV444P9:
+	case PIX_FMT_YUV444P10:
+	case PIX_FMT_YUV444P16:
+		return true;
+	default:
+		return false;
+	}
+}
+
+int get_depth(PixelFormat pix_fmt)
+{
+	return av_pix_fmt_descriptors[pix_fmt].comp[0].depth_minus1 + 1;
+}
+
+int get_plane_count(PixelFormat pix_fmt)
+{
+	const auto& desc = av_pix_fmt_descriptors[pix_fmt];
+	int count = 0;
+	for(int n = 0; n < desc.nb_components; ++n)
+		count = std::max(count, desc.comp[n].plane + 1);
+	return count;
+}
+
+int get_plane_width(PixelFormat pix_fmt, int plane, int width)
+{
+	return plane == 1 || plane == 2 ? -((-width) >> av_pix_fmt_descriptors[pix_fmt].log2_chroma_w) : width;
+}
+
+int get_plane_height(PixelFormat pix_fmt, int plane, int height)
+{
+	return plane == 1 || plane == 2 ? -((-height) >> av_pix_fmt_descriptors[pix_fmt].log2_chroma_h) : height;
+}
+
+// Row kernels
+
+// 9-16 bit to 8 bit with rounding, shift is depth - 8.
+void reduce_row(uint8_t* dest, const uint16_t* source, int count, int shift)
+{
+	auto shift_xmm		= _mm_cvtsi32_si128(shift);
+	auto round_xmm		= _mm_cvtsi32_si128(shift - 1);
+	auto one			= _mm_set1_epi16(1);
+
+	int x = 0;
+	for(; x + 16 <= count; x += 16)
+	{
+		auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + x));
+		auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + x + 8));
+		a = _mm_add_epi16(_mm_srl_epi16(a, shift_xmm), _mm_and_si128(_mm_srl_epi16(a, round_xmm), one));
+		b = _mm_add_epi16(_mm_srl_epi16(b, shift_xmm), _mm_and_si128(_mm_srl_epi16(b, round_xmm), one));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + x), _mm_packus_epi16(a, b));
+	}
+	for(; x < count; ++x)
+		dest[x] = static_cast<uint8_t>(std::min(255, (source[x] >> shift) + ((source[x] >> (shift - 1)) & 1)));
+}
+
+void lut_row(uint8_t* dest, const uint8_t* source, int count, const uint8_t* lut)
+{
+	for(int x = 0; x < count; ++x)
+		dest[x] = lut[source[x]];
+}
+
+// Splits interleaved pairs, used for the chroma plane of nv12 and nv21.
+void deinterleave_row(uint8_t* even, uint8_t* odd, const uint8_t* source, int pairs)
+{
+	auto mask = _mm_set1_epi16(0x00FF);
+
+	int x = 0;
+	for(; x + 16 <= pairs; x += 16)
+	{
+		auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + x*2));
+		auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + x*2 + 16));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(even + x), _mm_packus_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask)));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(odd + x),  _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8)));
+	}
+	for(; x < pairs; ++x)
+	{
+		even[x] = source[x*2 + 0];
+		odd[x]	= source[x*2 + 1];
+	}
+}
+
+// uyvy and yuyv to planar 4:2:2.
+void packed_422_row(uint8_t* y, uint8_t* cb, uint8_t* cr, const uint8_t* source, int width, bool uyvy)
+{
+	auto mask = _mm_set1_epi16(0x00FF);
+	auto zero = _mm_setzero_si128();
+
+	int x = 0;
+	for(; x + 16 <= width; x += 16)
+	{
+		auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + x*2));
+		auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + x*2 + 16));
+
+		auto even = _mm_packus_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask));
+		auto odd  = _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+
+		auto luma	= uyvy ? odd  : even;
+		auto chroma = uyvy ? even : odd;
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(y + x), luma);
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(cb + x/2), _mm_packus_epi16(_mm_and_si128(chroma, mask), zero));
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(cr + x/2), _mm_packus_epi16(_mm_srli_epi16(chroma, 8), zero));
+	}
+
+	auto luma_offset	= uyvy ? 1 : 0;
+	auto chroma_offset	= uyvy ? 0 : 1;
+	for(; x < width; x += 2)
+	{
+		auto p = source + x*2;
+		y[x]		= p[luma_offset];
+		cb[x/2]		= p[chroma_offset];
+		cr[x/2]		= p[chroma_offset + 2];
+		if(x + 1 < width)
+			y[x + 1] = p[luma_offset + 2];
+	}
+}
+
+// uyyvyy411 to planar 4:1:1.
+void packed_411_row(uint8_t* y, uint8_t* cb, uint8_t* cr, const uint8_t* source, int width)
+{
+	for(int x = 0; x < width; x += 4)
+	{
+		auto p = source + (x/4)*6;
+		cb[x/4] = p[0];
+		cr[x/4] = p[3];
+		y[x] = p[1];
+		if(x + 1 < width) y[x + 1] = p[2];
+		if(x + 2 < width) y[x + 2] = p[4];
+		if(x + 3 < width) y[x + 3] = p[5];
+	}
+}
+
+// Ycbcr to bgra, fixed point in quarter units. Each term is (x * 64 * k) >> 16 = x * k / 1024,
+// which is what _mm_mulhi_epi16 computes, so the scalar and sse2 paths match exactly.
+struct ycbcr_matrix
+{
+	int16_t y_offset;
+	int16_t y;
+	int16_t cr_r;
+	int16_t cb_g;
+	int16_t cr_g;
+	int16_t cb_b;
+};
+
+ycbcr_matrix get_matrix(color_space::type space, color_range::type range)
+{
+	double kr = 0.299;
+	double kb = 0.114;
+	if(space == color_space::bt709)
+	{
+		kr = 0.2126;
+		kb = 0.0722;
+	}
+	else if(space == color_space::bt2020)
+	{
+		kr = 0.2627;
+		kb = 0.0593;
+	}
+	auto kg = 1.0 - kr - kb;
+
+	auto y_scale = range == color_range::full ? 1.0 : 255.0/219.0;
+	auto c_scale = range == color_range::full ? 1.0 : 255.0/224.0;
+
+	auto fixed = [](double value)
+	{
+		return static_cast<int16_t>(std::floor(value * 4096.0 + 0.5));
+	};
+
+	ycbcr_matrix m;
+	m.y_offset	= range == color_range::full ? 0 : 16;
+	m.y			= fixed(y_scale);
+	m.cr_r		= fixed(c_scale * 2.0 * (1.0 - kr));
+	m.cb_g		= fixed(c_scale * 2.0 * kb * (1.0 - kb) / kg);
+	m.cr_g		= fixed(c_scale * 2.0 * kr * (1.0 - kr) / kg);
+	m.cb_b		= fixed(c_scale * 2.0 * (1.0 - kb));
+	return m;
+}
+
+inline int fixed_mul(int x, int k)
+{
+	return ((x << 6) * k) >> 16;
+}
+
+inline uint8_t clamp_byte(int value)
+{
+	return static_cast<uint8_t>(std::max(0, std::min(255, value)));
+}
+
+inline __m128i load_chroma_sse2(const uint8_t* source, int shift)
+{
+	switch(shift)
+	{
+	case 0:
+		return _mm_loadl_epi64(reinterpret_cast<const __m128i*>(source));
+	case 1:
+		{
+			int32_t value;
+			memcpy(&value, source, sizeof(value));
+			auto xmm = _mm_cvtsi32_si128(value);
+			return _mm_unpacklo_epi8(xmm, xmm);
+		}
+	default:
+		{
+			int16_t value;
+			memcpy(&value, source, sizeof(value));
+			auto xmm = _mm_cvtsi32_si128(value);
+			xmm = _mm_unpacklo_epi8(xmm, xmm);
+			return _mm_unpacklo_epi8(xmm, xmm);
+		}
+	}
+}
+
+void ycbcr_to_bgra_row(uint8_t* dest, const uint8_t* y, const uint8_t* cb, const uint8_t* cr, const uint8_t* a, int width, int chroma_shift, const ycbcr_matrix& m)
+{
+	auto zero		= _mm_setzero_si128();
+	auto y_offset	= _mm_set1_epi16(m.y_offset);
+	auto c_offset	= _mm_set1_epi16(128);
+	auto round		= _mm_set1_epi16(2);
+	auto k_y		= _mm_set1_epi16(m.y);
+	auto k_cr_r		= _mm_set1_epi16(m.cr_r);
+	auto k_cb_g		= _mm_set1_epi16(m.cb_g);
+	auto k_cr_g		= _mm_set1_epi16(m.cr_g);
+	auto k_cb_b		= _mm_set1_epi16(m.cb_b);
+	auto opaque		= _mm_set1_epi8(-1);
+
+	int x = 0;
+	if(chroma_shift <= 2)
+	{
+		for(; x + 8 <= width; x += 8)
+		{
+			auto yv		= _mm_slli_epi16(_mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(y + x)), zero), y_offset), 6);
+			auto cbv	= _mm_slli_epi16(_mm_sub_epi16(_mm_unpacklo_epi8(load_chroma_sse2(cb + (x >> chroma_shift), chroma_shift), zero), c_offset), 6);
+			auto crv	= _mm_slli_epi16(_mm_sub_epi16(_mm_unpacklo_epi8(load_chroma_sse2(cr + (x >> chroma_shift), chroma_shift), zero), c_offset), 6);
+
+			auto luma	= _mm_add_epi16(_mm_mulhi_epi16(yv, k_y), round);
+			auto b		= _mm_srai_epi16(_mm_add_epi16(luma, _mm_mulhi_epi16(cbv, k_cb_b)), 2);
+			auto g		= _mm_srai_epi16(_mm_sub_epi16(_mm_sub_epi16(luma, _mm_mulhi_epi16(cbv, k_cb_g)), _mm_mulhi_epi16(crv, k_cr_g)), 2);
+			auto r		= _mm_srai_epi16(_mm_add_epi16(luma, _mm_mulhi_epi16(crv, k_cr_r)), 2);
+
+			auto alpha	= a ? _mm_loadl_epi64(reinterpret_cast<const __m128i*>(a + x)) : opaque;
+
+			auto bg		= _mm_unpacklo_epi8(_mm_packus_epi16(b, b), _mm_packus_epi16(g, g));
+			auto ra		= _mm_unpacklo_epi8(_mm_packus_epi16(r, r), alpha);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + x*4),	  _mm_unpacklo_epi16(bg, ra));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + x*4 + 16), _mm_unpackhi_epi16(bg, ra));
+		}
+	}
+
+	for(; x < width; ++x)
+	{
+		auto luma	= fixed_mul(y[x] - m.y_offset, m.y) + 2;
+		auto cbv	= cb[x >> chroma_shift] - 128;
+		auto crv	= cr[x >> chroma_shift] - 128;
+
+		dest[x*4 + 0] = clamp_byte((luma + fixed_mul(cbv, m.cb_b)) >> 2);
+		dest[x*4 + 1] = clamp_byte((luma - fixed_mul(cbv, m.cb_g) - fixed_mul(crv, m.cr_g)) >> 2);
+		dest[x*4 + 2] = clamp_byte((luma + fixed_mul(crv, m.cr_r)) >> 2);
+		dest[x*4 + 3] = a ? a[x] : 255;
+	}
+}
+
+// Converters
+
+void convert_packed_422(const AVFrame& source, AVFrame& dest)
+{
+	bool uyvy = source.format == PIX_FMT_UYVY422;
+	parallel_rows(source.height, [&](int begin, int end)
+	{
+		for(int n = begin; n < end; ++n)
+		{
+			packed_422_row(get_row(dest.data[0], dest.linesize[0], n),
+						   get_row(dest.data[1], dest.linesize[1], n),
+						   get_row(dest.data[2], dest.linesize[2], n),
+						   get_row(source.data[0], source.linesize[0], n), source.width, uyvy);
+		}
+	});
+}
+
+void convert_packed_411(const AVFrame& source, AVFrame& dest)
+{
+	parallel_rows(source.height, [&](int begin, int end)
+	{
+		for(int n = begin; n < end; ++n)
+		{
+			packed_411_row(get_row(dest.data[0], dest.linesize[0], n),
+						   get_row(dest.data[1], dest.linesize[1], n),
+						   get_row(dest.data[2], dest.linesize[2], n),
+						   get_row(source.data[0], source.linesize[0], n), source.width);
+		}
+	});
+}
+
+void convert_nv12(const AVFrame& source, AVFrame& dest)
+{
+	bool nv21 = source.format == PIX_FMT_NV21;
+	auto chroma_width  = (source.width  + 1) / 2;
+	auto chroma_height = (source.height + 1) / 2;
+
+	parallel_rows(source.height, [&](int begin, int end)
+	{
+		for(int n = begin; n < end; ++n)
+			memcpy(get_row(dest.data[0], dest.linesize[0], n), get_row(source.data[0], source.linesize[0], n), source.width);
+	});
+
+	parallel_rows(chroma_height, [&](int begin, int end)
+	{
+		for(int n = begin; n < end; ++n)
+		{
+			auto cb = get_row(dest.data[nv21 ? 2 : 1], dest.linesize[nv21 ? 2 : 1], n);
+			auto cr = get_row(dest.data[nv21 ? 1 : 2], dest.linesize[nv21 ? 1 : 2], n);
+			deinterleave_row(cb, cr, get_row(source.data[1], source.linesize[1], n), chroma_width);
+		}
+	});
+}
+
+// Reduces the bit depth and compresses full range into limited range, plane by plane.
+void convert_planar(const AVFrame& source, AVFrame& dest, color_range::type range)
+{
+	auto pix_fmt = static_cast<PixelFormat>(source.format);
+	auto depth	 = get_depth(pix_fmt);
+
+	uint8_t luma_lut[256];
+	uint8_t chroma_lut[256];
+	for(int n = 0; n < 256; ++n)
+	{
+		luma_lut[n]		= static_cast<uint8_t>(std::floor(16.0  + n * 219.0 / 255.0 + 0.5));
+		chroma_lut[n]	= static_cast<uint8_t>(std::floor(128.0 + (n - 128) * 224.0 / 255.0 + 0.5));
+	}
+
+	for(int plane = 0; plane < get_plane_count(pix_fmt); ++plane)
+	{
+		auto width	= get_plane_width(pix_fmt, plane, source.width);
+		auto height	= get_plane_height(pix_fmt, plane, source.height);
+		auto lut	= range == color_range::full && plane < 3 ? (plane == 0 ? luma_lut : chroma_lut) : nullptr;
+
+		parallel_rows(height, [&](int begin, int end)
+		{
+			for(int n = begin; n < end; ++n)
+			{
+				auto dest_row = get_row(dest.data[plane], dest.linesize[plane], n);
+
+				if(depth > 8)
+					reduce_row(dest_row, get_row(reinterpret_cast<const uint16_t*>(source.data[plane]), source.linesize[plane], n), width, depth - 8);
+				else if(!lut)
+					memcpy(dest_row, get_row(source.data[plane], source.linesize[plane], n), width);
+
+				if(lut)
+					lut_row(dest_row, depth > 8 ? dest_row : get_row(source.data[plane], source.linesize[plane], n), width, lut);
+			}
+		});
+	}
+}
+
+void convert_to_bgra(const AVFrame& source, AVFrame& dest, color_space::type space, color_range::type range)
+{
+	auto pix_fmt	= static_cast<PixelFormat>(source.format);
+	auto depth		= get_depth(pix_fmt);
+	auto planes		= get_plane_count(pix_fmt);
+	auto matrix		= get_matrix(space, range);
+	auto shift_w	= av_pix_fmt_descriptors[pix_fmt].log2_chroma_w;
+	auto shift_h	= av_pix_fmt_descriptors[pix_fmt].log2_chroma_h;
+
+	parallel_rows(source.height, [&](int begin, int end)
+	{
+		// High bit depth rows are reduced into per slice buffers first.
+		std::vector<uint8_t> buffers[4];
+
+		const uint8_t* rows[4] = {nullptr, nullptr, nullptr, nullptr};
+		for(int n = begin; n < end; ++n)
+		{
+			for(int plane = 0; plane < planes; ++plane)
+			{
+				auto width	= get_plane_width(pix_fmt, plane, source.width);
+				auto y		= plane == 1 || plane == 2 ? n >> shift_h : n;
+
+				if(depth > 8)
+				{
+					buffers[plane].resize(width);
+					reduce_row(buffers[plane].data(), get_row(reinterpret_cast<const uint16_t*>(source.data[plane]), source.linesize[plane], y), width, depth - 8);
+					rows[plane] = buffers[plane].data();
+				}
+				else
+					rows[plane] = get_row(source.data[plane], source.linesize[plane], y);
+			}
+
+			ycbcr_to_bgra_row(get_row(dest.data[0], dest.linesize[0], n), rows[0], rows[1], rows[2], rows[3], source.width, shift_w, matrix);
+		}
+	});
+}
+
+}
+
+PixelFormat get_conversion_target(PixelFormat pix_fmt)
+{
+	switch(pix_fmt)
+	{
+	case PIX_FMT_UYVY422:
+	case PIX_FMT_YUYV422:
+	case PIX_FMT_YUVJ422P:
+	case PIX_FMT_YUV422P9:
+	case PIX_FMT_YUV422P10:
+	case PIX_FMT_YUV422P16:
+		return PIX_FMT_YUV422P;
+	case PIX_FMT_NV12:
+	case PIX_FMT_NV21:
+	case PIX_FMT_YUVJ420P:
+	case PIX_FMT_YUV420P9:
+	case PIX_FMT_YUV420P10:
+	case PIX_FMT_YUV420P16:
+		return PIX_FMT_YUV420P;
+	case PIX_FMT_YUVJ444P:
+	case PIX_FMT_YUV444P9:
+	case PIX_FMT_YUV444P10:
+	case PIX_FMT_YUV444P16:
+		return PIX_FMT_YUV444P;
+	case PIX_FMT_UYYVYY411:
+		return PIX_FMT_YUV411P;
+	case PIX_FMT_YUV440P:	// Not supported by the image mixer.
+	case PIX_FMT_YUVJ440P:
+		return PIX_FMT_BGRA;
+	default:
+		return PIX_FMT_NONE;
+	}
+}
+
+color_range::type get_color_range(PixelFormat pix_fmt)
+{
+	switch(pix_fmt)
+	{
+	case PIX_FMT_YUVJ420P:
+	case PIX_FMT_YUVJ422P:
+	case PIX_FMT_YUVJ444P:
+	case PIX_FMT_YUVJ440P:
+		return color_range::full;
+	default:
+		return color_range::limited;
+	}
+}
+
+void convert_frame(const AVFrame& source, AVFrame& dest, color_space::type space, color_range::type range)
+{
+	auto source_fmt = static_cast<PixelFormat>(source.format);
+	auto dest_fmt	= static_cast<PixelFormat>(dest.format);
+
+	if(source.width < 1 || source.height < 1 || source.data[0] == nullptr || dest.data[0] == nullptr)
+		BOOST_THROW_EXCEPTION(invalid_argument() << msg_info("Empty frame."));
+
+	if((source_fmt == PIX_FMT_UYVY422 || source_fmt == PIX_FMT_YUYV422) && dest_fmt == PIX_FMT_YUV422P)
+		convert_packed_422(source, dest);
+	else if(source_fmt == PIX_FMT_UYYVYY411 && dest_fmt == PIX_FMT_YUV411P)
+		convert_packed_411(source, dest);
+	else if((source_fmt == PIX_FMT_NV12 || source_fmt == PIX_FMT_NV21) && dest_fmt == PIX_FMT_YUV420P)
+		convert_nv12(source, dest);
+	else if(is_planar_ycbcr(source_fmt) && dest_fmt == PIX_FMT_BGRA)
+		convert_to_bgra(source, dest, space, range);
+	else if(is_planar_ycbcr(source_fmt) && is_planar_ycbcr(dest_fmt) && get_depth(dest_fmt) == 8 &&
+			av_pix_fmt_descriptors[source_fmt].log2_chroma_w == av_pix_fmt_descriptors[dest_fmt].log2_chroma_w &&
+			av_pix_fmt_descriptors[source_fmt].log2_chroma_h == av_pix_fmt_descriptors[dest_fmt].log2_chroma_h)
+		convert_planar(source, dest, range);
+	else
+		BOOST_THROW_EXCEPTION(invalid_argument() << msg_info("Unsupported color conversion."));
+}
+
+}}
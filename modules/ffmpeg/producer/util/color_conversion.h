@@ -0,0 +1,70 @@
+/*
+* Copyright 2013 Sveriges Television AB http://casparcg.com/
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+#pragma once
+
+#include <string>
+
+struct AVFrame;
+enum PixelFormat;
+
+namespace caspar { namespace ffmpeg {
+
+struct color_space
+{
+	enum type
+	{
+		bt601,
+		bt709,
+		bt2020,
+		count
+	};
+
+	// The matrix the image mixer assumes for ycbcr frames of the given height.
+	static color_space::type get_default(int height)
+	{
+		return height > 700 ? bt709 : bt601;
+	}
+};
+
+struct color_range
+{
+	enum type
+	{
+		limited,	// 16-235 luma, 16-240 chroma.
+		full,		// 0-255 (jpeg).
+		count
+	};
+};
+
+// Returns the format make_write_frame uploads frames of pix_fmt as, or PIX_FMT_NONE if
+// convert_frame can't convert pix_fmt. Ycbcr targets are always 8 bit limited range.
+PixelFormat get_conversion_target(PixelFormat pix_fmt);
+
+// Returns the range the samples of pix_fmt are stored in.
+color_range::type get_color_range(PixelFormat pix_fmt);
+
+// Converts source into dest, which must have the same dimensions and a format returned by
+// get_conversion_target. Rows are converted in parallel slices using sse2. space and range
+// describe source and are only used when converting to rgb.
+void convert_frame(const AVFrame& source, AVFrame& dest, color_space::type space, color_range::type range);
+
+}}
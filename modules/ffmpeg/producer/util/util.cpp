@@ -24,8 +24,10 @@
 #include "util.h"
 
 #include "flv.h"
+#include "color_conversion.h"
 
 #include "../tbb_avcodec.h"
+#include "../../ffmpeg.h"
 #include "../../ffmpeg_error.h"
 
 #include <tbb/concurrent_unordered_map.h>
@@ -36,6 +38,7 @@
 #include <core/producer/frame_producer.h>
 #include <core/mixer/write_frame.h>
 #include <core/mixer/audio/audio_util.h>
+#include <core/media_library.h>
 
 #include <common/exception/exceptions.h>
 #include <common/utility/assert.h>
@@ -173,6 +176,31 @@ int make_alpha_format(int format)
 	}
 }
 
+// Returns the frame that the video_decoder rendered decoded_frame directly into, if its planes can be used as is.
+static std::shared_ptr<core::write_frame> take_direct_frame(const void* tag, AVFrame& decoded_frame, const core::pixel_format_desc& desc, const core::channel_layout& audio_channel_layout)
+{
+	auto direct = static_cast<std::shared_ptr<core::write_frame>*>(decoded_frame.opaque);
+	if(!direct || !*direct)
+		return nullptr;
+
+	auto image = std::move(*direct); // The planes can only be committed once.
+	auto& image_desc = image->get_pixel_format_desc();
+
+	if(image_desc.pix_fmt != desc.pix_fmt || image_desc.planes.size() != desc.planes.size())
+		return nullptr;
+
+	for(size_t n = 0; n < desc.planes.size(); ++n)
+	{
+		if(image_desc.planes[n].width	!= desc.planes[n].width  ||
+		   image_desc.planes[n].height	!= desc.planes[n].height ||
+		   image_desc.planes[n].linesize != static_cast<size_t>(decoded_frame.linesize[n]) ||
+		   image->image_data(n).begin() != decoded_frame.data[n])
+			return nullptr;
+	}
+
+	return std::make_shared<core::write_frame>(tag, audio_channel_layout, *image);
+}
+
 safe_ptr<core::write_frame> make_write_frame(const void* tag, const safe_ptr<AVFrame>& decoded_frame, const safe_ptr<core::frame_factory>& frame_factory, int hints, const core::channel_layout& audio_channel_layout)
 {			
 	static tbb::concurrent_unordered_map<int64_t, tbb::concurrent_queue<std::shared_ptr<SwsContext>>> sws_contexts_;
@@ -187,53 +215,26 @@ safe_ptr<core::write_frame> make_write_frame(const void* tag, const safe_ptr<AVF
 	if(hints & core::frame_producer::ALPHA_HINT)
 		desc = get_pixel_format_desc(static_cast<PixelFormat>(make_alpha_format(decoded_frame->format)), width, height);
 
-	std::shared_ptr<core::write_frame> write;
+	auto write = take_direct_frame(tag, *decoded_frame, desc, audio_channel_layout);
 
-	if(desc.pix_fmt == core::pixel_format::invalid)
+	if(write)
+	{
+		write->set_type(get_mode(*decoded_frame));
+		write->commit();
+	}
+	else if(desc.pix_fmt == core::pixel_format::invalid)
 	{
-		auto pix_fmt = static_cast<PixelFormat>(decoded_frame->format);
-		auto target_pix_fmt = PIX_FMT_BGRA;
-
-		if(pix_fmt == PIX_FMT_UYVY422)
-			target_pix_fmt = PIX_FMT_YUV422P;
-		else if(pix_fmt == PIX_FMT_YUYV422)
-			target_pix_fmt = PIX_FMT_YUV422P;
-		else if(pix_fmt == PIX_FMT_UYYVYY411)
-			target_pix_fmt = PIX_FMT_YUV411P;
-		else if(pix_fmt == PIX_FMT_YUV420P10)
-			target_pix_fmt = PIX_FMT_YUV420P;
-		else if(pix_fmt == PIX_FMT_YUV422P10)
-			target_pix_fmt = PIX_FMT_YUV422P;
-		else if(pix_fmt == PIX_FMT_YUV444P10)
-			target_pix_fmt = PIX_FMT_YUV444P;
+		auto pix_fmt		= static_cast<PixelFormat>(decoded_frame->format);
+		auto target_pix_fmt = get_conversion_target(pix_fmt);
+		bool convert		= target_pix_fmt != PIX_FMT_NONE; // Otherwise fall back to swscale.
+
+		if(!convert)
+			target_pix_fmt = PIX_FMT_BGRA;
 		
 		auto target_desc = get_pixel_format_desc(target_pix_fmt, width, height);
 
 		write = frame_factory->create_frame(tag, target_desc, audio_channel_layout);
 		write->set_type(get_mode(*decoded_frame));
-
-		std::shared_ptr<SwsContext> sws_context;
-
-		//CASPAR_LOG(warning) << "Hardware accelerated color transform not supported.";
-		
-		int64_t key = ((static_cast<int64_t>(width)			 << 32) & 0xFFFF00000000) | 
-					  ((static_cast<int64_t>(height)		 << 16) & 0xFFFF0000) | 
-					  ((static_cast<int64_t>(pix_fmt)		 <<  8) & 0xFF00) | 
-					  ((static_cast<int64_t>(target_pix_fmt) <<  0) & 0xFF);
-			
-		auto& pool = sws_contexts_[key];
-						
-		if(!pool.try_pop(sws_context))
-		{
-			double param;
-			sws_context.reset(sws_getContext(width, height, pix_fmt, width, height, target_pix_fmt, SWS_BILINEAR, nullptr, nullptr, &param), sws_freeContext);
-		}
-			
-		if(!sws_context)
-		{
-			BOOST_THROW_EXCEPTION(operation_failed() << msg_info("Could not create software scaling context.") << 
-									boost::errinfo_api_function("sws_getContext"));
-		}	
 		
 		safe_ptr<AVFrame> av_frame(avcodec_alloc_frame(), av_free);	
 		avcodec_get_frame_defaults(av_frame.get());			
@@ -244,17 +245,48 @@ safe_ptr<core::write_frame> make_write_frame(const void* tag, const safe_ptr<AVF
 		}
 		else
 		{
-			av_frame->width	 = width;
-			av_frame->height = height;
 			for(size_t n = 0; n < target_desc.planes.size(); ++n)
 			{
 				av_frame->data[n]		= write->image_data(n).begin();
 				av_frame->linesize[n]	= target_desc.planes[n].linesize;
 			}
 		}
+		av_frame->format = target_pix_fmt;
+		av_frame->width	 = width;
+		av_frame->height = height;
 
-		sws_scale(sws_context.get(), decoded_frame->data, decoded_frame->linesize, 0, height, av_frame->data, av_frame->linesize);	
-		pool.push(sws_context);
+		if(convert)
+		{
+			convert_frame(*decoded_frame, *av_frame, color_space::get_default(height), get_color_range(pix_fmt));
+		}
+		else
+		{
+			std::shared_ptr<SwsContext> sws_context;
+
+			//CASPAR_LOG(warning) << "Hardware accelerated color transform not supported.";
+		
+			int64_t key = ((static_cast<int64_t>(width)			 << 32) & 0xFFFF00000000) | 
+						  ((static_cast<int64_t>(height)		 << 16) & 0xFFFF0000) | 
+						  ((static_cast<int64_t>(pix_fmt)		 <<  8) & 0xFF00) | 
+						  ((static_cast<int64_t>(target_pix_fmt) <<  0) & 0xFF);
+			
+			auto& pool = sws_contexts_[key];
+						
+			if(!pool.try_pop(sws_context))
+			{
+				double param;
+				sws_context.reset(sws_getContext(width, height, pix_fmt, width, height, target_pix_fmt, SWS_BILINEAR, nullptr, nullptr, &param), sws_freeContext);
+			}
+			
+			if(!sws_context)
+			{
+				BOOST_THROW_EXCEPTION(operation_failed() << msg_info("Could not create software scaling context.") << 
+										boost::errinfo_api_function("sws_getContext"));
+			}	
+
+			sws_scale(sws_context.get(), decoded_frame->data, decoded_frame->linesize, 0, height, av_frame->data, av_frame->linesize);	
+			pool.push(sws_context);
+		}
 
 		write->commit();		
 	}
@@ -278,7 +310,7 @@ safe_ptr<core::write_frame> make_write_frame(const void* tag, const safe_ptr<AVF
 				// Copy line by line since ffmpeg sometimes pads each line.
 				tbb::parallel_for<size_t>(0, desc.planes[n].height, [&](size_t y)
 				{
-					fast_memcpy(result + y*plane.linesize, decoded + y*decoded_linesize, plane.linesize);
+					fast_memcpy(result + y*plane.linesize, decoded + y*decoded_linesize, plane.linesize, memcpy_mode::streaming);
 				});
 			}
 			else
@@ -465,6 +497,37 @@ bool is_valid_file(const std::wstring filename)
 	return is_valid_file(filename, invalid_exts);
 }
 
+bool get_media_info(const std::wstring& filename, core::media_info& info)
+{
+	auto disable_logging = temporary_disable_logging_for_thread(true);
+
+	AVFormatContext* weak_context = nullptr;
+	if(avformat_open_input(&weak_context, narrow(filename).c_str(), nullptr, nullptr) < 0)
+		return false;
+
+	safe_ptr<AVFormatContext> context(weak_context, av_close_input_file);
+	if(avformat_find_stream_info(weak_context, nullptr) < 0)
+		return false;
+
+	info.fps = read_fps(*context, 0.0);
+
+	if(info.fps > 0.0 && context->duration != AV_NOPTS_VALUE && context->duration > 0)
+		info.duration = static_cast<int64_t>(static_cast<double>(context->duration) * info.fps / static_cast<double>(AV_TIME_BASE) + 0.5);
+
+	auto video_index = av_find_best_stream(context.get(), AVMEDIA_TYPE_VIDEO, -1, -1, 0, 0);
+	if(video_index > -1)
+	{
+		info.width	= context->streams[video_index]->codec->width;
+		info.height	= context->streams[video_index]->codec->height;
+	}
+
+	auto audio_index = av_find_best_stream(context.get(), AVMEDIA_TYPE_AUDIO, -1, -1, 0, 0);
+	if(audio_index > -1)
+		info.audio_layout = get_audio_channel_layout(*context->streams[audio_index]->codec, L"").name;
+
+	return true;
+}
+
 std::wstring probe_stem(const std::wstring stem, const std::vector<std::wstring>& invalid_exts)
 {
 	auto stem2 = boost::filesystem2::wpath(stem);
@@ -42,6 +42,7 @@ struct pixel_format_desc;
 class write_frame;
 struct frame_factory;
 struct channel_layout;
+struct media_info;
 
 }
 
@@ -57,6 +58,7 @@ std::shared_ptr<AVFrame>			empty_video();
 static const int CASPAR_PIX_FMT_LUMA = 10; // Just hijack some unual pixel format.
 
 core::field_mode::type		get_mode(const AVFrame& frame);
+core::pixel_format_desc		get_pixel_format_desc(PixelFormat pix_fmt, size_t width, size_t height);
 int							make_alpha_format(int format); // NOTE: Be careful about CASPAR_PIX_FMT_LUMA, change it to PIX_FMT_GRAY8 if you want to use the frame inside some ffmpeg function.
 safe_ptr<core::write_frame> make_write_frame(const void* tag, const safe_ptr<AVFrame>& decoded_frame, const safe_ptr<core::frame_factory>& frame_factory, int hints, const core::channel_layout& audio_channel_layout);
 
@@ -75,6 +77,7 @@ std::wstring probe_stem(const std::wstring stem, const std::vector<std::wstring>
 std::wstring probe_stem(const std::wstring stem);
 bool is_valid_file(const std::wstring filename, const std::vector<std::wstring>& invalid_exts);
 bool is_valid_file(const std::wstring filename);
+bool get_media_info(const std::wstring& filename, core::media_info& info); // Duration, resolution, fps and audio layout.
 
 core::channel_layout get_audio_channel_layout(const AVCodecContext& context, const std::wstring& custom_channel_order);
 
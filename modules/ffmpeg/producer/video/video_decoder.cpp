@@ -29,10 +29,14 @@
 
 #include <core/producer/frame/frame_transform.h>
 #include <core/producer/frame/frame_factory.h>
+#include <core/producer/frame/pixel_format.h>
+#include <core/mixer/write_frame.h>
 
 #include <boost/range/algorithm_ext/push_back.hpp>
 #include <boost/filesystem.hpp>
 
+#include <climits>
+#include <cstdint>
 #include <queue>
 
 #if defined(_MSC_VER)
@@ -49,11 +53,35 @@ extern "C"
 #endif
 
 namespace caspar { namespace ffmpeg {
+
+// Codecs that write each picture exactly once and never read it back. Only these are rendered directly into
+// write_frame buffers, since those are write-combined mapped memory and are unmapped once committed.
+static bool is_direct_rendering_codec(const AVCodecContext& context)
+{
+	if(!(context.codec->capabilities & CODEC_CAP_DR1) || context.lowres != 0)
+		return false;
+
+	if(context.active_thread_type & FF_THREAD_FRAME) // get_buffer would be called from the decoding threads.
+		return false;
+
+	switch(context.codec_id)
+	{
+	case CODEC_ID_DNXHD:
+	case CODEC_ID_PRORES:
+	case CODEC_ID_MJPEG:
+	case CODEC_ID_DVVIDEO:
+		return true;
+	default:
+		return false;
+	}
+}
 	
 struct video_decoder::implementation : boost::noncopyable
 {
+	const safe_ptr<core::frame_factory>		frame_factory_;
 	int										index_;
 	const safe_ptr<AVCodecContext>			codec_context_;
+	bool									direct_rendering_;
 
 	std::queue<safe_ptr<AVPacket>>			packets_;
 	
@@ -64,15 +92,104 @@ struct video_decoder::implementation : boost::noncopyable
 	bool									is_progressive_;
 
 	tbb::atomic<size_t>						file_frame_number_;
+	int64_t									seek_pts_;
 
 public:
-	explicit implementation(const safe_ptr<AVFormatContext>& context) 
-		: codec_context_(open_codec(*context, AVMEDIA_TYPE_VIDEO, index_))
+	explicit implementation(const safe_ptr<AVFormatContext>& context, const safe_ptr<core::frame_factory>& frame_factory) 
+		: frame_factory_(frame_factory)
+		, codec_context_(open_codec(*context, AVMEDIA_TYPE_VIDEO, index_))
+		, direct_rendering_(is_direct_rendering_codec(*codec_context_))
 		, nb_frames_(static_cast<uint32_t>(context->streams[index_]->nb_frames))
 		, width_(codec_context_->width)
 		, height_(codec_context_->height)
+		, seek_pts_(AV_NOPTS_VALUE)
 	{
 		file_frame_number_ = 0;
+
+		if(direct_rendering_)
+		{
+			codec_context_->opaque			= this;
+			codec_context_->get_buffer		= &get_buffer;
+			codec_context_->release_buffer	= &release_buffer;
+			codec_context_->reget_buffer	= &avcodec_default_reget_buffer;
+		}
+	}
+
+	static int get_buffer(AVCodecContext* context, AVFrame* picture)
+	{
+		picture->opaque = nullptr;
+
+		auto self = static_cast<implementation*>(context->opaque);
+		if(picture->reference || !self->get_direct_buffer(*context, *picture))
+			return avcodec_default_get_buffer(context, picture);
+
+		return 0;
+	}
+
+	static void release_buffer(AVCodecContext* context, AVFrame* picture)
+	{
+		if(picture->type != FF_BUFFER_TYPE_USER)
+		{
+			avcodec_default_release_buffer(context, picture);
+			return;
+		}
+
+		delete static_cast<std::shared_ptr<core::write_frame>*>(picture->opaque);
+		picture->opaque = nullptr;
+
+		for(int n = 0; n < 4; ++n)
+			picture->data[n] = nullptr;
+	}
+
+	// Lets the decoder write straight into the planes of a write_frame, which removes one full frame copy in
+	// make_write_frame. The planes keep the tight linesizes the mixer expects, so this is only possible when
+	// those already satisfy the codec's alignment, otherwise the default ffmpeg buffers are used.
+	bool get_direct_buffer(AVCodecContext& context, AVFrame& picture)
+	{
+		auto pix_fmt	= context.pix_fmt;
+		auto desc		= get_pixel_format_desc(pix_fmt, context.width, context.height);
+
+		if(desc.pix_fmt == core::pixel_format::invalid || desc.pix_fmt == core::pixel_format::luma)
+			return false;
+
+		int width		= context.width;
+		int height		= context.height;
+		int linesize_align[4];
+		avcodec_align_dimensions2(&context, &width, &height, linesize_align);
+
+		auto padded_desc = get_pixel_format_desc(pix_fmt, width, height);
+		
+		for(size_t n = 0; n < desc.planes.size(); ++n)
+		{
+			auto& plane = desc.planes[n];
+
+			if(padded_desc.planes[n].linesize > plane.linesize || plane.linesize % linesize_align[n] != 0)
+				return false;
+
+			// The codec writes whole macroblocks, reserve the padded rows plus the same tail slack as avcodec_default_get_buffer.
+			plane.size = std::max(plane.size, plane.linesize * padded_desc.planes[n].height) + 64;
+		}
+
+		std::shared_ptr<core::write_frame> frame = frame_factory_->create_frame(this, desc, core::channel_layout::stereo());
+
+		for(size_t n = 0; n < desc.planes.size(); ++n)
+		{
+			auto data = frame->image_data(n).begin();
+			if(!data || reinterpret_cast<std::uintptr_t>(data) % 32 != 0)
+				return false;
+
+			picture.data[n]		= data;
+			picture.base[n]		= data;
+			picture.linesize[n]	= static_cast<int>(desc.planes[n].linesize);
+		}
+
+		picture.type				= FF_BUFFER_TYPE_USER;
+		picture.age					= INT_MAX;
+		picture.reordered_opaque	= context.reordered_opaque;
+		picture.pkt_pts				= context.pkt ? context.pkt->pts : AV_NOPTS_VALUE;
+		picture.opaque				= new std::shared_ptr<core::write_frame>(std::move(frame));
+
+		return true;
 	}
 
 	void push(const std::shared_ptr<AVPacket>& packet)
@@ -86,28 +203,36 @@ public:
 
 	std::shared_ptr<AVFrame> poll()
 	{		
-		if(packets_.empty())
-			return nullptr;
-		
-		auto packet = packets_.front();
+		while(!packets_.empty())
+		{
+			auto packet = packets_.front();
 					
-		if(packet->data == nullptr)
-		{			
-			if(codec_context_->codec->capabilities & CODEC_CAP_DELAY)
-			{
-				auto video = decode(packet);
-				if(video)
-					return video;
-			}
+			if(packet->data == nullptr)
+			{			
+				if((codec_context_->codec->capabilities & CODEC_CAP_DELAY) || (codec_context_->active_thread_type & FF_THREAD_FRAME))
+				{
+					auto video = decode(packet);
+					if(video)
+						return video;
+				}
 					
+				packets_.pop();
+				file_frame_number_ = static_cast<size_t>(packet->pos);
+				seek_pts_		   = packet->stream_index == index_ ? packet->pts : AV_NOPTS_VALUE; // Set by frame accurate seeks.
+				avcodec_flush_buffers(codec_context_.get());
+				return flush_video();	
+			}
+			
 			packets_.pop();
-			file_frame_number_ = static_cast<size_t>(packet->pos);
-			avcodec_flush_buffers(codec_context_.get());
-			return flush_video();	
+			auto video = decode(packet);
+
+			if(video || seek_pts_ == AV_NOPTS_VALUE)
+				return video;
+
+			// Still decoding forward to the seek target, there is no need to wait for the next frame.
 		}
-			
-		packets_.pop();
-		return decode(packet);
+
+		return nullptr;
 	}
 
 	std::shared_ptr<AVFrame> decode(safe_ptr<AVPacket> pkt)
@@ -128,13 +253,29 @@ public:
 
 		if(decoded_frame->repeat_pict > 0)
 			CASPAR_LOG(warning) << "[video_decoder] Field repeat_pict not implemented.";
+
+		if(seek_pts_ != AV_NOPTS_VALUE)
+		{
+			auto pts = decoded_frame->pkt_pts != AV_NOPTS_VALUE ? decoded_frame->pkt_pts : decoded_frame->best_effort_timestamp;
+			if(pts != AV_NOPTS_VALUE && pts < seek_pts_)
+				return nullptr;
+
+			seek_pts_ = AV_NOPTS_VALUE;
+		}
 		
 		++file_frame_number_;
 
+		// The codec releases its reference to a direct buffer whenever it likes, hand make_write_frame a reference
+		// of its own through the opaque field of our copy of the picture.
+		std::shared_ptr<std::shared_ptr<core::write_frame>> direct_frame;
+		if(decoded_frame->type == FF_BUFFER_TYPE_USER && decoded_frame->opaque)
+			direct_frame = std::make_shared<std::shared_ptr<core::write_frame>>(*static_cast<std::shared_ptr<core::write_frame>*>(decoded_frame->opaque));
+		decoded_frame->opaque = direct_frame.get();
+
 		// This ties the life of the decoded_frame to the packet that it came from. For the
 		// current version of ffmpeg (0.8 or c17808c) the RAW_VIDEO codec returns frame data
 		// owned by the packet.
-		return std::shared_ptr<AVFrame>(decoded_frame.get(), [decoded_frame, pkt](AVFrame*){});
+		return std::shared_ptr<AVFrame>(decoded_frame.get(), [decoded_frame, pkt, direct_frame](AVFrame*){});
 	}
 	
 	bool ready() const
@@ -149,11 +290,11 @@ public:
 
 	std::wstring print() const
 	{		
-		return L"[video-decoder] " + widen(codec_context_->codec->long_name);
+		return L"[video-decoder] " + widen(codec_context_->codec->long_name) + (direct_rendering_ ? L" (direct rendering)" : L"");
 	}
 };
 
-video_decoder::video_decoder(const safe_ptr<AVFormatContext>& context) : impl_(new implementation(context)){}
+video_decoder::video_decoder(const safe_ptr<AVFormatContext>& context, const safe_ptr<core::frame_factory>& frame_factory) : impl_(new implementation(context, frame_factory)){}
 void video_decoder::push(const std::shared_ptr<AVPacket>& packet){impl_->push(packet);}
 std::shared_ptr<AVFrame> video_decoder::poll(){return impl_->poll();}
 bool video_decoder::ready() const{return impl_->ready();}
@@ -41,7 +41,7 @@ namespace ffmpeg {
 class video_decoder : boost::noncopyable
 {
 public:
-	explicit video_decoder(const safe_ptr<AVFormatContext>& context);
+	explicit video_decoder(const safe_ptr<AVFormatContext>& context, const safe_ptr<core::frame_factory>& frame_factory);
 	
 	bool ready() const;
 	void push(const std::shared_ptr<AVPacket>& packet);
@@ -253,7 +253,7 @@ public:
 		return result;
 	}
 	
-	safe_ptr<core::basic_frame> render_frame(double sync)
+	safe_ptr<core::basic_frame> render_frame(double sync, bool offline)
 	{
 		float frame_time = 1.0f/ax_->GetFPS();
 
@@ -263,10 +263,13 @@ public:
 		if(ax_->IsEmpty())
 			return core::basic_frame::empty();		
 		
-		if(sync > 0.00001)			
-			timer_.tick(frame_time*sync); // This will block the thread.
-		else
-			graph_->set_tag("sync");
+		if(!offline) // Offline frames are rendered as fast as the channel receives them.
+		{
+			if(sync > 0.00001)			
+				timer_.tick(frame_time*sync); // This will block the thread.
+			else
+				graph_->set_tag("sync");
+		}
 
 		graph_->set_value("sync", sync);
 			
@@ -332,8 +335,10 @@ struct flash_producer : public core::frame_producer
 	const int													width_;
 	const int													height_;
 	const int													buffer_size_;
+	const int													offline_timeout_;	// Seconds an offline channel waits for a frame.
 
 	tbb::atomic<int>											fps_;
+	tbb::atomic<bool>											offline_;
 
 	safe_ptr<diagnostics::graph>								graph_;
 
@@ -354,9 +359,11 @@ public:
 		, width_(width > 0 ? width : frame_factory->get_video_format_desc().width)
 		, height_(height > 0 ? height : frame_factory->get_video_format_desc().height)
 		, buffer_size_(env::properties().get(L"configuration.flash.buffer-depth", frame_factory_->get_video_format_desc().fps > 30.0 ? 4 : 2))
+		, offline_timeout_(env::properties().get(L"configuration.flash.offline-timeout-seconds", 10))
 		, executor_(L"flash_producer")
 	{	
 		fps_ = 0;
+		offline_ = false;
 	 
 		graph_->set_color("late-frame", diagnostics::color(0.6f, 0.3f, 0.9f));
 		graph_->set_text(print());
@@ -378,11 +385,27 @@ public:
 
 	// frame_producer
 		
-	virtual safe_ptr<core::basic_frame> receive(int) override
+	virtual safe_ptr<core::basic_frame> receive(int hints) override
 	{					
 		auto frame = core::basic_frame::late();
+
+		offline_ = (hints & core::frame_producer::OFFLINE_HINT) != 0;
 		
-		if(output_buffer_.try_pop(frame))	
+		if(offline_)
+		{
+			// Every popped frame is replaced by next(). A renderer that has stopped rendering fails the producer 
+			// instead of holding the channel.
+			auto deadline = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::seconds(offline_timeout_);
+			while(!output_buffer_.try_pop(frame))
+			{
+				if(boost::posix_time::microsec_clock::universal_time() > deadline)
+					BOOST_THROW_EXCEPTION(timed_out() << msg_info(narrow(print()) + " No frame rendered within the offline timeout."));
+
+				boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+			}
+			next();
+		}
+		else if(output_buffer_.try_pop(frame))	
 			next();
 		else
 			graph_->set_tag("late-frame");
@@ -494,7 +517,7 @@ public:
 		double ratio = std::min(1.0, static_cast<double>(output_buffer_.size())/static_cast<double>(std::max(1, buffer_size_ - 1)));
 		double sync  = 2*ratio - ratio*ratio;
 
-		auto frame = renderer_->render_frame(sync);
+		auto frame = renderer_->render_frame(sync, offline_);
 		lock(last_frame_mutex_, [&]
 		{
 			last_frame_ = frame;
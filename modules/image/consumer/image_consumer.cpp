@@ -20,6 +20,7 @@
 */
 
 #include "image_consumer.h"
+#include "image_writer.h"
 
 #include <common/exception/exceptions.h>
 #include <common/env.h>
@@ -35,12 +36,9 @@
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/thread.hpp>
 
-#include <FreeImage.h>
 #include <vector>
 #include <algorithm>
 
-#include "../util/image_view.h"
-
 namespace caspar { namespace image {
 
 void write_cropped_png(
@@ -50,26 +48,24 @@ void write_cropped_png(
 		int width,
 		int height)
 {
-	auto bitmap = std::shared_ptr<FIBITMAP>(FreeImage_Allocate(width, height, 32), FreeImage_Unload);
-	image_view<bgra_pixel> destination_view(FreeImage_GetBits(bitmap.get()), width, height);
-	image_view<bgra_pixel> complete_frame(const_cast<uint8_t*>(frame->image_data().begin()), format_desc.width, format_desc.height);
-	auto thumbnail_view = complete_frame.subview(0, 0, width, height);
-
-	std::copy(thumbnail_view.begin(), thumbnail_view.end(), destination_view.begin());
-	FreeImage_FlipVertical(bitmap.get());
-	FreeImage_SaveU(FIF_PNG, bitmap.get(), output_file.string().c_str(), 0);
+	image_write_params params(image_encoding::png, env::properties().get(L"configuration.thumbnails.png-level", -1));
+	write_image(frame, format_desc, output_file, params, width, height).get();
 }
 
 struct image_consumer : public core::frame_consumer
 {
-	core::video_format_desc	format_desc_;
-	std::wstring			filename_;
+	core::video_format_desc							format_desc_;
+	const std::wstring								filename_;
+	const image_write_params						params_;
+	const std::shared_ptr<boost::promise<std::wstring>>	result_;
 public:
 
 	// frame_consumer
 
-	image_consumer(const std::wstring& filename)
+	image_consumer(const std::wstring& filename, const image_write_params& params, const std::shared_ptr<boost::promise<std::wstring>>& result)
 		: filename_(filename)
+		, params_(params)
+		, result_(result)
 	{
 	}
 
@@ -85,44 +81,25 @@ public:
 	
 	virtual boost::unique_future<bool> send(const safe_ptr<core::read_frame>& frame) override
 	{				
-		auto format_desc = format_desc_;
-		auto filename = filename_;
-
-		boost::thread async([format_desc, frame, filename]
-		{
-			try
-			{
-				auto filename2 = filename;
-
-				if (filename2.empty())
-					filename2 = env::media_folder() + widen(boost::posix_time::to_iso_string(boost::posix_time::second_clock::local_time())) + L".png";
-				else
-					filename2 = env::media_folder() + filename2 + L".png";
-
-				auto bitmap = std::shared_ptr<FIBITMAP>(FreeImage_Allocate(format_desc.width, format_desc.height, 32), FreeImage_Unload);
-				memcpy(FreeImage_GetBits(bitmap.get()), frame->image_data().begin(), frame->image_size());
-				FreeImage_FlipVertical(bitmap.get());
-				FreeImage_SaveU(FIF_PNG, bitmap.get(), filename2.c_str(), 0);
-			}
-			catch(...)
-			{
-				CASPAR_LOG_CURRENT_EXCEPTION();
-			}
-		});
-		async.detach();
+		auto filename = filename_.empty() ? widen(boost::posix_time::to_iso_string(boost::posix_time::second_clock::local_time())) : filename_;
+
+		write_image(frame, format_desc_, env::media_folder() + filename + image_encoding::extension(params_.encoding), params_, result_);
 
 		return wrap_as_future(false);
 	}
 
 	virtual std::wstring print() const override
 	{
-		return L"image[]";
+		return L"image[" + image_encoding::print(params_.encoding) + L"]";
 	}
 
 	virtual boost::property_tree::wptree info() const override
 	{
 		boost::property_tree::wptree info;
 		info.add(L"type", L"image-consumer");
+		info.add(L"encoding", image_encoding::print(params_.encoding));
+		info.add(L"level", params_.level);
+		info.add_child(L"writer", image_writer_info());
 		return info;
 	}
 
@@ -138,16 +115,24 @@ public:
 };
 
 safe_ptr<core::frame_consumer> create_consumer(const core::parameters& params)
+{
+	return create_consumer(params, std::make_shared<boost::promise<std::wstring>>());
+}
+
+safe_ptr<core::frame_consumer> create_consumer(const core::parameters& params, const std::shared_ptr<boost::promise<std::wstring>>& result)
 {
 	if(params.size() < 1 || params.at(0) != L"IMAGE")
 		return core::frame_consumer::empty();
 
 	std::wstring filename;
 
-	if (params.size() > 1)
-		filename = params.at(1);
+	if (params.size() > 1 && params.at(1) != L"ENCODER" && params.at(1) != L"LEVEL")
+		filename = params.at_original(1);
+
+	auto encoding	= image_encoding::parse(params.get(L"ENCODER", env::properties().get(L"configuration.image.print-encoder", std::wstring(L"png"))));
+	auto level		= params.get(L"LEVEL", env::properties().get(L"configuration.image.print-level", -1));
 
-	return make_safe<image_consumer>(filename);
+	return make_safe<image_consumer>(filename, image_write_params(encoding, level), result);
 }
 
 }}
@@ -27,6 +27,7 @@
 
 #include <boost/property_tree/ptree.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/thread/future.hpp>
 
 #include <string>
 #include <vector>
@@ -49,6 +50,10 @@ void write_cropped_png(
 		int width,
 		int height);
 
+// IMAGE [filename] [ENCODER PNG|TGA|BMP|QOI|JPEG] [LEVEL n], the extension is added from the encoder.
 safe_ptr<core::frame_consumer> create_consumer(const core::parameters& params);
 
+// Same as above, result is set to the written file, or the error, once the snapshot has been encoded.
+safe_ptr<core::frame_consumer> create_consumer(const core::parameters& params, const std::shared_ptr<boost::promise<std::wstring>>& result);
+
 }}
\ No newline at end of file
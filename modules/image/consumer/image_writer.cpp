@@ -0,0 +1,466 @@
+/*
+* Copyright 2013 Sveriges Television AB http://casparcg.com/
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+#include "image_writer.h"
+
+#include <common/exception/exceptions.h>
+#include <common/env.h>
+#include <common/log/log.h>
+#include <common/utility/string.h>
+
+#include <core/video_format.h>
+#include <core/mixer/read_frame.h>
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/exception/errinfo_file_name.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/thread.hpp>
+#include <boost/timer.hpp>
+
+#include <FreeImage.h>
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <vector>
+
+namespace caspar { namespace image {
+
+image_encoding::type image_encoding::parse(const std::wstring& value, image_encoding::type default_value)
+{
+	if(boost::iequals(value, L"png"))
+		return png;
+	if(boost::iequals(value, L"tga"))
+		return tga;
+	if(boost::iequals(value, L"bmp"))
+		return bmp;
+	if(boost::iequals(value, L"qoi"))
+		return qoi;
+	if(boost::iequals(value, L"jpeg") || boost::iequals(value, L"jpg"))
+		return jpeg;
+	return default_value;
+}
+
+std::wstring image_encoding::print(image_encoding::type value)
+{
+	switch(value)
+	{
+	case tga:	return L"tga";
+	case bmp:	return L"bmp";
+	case qoi:	return L"qoi";
+	case jpeg:	return L"jpeg";
+	default:	return L"png";
+	}
+}
+
+std::wstring image_encoding::extension(image_encoding::type value)
+{
+	return value == jpeg ? L".jpg" : L"." + print(value);
+}
+
+image_write_params::image_write_params(image_encoding::type encoding, int level)
+	: encoding(encoding)
+	, level(level)
+{
+}
+
+// FreeImage stores the rows bottom up.
+static std::shared_ptr<FIBITMAP> copy_to_bitmap(const uint8_t* source, int pitch, int width, int height)
+{
+	auto bitmap = std::shared_ptr<FIBITMAP>(FreeImage_Allocate(width, height, 32), FreeImage_Unload);
+	if(!bitmap)
+		BOOST_THROW_EXCEPTION(bad_alloc());
+
+	for(int y = 0; y < height; ++y)
+		std::memcpy(FreeImage_GetScanLine(bitmap.get(), height - 1 - y), source + y*pitch, width*4);
+
+	return bitmap;
+}
+
+struct qoi_pixel
+{
+	uint8_t r, g, b, a;
+
+	bool operator==(const qoi_pixel& other) const
+	{
+		return r == other.r && g == other.g && b == other.b && a == other.a;
+	}
+
+	int hash() const
+	{
+		return (r*3 + g*5 + b*7 + a*11) % 64;
+	}
+};
+
+// See the specification at qoiformat.org.
+static std::vector<uint8_t> encode_qoi(const uint8_t* source, int pitch, int width, int height)
+{
+	std::vector<uint8_t> bytes;
+	bytes.reserve(14 + width*height*5 + 8);
+
+	auto put32 = [&](uint32_t value)
+	{
+		bytes.push_back(static_cast<uint8_t>(value >> 24));
+		bytes.push_back(static_cast<uint8_t>(value >> 16));
+		bytes.push_back(static_cast<uint8_t>(value >> 8));
+		bytes.push_back(static_cast<uint8_t>(value));
+	};
+
+	bytes.push_back('q'); 
+	bytes.push_back('o'); 
+	bytes.push_back('i'); 
+	bytes.push_back('f');
+	put32(width);
+	put32(height);
+	bytes.push_back(4); // rgba
+	bytes.push_back(0); // srgb
+
+	qoi_pixel index[64];
+	std::memset(index, 0, sizeof(index));
+
+	qoi_pixel previous = {0, 0, 0, 255};
+	int run = 0;
+
+	for(int y = 0; y < height; ++y)
+	{
+		auto row = source + y*pitch;
+
+		for(int x = 0; x < width; ++x)
+		{
+			qoi_pixel pixel = {row[x*4+2], row[x*4+1], row[x*4+0], row[x*4+3]}; // bgra
+
+			if(pixel == previous)
+			{
+				if(++run == 62)
+				{
+					bytes.push_back(static_cast<uint8_t>(0xc0 | (run - 1)));
+					run = 0;
+				}
+				continue;
+			}
+
+			if(run > 0)
+			{
+				bytes.push_back(static_cast<uint8_t>(0xc0 | (run - 1)));
+				run = 0;
+			}
+
+			auto hash = pixel.hash();
+
+			if(index[hash] == pixel)
+				bytes.push_back(static_cast<uint8_t>(hash));
+			else
+			{
+				index[hash] = pixel;
+
+				if(pixel.a == previous.a)
+				{
+					int dr = static_cast<int8_t>(pixel.r - previous.r);
+					int dg = static_cast<int8_t>(pixel.g - previous.g);
+					int db = static_cast<int8_t>(pixel.b - previous.b);
+					int dr_dg = dr - dg;
+					int db_dg = db - dg;
+
+					if(dr > -3 && dr < 2 && dg > -3 && dg < 2 && db > -3 && db < 2)
+						bytes.push_back(static_cast<uint8_t>(0x40 | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2)));
+					else if(dr_dg > -9 && dr_dg < 8 && dg > -33 && dg < 32 && db_dg > -9 && db_dg < 8)
+					{
+						bytes.push_back(static_cast<uint8_t>(0x80 | (dg + 32)));
+						bytes.push_back(static_cast<uint8_t>((dr_dg + 8) << 4 | (db_dg + 8)));
+					}
+					else
+					{
+						bytes.push_back(0xfe);
+						bytes.push_back(pixel.r);
+						bytes.push_back(pixel.g);
+						bytes.push_back(pixel.b);
+					}
+				}
+				else
+				{
+					bytes.push_back(0xff);
+					bytes.push_back(pixel.r);
+					bytes.push_back(pixel.g);
+					bytes.push_back(pixel.b);
+					bytes.push_back(pixel.a);
+				}
+			}
+
+			previous = pixel;
+		}
+	}
+
+	if(run > 0)
+		bytes.push_back(static_cast<uint8_t>(0xc0 | (run - 1)));
+
+	static const uint8_t end_marker[] = {0, 0, 0, 0, 0, 0, 0, 1};
+	bytes.insert(bytes.end(), std::begin(end_marker), std::end(end_marker));
+
+	return bytes;
+}
+
+static std::wstring encode_image(
+		const safe_ptr<core::read_frame>& frame,
+		const core::video_format_desc& format_desc,
+		const boost::filesystem::wpath& output_file,
+		const image_write_params& params,
+		int width,
+		int height)
+{
+	if(frame->image_size() < static_cast<int>(format_desc.width*format_desc.height*4))
+		BOOST_THROW_EXCEPTION(invalid_argument() << msg_info("Frame has no image."));
+
+	auto source = frame->image_data().begin();
+	auto pitch	= static_cast<int>(format_desc.width*4);
+
+	width	= width  > 0 ? std::min(width,  static_cast<int>(format_desc.width))  : format_desc.width;
+	height	= height > 0 ? std::min(height, static_cast<int>(format_desc.height)) : format_desc.height;
+
+	bool written = false;
+
+	if(params.encoding == image_encoding::qoi)
+	{
+		auto bytes = encode_qoi(source, pitch, width, height);
+
+		boost::filesystem::ofstream stream(output_file, std::ios::binary | std::ios::trunc);
+		stream.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+		written = !stream.fail();
+	}
+	else
+	{
+		auto bitmap = copy_to_bitmap(source, pitch, width, height);
+
+		switch(params.encoding)
+		{
+		case image_encoding::tga:
+			written = FreeImage_SaveU(FIF_TARGA, bitmap.get(), output_file.string().c_str(), params.level > 0 ? TARGA_SAVE_RLE : TARGA_DEFAULT) != FALSE;
+			break;
+		case image_encoding::bmp:
+			written = FreeImage_SaveU(FIF_BMP, bitmap.get(), output_file.string().c_str(), BMP_DEFAULT) != FALSE;
+			break;
+		case image_encoding::jpeg:
+			{
+				auto rgb = std::shared_ptr<FIBITMAP>(FreeImage_ConvertTo24Bits(bitmap.get()), FreeImage_Unload);
+				auto quality = params.level < 0 ? 90 : std::max(1, std::min(100, params.level));
+				written = rgb && FreeImage_SaveU(FIF_JPEG, rgb.get(), output_file.string().c_str(), quality) != FALSE;
+			}
+			break;
+		default:
+			{
+				auto level = params.level < 0 ? 1 : std::min(9, params.level);
+				written = FreeImage_SaveU(FIF_PNG, bitmap.get(), output_file.string().c_str(), level > 0 ? level : PNG_Z_NO_COMPRESSION) != FALSE;
+			}
+			break;
+		}
+	}
+
+	if(!written)
+		BOOST_THROW_EXCEPTION(io_error() << msg_info("Failed to write image.") << boost::errinfo_file_name(narrow(output_file.string())));
+
+	return output_file.string();
+}
+
+// Jobs are encoded by a fixed number of threads, post() blocks while capacity jobs are waiting.
+class image_writer : boost::noncopyable
+{
+	struct job
+	{
+		std::function<std::wstring()>					encode;
+		std::shared_ptr<boost::promise<std::wstring>>	result;
+	};
+
+	const int						thread_count_;
+	const size_t					capacity_;
+
+	mutable boost::mutex			mutex_;
+	boost::condition_variable		not_empty_;
+	boost::condition_variable		not_full_;
+	std::deque<job>					jobs_;
+	bool							running_;
+	int								busy_;
+	int64_t							written_;
+	int64_t							failed_;
+	int64_t							blocked_;
+	double							total_encode_millis_;
+
+	boost::thread_group				workers_;
+public:
+	image_writer(int thread_count, size_t capacity)
+		: thread_count_(std::max(1, thread_count))
+		, capacity_(std::max<size_t>(1, capacity))
+		, running_(true)
+		, busy_(0)
+		, written_(0)
+		, failed_(0)
+		, blocked_(0)
+		, total_encode_millis_(0.0)
+	{
+		for(int n = 0; n < thread_count_; ++n)
+			workers_.create_thread([this]{run();});
+
+		CASPAR_LOG(info) << L"Image writer using " << thread_count_ << L" thread(s).";
+	}
+
+	~image_writer()
+	{
+		{
+			boost::lock_guard<boost::mutex> lock(mutex_);
+			running_ = false;
+		}
+
+		not_empty_.notify_all();
+		workers_.join_all(); // The queued jobs are finished first.
+	}
+
+	void post(const std::function<std::wstring()>& encode, const std::shared_ptr<boost::promise<std::wstring>>& result)
+	{
+		job new_job;
+		new_job.encode = encode;
+		new_job.result = result;
+
+		{
+			boost::unique_lock<boost::mutex> lock(mutex_);
+
+			if(jobs_.size() >= capacity_)
+			{
+				++blocked_;
+				while(jobs_.size() >= capacity_)
+					not_full_.wait(lock);
+			}
+
+			jobs_.push_back(new_job);
+		}
+
+		not_empty_.notify_one();
+	}
+
+	boost::property_tree::wptree info() const
+	{
+		boost::lock_guard<boost::mutex> lock(mutex_);
+
+		boost::property_tree::wptree info;
+		info.add(L"threads",		thread_count_);
+		info.add(L"busy",			busy_);
+		info.add(L"queued",			jobs_.size());
+		info.add(L"capacity",		capacity_);
+		info.add(L"written",		written_);
+		info.add(L"failed",			failed_);
+		info.add(L"blocked",		blocked_);
+		info.add(L"average-encode-millis", written_ + failed_ > 0 ? total_encode_millis_ / static_cast<double>(written_ + failed_) : 0.0);
+		return info;
+	}
+
+	static image_writer& get_instance()
+	{
+		static image_writer instance(
+				env::properties().get(L"configuration.image.writer-threads", std::max(1, static_cast<int>(boost::thread::hardware_concurrency()) / 2)),
+				env::properties().get(L"configuration.image.writer-queue-depth", 16));
+		return instance;
+	}
+private:
+	void run()
+	{
+		while(true)
+		{
+			job next;
+			{
+				boost::unique_lock<boost::mutex> lock(mutex_);
+
+				while(running_ && jobs_.empty())
+					not_empty_.wait(lock);
+
+				if(jobs_.empty())
+					return;
+
+				next = jobs_.front();
+				jobs_.pop_front();
+				++busy_;
+			}
+
+			not_full_.notify_one();
+
+			boost::timer encode_timer;
+			bool succeeded = false;
+
+			try
+			{
+				auto file = next.encode();
+				next.result->set_value(file);
+				succeeded = true;
+			}
+			catch(...)
+			{
+				CASPAR_LOG_CURRENT_EXCEPTION();
+
+				try
+				{
+					next.result->set_exception(boost::current_exception());
+				}
+				catch(...) // Already satisfied.
+				{
+				}
+			}
+
+			boost::lock_guard<boost::mutex> lock(mutex_);
+			--busy_;
+			++(succeeded ? written_ : failed_);
+			total_encode_millis_ += encode_timer.elapsed() * 1000.0;
+		}
+	}
+};
+
+void write_image(
+		const safe_ptr<core::read_frame>& frame,
+		const core::video_format_desc& format_desc,
+		const boost::filesystem::wpath& output_file,
+		const image_write_params& params,
+		const std::shared_ptr<boost::promise<std::wstring>>& result,
+		int width,
+		int height)
+{
+	image_writer::get_instance().post([=]
+	{
+		return encode_image(frame, format_desc, output_file, params, width, height);
+	}, result);
+}
+
+boost::shared_future<std::wstring> write_image(
+		const safe_ptr<core::read_frame>& frame,
+		const core::video_format_desc& format_desc,
+		const boost::filesystem::wpath& output_file,
+		const image_write_params& params,
+		int width,
+		int height)
+{
+	auto result = std::make_shared<boost::promise<std::wstring>>();
+	boost::shared_future<std::wstring> future(result->get_future());
+	write_image(frame, format_desc, output_file, params, result, width, height);
+	return future;
+}
+
+boost::property_tree::wptree image_writer_info()
+{
+	return image_writer::get_instance().info();
+}
+
+}}
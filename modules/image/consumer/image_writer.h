@@ -0,0 +1,90 @@
+/*
+* Copyright 2013 Sveriges Television AB http://casparcg.com/
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+#pragma once
+
+#include <common/memory/safe_ptr.h>
+
+#include <boost/filesystem.hpp>
+#include <boost/property_tree/ptree_fwd.hpp>
+#include <boost/thread/future.hpp>
+
+#include <memory>
+#include <string>
+
+namespace caspar { 
+
+namespace core {
+	class read_frame;
+	struct video_format_desc;
+}
+
+namespace image {
+
+struct image_encoding
+{
+	enum type
+	{
+		png,	// Deflate, level 0-9 (default 1).
+		tga,	// Uncompressed, level 1 run length encodes.
+		bmp,	// Uncompressed.
+		qoi,	// Lossless run, index and delta coding (qoiformat.org), several times faster than png.
+		jpeg,	// Lossy without alpha, level is the quality 1-100 (default 90).
+		count
+	};
+
+	static image_encoding::type parse(const std::wstring& value, image_encoding::type default_value = png);
+	static std::wstring print(image_encoding::type value);
+	static std::wstring extension(image_encoding::type value); // Including the dot.
+};
+
+struct image_write_params
+{
+	image_encoding::type	encoding;
+	int						level;	// -1 selects the default of the encoding.
+
+	explicit image_write_params(image_encoding::type encoding = image_encoding::png, int level = -1);
+};
+
+// Encodes the top left width x height pixels of frame, whose dimensions are those of format_desc, on a 
+// bounded pool of writer threads (configuration.image.writer-threads). Blocks while the job queue is full.
+// result is set to the written file, or the exception of a failed job. A width or height of 0 writes the 
+// whole frame.
+void write_image(
+		const safe_ptr<core::read_frame>& frame,
+		const core::video_format_desc& format_desc,
+		const boost::filesystem::wpath& output_file,
+		const image_write_params& params,
+		const std::shared_ptr<boost::promise<std::wstring>>& result,
+		int width = 0,
+		int height = 0);
+
+boost::shared_future<std::wstring> write_image(
+		const safe_ptr<core::read_frame>& frame,
+		const core::video_format_desc& format_desc,
+		const boost::filesystem::wpath& output_file,
+		const image_write_params& params,
+		int width = 0,
+		int height = 0);
+
+boost::property_tree::wptree image_writer_info();
+
+}}
@@ -48,7 +48,7 @@
 
 namespace caspar { namespace oal {
 
-typedef std::vector<int16_t, tbb::cache_aligned_allocator<int16_t>> audio_buffer_16;
+using core::audio_buffer_16;
 
 struct oal_consumer : public core::frame_consumer,  public sf::SoundStream
 {
@@ -48,7 +48,7 @@ namespace caspar { namespace portaudio {
 			<< msg_info(std::string("PortAudio error: ") \
 			+ Pa_GetErrorText(err)))
 
-typedef std::vector<int16_t, tbb::cache_aligned_allocator<int16_t>> audio_buffer_16;
+using core::audio_buffer_16;
 
 int callback(
 		const void*, // input
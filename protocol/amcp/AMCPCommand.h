@@ -27,6 +27,7 @@
 #include <core/parameters/parameters.h>
 #include <core/video_channel.h>
 #include <core/thumbnail_generator.h>
+#include <core/media_library.h>
 
 #include <boost/algorithm/string.hpp>
 
@@ -72,6 +73,12 @@ namespace caspar { namespace protocol { namespace amcp {
 		void SetThumbGenerator(const std::shared_ptr<core::thumbnail_generator>& thumb_gen) {thumb_gen_ = thumb_gen;}
 		std::shared_ptr<core::thumbnail_generator> GetThumbGenerator() { return thumb_gen_; }
 
+		void SetMediaLibrary(const std::shared_ptr<core::media_library>& media_library) {media_library_ = media_library;}
+		std::shared_ptr<core::media_library> GetMediaLibrary() { return media_library_; }
+
+		void SetTemplateLibrary(const std::shared_ptr<core::media_library>& template_library) {template_library_ = template_library;}
+		std::shared_ptr<core::media_library> GetTemplateLibrary() { return template_library_; }
+
 		void SetShutdownServerNow(boost::promise<bool>& shutdown_server_now) {shutdown_server_now_ = &shutdown_server_now;}
 		boost::promise<bool>& GetShutdownServerNow() { return *shutdown_server_now_; }
 
@@ -103,6 +110,8 @@ namespace caspar { namespace protocol { namespace amcp {
 		std::shared_ptr<core::video_channel> pChannel_;
 		std::vector<safe_ptr<core::video_channel>> channels_;
 		std::shared_ptr<core::thumbnail_generator> thumb_gen_;
+		std::shared_ptr<core::media_library> media_library_;
+		std::shared_ptr<core::media_library> template_library_;
 		boost::promise<bool>* shutdown_server_now_;
 		AMCPCommandScheduling scheduling_;
 		std::wstring replyString_;
@@ -47,6 +47,7 @@
 #include <core/producer/stage.h>
 #include <core/producer/layer.h>
 #include <core/mixer/mixer.h>
+#include <core/mixer/audio/audio_buffer_pool.h>
 #include <core/mixer/gpu/ogl_device.h>
 #include <core/consumer/output.h>
 
@@ -59,6 +60,7 @@
 #include <modules/flash/producer/cg_producer.h>
 #include <modules/ffmpeg/producer/util/util.h>
 #include <modules/image/image.h>
+#include <modules/image/consumer/image_consumer.h>
 #include <modules/ogl/ogl.h>
 
 #include <algorithm>
@@ -253,6 +255,37 @@ std::wstring ListMedia()
 	return boost::to_upper_copy(replyString.str());
 }
 
+std::wstring WriteTimeInfo(std::time_t last_modified)
+{
+	auto writeTimeStr = boost::posix_time::to_iso_string(boost::posix_time::from_time_t(last_modified));
+	writeTimeStr.erase(std::remove_if(writeTimeStr.begin(), writeTimeStr.end(), [](char c){ return std::isdigit(c) == 0;}), writeTimeStr.end());
+	return std::wstring(writeTimeStr.begin(), writeTimeStr.end());
+}
+
+// Same format as MediaInfo(path), the extended format adds the duration in frames and the frame rate.
+std::wstring MediaInfo(const core::media_info& info, bool extended)
+{
+	auto str = boost::filesystem::wpath(info.name).external_file_string();
+
+	std::wstringstream replyString;
+	replyString << L"\"" << str << L"\"  " << info.clip_type << L"  " << info.size << L" " << WriteTimeInfo(info.last_modified);
+
+	if(extended)
+		replyString << L" " << info.duration << L" " << info.fps;
+
+	replyString << L"\r\n";
+	return replyString.str();
+}
+
+std::wstring ListMedia(const core::media_library& media_library, const std::wstring& prefix, const std::wstring& clip_type)
+{	
+	std::wstringstream replyString;
+	BOOST_FOREACH(auto& info, media_library.find(prefix, clip_type))
+		replyString << MediaInfo(info, false);
+	
+	return boost::to_upper_copy(replyString.str());
+}
+
 std::wstring ListTemplates() 
 {
 	std::wstringstream replyString;
@@ -288,6 +321,34 @@ std::wstring ListTemplates()
 	return replyString.str();
 }
 
+std::wstring ListTemplates(const core::media_library& template_library, const std::wstring& prefix) 
+{
+	std::wstringstream replyString;
+
+	BOOST_FOREACH(auto& info, template_library.find(prefix))
+	{
+		auto relativePath = boost::filesystem::wpath(info.name);
+
+		std::wstring dir = relativePath.parent_path().external_directory_string();
+		std::wstring file = boost::to_upper_copy(relativePath.filename());
+		auto str = boost::filesystem::wpath(dir + L"/" + file).external_file_string();
+		boost::trim_if(str, boost::is_any_of("\\/"));
+
+		replyString << TEXT("\"") << str
+					<< TEXT("\" ") << info.size
+					<< TEXT(" ") << WriteTimeInfo(info.last_modified)
+					<< TEXT("\r\n");		
+	}
+
+	return replyString.str();
+}
+
+// The library is indexed with '/' separators.
+std::wstring ToLibraryPrefix(const std::wstring& prefix)
+{
+	return boost::replace_all_copy(prefix, L"\\", L"/");
+}
+
 namespace amcp {
 	
 AMCPCommand::AMCPCommand() : channelIndex_(0), scheduling_(Default), layerIndex_(-1)
@@ -426,6 +487,7 @@ bool CallCommand::DoExecute()
 
 // UGLY HACK
 tbb::concurrent_unordered_map<int, std::vector<stage::transform_tuple_t>> deferred_transforms;
+tbb::concurrent_unordered_map<int, std::vector<stage::transform_tuple_t>> deferred_appended_transforms;
 
 core::frame_transform MixerCommand::get_current_transform()
 {
@@ -442,7 +504,14 @@ bool MixerCommand::DoExecute()
 		if(defer)
 			_parameters.pop_back();
 
+		// e.g. MIXER 1-10 OPACITY 0 25 easeinsine APPEND, tweens from where the current tweens of the layer end 
+		// instead of replacing them.
+		bool append = _parameters.back() == L"APPEND";
+		if(append)
+			_parameters.pop_back();
+
 		std::vector<stage::transform_tuple_t> transforms;
+		std::vector<stage::transform_tuple_t> appended_transforms;
 
 		if(_parameters[0] == L"KEYER" || _parameters[0] == L"IS_KEY")
 		{
@@ -744,7 +813,8 @@ bool MixerCommand::DoExecute()
 		}
 		else if(_parameters[0] == L"COMMIT")
 		{
-			transforms = std::move(deferred_transforms[GetChannelIndex()]);
+			transforms			= std::move(deferred_transforms[GetChannelIndex()]);
+			appended_transforms	= std::move(deferred_appended_transforms[GetChannelIndex()]);
 		}
 		else
 		{
@@ -752,13 +822,23 @@ bool MixerCommand::DoExecute()
 			return false;
 		}
 
+		if(append)
+			std::swap(transforms, appended_transforms);
+
 		if(defer)
 		{
 			auto& defer_tranforms = deferred_transforms[GetChannelIndex()];
 			defer_tranforms.insert(defer_tranforms.end(), transforms.begin(), transforms.end());
+
+			auto& defer_appended_tranforms = deferred_appended_transforms[GetChannelIndex()];
+			defer_appended_tranforms.insert(defer_appended_tranforms.end(), appended_transforms.begin(), appended_transforms.end());
 		}
 		else
+		{
 			GetChannel()->stage()->apply_transforms(transforms);
+			if(!appended_transforms.empty())
+				GetChannel()->stage()->append_transforms(appended_transforms);
+		}
 	
 		SetReplyString(TEXT("202 MIXER OK\r\n"));
 
@@ -1206,13 +1286,47 @@ bool ClearCommand::DoExecute()
 
 bool PrintCommand::DoExecute()
 {
-	parameters params;
-	params.push_back(L"IMAGE");
-	GetChannel()->output()->add(create_consumer(params));
-		
-	SetReplyString(TEXT("202 PRINT OK\r\n"));
+	try
+	{
+		parameters params;
+		params.push_back(L"IMAGE");
+		BOOST_FOREACH(auto& param, _parameters.get_original())
+			params.push_back(param);
+		params.to_upper();
 
-	return true;
+		// PRINT [filename] [ENCODER ...] [LEVEL n] [WAIT]. Only with WAIT is the channel's command queue held until 
+		// the file has been written, and the reply carries its path. Otherwise failures are only logged.
+		if(!params.remove_if_exists(L"WAIT"))
+		{
+			GetChannel()->output()->add(image::create_consumer(params));
+
+			SetReplyString(TEXT("202 PRINT OK\r\n"));
+			return true;
+		}
+
+		auto result = std::make_shared<boost::promise<std::wstring>>();
+		auto written = result->get_future();
+
+		GetChannel()->output()->add(image::create_consumer(params, result));
+
+		if(!written.timed_wait(boost::posix_time::seconds(env::properties().get(L"configuration.image.print-timeout-seconds", 10))))
+		{
+			SetReplyString(TEXT("502 PRINT FAILED\r\n"));
+			return false;
+		}
+
+		std::wstringstream replyString;
+		replyString << TEXT("201 PRINT OK\r\n") << written.get() << TEXT("\r\n");
+		SetReplyString(replyString.str());
+
+		return true;
+	}
+	catch(...)
+	{
+		CASPAR_LOG_CURRENT_EXCEPTION();
+		SetReplyString(TEXT("502 PRINT FAILED\r\n"));
+		return false;
+	}
 }
 
 bool LogCommand::DoExecute()
@@ -1814,12 +1928,22 @@ bool CinfCommand::DoExecute()
 	try
 	{
 		std::wstring info;
-		for (boost::filesystem::wrecursive_directory_iterator itr(env::media_folder()), end; itr != end; ++itr)
+		auto media_library = GetMediaLibrary();
+
+		if(media_library)
 		{
-			auto path = itr->path();
-			auto file = path.replace_extension(L"").filename();
-			if(boost::iequals(file, _parameters.at(0)))
-				info += MediaInfo(itr->path()) + L"\r\n";
+			BOOST_FOREACH(auto& media, media_library->find_by_filename(_parameters.at(0)))
+				info += MediaInfo(media, true) + L"\r\n";
+		}
+		else
+		{
+			for (boost::filesystem::wrecursive_directory_iterator itr(env::media_folder()), end; itr != end; ++itr)
+			{
+				auto path = itr->path();
+				auto file = path.replace_extension(L"").filename();
+				if(boost::iequals(file, _parameters.at(0)))
+					info += MediaInfo(itr->path()) + L"\r\n";
+			}
 		}
 
 		if(info.empty())
@@ -1909,6 +2033,7 @@ bool InfoCommand::DoExecute()
 			info.add(L"system.caspar.ffmpeg.avfilter",			caspar::ffmpeg::get_avfilter_version());
 			info.add(L"system.caspar.ffmpeg.avutil",			caspar::ffmpeg::get_avutil_version());
 			info.add(L"system.caspar.ffmpeg.swscale",			caspar::ffmpeg::get_swscale_version());
+			info.add_child(L"system.caspar.audio-buffer-pool",	caspar::core::audio_buffer_pool_info());
 									
 			boost::property_tree::write_xml(replyString, info, w);
 		}
@@ -1925,6 +2050,23 @@ bool InfoCommand::DoExecute()
 			
 			boost::property_tree::write_xml(replyString, info, w);
 		}
+		else if(_parameters.size() >= 1 && _parameters[0] == L"THUMBNAILS")
+		{
+			auto thumb_gen = GetThumbGenerator();
+
+			if (!thumb_gen)
+			{
+				SetReplyString(L"501 INFO THUMBNAILS ERROR\r\n");
+				return false;
+			}
+
+			replyString << L"201 INFO THUMBNAILS OK\r\n";
+
+			boost::property_tree::wptree info;
+			info.add_child(L"thumbnails", thumb_gen->info());
+
+			boost::property_tree::write_xml(replyString, info, w);
+		}
 		else if(_parameters.size() >= 2 && _parameters[1] == L"DELAY")
 		{
 			replyString << L"201 INFO DELAY OK\r\n";
@@ -2019,9 +2161,22 @@ bool ClsCommand::DoExecute()
 		tga = still
 		col = still
 	*/
+	std::wstring prefix;
+	std::wstring clip_type;
+
+	BOOST_FOREACH(auto& param, _parameters)
+	{
+		if(param == L"STILL" || param == L"MOVIE" || param == L"AUDIO")
+			clip_type = param;
+		else
+			prefix = ToLibraryPrefix(param);
+	}
+
+	auto media_library = GetMediaLibrary();
+
 	std::wstringstream replyString;
 	replyString << TEXT("200 CLS OK\r\n");
-	replyString << ListMedia();
+	replyString << (media_library ? ListMedia(*media_library, prefix, clip_type) : ListMedia());
 	replyString << TEXT("\r\n");
 	SetReplyString(boost::to_upper_copy(replyString.str()));
 	return true;
@@ -2032,7 +2187,8 @@ bool TlsCommand::DoExecute()
 	std::wstringstream replyString;
 	replyString << TEXT("200 TLS OK\r\n");
 
-	replyString << ListTemplates();
+	auto template_library = GetTemplateLibrary();
+	replyString << (template_library ? ListTemplates(*template_library, _parameters.empty() ? L"" : ToLibraryPrefix(_parameters[0])) : ListTemplates());
 	replyString << TEXT("\r\n");
 
 	SetReplyString(replyString.str());
@@ -2082,6 +2238,19 @@ bool SetCommand::DoExecute()
 		else
 			SetReplyString(TEXT("501 SET MODE FAILED\r\n"));
 	}
+	else if(name == TEXT("CLOCK"))
+	{
+		// SET 1 CLOCK OFFLINE [frames] renders the given number of frames and then holds the channel.
+		auto clock = core::channel_clock::parse(value, core::channel_clock::count);
+		if(clock != core::channel_clock::count)
+		{
+			GetChannel()->set_clock(clock);
+			GetChannel()->stage()->set_frame_budget(_parameters.size() > 2 ? boost::lexical_cast<int64_t>(_parameters[2]) : -1);
+			SetReplyString(TEXT("202 SET CLOCK OK\r\n"));
+		}
+		else
+			SetReplyString(TEXT("501 SET CLOCK FAILED\r\n"));
+	}
 	else
 	{
 		this->SetReplyString(TEXT("403 SET ERROR\r\n"));
@@ -56,9 +56,13 @@ inline std::shared_ptr<core::video_channel> GetChannelSafe(unsigned int index, c
 AMCPProtocolStrategy::AMCPProtocolStrategy(
 		const std::vector<safe_ptr<core::video_channel>>& channels,
 		const std::shared_ptr<core::thumbnail_generator>& thumb_gen,
+		const std::shared_ptr<core::media_library>& media_library,
+		const std::shared_ptr<core::media_library>& template_library,
 		boost::promise<bool>& shutdown_server_now)
 	: channels_(channels)
 	, thumb_gen_(thumb_gen)
+	, media_library_(media_library)
+	, template_library_(template_library)
 	, shutdown_server_now_(shutdown_server_now)
 {
 	AMCPCommandQueuePtr pGeneralCommandQueue(new AMCPCommandQueue());
@@ -200,6 +204,8 @@ AMCPCommandPtr AMCPProtocolStrategy::InterpretCommandString(const std::wstring&
 			{
 				pCommand->SetChannels(channels_);
 				pCommand->SetThumbGenerator(thumb_gen_);
+				pCommand->SetMediaLibrary(media_library_);
+				pCommand->SetTemplateLibrary(template_library_);
 				pCommand->SetShutdownServerNow(shutdown_server_now_);
 				//Set scheduling
 				if(commandSwitch.size() > 0) {
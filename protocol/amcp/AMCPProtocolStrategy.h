@@ -24,6 +24,7 @@
 #include "../util/protocolstrategy.h"
 #include <core/video_channel.h>
 #include <core/thumbnail_generator.h>
+#include <core/media_library.h>
 
 #include "AMCPCommand.h"
 #include "AMCPCommandQueue.h"
@@ -51,6 +52,8 @@ public:
 	AMCPProtocolStrategy(
 			const std::vector<safe_ptr<core::video_channel>>& channels,
 			const std::shared_ptr<core::thumbnail_generator>& thumb_gen,
+			const std::shared_ptr<core::media_library>& media_library,
+			const std::shared_ptr<core::media_library>& template_library,
 			boost::promise<bool>& shutdown_server_now);
 	virtual ~AMCPProtocolStrategy();
 
@@ -72,6 +75,8 @@ private:
 
 	std::vector<safe_ptr<core::video_channel>> channels_;
 	std::shared_ptr<core::thumbnail_generator> thumb_gen_;
+	std::shared_ptr<core::media_library> media_library_;
+	std::shared_ptr<core::media_library> template_library_;
 	boost::promise<bool>& shutdown_server_now_;
 	std::vector<AMCPCommandQueuePtr> commandQueues_;
 	static const std::wstring MessageDelimiter;
@@ -37,6 +37,7 @@
 #include <core/consumer/output.h>
 #include <core/consumer/synchronizing/synchronizing_consumer.h>
 #include <core/thumbnail_generator.h>
+#include <core/media_library.h>
 
 #include <modules/bluefish/bluefish.h>
 #include <modules/decklink/decklink.h>
@@ -54,6 +55,7 @@
 #include <modules/decklink/consumer/blocking_decklink_consumer.h>
 #include <modules/ogl/consumer/ogl_consumer.h>
 #include <modules/ffmpeg/consumer/ffmpeg_consumer.h>
+#include <modules/ffmpeg/producer/util/util.h>
 
 #include <protocol/amcp/AMCPProtocolStrategy.h>
 #include <protocol/cii/CIIProtocolStrategy.h>
@@ -79,17 +81,19 @@ struct server::implementation : boost::noncopyable
 	protocol::asio::io_service_manager			io_service_manager_;
 	core::monitor::subject						monitor_subject_;
 	boost::promise<bool>&						shutdown_server_now_;
-	safe_ptr<ogl_device>						ogl_;
+	std::shared_ptr<ogl_device>					ogl_; // nullptr when using the cpu image mixer.
 	std::vector<safe_ptr<IO::AsyncEventServer>> async_servers_;	
 	std::shared_ptr<IO::AsyncEventServer>		primary_amcp_server_;
 	osc::client									osc_client_;
 	std::vector<std::shared_ptr<void>>			predefined_osc_subscriptions_;
 	std::vector<safe_ptr<video_channel>>		channels_;
 	std::shared_ptr<thumbnail_generator>		thumbnail_generator_;
+	std::shared_ptr<media_library>				media_library_;
+	std::shared_ptr<media_library>				template_library_;
 
 	implementation(boost::promise<bool>& shutdown_server_now)
 		: shutdown_server_now_(shutdown_server_now)
-		, ogl_(ogl_device::create())
+		, ogl_(create_accelerator(env::properties()))
 		, osc_client_(io_service_manager_.service(), monitor_subject_)
 	{
 		setup_audio(env::properties());
@@ -120,6 +124,9 @@ struct server::implementation : boost::noncopyable
 
 		setup_thumbnail_generation(env::properties());
 
+		setup_media_library(env::properties());
+		CASPAR_LOG(info) << L"Initialized media library.";
+
 		setup_controllers(env::properties());
 		CASPAR_LOG(info) << L"Initialized controllers.";
 
@@ -129,6 +136,8 @@ struct server::implementation : boost::noncopyable
 
 	~implementation()
 	{		
+		media_library_.reset();
+		template_library_.reset();
 		ffmpeg::uninit();
 
 		thumbnail_generator_.reset();
@@ -137,6 +146,31 @@ struct server::implementation : boost::noncopyable
 		channels_.clear();
 	}
 
+	static std::shared_ptr<ogl_device> create_accelerator(const boost::property_tree::wptree& pt)
+	{
+		auto accelerator = pt.get(L"configuration.accelerator", L"auto");
+
+		if(accelerator == L"cpu")
+		{
+			CASPAR_LOG(info) << L"Using cpu image mixer.";
+			return nullptr;
+		}
+
+		try
+		{
+			return ogl_device::create();
+		}
+		catch(...)
+		{
+			if(accelerator == L"gpu")
+				throw;
+
+			CASPAR_LOG_CURRENT_EXCEPTION();
+			CASPAR_LOG(warning) << L"Failed to initialize OpenGL. Falling back to cpu image mixer.";
+			return nullptr;
+		}
+	}
+
 	void setup_audio(const boost::property_tree::wptree& pt)
 	{
 		register_default_channel_layouts(default_channel_layout_repository());
@@ -172,12 +206,16 @@ struct server::implementation : boost::noncopyable
 			channels_.back()->monitor_output().link_target(&monitor_subject_);
 			channels_.back()->mixer()->set_straight_alpha_output(
 					xml_channel.second.get(L"straight-alpha-output", false));
+			channels_.back()->set_clock(
+					core::channel_clock::parse(xml_channel.second.get(L"clock", L"realtime")));
 
 			create_consumers(
 				xml_channel.second.get_child(L"consumers"),
-				[&] (const safe_ptr<core::frame_consumer>& consumer)
+				[&] (const boost::property_tree::wptree& xml_consumer, const safe_ptr<core::frame_consumer>& consumer)
 				{
-					channels_.back()->output()->add(consumer);
+					auto queue_policy	= core::consumer_queue_policy::parse(xml_consumer.get(L"queue-policy", L"auto"));
+					auto queue_depth	= xml_consumer.get(L"queue-depth", 0);
+					channels_.back()->output()->add(consumer, queue_policy, queue_depth);
 				});
 		}
 
@@ -191,7 +229,7 @@ struct server::implementation : boost::noncopyable
 	{
 		std::vector<safe_ptr<Base>> consumers;
 
-		create_consumers(pt, [&] (const safe_ptr<core::frame_consumer>& consumer)
+		create_consumers(pt, [&] (const boost::property_tree::wptree&, const safe_ptr<core::frame_consumer>& consumer)
 		{
 			consumers.push_back(dynamic_pointer_cast<Base>(consumer));
 		});
@@ -209,19 +247,19 @@ struct server::implementation : boost::noncopyable
 				auto name = xml_consumer.first;
 
 				if (name == L"screen")
-					on_consumer(ogl::create_consumer(xml_consumer.second));
+					on_consumer(xml_consumer.second, ogl::create_consumer(xml_consumer.second));
 				else if (name == L"bluefish")					
-					on_consumer(bluefish::create_consumer(xml_consumer.second));					
+					on_consumer(xml_consumer.second, bluefish::create_consumer(xml_consumer.second));					
 				else if (name == L"decklink")					
-					on_consumer(decklink::create_consumer(xml_consumer.second));				
+					on_consumer(xml_consumer.second, decklink::create_consumer(xml_consumer.second));				
 				else if (name == L"blocking-decklink")
-					on_consumer(decklink::create_blocking_consumer(xml_consumer.second));				
+					on_consumer(xml_consumer.second, decklink::create_blocking_consumer(xml_consumer.second));				
 				else if (name == L"file" || name == L"stream")					
-					on_consumer(ffmpeg::create_consumer(xml_consumer.second));						
+					on_consumer(xml_consumer.second, ffmpeg::create_consumer(xml_consumer.second));						
 				else if (name == L"system-audio")
-					on_consumer(portaudio::create_consumer());
+					on_consumer(xml_consumer.second, portaudio::create_consumer());
 				else if (name == L"synchronizing")
-					on_consumer(make_safe<core::synchronizing_consumer>(
+					on_consumer(xml_consumer.second, make_safe<core::synchronizing_consumer>(
 							create_consumers<core::frame_consumer>(
 									xml_consumer.second)));
 				else if (name != L"<xmlcomment>")
@@ -320,17 +358,77 @@ struct server::implementation : boost::noncopyable
 				pt.get(L"configuration.thumbnails.width", 256),
 				pt.get(L"configuration.thumbnails.height", 144),
 				core::video_format_desc::get(pt.get(L"configuration.thumbnails.video-mode", L"720p2500")),
-				ogl_,
+				pt.get(L"configuration.thumbnails.workers", 2),
 				pt.get(L"configuration.thumbnails.generate-delay-millis", 2000),
 				&image::write_cropped_png));
 
 		CASPAR_LOG(info) << L"Initialized thumbnail generator.";
 	}
 
+	static bool extract_media_info(const boost::filesystem::wpath& file, media_info& info)
+	{
+		std::wstring extension = boost::to_upper_copy(file.extension());
+		bool probe = true;
+
+		if(extension == TEXT(".TGA") || extension == TEXT(".COL") || extension == L".PNG" || extension == L".JPEG" || extension == L".JPG" ||
+			extension == L"GIF" || extension == L"BMP")
+		{
+			info.clip_type = L"STILL";
+			probe = false;
+		}
+		else if(extension == TEXT(".WAV") || extension == TEXT(".MP3"))
+			info.clip_type = L"AUDIO";
+		else if(extension == TEXT(".SWF") || extension == TEXT(".CT") || extension == TEXT(".STGA"))
+		{
+			info.clip_type = L"MOVIE";
+			probe = false;
+		}
+		else if(extension == TEXT(".DV") || extension == TEXT(".MOV") || 
+				extension == TEXT(".MPG") || extension == TEXT(".AVI") || 
+				extension == TEXT(".MP4") || extension == TEXT(".FLV") || 
+				ffmpeg::is_valid_file(file.file_string()))
+			info.clip_type = L"MOVIE";
+		else
+			return false;
+
+		if(probe)
+			ffmpeg::get_media_info(file.file_string(), info);
+
+		return true;
+	}
+
+	static bool extract_template_info(const boost::filesystem::wpath& file, media_info& info)
+	{
+		if(file.extension() != L".ft" && file.extension() != L".ct")
+			return false;
+
+		info.clip_type = L"TEMPLATE";
+		return true;
+	}
+
+	void setup_media_library(const boost::property_tree::wptree& pt)
+	{
+		polling_filesystem_monitor_factory monitor_factory(
+				io_service_manager_.service(),
+				pt.get(L"configuration.media-library.scan-interval-millis", 5000));
+
+		media_library_.reset(new media_library(
+				monitor_factory,
+				env::media_folder(),
+				boost::filesystem::wpath(env::data_folder()) / L"media.library",
+				&extract_media_info));
+
+		template_library_.reset(new media_library(
+				monitor_factory,
+				env::template_folder(),
+				boost::filesystem::wpath(env::data_folder()) / L"templates.library",
+				&extract_template_info));
+	}
+
 	safe_ptr<IO::IProtocolStrategy> create_protocol(const std::wstring& name) const
 	{
 		if(boost::iequals(name, L"AMCP"))
-			return make_safe<amcp::AMCPProtocolStrategy>(channels_, thumbnail_generator_, shutdown_server_now_);
+			return make_safe<amcp::AMCPProtocolStrategy>(channels_, thumbnail_generator_, media_library_, template_library_, shutdown_server_now_);
 		else if(boost::iequals(name, L"CII"))
 			return make_safe<cii::CIIProtocolStrategy>(channels_);
 		else if(boost::iequals(name, L"CLOCK"))